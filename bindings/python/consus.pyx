@@ -65,9 +65,15 @@ cdef extern from "consus.h":
         CONSUS_COORD_FAIL    = 6787
         CONSUS_UNAVAILABLE   = 6788
         CONSUS_SERVER_ERROR  = 6789
+        CONSUS_THROTTLED     = 6790
         CONSUS_INTERNAL      = 6910
         CONSUS_GARBAGE       = 6911
 
+    cdef enum consus_priority:
+        CONSUS_PRIORITY_INTERACTIVE = 0
+        CONSUS_PRIORITY_NORMAL      = 1
+        CONSUS_PRIORITY_BATCH       = 2
+
     cdef struct consus_client
     cdef struct consus_transaction
     consus_client* consus_create(const char* coordinator, uint16_t port)
@@ -83,6 +89,7 @@ cdef extern from "consus.h":
     const char* consus_error_location(consus_client* client)
     const char* consus_returncode_to_string(consus_returncode)
     int64_t consus_begin_transaction(consus_client* client, consus_returncode* status, consus_transaction** xact)
+    int64_t consus_begin_transaction_with_priority(consus_client* client, consus_priority priority, consus_returncode* status, consus_transaction** xact)
     int64_t consus_commit_transaction(consus_transaction* xact, consus_returncode* status)
     int64_t consus_abort_transaction(consus_transaction* xact, consus_returncode* status)
     int64_t consus_restart_transaction(consus_transaction* xact, consus_returncode* status)
@@ -137,6 +144,7 @@ class ConsusSeeErrnoException(ConsusException): pass
 class ConsusCoordFailException(ConsusException): pass
 class ConsusUnavailableException(ConsusException): pass
 class ConsusServerErrorException(ConsusException): pass
+class ConsusThrottledException(ConsusException): pass
 class ConsusInternalException(ConsusException): pass
 class ConsusGarbageException(ConsusException): pass
 
@@ -164,8 +172,8 @@ cdef class Client:
         if self.client:
             consus_destroy(self.client)
 
-    def begin_transaction(self):
-        return Transaction(self)
+    def begin_transaction(self, priority=CONSUS_PRIORITY_NORMAL):
+        return Transaction(self, priority)
 
     cdef finish(self, int64_t req, consus_returncode* rstatus):
         cdef consus_returncode lstatus
@@ -192,6 +200,7 @@ cdef class Client:
                      CONSUS_COORD_FAIL: ConsusCoordFailException,
                      CONSUS_UNAVAILABLE: ConsusUnavailableException,
                      CONSUS_SERVER_ERROR: ConsusServerErrorException,
+                     CONSUS_THROTTLED: ConsusThrottledException,
                      CONSUS_INTERNAL: ConsusInternalException,
                      CONSUS_GARBAGE: ConsusGarbageException}.get(status, ConsusInternalException)
         raise exception(status, consus_error_message(self.client).decode('ascii', 'ignore'))
@@ -201,10 +210,10 @@ cdef class Transaction:
     cdef Client client
     cdef consus_transaction* xact
 
-    def __cinit__(self, Client client):
+    def __cinit__(self, Client client, priority=CONSUS_PRIORITY_NORMAL):
         cdef consus_returncode status
         self.client = client
-        req = consus_begin_transaction(self.client.client, &status, &self.xact)
+        req = consus_begin_transaction_with_priority(self.client.client, priority, &status, &self.xact)
         self.finish(req, &status)
         assert self.xact
 
@@ -254,5 +263,10 @@ cdef class Transaction:
         req = consus_abort_transaction(self.xact, &status)
         self.finish(req, &status)
 
+    def restart(self):
+        cdef consus_returncode status
+        req = consus_restart_transaction(self.xact, &status)
+        self.finish(req, &status)
+
     cdef finish(self, int64_t req, consus_returncode* rstatus):
         return self.client.finish(req, rstatus)
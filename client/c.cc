@@ -32,9 +32,11 @@
 #include <signal.h>
 
 // C++
+#include <memory>
 #include <new>
 
 // e
+#include <e/buffer.h>
 #include <e/guard.h>
 
 // consus
@@ -43,6 +45,7 @@
 #include "common/macros.h"
 #include "client/client.h"
 #include "client/transaction.h"
+#include "client/value_view.h"
 
 #define FAKE_STATUS consus_returncode _status; consus_returncode* status = &_status
 
@@ -210,6 +213,7 @@ consus_returncode_to_string(consus_returncode stat)
         CSTRINGIFY(CONSUS_COORD_FAIL);
         CSTRINGIFY(CONSUS_UNAVAILABLE);
         CSTRINGIFY(CONSUS_SERVER_ERROR);
+        CSTRINGIFY(CONSUS_THROTTLED);
         CSTRINGIFY(CONSUS_INTERNAL);
         CSTRINGIFY(CONSUS_GARBAGE);
         default:
@@ -223,7 +227,27 @@ consus_begin_transaction(consus_client* client,
                          consus_transaction** xact)
 {
     C_WRAP_EXCEPT(
-    return cl->begin_transaction(status, xact);
+    return cl->begin_transaction(CONSUS_PRIORITY_NORMAL, status, xact);
+    );
+}
+
+CONSUS_API int64_t
+consus_begin_transaction_with_priority(consus_client* client,
+                                       consus_priority priority,
+                                       consus_returncode* status,
+                                       consus_transaction** xact)
+{
+    C_WRAP_EXCEPT(
+    return cl->begin_transaction(priority, status, xact);
+    );
+}
+
+CONSUS_API int64_t
+consus_restart_transaction(consus_transaction* xact,
+                           consus_returncode* status)
+{
+    C_WRAP_EXCEPT_XACT(
+    return tx->restart(status);
     );
 }
 
@@ -233,6 +257,82 @@ consus_destroy_transaction(consus_transaction* xact)
     delete reinterpret_cast<consus::transaction*>(xact);
 }
 
+CONSUS_API int
+consus_retry_transaction(consus_client* client,
+                         consus_priority priority,
+                         consus_transaction_body body, void* arg,
+                         unsigned max_attempts,
+                         consus_returncode* status)
+{
+    C_WRAP_EXCEPT(
+    consus_transaction* xact = NULL;
+    consus_returncode op_status;
+    int64_t id = cl->begin_transaction(priority, &op_status, &xact);
+
+    if (id < 0 || cl->wait(id, -1, status) < 0)
+    {
+        return -1;
+    }
+
+    if (op_status != CONSUS_SUCCESS)
+    {
+        *status = op_status;
+        return -1;
+    }
+
+    std::auto_ptr<consus::transaction> tx(reinterpret_cast<consus::transaction*>(xact));
+
+    for (unsigned attempt = 1; ; ++attempt)
+    {
+        *status = body(xact, arg);
+
+        if (*status == CONSUS_SUCCESS || *status == CONSUS_COMMITTED)
+        {
+            return 0;
+        }
+
+        if (!consus::transaction::retryable(*status) || attempt >= max_attempts)
+        {
+            return -1;
+        }
+
+        const consus_returncode reason = *status;
+
+        // the servers may still consider the attempt live; abort it so that
+        // its locks go away and the restart may inherit its age
+        if (reason != CONSUS_ABORTED)
+        {
+            id = tx->abort(&op_status);
+
+            if (id < 0 || cl->wait(id, -1, status) < 0)
+            {
+                return -1;
+            }
+        }
+
+        tx->mark_aborted(reason);
+        id = tx->restart(&op_status);
+
+        if (id < 0 || cl->wait(id, -1, status) < 0)
+        {
+            return -1;
+        }
+
+        if (op_status != CONSUS_SUCCESS)
+        {
+            *status = op_status;
+            return -1;
+        }
+    }
+    );
+}
+
+CONSUS_API void
+consus_set_read_cache(consus_client* client, size_t max_entries)
+{
+    reinterpret_cast<consus::client*>(client)->set_read_cache(max_entries);
+}
+
 CONSUS_API int64_t
 consus_get(consus_transaction* xact,
            const char* table,
@@ -245,6 +345,26 @@ consus_get(consus_transaction* xact,
     );
 }
 
+CONSUS_API int64_t
+consus_get_view(consus_transaction* xact,
+                const char* table,
+                const char* key, size_t key_sz,
+                consus_returncode* status,
+                consus_value** handle,
+                const char** value, size_t* value_sz)
+{
+    C_WRAP_EXCEPT_XACT(
+    return tx->get(table, key, key_sz, status, const_cast<char**>(value), value_sz,
+                   reinterpret_cast<e::buffer**>(handle));
+    );
+}
+
+CONSUS_API void
+consus_release_value(consus_value* handle)
+{
+    consus::release_value_view(reinterpret_cast<e::buffer*>(handle));
+}
+
 CONSUS_API int64_t
 consus_put(consus_transaction* xact,
            const char* table,
@@ -275,6 +395,29 @@ consus_abort_transaction(consus_transaction* xact,
     );
 }
 
+CONSUS_API int64_t
+consus_tail_changes(consus_client* client,
+                    consus_change_cursor* cursor,
+                    consus_returncode* status,
+                    consus_change** changes, size_t* changes_sz)
+{
+    C_WRAP_EXCEPT(
+    return cl->tail_changes(cursor, status, changes, changes_sz);
+    );
+}
+
+CONSUS_API int64_t
+consus_index_lookup(consus_client* client,
+                    const char* table, const char* field,
+                    const char* value, size_t value_sz,
+                    consus_returncode* status,
+                    consus_index_entry** keys, size_t* keys_sz)
+{
+    C_WRAP_EXCEPT(
+    return cl->index_lookup(table, field, value, value_sz, status, keys, keys_sz);
+    );
+}
+
 CONSUS_API int
 consus_debug_client_configuration(consus_client* client,
                                   consus_returncode* status,
@@ -323,6 +466,35 @@ consus_admin_set_default_data_center(consus_client* client, const char* name,
     );
 }
 
+CONSUS_API int
+consus_admin_set_quota(consus_client* client, const char* table,
+                       uint64_t ops_per_second, uint64_t bytes_per_second,
+                       consus_returncode* status)
+{
+    C_WRAP_EXCEPT(
+    return cl->set_quota(table, ops_per_second, bytes_per_second, status);
+    );
+}
+
+CONSUS_API int
+consus_admin_set_idle_timeout(consus_client* client, const char* table,
+                              uint64_t milliseconds, consus_returncode* status)
+{
+    C_WRAP_EXCEPT(
+    return cl->set_idle_timeout(table, milliseconds, status);
+    );
+}
+
+CONSUS_API int
+consus_admin_create_index(consus_client* client,
+                          const char* table, const char* field,
+                          consus_returncode* status)
+{
+    C_WRAP_EXCEPT(
+    return cl->create_index(table, field, status);
+    );
+}
+
 CONSUS_API int
 consus_admin_availability_check(consus_client* client,
                                 consus_availability_requirements* reqs,
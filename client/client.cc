@@ -38,11 +38,15 @@
 #include "common/kvs_configuration.h"
 #include "common/macros.h"
 #include "common/paxos_group.h"
+#include "common/quota.h"
+#include "common/secondary_index.h"
 #include "common/txman_configuration.h"
 #include "client/client.h"
 #include "client/pending.h"
 #include "client/pending_begin_transaction.h"
+#include "client/pending_index_lookup.h"
 #include "client/pending_string.h"
+#include "client/pending_tail_changes.h"
 
 using consus::client;
 
@@ -73,11 +77,16 @@ client :: client(const char* host, uint16_t port)
     , m_config_data_sz(0)
     , m_busybee_controller(&m_config)
     , m_busybee(busybee_client::create(&m_busybee_controller))
+    , m_chunks()
+    , m_chunk_sender()
+    , m_local()
     , m_next_client_id(1)
     , m_next_server_nonce(1)
     , m_pending()
     , m_returnable()
+    , m_deferred()
     , m_returned()
+    , m_read_cache()
     , m_flagfd()
     , m_last_error()
 {
@@ -86,7 +95,8 @@ client :: client(const char* host, uint16_t port)
         throw std::bad_alloc();
     }
 
-    busybee_returncode rc = m_busybee->set_external_fd(replicant_client_poll_fd(m_coord));
+    int fd = m_local.external_fd(replicant_client_poll_fd(m_coord));
+    busybee_returncode rc = m_busybee->set_external_fd(fd);
     assert(rc == BUSYBEE_SUCCESS);
 }
 
@@ -100,11 +110,16 @@ client :: client(const char* conn_str)
     , m_config_data_sz(0)
     , m_busybee_controller(&m_config)
     , m_busybee(busybee_client::create(&m_busybee_controller))
+    , m_chunks()
+    , m_chunk_sender()
+    , m_local()
     , m_next_client_id(1)
     , m_next_server_nonce(1)
     , m_pending()
     , m_returnable()
+    , m_deferred()
     , m_returned()
+    , m_read_cache()
     , m_flagfd()
     , m_last_error()
 {
@@ -113,7 +128,8 @@ client :: client(const char* conn_str)
         throw std::bad_alloc();
     }
 
-    busybee_returncode rc = m_busybee->set_external_fd(replicant_client_poll_fd(m_coord));
+    int fd = m_local.external_fd(replicant_client_poll_fd(m_coord));
+    busybee_returncode rc = m_busybee->set_external_fd(fd);
     assert(rc == BUSYBEE_SUCCESS);
 }
 
@@ -128,8 +144,10 @@ client :: loop(int timeout, consus_returncode* status)
     *status = CONSUS_SUCCESS;
     m_last_error = e::error();
 
-    while (!m_returnable.empty() || !m_pending.empty())
+    while (!m_returnable.empty() || !m_pending.empty() || !m_deferred.empty())
     {
+        int inner_timeout = kickstart_deferred(timeout);
+
         if (!m_returnable.empty())
         {
             m_returned = m_returnable.front();
@@ -138,7 +156,7 @@ client :: loop(int timeout, consus_returncode* status)
             return m_returned->client_id();
         }
 
-        if (inner_loop(timeout, status) < 0)
+        if (inner_loop(inner_timeout, status) < 0)
         {
             return -1;
         }
@@ -155,6 +173,8 @@ client :: wait(int64_t id, int timeout, consus_returncode* status)
 
     while (true)
     {
+        int inner_timeout = kickstart_deferred(timeout);
+
         for (std::list<e::intrusive_ptr<pending> >::iterator it = m_returnable.begin();
                 it != m_returnable.end(); ++it)
         {
@@ -169,7 +189,7 @@ client :: wait(int64_t id, int timeout, consus_returncode* status)
             }
         }
 
-        if (inner_loop(timeout, status) < 0)
+        if (inner_loop(inner_timeout, status) < 0)
         {
             return -1;
         }
@@ -179,7 +199,8 @@ client :: wait(int64_t id, int timeout, consus_returncode* status)
 }
 
 int64_t
-client :: begin_transaction(consus_returncode* status,
+client :: begin_transaction(consus_priority priority,
+                            consus_returncode* status,
                             consus_transaction** xact)
 {
     if (!maintain_coord_connection(status))
@@ -188,11 +209,61 @@ client :: begin_transaction(consus_returncode* status,
     }
 
     int64_t client_id = generate_new_client_id();
-    pending* p = new pending_begin_transaction(client_id, status, xact);
+    pending* p = new pending_begin_transaction(client_id, priority, status, xact);
     p->kickstart_state_machine(this);
     return client_id;
 }
 
+int64_t
+client :: tail_changes(consus_change_cursor* cursor,
+                       consus_returncode* status,
+                       consus_change** changes, size_t* changes_sz)
+{
+    if (!maintain_coord_connection(status))
+    {
+        return -1;
+    }
+
+    int64_t client_id = generate_new_client_id();
+    pending* p = new pending_tail_changes(client_id, cursor, status, changes, changes_sz);
+    p->kickstart_state_machine(this);
+    return client_id;
+}
+
+int64_t
+client :: index_lookup(const char* table, const char* field,
+                       const char* value, size_t value_sz,
+                       consus_returncode* status,
+                       consus_index_entry** keys, size_t* keys_sz)
+{
+    if (!maintain_coord_connection(status))
+    {
+        return -1;
+    }
+
+    unsigned char* binval = NULL;
+    size_t binval_sz = 0;
+
+    if (treadstone_json_sz_to_binary(value, value_sz, &binval, &binval_sz) < 0)
+    {
+        ERROR(INVALID) << "value contains invalid JSON";
+        return -1;
+    }
+
+    int64_t client_id = generate_new_client_id();
+    pending* p = new pending_index_lookup(client_id, status, table, field,
+                                          binval, binval_sz, keys, keys_sz);
+    free(binval);
+    p->kickstart_state_machine(this);
+    return client_id;
+}
+
+void
+client :: set_read_cache(size_t max_entries)
+{
+    m_read_cache.set_capacity(max_entries);
+}
+
 int
 client :: create_data_center(const char* name, consus_returncode* status)
 {
@@ -277,6 +348,77 @@ client :: set_default_data_center(const char* name, consus_returncode* status)
     return 0;
 }
 
+int
+client :: set_quota(const char* table, uint64_t ops_per_second,
+                     uint64_t bytes_per_second, consus_returncode* status)
+{
+    quota q(table ? quota::TABLE : quota::CLIENT, table ? table : "",
+            ops_per_second, bytes_per_second, 0);
+    std::string tmp;
+    e::packer(&tmp) << q;
+    replicant_returncode rc;
+    char* data = NULL;
+    size_t data_sz = 0;
+    int64_t id = replicant_client_call(m_coord, "consus", "quota_set",
+                                       tmp.data(), tmp.size(), REPLICANT_CALL_ROBUST,
+                                       &rc, &data, &data_sz);
+
+    if (!replicant_finish(id, &rc, status))
+    {
+        return -1;
+    }
+
+    if (data) free(data);
+    return 0;
+}
+
+int
+client :: set_idle_timeout(const char* table, uint64_t milliseconds,
+                            consus_returncode* status)
+{
+    quota q(table ? quota::TABLE : quota::CLIENT, table ? table : "",
+            0, 0, milliseconds);
+    std::string tmp;
+    e::packer(&tmp) << q;
+    replicant_returncode rc;
+    char* data = NULL;
+    size_t data_sz = 0;
+    int64_t id = replicant_client_call(m_coord, "consus", "idle_timeout_set",
+                                       tmp.data(), tmp.size(), REPLICANT_CALL_ROBUST,
+                                       &rc, &data, &data_sz);
+
+    if (!replicant_finish(id, &rc, status))
+    {
+        return -1;
+    }
+
+    if (data) free(data);
+    return 0;
+}
+
+int
+client :: create_index(const char* table, const char* field,
+                       consus_returncode* status)
+{
+    secondary_index si(table, field);
+    std::string tmp;
+    e::packer(&tmp) << si;
+    replicant_returncode rc;
+    char* data = NULL;
+    size_t data_sz = 0;
+    int64_t id = replicant_client_call(m_coord, "consus", "index_create",
+                                       tmp.data(), tmp.size(), REPLICANT_CALL_ROBUST,
+                                       &rc, &data, &data_sz);
+
+    if (!replicant_finish(id, &rc, status))
+    {
+        return -1;
+    }
+
+    if (data) free(data);
+    return 0;
+}
+
 int
 client :: availability_check(consus_availability_requirements* reqs,
                              int timeout,
@@ -328,7 +470,9 @@ client :: availability_check(consus_availability_requirements* reqs,
         std::vector<txman_state> txmans;
         std::vector<paxos_group> txman_groups;
         std::vector<kvs> kvss;
-        up = txman_configuration(up, &cid, &vid, &flags, &dcs, &txmans, &txman_groups, &kvss);
+        std::vector<quota> quotas;
+        std::vector<secondary_index> indexes;
+        up = txman_configuration(up, &cid, &vid, &flags, &dcs, &txmans, &txman_groups, &kvss, &quotas, &indexes);
 
         if (data)
         {
@@ -523,7 +667,9 @@ client :: debug_txman_configuration(consus_returncode* status, const char** str)
     std::vector<txman_state> txmans;
     std::vector<paxos_group> txman_groups;
     std::vector<kvs> kvss;
-    up = txman_configuration(up, &cid, &vid, &flags, &dcs, &txmans, &txman_groups, &kvss);
+    std::vector<quota> quotas;
+    std::vector<secondary_index> indexes;
+    up = txman_configuration(up, &cid, &vid, &flags, &dcs, &txmans, &txman_groups, &kvss, &quotas, &indexes);
     free(data);
 
     if (up.error())
@@ -532,7 +678,7 @@ client :: debug_txman_configuration(consus_returncode* status, const char** str)
         return -1;
     }
 
-    std::string s = txman_configuration(cid, vid, flags, dcs, txmans, txman_groups, kvss);
+    std::string s = txman_configuration(cid, vid, flags, dcs, txmans, txman_groups, kvss, quotas, indexes);
     e::intrusive_ptr<pending_string> p = new pending_string(s);
     *str = p->string();
     m_returned = p.get();
@@ -627,10 +773,25 @@ client :: add_to_returnable(pending* p)
     m_returnable.push_back(p);
 }
 
+void
+client :: kickstart_after(pending* p, uint64_t delay)
+{
+    if (delay == 0)
+    {
+        p->kickstart_state_machine(this);
+        return;
+    }
+
+    const uint64_t when = po6::monotonic_time() + delay;
+    m_deferred.push_back(std::make_pair(when, e::intrusive_ptr<pending>(p)));
+}
+
 bool
 client :: send(uint64_t nonce, comm_id id, std::auto_ptr<e::buffer> msg, pending* p)
 {
-    busybee_returncode rc = m_busybee->send(id.get(), msg);
+    busybee_returncode rc = m_local.reaches(id, m_config.get_address(id))
+                          ? send_chunked(&m_local, id.get(), &m_chunk_sender, msg)
+                          : send_chunked(m_busybee.get(), id.get(), &m_chunk_sender, msg);
 
     if (rc == BUSYBEE_DISRUPTED)
     {
@@ -645,9 +806,25 @@ client :: send(uint64_t nonce, comm_id id, std::auto_ptr<e::buffer> msg, pending
     return rc == BUSYBEE_SUCCESS;
 }
 
+void
+client :: send_chunk_control(comm_id id, std::auto_ptr<e::buffer> msg)
+{
+    busybee_returncode rc = m_local.reaches(id, m_config.get_address(id))
+                          ? m_local.send(id.get(), msg)
+                          : m_busybee->send(id.get(), msg);
+
+    if (rc == BUSYBEE_DISRUPTED)
+    {
+        handle_disruption(id);
+    }
+}
+
 void
 client :: handle_disruption(const comm_id& id)
 {
+    m_chunks.forget(id);
+    m_chunk_sender.forget(id);
+
     for (std::map<std::pair<comm_id, uint64_t>, e::intrusive_ptr<pending> >::iterator it = m_pending.begin();
             it != m_pending.end(); )
     {
@@ -668,10 +845,20 @@ client :: handle_disruption(const comm_id& id)
 int64_t
 client :: inner_loop(int timeout, consus_returncode* status)
 {
-    uint64_t cid_num;
+    comm_id id;
+    uint64_t cid_num = 0;
     std::auto_ptr<e::buffer> msg;
-    busybee_returncode rc = m_busybee->recv(timeout, &cid_num, &msg);
-    comm_id id(cid_num);
+    busybee_returncode rc = BUSYBEE_SUCCESS;
+
+    if (m_local.recv(&id, &msg))
+    {
+        cid_num = id.get();
+    }
+    else
+    {
+        rc = m_busybee->recv(m_local.prepare_to_wait() ? timeout : 0, &cid_num, &msg);
+        id = comm_id(cid_num);
+    }
 
     switch (rc)
     {
@@ -686,11 +873,7 @@ client :: inner_loop(int timeout, consus_returncode* status)
             handle_disruption(id);
             return 0;
         case BUSYBEE_EXTERNAL:
-            if (!maintain_coord_connection(status))
-            {
-                return -1;
-            }
-            return 0;
+            return handle_external(status) ? 0 : -1;
         case BUSYBEE_SEE_ERRNO:
             ERROR(SEE_ERRNO) << po6::strerror(errno);
             return -1;
@@ -704,7 +887,40 @@ client :: inner_loop(int timeout, consus_returncode* status)
     network_msgtype msg_type;
     uint64_t nonce;
     e::unpacker up = msg->unpack_from(BUSYBEE_HEADER_SIZE);
-    up = up >> msg_type >> nonce;
+    up = up >> msg_type;
+
+    // a large response arrives in pieces; hand it off once it is whole
+    if (!up.error() && msg_type == CONSUS_CHUNK_ACK)
+    {
+        std::auto_ptr<e::buffer> chunk = m_chunk_sender.acknowledged(id, up);
+
+        if (chunk.get())
+        {
+            send_chunk_control(id, chunk);
+        }
+
+        return 0;
+    }
+
+    if (!up.error() && msg_type == CONSUS_CHUNK)
+    {
+        std::auto_ptr<e::buffer> ack = make_chunk_ack(up);
+
+        if (ack.get())
+        {
+            send_chunk_control(id, ack);
+        }
+
+        if (!m_chunks.reassemble(id, up, &msg))
+        {
+            return 0;
+        }
+
+        up = msg->unpack_from(BUSYBEE_HEADER_SIZE);
+        up = up >> msg_type;
+    }
+
+    up = up >> nonce;
 
     if (up.error() || msg_type != CLIENT_RESPONSE)
     {
@@ -729,6 +945,35 @@ client :: inner_loop(int timeout, consus_returncode* status)
     return 0;
 }
 
+int
+client :: kickstart_deferred(int timeout)
+{
+    const uint64_t now = po6::monotonic_time();
+
+    for (std::list<std::pair<uint64_t, e::intrusive_ptr<pending> > >::iterator it = m_deferred.begin();
+            it != m_deferred.end(); )
+    {
+        if (it->first <= now)
+        {
+            e::intrusive_ptr<pending> p = it->second;
+            it = m_deferred.erase(it);
+            p->kickstart_state_machine(this);
+            continue;
+        }
+
+        const int ms = (it->first - now + PO6_MILLIS - 1) / PO6_MILLIS;
+
+        if (timeout < 0 || ms < timeout)
+        {
+            timeout = ms;
+        }
+
+        ++it;
+    }
+
+    return timeout;
+}
+
 int64_t
 client :: post_loop(consus_returncode* status)
 {
@@ -746,7 +991,7 @@ client :: post_loop(consus_returncode* status)
             handle_disruption(comm_id(cid_num));
             break;
         case BUSYBEE_EXTERNAL:
-            if (!maintain_coord_connection(status))
+            if (!handle_external(status))
             {
                 return -1;
             }
@@ -766,6 +1011,20 @@ client :: post_loop(consus_returncode* status)
     return -1;
 }
 
+bool
+client :: handle_external(consus_returncode* status)
+{
+    std::vector<comm_id> disrupted;
+    bool coord = m_local.external(&disrupted);
+
+    for (size_t i = 0; i < disrupted.size(); ++i)
+    {
+        handle_disruption(disrupted[i]);
+    }
+
+    return !coord || maintain_coord_connection(status);
+}
+
 bool
 client :: maintain_coord_connection(consus_returncode* status)
 {
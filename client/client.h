@@ -49,9 +49,12 @@
 #include <consus.h>
 #include <consus-admin.h>
 #include "namespace.h"
+#include "common/chunking.h"
 #include "client/configuration.h"
 #include "client/controller.h"
+#include "client/local_transport.h"
 #include "client/pending.h"
+#include "client/read_cache.h"
 #include "client/server_selector.h"
 
 BEGIN_CONSUS_NAMESPACE
@@ -67,11 +70,26 @@ class client
         // public API
         int64_t loop(int timeout, consus_returncode* status);
         int64_t wait(int64_t id, int timeout, consus_returncode* status);
-        int64_t begin_transaction(consus_returncode* status,
+        int64_t begin_transaction(consus_priority priority,
+                                  consus_returncode* status,
                                   consus_transaction** xact);
+        int64_t tail_changes(consus_change_cursor* cursor,
+                             consus_returncode* status,
+                             consus_change** changes, size_t* changes_sz);
+        int64_t index_lookup(const char* table, const char* field,
+                             const char* value, size_t value_sz,
+                             consus_returncode* status,
+                             consus_index_entry** keys, size_t* keys_sz);
+        void set_read_cache(size_t max_entries);
         // admin API
         int create_data_center(const char* name, consus_returncode* status);
         int set_default_data_center(const char* name, consus_returncode* status);
+        int set_quota(const char* table, uint64_t ops_per_second,
+                      uint64_t bytes_per_second, consus_returncode* status);
+        int set_idle_timeout(const char* table, uint64_t milliseconds,
+                             consus_returncode* status);
+        int create_index(const char* table, const char* field,
+                         consus_returncode* status);
         int availability_check(consus_availability_requirements* reqs,
                                int timeout, consus_returncode* status);
         // internal semi-public API
@@ -89,8 +107,13 @@ class client
         int64_t generate_new_client_id();
         void initialize(server_selector* ss);
         void add_to_returnable(pending* p);
+        // start p's state machine once delay nanoseconds have passed
+        void kickstart_after(pending* p, uint64_t delay);
         bool send(uint64_t nonce, comm_id id, std::auto_ptr<e::buffer> msg, pending* p);
+        // chunks and their acknowledgements, which no operation waits on
+        void send_chunk_control(comm_id id, std::auto_ptr<e::buffer> msg);
         void handle_disruption(const comm_id& id);
+        read_cache* get_read_cache() { return &m_read_cache; }
         bool replicant_finish(int64_t id, replicant_returncode* rc, consus_returncode* status);
         bool replicant_finish(int64_t id, int timeout, replicant_returncode* rc, consus_returncode* status);
 
@@ -100,6 +123,11 @@ class client
         // that it can return, so verify that at the callsite
         int64_t inner_loop(int timeout, consus_returncode* status);
         int64_t post_loop(consus_returncode* status);
+        // kickstart deferred operations that are due, and shorten timeout so
+        // the caller wakes for the next one
+        int kickstart_deferred(int timeout);
+        // BusyBee's external descriptor became readable
+        bool handle_external(consus_returncode* status);
         bool maintain_coord_connection(consus_returncode* status);
 
     private:
@@ -114,13 +142,20 @@ class client
         // communication
         controller m_busybee_controller;
         const std::auto_ptr<busybee_client> m_busybee;
+        chunk_reassembler m_chunks;
+        chunk_sender m_chunk_sender;
+        // transaction managers on this host
+        local_transport m_local;
         // nonces
         int64_t m_next_client_id;
         uint64_t m_next_server_nonce;
         // operations
         std::map<std::pair<comm_id, uint64_t>, e::intrusive_ptr<pending> > m_pending;
         std::list<e::intrusive_ptr<pending> > m_returnable;
+        std::list<std::pair<uint64_t, e::intrusive_ptr<pending> > > m_deferred;
         e::intrusive_ptr<pending> m_returned;
+        // recently read values, checked by the txman at commit
+        read_cache m_read_cache;
         // misc
         e::flagfd m_flagfd;
         e::error m_last_error;
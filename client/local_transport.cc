@@ -0,0 +1,357 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// C
+#include <stddef.h>
+#include <string.h>
+
+// POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef CONSUS_LOCAL_CHANNEL
+#include <sys/epoll.h>
+#endif
+
+// consus
+#include "common/local_channel.h"
+#include "client/local_transport.h"
+
+using consus::local_transport;
+
+struct local_transport::channel
+{
+    channel(comm_id i, int s, local_channel* c) : id(i), sock(s), chan(c) {}
+    ~channel() throw () { close(sock); }
+
+    const comm_id id;
+    const int sock;
+    const std::auto_ptr<local_channel> chan;
+
+    private:
+        channel(const channel&);
+        channel& operator = (const channel&);
+};
+
+local_transport :: local_transport()
+    : m_epoll(-1)
+    , m_coord(-1)
+    , m_channels()
+    , m_fds()
+    , m_last_recv()
+{
+}
+
+local_transport :: ~local_transport() throw ()
+{
+    for (channel_map_t::iterator it = m_channels.begin();
+            it != m_channels.end(); ++it)
+    {
+        delete it->second;
+    }
+
+    if (m_epoll >= 0)
+    {
+        close(m_epoll);
+    }
+}
+
+int
+local_transport :: external_fd(int coord)
+{
+    m_coord = coord;
+#ifdef CONSUS_LOCAL_CHANNEL
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = coord;
+
+    if (m_epoll >= 0 && epoll_ctl(m_epoll, EPOLL_CTL_ADD, coord, &ev) == 0)
+    {
+        return m_epoll;
+    }
+
+    // everything goes over TCP
+    if (m_epoll >= 0)
+    {
+        close(m_epoll);
+        m_epoll = -1;
+    }
+#endif
+    return coord;
+}
+
+bool
+local_transport :: reaches(comm_id id, const po6::net::location& loc)
+{
+    if (m_epoll < 0)
+    {
+        return false;
+    }
+
+    channel_map_t::iterator it = m_channels.find(id);
+
+    if (it != m_channels.end())
+    {
+        return it->second != NULL;
+    }
+
+    if (loc == po6::net::location())
+    {
+        return false;
+    }
+
+    channel* c = connect(id, loc);
+    m_channels[id] = c;
+    return c != NULL;
+}
+
+busybee_returncode
+local_transport :: send(uint64_t id, std::auto_ptr<e::buffer> msg)
+{
+    channel_map_t::iterator it = m_channels.find(comm_id(id));
+
+    if (it == m_channels.end() || !it->second)
+    {
+        return BUSYBEE_DISRUPTED;
+    }
+
+    if (!it->second->chan->send(msg))
+    {
+        // external() sees the hangup and reports the disruption
+        ::shutdown(it->second->sock, SHUT_RDWR);
+        return BUSYBEE_DISRUPTED;
+    }
+
+    return BUSYBEE_SUCCESS;
+}
+
+bool
+local_transport :: recv(comm_id* id, std::auto_ptr<e::buffer>* msg)
+{
+    // start after the channel that last had something, so that one busy
+    // transaction manager does not starve the others
+    channel_map_t::iterator start = m_channels.upper_bound(m_last_recv);
+
+    for (unsigned pass = 0; pass < 2; ++pass)
+    {
+        channel_map_t::iterator it = pass == 0 ? start : m_channels.begin();
+        channel_map_t::iterator end = pass == 0 ? m_channels.end() : start;
+
+        for (; it != end; ++it)
+        {
+            if (!it->second)
+            {
+                continue;
+            }
+
+            if (it->second->chan->recv(msg))
+            {
+                *id = m_last_recv = it->first;
+                return true;
+            }
+
+            if (it->second->chan->broken())
+            {
+                ::shutdown(it->second->sock, SHUT_RDWR);
+            }
+        }
+    }
+
+    return false;
+}
+
+bool
+local_transport :: prepare_to_wait()
+{
+    for (channel_map_t::iterator it = m_channels.begin();
+            it != m_channels.end(); ++it)
+    {
+        if (it->second && !it->second->chan->prepare_to_wait())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+local_transport :: external(std::vector<comm_id>* disrupted)
+{
+#ifdef CONSUS_LOCAL_CHANNEL
+    if (m_epoll < 0)
+    {
+        return true;
+    }
+
+    struct epoll_event events[64];
+    int n = epoll_wait(m_epoll, events, sizeof(events) / sizeof(events[0]), 0);
+    bool coord = n < 0;
+
+    for (int i = 0; i < n; ++i)
+    {
+        const int fd = events[i].data.fd;
+
+        if (fd == m_coord)
+        {
+            coord = true;
+            continue;
+        }
+
+        std::map<int, channel*>::iterator it = m_fds.find(fd);
+
+        if (it == m_fds.end())
+        {
+            continue;
+        }
+
+        channel* c = it->second;
+
+        if (fd == c->sock)
+        {
+            // the transaction manager never writes to the socket once the
+            // channel is up; readable means it went away
+            char byte;
+            ssize_t ret = ::read(fd, &byte, 1);
+
+            if (ret == 0 || (ret < 0 && errno != EAGAIN && errno != EINTR))
+            {
+                disrupted->push_back(c->id);
+                drop(c);
+            }
+        }
+        else
+        {
+            c->chan->silence();
+            c->chan->flush();
+        }
+    }
+
+    return coord;
+#else
+    (void) disrupted;
+    return true;
+#endif
+}
+
+local_transport::channel*
+local_transport :: connect(comm_id id, const po6::net::location& loc)
+{
+#ifdef CONSUS_LOCAL_CHANNEL
+    const std::string name = local_channel::socket_name(loc);
+    struct sockaddr_un addr;
+
+    if (name.size() > sizeof(addr.sun_path))
+    {
+        return NULL;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memmove(addr.sun_path, name.data(), name.size());
+    socklen_t addr_sz = offsetof(struct sockaddr_un, sun_path) + name.size();
+    // the transaction manager hands over the channel as soon as it accepts;
+    // don't wait on one that is wedged
+    struct timeval tv;
+    tv.tv_sec = 1;
+    tv.tv_usec = 0;
+    int fds[local_channel::DESCRIPTORS];
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    // no transaction manager at loc on this host
+    if (sock < 0 ||
+        ::connect(sock, reinterpret_cast<struct sockaddr*>(&addr), addr_sz) < 0 ||
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0 ||
+        !local_channel::recv_descriptors(sock, fds))
+    {
+        if (sock >= 0)
+        {
+            close(sock);
+        }
+
+        return NULL;
+    }
+
+    std::auto_ptr<channel> c(new channel(id, sock, local_channel::attach(fds)));
+
+    if (!c->chan.get() || fcntl(c->sock, F_SETFL, O_NONBLOCK) < 0)
+    {
+        return NULL;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = c->sock;
+
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, c->sock, &ev) < 0)
+    {
+        return NULL;
+    }
+
+    ev.data.fd = c->chan->bell();
+
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, c->chan->bell(), &ev) < 0)
+    {
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, c->sock, &ev);
+        return NULL;
+    }
+
+    m_fds[c->sock] = c.get();
+    m_fds[c->chan->bell()] = c.get();
+    return c.release();
+#else
+    (void) id;
+    (void) loc;
+    return NULL;
+#endif
+}
+
+void
+local_transport :: drop(channel* c)
+{
+#ifdef CONSUS_LOCAL_CHANNEL
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, c->sock, &ev);
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, c->chan->bell(), &ev);
+#endif
+    m_fds.erase(c->sock);
+    m_fds.erase(c->chan->bell());
+    // try again should the transaction manager come back
+    m_channels.erase(c->id);
+    delete c;
+}
@@ -0,0 +1,102 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_client_local_transport_h_
+#define consus_client_local_transport_h_
+
+// STL
+#include <map>
+#include <memory>
+#include <vector>
+
+// po6
+#include <po6/net/location.h>
+
+// e
+#include <e/buffer.h>
+
+// BusyBee
+#include <busybee.h>
+
+// consus
+#include "namespace.h"
+#include "common/ids.h"
+
+BEGIN_CONSUS_NAMESPACE
+class local_channel;
+
+// Shared-memory channels to the transaction managers on this host (see
+// common/local_channel.h).  BusyBee watches a single external descriptor, so
+// the coordinator's descriptor goes behind an epoll descriptor along with
+// every channel's bell and socket, and BUSYBEE_EXTERNAL covers them all.
+class local_transport
+{
+    public:
+        local_transport();
+        ~local_transport() throw ();
+
+    public:
+        // the descriptor for BusyBee to watch in place of coord
+        int external_fd(int coord);
+        // whether messages to id go over a channel; the first call for each
+        // id tries to open one to the transaction manager at loc
+        bool reaches(comm_id id, const po6::net::location& loc);
+        // for send_chunked
+        busybee_returncode send(uint64_t id, std::auto_ptr<e::buffer> msg);
+        // the next message from any channel, if there is one
+        bool recv(comm_id* id, std::auto_ptr<e::buffer>* msg);
+        // call before blocking on the external descriptor; false if a message
+        // arrived in the meantime and the caller must not block
+        bool prepare_to_wait();
+        // call when BusyBee returns BUSYBEE_EXTERNAL; fills in the channels
+        // that went away and returns whether the coordinator needs attention
+        bool external(std::vector<comm_id>* disrupted);
+
+    private:
+        struct channel;
+        typedef std::map<comm_id, channel*> channel_map_t;
+
+    private:
+        channel* connect(comm_id id, const po6::net::location& loc);
+        void drop(channel* c);
+
+    private:
+        int m_epoll;
+        int m_coord;
+        // a NULL channel means the id is not on this host
+        channel_map_t m_channels;
+        std::map<int, channel*> m_fds;
+        comm_id m_last_recv;
+
+    private:
+        local_transport(const local_transport&);
+        local_transport& operator = (const local_transport&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_client_local_transport_h_
@@ -38,15 +38,31 @@
 using consus::pending_begin_transaction;
 
 pending_begin_transaction :: pending_begin_transaction(int64_t client_id,
+                                                       consus_priority priority,
                                                        consus_returncode* status,
                                                        consus_transaction** xact)
     : pending(client_id, status)
+    , m_priority(priority)
     , m_xact(xact)
+    , m_restart(NULL)
     , m_ss()
+    , m_anywhere(true)
 {
     *m_xact = NULL;
 }
 
+pending_begin_transaction :: pending_begin_transaction(int64_t client_id,
+                                                       consus_returncode* status,
+                                                       transaction* xact)
+    : pending(client_id, status)
+    , m_priority(consus_priority(xact->txid().priority))
+    , m_xact(NULL)
+    , m_restart(xact)
+    , m_ss()
+    , m_anywhere(false)
+{
+}
+
 pending_begin_transaction :: ~pending_begin_transaction() throw ()
 {
 }
@@ -60,7 +76,16 @@ pending_begin_transaction :: describe()
 void
 pending_begin_transaction :: kickstart_state_machine(client* cl)
 {
-    cl->initialize(&m_ss);
+    // only the previous incarnation's group will let a restart keep its age
+    if (m_restart)
+    {
+        m_restart->initialize(&m_ss);
+    }
+    else
+    {
+        cl->initialize(&m_ss);
+    }
+
     send_request(cl);
 }
 
@@ -85,7 +110,34 @@ pending_begin_transaction :: handle_busybee_op(client* cl,
     consus_returncode rc;
     transaction_id txid;
     std::vector<comm_id> ids;
-    up = up >> rc >> txid >> ids;
+    up = up >> rc;
+
+    // a server that turns the transaction away sends only the returncode
+    if (!up.error() && rc != CONSUS_SUCCESS)
+    {
+        uint64_t retry_after = 0;
+
+        if (rc == CONSUS_THROTTLED)
+        {
+            up = up >> retry_after;
+        }
+
+        if (m_restart && rc == CONSUS_THROTTLED)
+        {
+            m_restart->mark_throttled(retry_after);
+        }
+        else if (m_restart)
+        {
+            m_restart->mark_aborted(rc);
+        }
+
+        set_status(rc);
+        error(__FILE__, __LINE__) << "server refused to begin the transaction";
+        cl->add_to_returnable(this);
+        return;
+    }
+
+    up = up >> txid >> ids;
 
     if (up.error())
     {
@@ -94,6 +146,14 @@ pending_begin_transaction :: handle_busybee_op(client* cl,
         return;
     }
 
+    if (m_restart)
+    {
+        m_restart->restarted(txid, &ids[0], ids.size());
+        this->success();
+        cl->add_to_returnable(this);
+        return;
+    }
+
     transaction* t = new transaction(cl, txid, &ids[0], ids.size());
     *m_xact = reinterpret_cast<consus_transaction*>(t);
     this->success();
@@ -108,9 +168,20 @@ pending_begin_transaction :: send_request(client* cl)
         const uint64_t nonce = cl->generate_new_nonce();
         const size_t sz = BUSYBEE_HEADER_SIZE
                         + pack_size(TXMAN_BEGIN)
-                        + VARINT_64_MAX_SIZE;
+                        + VARINT_64_MAX_SIZE
+                        + sizeof(uint8_t)
+                        + (m_restart ? pack_size(m_restart->txid()) : 0);
         comm_id id = m_ss.next();
 
+        // none of the previous group is reachable; begin anew anywhere,
+        // at the cost of the transaction's age
+        if (id == comm_id() && !m_anywhere)
+        {
+            m_anywhere = true;
+            cl->initialize(&m_ss);
+            continue;
+        }
+
         if (id == comm_id())
         {
             PENDING_ERROR(UNAVAILABLE) << "insufficient number of servers to ensure durability";
@@ -119,7 +190,15 @@ pending_begin_transaction :: send_request(client* cl)
         }
 
         std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-        msg->pack_at(BUSYBEE_HEADER_SIZE) << TXMAN_BEGIN << e::pack_varint(nonce);
+        e::packer pa = msg->pack_at(BUSYBEE_HEADER_SIZE)
+            << TXMAN_BEGIN << e::pack_varint(nonce) << uint8_t(m_priority);
+
+        // the server decides whether the restart keeps the previous
+        // incarnation's start
+        if (m_restart)
+        {
+            pa = pa << m_restart->txid();
+        }
 
         if (cl->send(nonce, id, msg, this))
         {
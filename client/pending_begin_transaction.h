@@ -33,13 +33,19 @@
 #include "client/server_selector.h"
 
 BEGIN_CONSUS_NAMESPACE
+class transaction;
 
 class pending_begin_transaction : public pending
 {
     public:
         pending_begin_transaction(int64_t client_id,
+                                  consus_priority priority,
                                   consus_returncode* status,
                                   consus_transaction** xact);
+        // begin a new incarnation of xact that inherits its start
+        pending_begin_transaction(int64_t client_id,
+                                  consus_returncode* status,
+                                  transaction* xact);
         virtual ~pending_begin_transaction() throw ();
 
     public:
@@ -56,8 +62,11 @@ class pending_begin_transaction : public pending
         void send_request(client* cl);
 
     private:
+        const consus_priority m_priority;
         consus_transaction** m_xact;
+        transaction* m_restart;
         server_selector m_ss;
+        bool m_anywhere;
 
     private:
         pending_begin_transaction(const pending_begin_transaction&);
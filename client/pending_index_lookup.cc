@@ -0,0 +1,234 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdlib.h>
+#include <string.h>
+
+// STL
+#include <sstream>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/errno.h>
+
+// e
+#include <e/strescape.h>
+
+// treadstone
+#include <treadstone.h>
+
+// BusyBee
+#include <busybee.h>
+
+// consus
+#include "common/consus.h"
+#include "client/client.h"
+#include "client/pending_index_lookup.h"
+
+using consus::pending_index_lookup;
+
+pending_index_lookup :: pending_index_lookup(int64_t client_id,
+                                             consus_returncode* status,
+                                             const char* table,
+                                             const char* field,
+                                             const unsigned char* value, size_t value_sz,
+                                             consus_index_entry** keys,
+                                             size_t* keys_sz)
+    : pending(client_id, status)
+    , m_ss()
+    , m_table(table)
+    , m_field(field)
+    , m_value(value, value + value_sz)
+    , m_keys(keys)
+    , m_keys_sz(keys_sz)
+{
+    *m_keys = NULL;
+    *m_keys_sz = 0;
+}
+
+pending_index_lookup :: ~pending_index_lookup() throw ()
+{
+}
+
+std::string
+pending_index_lookup :: describe()
+{
+    std::ostringstream ostr;
+    ostr << "pending_index_lookup(table=\"" << e::strescape(m_table)
+         << "\", field=\"" << e::strescape(m_field) << "\")";
+    return ostr.str();
+}
+
+void
+pending_index_lookup :: kickstart_state_machine(client* cl)
+{
+    cl->initialize(&m_ss);
+    send_request(cl);
+}
+
+void
+pending_index_lookup :: handle_server_failure(client* cl, comm_id)
+{
+    send_request(cl);
+}
+
+void
+pending_index_lookup :: handle_server_disruption(client* cl, comm_id)
+{
+    send_request(cl);
+}
+
+void
+pending_index_lookup :: handle_busybee_op(client* cl,
+                                          uint64_t,
+                                          std::auto_ptr<e::buffer>,
+                                          e::unpacker up)
+{
+    consus_returncode rc;
+    up = up >> rc;
+
+    if (!up.error() && rc == CONSUS_UNKNOWN_TABLE)
+    {
+        PENDING_ERROR(UNKNOWN_TABLE) << "no index on field \"" << e::strescape(m_field)
+                                     << "\" of table \"" << e::strescape(m_table) << "\"";
+        cl->add_to_returnable(this);
+        return;
+    }
+
+    if (!up.error() && rc != CONSUS_SUCCESS)
+    {
+        set_status(rc);
+        error(__FILE__, __LINE__) << "server sent failure code";
+        cl->add_to_returnable(this);
+        return;
+    }
+
+    uint64_t count = 0;
+    up = up >> count;
+    std::vector<std::string> keys;
+    size_t sz = 0;
+
+    for (uint64_t i = 0; !up.error() && i < count; ++i)
+    {
+        e::slice key;
+        up = up >> key;
+
+        if (up.error())
+        {
+            break;
+        }
+
+        char* tmp = NULL;
+
+        if (treadstone_binary_to_json(key.data(), key.size(), &tmp))
+        {
+            PENDING_ERROR(SEE_ERRNO) << po6::strerror(errno);
+            cl->add_to_returnable(this);
+            return;
+        }
+
+        keys.push_back(std::string(tmp));
+        free(tmp);
+        sz += sizeof(consus_index_entry) + keys.back().size() + 1;
+    }
+
+    if (up.error())
+    {
+        PENDING_ERROR(SERVER_ERROR) << "server sent a corrupt response to \"index-lookup\"";
+        cl->add_to_returnable(this);
+        return;
+    }
+
+    if (!keys.empty())
+    {
+        // one allocation for the array and everything it points to, so the
+        // caller releases it all with a single free()
+        char* base = static_cast<char*>(malloc(sz));
+
+        if (!base)
+        {
+            PENDING_ERROR(SEE_ERRNO) << po6::strerror(errno);
+            cl->add_to_returnable(this);
+            return;
+        }
+
+        consus_index_entry* es = reinterpret_cast<consus_index_entry*>(base);
+        char* ptr = base + keys.size() * sizeof(consus_index_entry);
+
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            memmove(ptr, keys[i].data(), keys[i].size());
+            ptr[keys[i].size()] = '\0';
+            es[i].key = ptr;
+            es[i].key_sz = keys[i].size();
+            ptr += keys[i].size() + 1;
+        }
+
+        *m_keys = es;
+        *m_keys_sz = keys.size();
+    }
+
+    this->success();
+    cl->add_to_returnable(this);
+}
+
+void
+pending_index_lookup :: send_request(client* cl)
+{
+    while (true)
+    {
+        const uint64_t nonce = cl->generate_new_nonce();
+        const size_t sz = BUSYBEE_HEADER_SIZE
+                        + pack_size(TXMAN_INDEX_LOOKUP)
+                        + VARINT_64_MAX_SIZE
+                        + pack_size(e::slice(m_table))
+                        + pack_size(e::slice(m_field))
+                        + pack_size(e::slice(m_value));
+        comm_id id = m_ss.next();
+
+        if (id == comm_id())
+        {
+            PENDING_ERROR(UNAVAILABLE) << "no transaction manager available to look up the index";
+            cl->add_to_returnable(this);
+            return;
+        }
+
+        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+        msg->pack_at(BUSYBEE_HEADER_SIZE)
+            << TXMAN_INDEX_LOOKUP << e::pack_varint(nonce)
+            << e::slice(m_table)
+            << e::slice(m_field)
+            << e::slice(m_value);
+
+        if (cl->send(nonce, id, msg, this))
+        {
+            return;
+        }
+    }
+}
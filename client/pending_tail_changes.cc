@@ -0,0 +1,262 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdlib.h>
+#include <string.h>
+
+// STL
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/errno.h>
+
+// treadstone
+#include <treadstone.h>
+
+// BusyBee
+#include <busybee.h>
+
+// consus
+#include "common/constants.h"
+#include "common/consus.h"
+#include "common/transaction_id.h"
+#include "client/client.h"
+#include "client/pending_tail_changes.h"
+
+using consus::pending_tail_changes;
+
+pending_tail_changes :: pending_tail_changes(int64_t client_id,
+                                             consus_change_cursor* cursor,
+                                             consus_returncode* status,
+                                             consus_change** changes,
+                                             size_t* changes_sz)
+    : pending(client_id, status)
+    , m_cursor(cursor)
+    , m_changes(changes)
+    , m_changes_sz(changes_sz)
+    , m_ss()
+    , m_server()
+{
+    *m_changes = NULL;
+    *m_changes_sz = 0;
+}
+
+pending_tail_changes :: ~pending_tail_changes() throw ()
+{
+}
+
+std::string
+pending_tail_changes :: describe()
+{
+    return "pending_tail_changes()";
+}
+
+void
+pending_tail_changes :: kickstart_state_machine(client* cl)
+{
+    if (m_cursor->server == 0)
+    {
+        cl->initialize(&m_ss);
+    }
+
+    send_request(cl);
+}
+
+void
+pending_tail_changes :: handle_server_failure(client* cl, comm_id)
+{
+    lost_server(cl);
+}
+
+void
+pending_tail_changes :: handle_server_disruption(client* cl, comm_id)
+{
+    lost_server(cl);
+}
+
+void
+pending_tail_changes :: handle_busybee_op(client* cl,
+                                          uint64_t,
+                                          std::auto_ptr<e::buffer>,
+                                          e::unpacker up)
+{
+    consus_returncode rc;
+    up = up >> rc;
+
+    if (!up.error() && rc != CONSUS_SUCCESS)
+    {
+        set_status(rc);
+        error(__FILE__, __LINE__) << "server refused to read the change feed";
+        cl->add_to_returnable(this);
+        return;
+    }
+
+    uint64_t next = 0;
+    uint64_t count = 0;
+    up = up >> next >> count;
+    std::vector<consus_change> changes;
+    std::vector<std::string> values;
+    size_t sz = 0;
+
+    for (uint64_t i = 0; !up.error() && i < count; ++i)
+    {
+        consus_change c;
+        transaction_id txid;
+        e::slice table;
+        e::slice key;
+        e::slice value;
+        up = up >> c.position >> c.timestamp >> txid >> table >> key >> value;
+
+        if (up.error())
+        {
+            break;
+        }
+
+        char* tmp = NULL;
+
+        if (treadstone_binary_to_json(value.data(), value.size(), &tmp))
+        {
+            PENDING_ERROR(SEE_ERRNO) << po6::strerror(errno);
+            cl->add_to_returnable(this);
+            return;
+        }
+
+        values.push_back(std::string(tmp));
+        free(tmp);
+        // stash the wire pointers; they're copied out below
+        c.table = reinterpret_cast<const char*>(table.data());
+        c.table_sz = table.size();
+        c.key = reinterpret_cast<const char*>(key.data());
+        c.key_sz = key.size();
+        c.value = NULL;
+        c.value_sz = values.back().size();
+        changes.push_back(c);
+        sz += sizeof(consus_change) + c.table_sz + 1 + c.key_sz + c.value_sz + 1;
+    }
+
+    if (up.error())
+    {
+        PENDING_ERROR(SERVER_ERROR) << "server sent a corrupt response to \"tail-changes\"";
+        cl->add_to_returnable(this);
+        return;
+    }
+
+    if (!changes.empty())
+    {
+        // one allocation for the array and everything it points to, so the
+        // caller releases it all with a single free()
+        char* base = static_cast<char*>(malloc(sz));
+
+        if (!base)
+        {
+            PENDING_ERROR(SEE_ERRNO) << po6::strerror(errno);
+            cl->add_to_returnable(this);
+            return;
+        }
+
+        consus_change* cs = reinterpret_cast<consus_change*>(base);
+        char* ptr = base + changes.size() * sizeof(consus_change);
+
+        for (size_t i = 0; i < changes.size(); ++i)
+        {
+            cs[i] = changes[i];
+            memmove(ptr, changes[i].table, changes[i].table_sz);
+            ptr[changes[i].table_sz] = '\0';
+            cs[i].table = ptr;
+            ptr += changes[i].table_sz + 1;
+            memmove(ptr, changes[i].key, changes[i].key_sz);
+            cs[i].key = ptr;
+            ptr += changes[i].key_sz;
+            memmove(ptr, values[i].data(), values[i].size());
+            ptr[values[i].size()] = '\0';
+            cs[i].value = ptr;
+            ptr += values[i].size() + 1;
+        }
+
+        *m_changes = cs;
+        *m_changes_sz = changes.size();
+    }
+
+    m_cursor->server = m_server.get();
+    m_cursor->position = next;
+    this->success();
+    cl->add_to_returnable(this);
+}
+
+void
+pending_tail_changes :: send_request(client* cl)
+{
+    while (true)
+    {
+        m_server = m_cursor->server != 0 ? comm_id(m_cursor->server) : m_ss.next();
+
+        if (m_server == comm_id())
+        {
+            PENDING_ERROR(UNAVAILABLE) << "no transaction manager available to read the change feed";
+            cl->add_to_returnable(this);
+            return;
+        }
+
+        const uint64_t nonce = cl->generate_new_nonce();
+        const uint64_t max_bytes = CONSUS_CHANGE_FEED_BATCH;
+        const size_t sz = BUSYBEE_HEADER_SIZE
+                        + pack_size(TXMAN_CHANGES)
+                        + VARINT_64_MAX_SIZE
+                        + 2 * sizeof(uint64_t);
+        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+        msg->pack_at(BUSYBEE_HEADER_SIZE)
+            << TXMAN_CHANGES << e::pack_varint(nonce)
+            << m_cursor->position << max_bytes;
+
+        if (cl->send(nonce, m_server, msg, this))
+        {
+            return;
+        }
+
+        // a cursor's position only means something to its own server
+        if (m_cursor->server != 0)
+        {
+            lost_server(cl);
+            return;
+        }
+    }
+}
+
+void
+pending_tail_changes :: lost_server(client* cl)
+{
+    if (m_cursor->server == 0)
+    {
+        send_request(cl);
+        return;
+    }
+
+    PENDING_ERROR(UNAVAILABLE) << "the transaction manager serving this change feed cursor is unavailable";
+    cl->add_to_returnable(this);
+}
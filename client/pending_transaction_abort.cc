@@ -110,7 +110,7 @@ pending_transaction_abort :: send_request(client* cl)
 
         if (id == comm_id())
         {
-            m_xact->mark_aborted();
+            m_xact->mark_aborted(CONSUS_UNAVAILABLE);
             PENDING_ERROR(UNAVAILABLE) << "insufficient number of servers to ensure durability";
             cl->add_to_returnable(this);
             return;
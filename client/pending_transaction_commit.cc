@@ -92,6 +92,17 @@ pending_transaction_commit :: handle_busybee_op(client* cl,
         abort(); // XXX
     }
 
+    if (rc == CONSUS_ABORTED)
+    {
+        // one of the cached reads may have been stale; we can't tell which
+        m_xact->invalidate_cached_reads();
+        m_xact->mark_aborted(rc);
+        set_status(rc);
+        error(__FILE__, __LINE__) << "transaction aborted";
+        cl->add_to_returnable(this);
+        return;
+    }
+
     this->success(); // XXX
     cl->add_to_returnable(this);
 }
@@ -102,25 +113,44 @@ pending_transaction_commit :: send_request(client* cl)
     while (true)
     {
         const uint64_t nonce = m_xact->parent()->generate_new_nonce();
-        const size_t sz = BUSYBEE_HEADER_SIZE
-                        + pack_size(TXMAN_COMMIT)
-                        + pack_size(m_xact->txid())
-                        + 2 * VARINT_64_MAX_SIZE;
+        const std::vector<transaction::cached_read>& cached(m_xact->cached_reads());
+        size_t sz = BUSYBEE_HEADER_SIZE
+                  + pack_size(TXMAN_COMMIT)
+                  + pack_size(m_xact->txid())
+                  + 3 * VARINT_64_MAX_SIZE;
+
+        for (size_t i = 0; i < cached.size(); ++i)
+        {
+            sz += VARINT_64_MAX_SIZE
+                + pack_size(e::slice(cached[i].table))
+                + pack_size(e::slice(cached[i].key))
+                + sizeof(uint64_t);
+        }
+
         comm_id id = m_ss.next();
 
         if (id == comm_id())
         {
-            m_xact->mark_aborted();
+            m_xact->mark_aborted(CONSUS_UNAVAILABLE);
             PENDING_ERROR(UNAVAILABLE) << "insufficient number of servers to ensure durability";
             cl->add_to_returnable(this);
             return;
         }
 
         std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-        msg->pack_at(BUSYBEE_HEADER_SIZE)
+        e::packer pa = msg->pack_at(BUSYBEE_HEADER_SIZE)
             << TXMAN_COMMIT << m_xact->txid()
             << e::pack_varint(nonce)
-            << e::pack_varint(m_slot);
+            << e::pack_varint(m_slot)
+            << e::pack_varint(cached.size());
+
+        for (size_t i = 0; i < cached.size(); ++i)
+        {
+            pa = pa << e::pack_varint(cached[i].slot)
+                    << e::slice(cached[i].table)
+                    << e::slice(cached[i].key)
+                    << cached[i].timestamp;
+        }
 
         if (cl->send(nonce, id, msg, this))
         {
@@ -25,6 +25,12 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+// C
+#include <string.h>
+
+// po6
+#include <po6/time.h>
+
 // e
 #include <e/strescape.h>
 
@@ -39,6 +45,7 @@
 #include "client/client.h"
 #include "client/pending_transaction_read.h"
 #include "client/transaction.h"
+#include "client/value_view.h"
 
 using consus::pending_transaction_read;
 
@@ -48,7 +55,8 @@ pending_transaction_read :: pending_transaction_read(int64_t client_id,
                                                      uint64_t slot,
                                                      const char* table,
                                                      const unsigned char* key, size_t key_sz,
-                                                     char** value, size_t* value_sz)
+                                                     char** value, size_t* value_sz,
+                                                     e::buffer** view)
     : pending(client_id, status)
     , m_xact(xact)
     , m_ss()
@@ -57,6 +65,7 @@ pending_transaction_read :: pending_transaction_read(int64_t client_id,
     , m_key(key, key + key_sz)
     , m_value(value)
     , m_value_sz(value_sz)
+    , m_view(view)
 {
 }
 
@@ -96,17 +105,31 @@ pending_transaction_read :: handle_server_disruption(client* cl, comm_id)
 void
 pending_transaction_read :: handle_busybee_op(client* cl,
                                               uint64_t,
-                                              std::auto_ptr<e::buffer>,
+                                              std::auto_ptr<e::buffer> msg,
                                               e::unpacker up)
 {
     consus_returncode rc;
     uint64_t timestamp;
     e::slice value;
-    up = up >> rc >> timestamp >> value;
+    up = up >> rc;
+
+    if (!up.error() && rc == CONSUS_THROTTLED)
+    {
+        uint64_t retry_after = 0;
+        up = up >> retry_after;
+        m_xact->mark_throttled(retry_after);
+        set_status(rc);
+        error(__FILE__, __LINE__) << "server throttled the transaction; retry after "
+                                  << retry_after / PO6_MILLIS << "ms";
+        cl->add_to_returnable(this);
+        return;
+    }
+
+    up = up >> timestamp >> value;
 
     if (up.error())
     {
-        m_xact->mark_aborted();
+        m_xact->mark_aborted(CONSUS_SERVER_ERROR);
         PENDING_ERROR(SERVER_ERROR) << "server sent a corrupt response to \"transaction-read\"";
         cl->add_to_returnable(this);
         return;
@@ -114,7 +137,7 @@ pending_transaction_read :: handle_busybee_op(client* cl,
 
     if (rc != CONSUS_SUCCESS && rc != CONSUS_NOT_FOUND)
     {
-        m_xact->mark_aborted();
+        m_xact->mark_aborted(rc);
         set_status(rc);
         error(__FILE__, __LINE__) << "server sent failure code";
         cl->add_to_returnable(this);
@@ -123,24 +146,20 @@ pending_transaction_read :: handle_busybee_op(client* cl,
 
     if (rc == CONSUS_SUCCESS)
     {
-        char* tmp = NULL;
-
-        if (treadstone_binary_to_json(value.data(), value.size(), &tmp))
-        {
-            PENDING_ERROR(SEE_ERRNO) << po6::strerror(errno);
-            cl->add_to_returnable(this);
-            return;
-        }
-
-        *m_value = tmp;
-        *m_value_sz = strlen(tmp);
-        this->success();
-        cl->add_to_returnable(this);
+        cl->get_read_cache()->insert(m_table, m_key, timestamp, value);
+        return_value(cl, value, msg);
     }
     else if (rc == CONSUS_NOT_FOUND)
     {
+        cl->get_read_cache()->invalidate(m_table, m_key);
         *m_value = NULL;
         *m_value_sz = 0;
+
+        if (m_view)
+        {
+            *m_view = NULL;
+        }
+
         set_status(CONSUS_NOT_FOUND);
         error(__FILE__, __LINE__) << "value not found";
         cl->add_to_returnable(this);
@@ -151,6 +170,12 @@ pending_transaction_read :: handle_busybee_op(client* cl,
     }
 }
 
+void
+pending_transaction_read :: cached_response(client* cl, const e::slice& value)
+{
+    return_value(cl, value, std::auto_ptr<e::buffer>());
+}
+
 void
 pending_transaction_read :: send_request(client* cl)
 {
@@ -167,7 +192,7 @@ pending_transaction_read :: send_request(client* cl)
 
         if (id == comm_id())
         {
-            m_xact->mark_aborted();
+            m_xact->mark_aborted(CONSUS_UNAVAILABLE);
             PENDING_ERROR(UNAVAILABLE) << "insufficient number of servers to ensure durability";
             cl->add_to_returnable(this);
             return;
@@ -187,3 +212,33 @@ pending_transaction_read :: send_request(client* cl)
         }
     }
 }
+
+void
+pending_transaction_read :: return_value(client* cl, const e::slice& value,
+                                         std::auto_ptr<e::buffer> backing)
+{
+    if (m_view)
+    {
+        const char* data = NULL;
+        *m_view = make_value_view(value, backing, &data);
+        *m_value = const_cast<char*>(data);
+        *m_value_sz = value.size();
+        this->success();
+        cl->add_to_returnable(this);
+        return;
+    }
+
+    char* tmp = NULL;
+
+    if (treadstone_binary_to_json(value.data(), value.size(), &tmp))
+    {
+        PENDING_ERROR(SEE_ERRNO) << po6::strerror(errno);
+        cl->add_to_returnable(this);
+        return;
+    }
+
+    *m_value = tmp;
+    *m_value_sz = strlen(tmp);
+    this->success();
+    cl->add_to_returnable(this);
+}
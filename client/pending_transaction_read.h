@@ -44,7 +44,8 @@ class pending_transaction_read : public pending
                                  uint64_t slot,
                                  const char* table,
                                  const unsigned char* key, size_t key_sz,
-                                 char** value, size_t* value_sz);
+                                 char** value, size_t* value_sz,
+                                 e::buffer** view);
         virtual ~pending_transaction_read() throw ();
 
     public:
@@ -57,8 +58,15 @@ class pending_transaction_read : public pending
                                        std::auto_ptr<e::buffer> msg,
                                        e::unpacker up);
 
+    public:
+        // answer with a value from the client's read cache instead of asking
+        // the server
+        void cached_response(client* cl, const e::slice& value);
+
     private:
         void send_request(client* cl);
+        void return_value(client* cl, const e::slice& value,
+                          std::auto_ptr<e::buffer> backing);
 
     private:
         transaction* m_xact;
@@ -68,6 +76,9 @@ class pending_transaction_read : public pending
         std::string m_key;
         char** m_value;
         size_t* m_value_sz;
+        // when non-NULL, the binary value is returned in place, and the
+        // buffer that holds it goes to the caller
+        e::buffer** m_view;
 
     private:
         pending_transaction_read(const pending_transaction_read&);
@@ -25,6 +25,9 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+// po6
+#include <po6/time.h>
+
 // e
 #include <e/strescape.h>
 
@@ -99,9 +102,21 @@ pending_transaction_write :: handle_busybee_op(client* cl,
     consus_returncode rc;
     up = up >> rc;
 
+    if (!up.error() && rc == CONSUS_THROTTLED)
+    {
+        uint64_t retry_after = 0;
+        up = up >> retry_after;
+        m_xact->mark_throttled(retry_after);
+        set_status(rc);
+        error(__FILE__, __LINE__) << "server throttled the transaction; retry after "
+                                  << retry_after / PO6_MILLIS << "ms";
+        cl->add_to_returnable(this);
+        return;
+    }
+
     if (up.error())
     {
-        m_xact->mark_aborted();
+        m_xact->mark_aborted(CONSUS_SERVER_ERROR);
         PENDING_ERROR(SERVER_ERROR) << "server sent a corrupt response to \"transaction-write\"";
         cl->add_to_returnable(this);
         return;
@@ -109,7 +124,7 @@ pending_transaction_write :: handle_busybee_op(client* cl,
 
     if (rc != CONSUS_SUCCESS)
     {
-        m_xact->mark_aborted();
+        m_xact->mark_aborted(rc);
         set_status(rc);
         error(__FILE__, __LINE__) << "server sent failure code";
         cl->add_to_returnable(this);
@@ -137,7 +152,7 @@ pending_transaction_write :: send_request(client* cl)
 
         if (id == comm_id())
         {
-            m_xact->mark_aborted();
+            m_xact->mark_aborted(CONSUS_UNAVAILABLE);
             PENDING_ERROR(UNAVAILABLE) << "insufficient number of servers to ensure durability";
             cl->add_to_returnable(this);
             return;
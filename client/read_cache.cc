@@ -0,0 +1,122 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// consus
+#include "client/read_cache.h"
+
+using consus::read_cache;
+
+read_cache :: read_cache()
+    : m_capacity(0)
+    , m_entries()
+    , m_lru()
+{
+}
+
+read_cache :: ~read_cache() throw ()
+{
+}
+
+void
+read_cache :: set_capacity(size_t max_entries)
+{
+    m_capacity = max_entries;
+    evict();
+}
+
+bool
+read_cache :: lookup(const std::string& table, const std::string& key,
+                     uint64_t* timestamp, std::string* value)
+{
+    entry_map_t::iterator it = m_entries.find(cache_key(table, key));
+
+    if (it == m_entries.end())
+    {
+        return false;
+    }
+
+    m_lru.splice(m_lru.begin(), m_lru, it->second.position);
+    *timestamp = it->second.timestamp;
+    *value = it->second.value;
+    return true;
+}
+
+void
+read_cache :: insert(const std::string& table, const std::string& key,
+                     uint64_t timestamp, const e::slice& value)
+{
+    if (m_capacity == 0)
+    {
+        return;
+    }
+
+    const cache_key ck(table, key);
+    entry_map_t::iterator it = m_entries.find(ck);
+
+    if (it == m_entries.end())
+    {
+        m_lru.push_front(ck);
+        it = m_entries.insert(std::make_pair(ck, entry())).first;
+        it->second.position = m_lru.begin();
+    }
+    else
+    {
+        m_lru.splice(m_lru.begin(), m_lru, it->second.position);
+
+        // a slow response must not replace a newer version
+        if (it->second.timestamp > timestamp)
+        {
+            return;
+        }
+    }
+
+    it->second.timestamp = timestamp;
+    it->second.value.assign(value.cdata(), value.size());
+    evict();
+}
+
+void
+read_cache :: invalidate(const std::string& table, const std::string& key)
+{
+    entry_map_t::iterator it = m_entries.find(cache_key(table, key));
+
+    if (it != m_entries.end())
+    {
+        m_lru.erase(it->second.position);
+        m_entries.erase(it);
+    }
+}
+
+void
+read_cache :: evict()
+{
+    while (m_entries.size() > m_capacity)
+    {
+        m_entries.erase(m_lru.back());
+        m_lru.pop_back();
+    }
+}
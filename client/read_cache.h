@@ -0,0 +1,93 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_client_read_cache_h_
+#define consus_client_read_cache_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <list>
+#include <map>
+#include <string>
+
+// e
+#include <e/slice.h>
+
+// consus
+#include "namespace.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// The most recently read version of each (table, key), bounded in size and
+// evicted least-recently-used first.  Values are kept in their binary form.
+class read_cache
+{
+    public:
+        read_cache();
+        ~read_cache() throw ();
+
+    public:
+        // zero disables the cache and drops everything in it
+        void set_capacity(size_t max_entries);
+        bool enabled() const { return m_capacity > 0; }
+        bool lookup(const std::string& table, const std::string& key,
+                    uint64_t* timestamp, std::string* value);
+        // copies value only if the cache is enabled
+        void insert(const std::string& table, const std::string& key,
+                    uint64_t timestamp, const e::slice& value);
+        void invalidate(const std::string& table, const std::string& key);
+
+    private:
+        typedef std::pair<std::string, std::string> cache_key;
+        typedef std::list<cache_key> lru_t;
+        struct entry
+        {
+            entry() : timestamp(0), value(), position() {}
+            uint64_t timestamp;
+            std::string value;
+            lru_t::iterator position;
+        };
+        typedef std::map<cache_key, entry> entry_map_t;
+
+    private:
+        void evict();
+
+    private:
+        size_t m_capacity;
+        entry_map_t m_entries;
+        lru_t m_lru;
+
+    private:
+        read_cache(const read_cache&);
+        read_cache& operator = (const read_cache&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_client_read_cache_h_
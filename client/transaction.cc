@@ -25,12 +25,19 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+// STL
+#include <algorithm>
+
+// po6
+#include <po6/time.h>
+
 // treadstone
 #include <treadstone.h>
 
 // consus
 #include "client/client.h"
 #include "client/transaction.h"
+#include "client/pending_begin_transaction.h"
 #include "client/pending_transaction_read.h"
 #include "client/pending_transaction_write.h"
 #include "client/pending_transaction_commit.h"
@@ -43,12 +50,28 @@
 
 using consus::transaction;
 
+bool
+transaction :: retryable(consus_returncode rc)
+{
+    return rc == CONSUS_ABORTED ||
+           rc == CONSUS_TIMEOUT ||
+           rc == CONSUS_COORD_FAIL ||
+           rc == CONSUS_UNAVAILABLE ||
+           rc == CONSUS_SERVER_ERROR ||
+           rc == CONSUS_THROTTLED;
+}
+
 transaction :: transaction(client* cl, const transaction_id& txid,
                            const comm_id* ids, size_t ids_sz)
     : m_cl(cl)
     , m_txid(txid)
     , m_ids(ids, ids + ids_sz)
     , m_next_slot(1)
+    , m_abort_reason(CONSUS_SUCCESS)
+    , m_restarts(0)
+    , m_retry_after(0)
+    , m_cached_reads()
+    , m_written()
 {
 }
 
@@ -60,7 +83,8 @@ int64_t
 transaction :: get(const char* table,
                    const char* key, size_t key_sz,
                    consus_returncode* status,
-                   char** value, size_t* value_sz)
+                   char** value, size_t* value_sz,
+                   e::buffer** view)
 {
     if (!m_cl->maintain_coord_connection(status))
     {
@@ -76,11 +100,28 @@ transaction :: get(const char* table,
         return -1;
     }
 
+    const std::string k(reinterpret_cast<const char*>(binkey), binkey_sz);
+    int64_t client_id = m_cl->generate_new_client_id();
+    cached_read cr;
+    std::string cached;
+
+    if (m_written.find(std::make_pair(std::string(table), k)) == m_written.end() &&
+        m_cl->get_read_cache()->lookup(table, k, &cr.timestamp, &cached))
+    {
+        cr.table = table;
+        cr.key = k;
+        m_cached_reads.push_back(cr);
+        pending_transaction_read* p = new pending_transaction_read(client_id, status, this, 0,
+                table, binkey, binkey_sz, value, value_sz, view);
+        free(binkey);
+        p->cached_response(m_cl, e::slice(cached));
+        return client_id;
+    }
+
     uint64_t slot = m_next_slot;
     ++m_next_slot;
-    int64_t client_id = m_cl->generate_new_client_id();
     pending* p = new pending_transaction_read(client_id, status, this, slot,
-            table, binkey, binkey_sz, value, value_sz);
+            table, binkey, binkey_sz, value, value_sz, view);
     free(binkey);
     p->kickstart_state_machine(m_cl);
     return client_id;
@@ -115,6 +156,9 @@ transaction :: put(const char* table,
         return -1;
     }
 
+    const std::string k(reinterpret_cast<const char*>(binkey), binkey_sz);
+    m_cl->get_read_cache()->invalidate(table, k);
+    m_written.insert(std::make_pair(std::string(table), k));
     uint64_t slot = m_next_slot;
     ++m_next_slot;
     int64_t client_id = m_cl->generate_new_client_id();
@@ -134,6 +178,15 @@ transaction :: commit(consus_returncode* status)
         return -1;
     }
 
+    for (size_t i = 0; i < m_cached_reads.size(); ++i)
+    {
+        if (m_cached_reads[i].slot == 0)
+        {
+            m_cached_reads[i].slot = m_next_slot;
+            ++m_next_slot;
+        }
+    }
+
     uint64_t slot = m_next_slot;
     ++m_next_slot;
     int64_t client_id = m_cl->generate_new_client_id();
@@ -158,6 +211,22 @@ transaction :: abort(consus_returncode* status)
     return client_id;
 }
 
+int64_t
+transaction :: restart(consus_returncode* status)
+{
+    if (!m_cl->maintain_coord_connection(status))
+    {
+        return -1;
+    }
+
+    const uint64_t delay = backoff();
+    ++m_restarts;
+    int64_t client_id = m_cl->generate_new_client_id();
+    pending* p = new pending_begin_transaction(client_id, status, this);
+    m_cl->kickstart_after(p, delay);
+    return client_id;
+}
+
 void
 transaction :: initialize(server_selector* ss)
 {
@@ -165,7 +234,86 @@ transaction :: initialize(server_selector* ss)
 }
 
 void
-transaction :: mark_aborted()
+transaction :: invalidate_cached_reads()
+{
+    for (size_t i = 0; i < m_cached_reads.size(); ++i)
+    {
+        m_cl->get_read_cache()->invalidate(m_cached_reads[i].table, m_cached_reads[i].key);
+    }
+}
+
+void
+transaction :: mark_aborted(consus_returncode reason)
+{
+    m_abort_reason = reason;
+}
+
+void
+transaction :: mark_throttled(uint64_t retry_after)
 {
-    ::abort(); // XXX
+    mark_aborted(CONSUS_THROTTLED);
+    m_retry_after = retry_after;
+}
+
+void
+transaction :: restarted(const transaction_id& txid,
+                         const comm_id* ids, size_t ids_sz)
+{
+    m_txid = txid;
+    m_ids.assign(ids, ids + ids_sz);
+    m_next_slot = 1;
+    m_abort_reason = CONSUS_SUCCESS;
+    m_retry_after = 0;
+    m_cached_reads.clear();
+    m_written.clear();
+}
+
+uint64_t
+transaction :: backoff()
+{
+    uint64_t base = 0;
+    uint64_t cap = 0;
+
+    switch (m_abort_reason)
+    {
+        // lost a lock to an older transaction; the restart keeps this
+        // transaction's age, so it only needs to let the winner finish
+        case CONSUS_ABORTED:
+            base = PO6_MILLIS;
+            cap = 250 * PO6_MILLIS;
+            break;
+        // the cluster is struggling; back off harder
+        case CONSUS_TIMEOUT:
+        case CONSUS_COORD_FAIL:
+        case CONSUS_UNAVAILABLE:
+        case CONSUS_SERVER_ERROR:
+            base = 50 * PO6_MILLIS;
+            cap = 5 * PO6_SECONDS;
+            break;
+        // over quota; never come back sooner than the server asked
+        case CONSUS_THROTTLED:
+            base = 10 * PO6_MILLIS;
+            cap = PO6_SECONDS;
+            break;
+        // explicitly aborted or restarted before anything went wrong
+        case CONSUS_SUCCESS:
+        case CONSUS_LESS_DURABLE:
+        case CONSUS_NOT_FOUND:
+        case CONSUS_COMMITTED:
+        case CONSUS_UNKNOWN_TABLE:
+        case CONSUS_NONE_PENDING:
+        case CONSUS_INVALID:
+        case CONSUS_INTERRUPTED:
+        case CONSUS_SEE_ERRNO:
+        case CONSUS_INTERNAL:
+        case CONSUS_GARBAGE:
+        default:
+            return 0;
+    }
+
+    const unsigned shift = std::min(m_restarts, 16U);
+    const uint64_t window = std::min(cap, base << shift);
+    // the txid's number comes from the server's random source, so it is a
+    // fresh source of jitter for every incarnation
+    return std::max(m_retry_after, window / 2 + m_txid.number % (window / 2 + 1));
 }
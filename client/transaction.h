@@ -31,7 +31,13 @@
 // C
 #include <stdint.h>
 
+// STL
+#include <set>
+#include <string>
+#include <vector>
+
 // e
+#include <e/buffer.h>
 #include <e/error.h>
 
 // consus
@@ -49,27 +55,67 @@ class transaction
                     const comm_id* ids, size_t ids_sz);
         ~transaction() throw ();
 
+    public:
+        // true for failures that a fresh incarnation may get past
+        static bool retryable(consus_returncode rc);
+
+    public:
+        // a read answered from the client's cache; the txman verifies it at
+        // the commit, which assigns its slot
+        struct cached_read
+        {
+            cached_read() : table(), key(), timestamp(0), slot(0) {}
+            std::string table;
+            std::string key;
+            uint64_t timestamp;
+            uint64_t slot;
+        };
+
     public:
         transaction_id txid() { return m_txid; }
         client* parent() { return m_cl; }
+        // with a view, value points into the response, which is handed
+        // back in *view, instead of into a JSON copy
         int64_t get(const char* table,
                     const char* key, size_t key_sz,
                     consus_returncode* status,
-                    char** value, size_t* value_sz);
+                    char** value, size_t* value_sz,
+                    e::buffer** view = NULL);
         int64_t put(const char* table,
                     const char* key, size_t key_sz,
                     const char* value, size_t value_sz,
                     consus_returncode* status);
         int64_t commit(consus_returncode* status);
         int64_t abort(consus_returncode* status);
+        int64_t restart(consus_returncode* status);
         void initialize(server_selector* ss);
-        void mark_aborted();
+        const std::vector<cached_read>& cached_reads() const { return m_cached_reads; }
+        // drop everything this transaction read from the cache, so that the
+        // restart fetches fresh versions
+        void invalidate_cached_reads();
+        void mark_aborted(consus_returncode reason);
+        void mark_throttled(uint64_t retry_after);
+        void restarted(const transaction_id& txid,
+                       const comm_id* ids, size_t ids_sz);
+
+    private:
+        uint64_t backoff();
 
     private:
         client* const m_cl;
-        const transaction_id m_txid;
-        const std::vector<comm_id> m_ids;
+        transaction_id m_txid;
+        std::vector<comm_id> m_ids;
         uint64_t m_next_slot;
+        // why the most recent incarnation aborted, and how many times it
+        // has been restarted; together they drive the restart backoff
+        consus_returncode m_abort_reason;
+        unsigned m_restarts;
+        // the server's hint for how long to wait when it throttled us
+        uint64_t m_retry_after;
+        // keys read from the client's cache, and keys written, which must
+        // not be served from it for the rest of this incarnation
+        std::vector<cached_read> m_cached_reads;
+        std::set<std::pair<std::string, std::string> > m_written;
 
     private:
         transaction(const transaction&);
@@ -0,0 +1,57 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_client_value_view_h_
+#define consus_client_value_view_h_
+
+// STL
+#include <memory>
+
+// e
+#include <e/buffer.h>
+#include <e/slice.h>
+
+// consus
+#include "namespace.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// The buffer behind a consus_value handle from consus_get_view().  When value
+// lies within backing, backing itself becomes the view and the value stays
+// where it is; otherwise (e.g., a value from the read cache, which may evict
+// it) the value is copied into a buffer of its own.  *data points at the value
+// within the returned buffer, which belongs to the caller until passed to
+// release_value_view().
+e::buffer*
+make_value_view(const e::slice& value, std::auto_ptr<e::buffer> backing,
+                const char** data);
+void
+release_value_view(e::buffer* view);
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_client_value_view_h_
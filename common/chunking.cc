@@ -0,0 +1,514 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <assert.h>
+#include <string.h>
+
+// STL
+#include <algorithm>
+
+// po6
+#include <po6/time.h>
+
+// consus
+#include "common/chunking.h"
+#include "common/network_msgtype.h"
+
+using consus::chunk_list;
+using consus::chunk_reassembler;
+using consus::chunk_sender;
+
+bool
+consus :: chunking_required(const e::buffer& msg)
+{
+    return msg.size() > BUSYBEE_HEADER_SIZE + CONSUS_CHUNK_THRESHOLD;
+}
+
+std::auto_ptr<e::buffer>
+consus :: make_chunk(uint64_t stream, const e::buffer& msg, uint64_t offset)
+{
+    assert(msg.size() >= BUSYBEE_HEADER_SIZE);
+    const uint64_t total = msg.size() - BUSYBEE_HEADER_SIZE;
+    assert(offset < total);
+    const uint64_t len = std::min(total - offset, uint64_t(CONSUS_CHUNK_SIZE));
+    e::slice bytes(msg.data() + BUSYBEE_HEADER_SIZE + offset, len);
+    const size_t sz = BUSYBEE_HEADER_SIZE
+                    + pack_size(CONSUS_CHUNK)
+                    + 3 * sizeof(uint64_t)
+                    + pack_size(bytes);
+    std::auto_ptr<e::buffer> chunk(e::buffer::create(sz));
+    chunk->pack_at(BUSYBEE_HEADER_SIZE)
+        << CONSUS_CHUNK << stream << offset << total << bytes;
+    return chunk;
+}
+
+std::auto_ptr<e::buffer>
+consus :: make_chunk(uint64_t stream, const chunk_list& msg, const e::slice& prefix, uint64_t offset)
+{
+    assert(offset < msg.size());
+    const uint64_t total = msg.size();
+    e::slice bytes(msg.chunk_at(offset));
+    assert(offset > 0 || prefix.size() <= bytes.size());
+    const size_t sz = BUSYBEE_HEADER_SIZE
+                    + pack_size(CONSUS_CHUNK)
+                    + 3 * sizeof(uint64_t)
+                    + pack_size(bytes);
+    std::auto_ptr<e::buffer> chunk(e::buffer::create(sz));
+    chunk->pack_at(BUSYBEE_HEADER_SIZE)
+        << CONSUS_CHUNK << stream << offset << total << bytes;
+
+    // the bytes are the last thing packed
+    if (offset == 0)
+    {
+        memmove(chunk->data() + chunk->size() - bytes.size(), prefix.data(), prefix.size());
+    }
+
+    return chunk;
+}
+
+std::auto_ptr<e::buffer>
+consus :: make_chunk_ack(e::unpacker up)
+{
+    uint64_t stream;
+    up = up >> stream;
+
+    if (up.error())
+    {
+        return std::auto_ptr<e::buffer>();
+    }
+
+    const size_t sz = BUSYBEE_HEADER_SIZE
+                    + pack_size(CONSUS_CHUNK_ACK)
+                    + sizeof(uint64_t);
+    std::auto_ptr<e::buffer> ack(e::buffer::create(sz));
+    ack->pack_at(BUSYBEE_HEADER_SIZE) << CONSUS_CHUNK_ACK << stream;
+    return ack;
+}
+
+chunk_list :: chunk_list(uint64_t total)
+    : m_total(total)
+    , m_chunks()
+{
+}
+
+chunk_list :: ~chunk_list() throw ()
+{
+    for (chunk_map_t::iterator it = m_chunks.begin(); it != m_chunks.end(); ++it)
+    {
+        delete it->second.first;
+    }
+}
+
+e::slice
+chunk_list :: chunk_at(uint64_t offset) const
+{
+    chunk_map_t::const_iterator it = m_chunks.find(offset);
+    assert(it != m_chunks.end());
+    return it->second.second;
+}
+
+std::auto_ptr<e::buffer>
+chunk_list :: flatten() const
+{
+    std::auto_ptr<e::buffer> whole(e::buffer::create(BUSYBEE_HEADER_SIZE + m_total));
+    whole->resize(BUSYBEE_HEADER_SIZE + m_total);
+
+    for (chunk_map_t::const_iterator c = m_chunks.begin(); c != m_chunks.end(); ++c)
+    {
+        const e::slice& b(c->second.second);
+        memmove(whole->data() + BUSYBEE_HEADER_SIZE + c->first, b.data(), b.size());
+    }
+
+    return whole;
+}
+
+bool
+chunk_list :: holds(uint64_t offset) const
+{
+    return m_chunks.find(offset) != m_chunks.end();
+}
+
+void
+chunk_list :: add(uint64_t offset, std::auto_ptr<e::buffer>* chunk, const e::slice& bytes)
+{
+    assert(!holds(offset));
+    m_chunks.insert(std::make_pair(offset, std::make_pair(chunk->release(), bytes)));
+}
+
+struct chunk_sender :: outgoing
+{
+    outgoing(std::auto_ptr<e::buffer> m)
+        : msg(m), list(), prefix(), next_offset(0), unacked(0), last_progress(po6::monotonic_time()) {}
+    outgoing(const e::compat::shared_ptr<const chunk_list>& l, const e::slice& p)
+        : msg(), list(l), prefix(p.str()), next_offset(0), unacked(0), last_progress(po6::monotonic_time()) {}
+    ~outgoing() throw () {}
+    uint64_t size() const { return msg.get() ? msg->size() - BUSYBEE_HEADER_SIZE : list->size(); }
+
+    // either the message, or the chunks of a message being relayed
+    std::auto_ptr<e::buffer> msg;
+    e::compat::shared_ptr<const chunk_list> list;
+    std::string prefix;
+    uint64_t next_offset;
+    unsigned unacked;
+    uint64_t last_progress;
+
+    private:
+        outgoing(const outgoing&);
+        outgoing& operator = (const outgoing&);
+};
+
+chunk_sender :: chunk_sender()
+    : m_mtx()
+    , m_next_stream(1)
+    , m_streams()
+{
+}
+
+chunk_sender :: ~chunk_sender() throw ()
+{
+    for (outgoing_map_t::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+    {
+        delete it->second;
+    }
+}
+
+uint64_t
+chunk_sender :: start(comm_id to, std::auto_ptr<e::buffer> msg)
+{
+    assert(chunking_required(*msg));
+    return start(to, new outgoing(msg));
+}
+
+uint64_t
+chunk_sender :: start(comm_id to, const e::compat::shared_ptr<const chunk_list>& msg,
+                      const e::slice& prefix)
+{
+    return start(to, new outgoing(msg, prefix));
+}
+
+std::auto_ptr<e::buffer>
+chunk_sender :: next(comm_id to, uint64_t stream)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return next(m_streams.find(std::make_pair(to, stream)));
+}
+
+std::auto_ptr<e::buffer>
+chunk_sender :: acknowledged(comm_id from, e::unpacker up)
+{
+    uint64_t stream;
+    up = up >> stream;
+
+    if (up.error())
+    {
+        return std::auto_ptr<e::buffer>();
+    }
+
+    po6::threads::mutex::hold hold(&m_mtx);
+    outgoing_map_t::iterator it = m_streams.find(std::make_pair(from, stream));
+
+    if (it != m_streams.end() && it->second->unacked > 0)
+    {
+        --it->second->unacked;
+        it->second->last_progress = po6::monotonic_time();
+    }
+
+    return next(it);
+}
+
+void
+chunk_sender :: forget(comm_id to)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    for (outgoing_map_t::iterator it = m_streams.begin(); it != m_streams.end(); )
+    {
+        if (it->first.first == to)
+        {
+            delete it->second;
+            m_streams.erase(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void
+chunk_sender :: expire(uint64_t cutoff)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    for (outgoing_map_t::iterator it = m_streams.begin(); it != m_streams.end(); )
+    {
+        if (it->second->last_progress < cutoff)
+        {
+            delete it->second;
+            m_streams.erase(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+size_t
+chunk_sender :: pending_streams()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return m_streams.size();
+}
+
+uint64_t
+chunk_sender :: start(comm_id to, outgoing* o)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    const uint64_t stream = m_next_stream++;
+    m_streams.insert(std::make_pair(std::make_pair(to, stream), o));
+    return stream;
+}
+
+std::auto_ptr<e::buffer>
+chunk_sender :: next(outgoing_map_t::iterator it)
+{
+    if (it == m_streams.end() ||
+        it->second->unacked >= CONSUS_CHUNK_WINDOW)
+    {
+        return std::auto_ptr<e::buffer>();
+    }
+
+    outgoing* o = it->second;
+    std::auto_ptr<e::buffer> chunk = o->msg.get()
+        ? make_chunk(it->first.second, *o->msg, o->next_offset)
+        : make_chunk(it->first.second, *o->list, e::slice(o->prefix), o->next_offset);
+    o->next_offset += CONSUS_CHUNK_SIZE;
+    ++o->unacked;
+
+    // the rest of the acknowledgements only slide a window with nothing left
+    if (o->next_offset >= o->size())
+    {
+        delete o;
+        m_streams.erase(it);
+    }
+
+    return chunk;
+}
+
+struct chunk_reassembler :: partial
+{
+    partial(uint64_t total)
+        : received(0), last_progress(po6::monotonic_time()), chunks(new chunk_list(total)) {}
+    ~partial() throw () {}
+
+    uint64_t received;
+    uint64_t last_progress;
+    std::auto_ptr<chunk_list> chunks;
+
+    private:
+        partial(const partial&);
+        partial& operator = (const partial&);
+};
+
+chunk_reassembler :: chunk_reassembler(uint64_t per_sender, uint64_t overall)
+    : m_per_sender(per_sender)
+    , m_overall(overall)
+    , m_mtx()
+    , m_partials()
+    , m_senders()
+    , m_buffered(0)
+{
+}
+
+chunk_reassembler :: ~chunk_reassembler() throw ()
+{
+    for (partial_map_t::iterator it = m_partials.begin(); it != m_partials.end(); ++it)
+    {
+        delete it->second;
+    }
+}
+
+bool
+chunk_reassembler :: reassemble(comm_id from, e::unpacker up, std::auto_ptr<e::buffer>* msg)
+{
+    std::auto_ptr<chunk_list> whole;
+
+    if (!collect(from, up, msg, &whole))
+    {
+        return false;
+    }
+
+    *msg = whole->flatten();
+    return true;
+}
+
+bool
+chunk_reassembler :: collect(comm_id from, e::unpacker up,
+                             std::auto_ptr<e::buffer>* msg,
+                             std::auto_ptr<chunk_list>* whole)
+{
+    uint64_t stream;
+    uint64_t offset;
+    uint64_t total;
+    e::slice bytes;
+    up = up >> stream >> offset >> total >> bytes;
+
+    // the sender cuts chunks at fixed boundaries, so a repeat of a chunk is
+    // always at an offset that is already held
+    if (up.error() || up.remain() ||
+        total > CONSUS_CHUNK_MAX ||
+        offset >= total || offset % CONSUS_CHUNK_SIZE != 0 ||
+        bytes.size() != std::min(total - offset, uint64_t(CONSUS_CHUNK_SIZE)))
+    {
+        return false;
+    }
+
+    po6::threads::mutex::hold hold(&m_mtx);
+    std::pair<comm_id, uint64_t> key(from, stream);
+    partial_map_t::iterator it = m_partials.find(key);
+
+    if (it == m_partials.end())
+    {
+        it = m_partials.insert(std::make_pair(key, new partial(total))).first;
+    }
+
+    partial* p = it->second;
+
+    if (p->chunks->size() != total)
+    {
+        drop(it);
+        return false;
+    }
+
+    if (p->chunks->holds(offset))
+    {
+        return false;
+    }
+
+    uint64_t& sender = m_senders[from];
+
+    if (sender + bytes.size() > m_per_sender ||
+        m_buffered + bytes.size() > m_overall)
+    {
+        if (sender == 0)
+        {
+            m_senders.erase(from);
+        }
+
+        drop(it);
+        return false;
+    }
+
+    p->chunks->add(offset, msg, bytes);
+    sender += bytes.size();
+    m_buffered += bytes.size();
+    p->received += bytes.size();
+    p->last_progress = po6::monotonic_time();
+
+    if (p->received < total)
+    {
+        return false;
+    }
+
+    *whole = p->chunks;
+    drop(it);
+    return true;
+}
+
+void
+chunk_reassembler :: forget(comm_id from)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    for (partial_map_t::iterator it = m_partials.begin(); it != m_partials.end(); )
+    {
+        if (it->first.first == from)
+        {
+            drop(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void
+chunk_reassembler :: expire(uint64_t cutoff)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    for (partial_map_t::iterator it = m_partials.begin(); it != m_partials.end(); )
+    {
+        if (it->second->last_progress < cutoff)
+        {
+            drop(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+size_t
+chunk_reassembler :: pending_streams()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return m_partials.size();
+}
+
+uint64_t
+chunk_reassembler :: buffered_bytes()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return m_buffered;
+}
+
+void
+chunk_reassembler :: drop(partial_map_t::iterator it)
+{
+    const uint64_t received = it->second->received;
+
+    if (received > 0)
+    {
+        sender_map_t::iterator s = m_senders.find(it->first.first);
+        assert(s != m_senders.end() && s->second >= received);
+        s->second -= received;
+
+        if (s->second == 0)
+        {
+            m_senders.erase(s);
+        }
+    }
+
+    m_buffered -= received;
+    delete it->second;
+    m_partials.erase(it);
+}
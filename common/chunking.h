@@ -0,0 +1,250 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_common_chunking_h_
+#define consus_common_chunking_h_
+
+// STL
+#include <map>
+#include <memory>
+#include <string>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/buffer.h>
+#include <e/compat.h>
+#include <e/slice.h>
+
+// BusyBee
+#include <busybee.h>
+
+// consus
+#include "namespace.h"
+#include "common/constants.h"
+#include "common/ids.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// Large messages are sent as a stream of CONSUS_CHUNK messages, each carrying
+// (stream, offset, total, bytes) for a slice of the original message.  The
+// receiver reassembles the stream and processes the result exactly as if it
+// had arrived in one piece.
+//
+// The receiver answers every chunk with a CONSUS_CHUNK_ACK, and the sender
+// keeps at most CONSUS_CHUNK_WINDOW chunks of any stream unacknowledged; the
+// rest wait in the chunk_sender, not in BusyBee's queue, so a small message
+// sent while a large one is in flight waits behind a few chunks at most.
+//
+// A daemon that only relays a large message under a new type and nonce need
+// not reassemble it:  it keeps the chunk_list the stream arrived as and sends
+// from that, so the message is made contiguous only where it is processed.
+class chunk_list;
+bool
+chunking_required(const e::buffer& msg);
+std::auto_ptr<e::buffer>
+make_chunk(uint64_t stream, const e::buffer& msg, uint64_t offset);
+// the chunk at offset of a relayed message, with prefix written over the
+// first bytes of the message (its type, and the fields a relay changes)
+std::auto_ptr<e::buffer>
+make_chunk(uint64_t stream, const chunk_list& msg, const e::slice& prefix, uint64_t offset);
+// the acknowledgement for a chunk, with up positioned just past its message
+// type; NULL if the chunk is malformed
+std::auto_ptr<e::buffer>
+make_chunk_ack(e::unpacker up);
+
+// The chunks of a completed stream, held in the buffers they arrived in.
+class chunk_list
+{
+    public:
+        chunk_list(uint64_t total);
+        ~chunk_list() throw ();
+
+    public:
+        // the size of the message, less BusyBee's header
+        uint64_t size() const { return m_total; }
+        // the bytes of the chunk at offset, which is on a CONSUS_CHUNK_SIZE
+        // boundary; chunk_at(0) starts with the message type
+        e::slice chunk_at(uint64_t offset) const;
+        // the whole message, copied into one buffer
+        std::auto_ptr<e::buffer> flatten() const;
+
+    private:
+        friend class chunk_reassembler;
+        typedef std::map<uint64_t, std::pair<e::buffer*, e::slice> > chunk_map_t;
+
+    private:
+        bool holds(uint64_t offset) const;
+        // takes the chunk's message, which bytes points into
+        void add(uint64_t offset, std::auto_ptr<e::buffer>* chunk, const e::slice& bytes);
+
+    private:
+        const uint64_t m_total;
+        chunk_map_t m_chunks;
+
+    private:
+        chunk_list(const chunk_list&);
+        chunk_list& operator = (const chunk_list&);
+};
+
+class chunk_sender
+{
+    public:
+        chunk_sender();
+        ~chunk_sender() throw ();
+
+    public:
+        // start streaming msg to "to" and return its stream id
+        uint64_t start(comm_id to, std::auto_ptr<e::buffer> msg);
+        // as above, relaying msg with prefix over its first bytes
+        uint64_t start(comm_id to, const e::compat::shared_ptr<const chunk_list>& msg,
+                       const e::slice& prefix);
+        // the next chunk of the stream that may go out now, if any
+        std::auto_ptr<e::buffer> next(comm_id to, uint64_t stream);
+        // consume one CONSUS_CHUNK_ACK, with up positioned just past the
+        // message type; returns the chunk it frees up to go out, if any
+        std::auto_ptr<e::buffer> acknowledged(comm_id from, e::unpacker up);
+        // drop streams to a receiver that went away, or that have not made
+        // progress since before the cutoff
+        void forget(comm_id to);
+        void expire(uint64_t cutoff);
+        size_t pending_streams();
+
+    private:
+        struct outgoing;
+        typedef std::map<std::pair<comm_id, uint64_t>, outgoing*> outgoing_map_t;
+
+    private:
+        uint64_t start(comm_id to, outgoing* o);
+        std::auto_ptr<e::buffer> next(outgoing_map_t::iterator it);
+
+    private:
+        po6::threads::mutex m_mtx;
+        uint64_t m_next_stream;
+        outgoing_map_t m_streams;
+
+    private:
+        chunk_sender(const chunk_sender&);
+        chunk_sender& operator = (const chunk_sender&);
+};
+
+template <typename BB>
+busybee_returncode
+send_stream(BB* bb, uint64_t to, chunk_sender* cs, uint64_t stream)
+{
+    for (std::auto_ptr<e::buffer> chunk = cs->next(comm_id(to), stream);
+            chunk.get(); chunk = cs->next(comm_id(to), stream))
+    {
+        busybee_returncode rc = bb->send(to, chunk);
+
+        if (rc != BUSYBEE_SUCCESS)
+        {
+            cs->forget(comm_id(to));
+            return rc;
+        }
+    }
+
+    return BUSYBEE_SUCCESS;
+}
+
+template <typename BB>
+busybee_returncode
+send_chunked(BB* bb, uint64_t to, chunk_sender* cs, std::auto_ptr<e::buffer> msg)
+{
+    if (!chunking_required(*msg))
+    {
+        return bb->send(to, msg);
+    }
+
+    return send_stream(bb, to, cs, cs->start(comm_id(to), msg));
+}
+
+template <typename BB>
+busybee_returncode
+send_chunked(BB* bb, uint64_t to, chunk_sender* cs,
+             const e::compat::shared_ptr<const chunk_list>& msg,
+             const e::slice& prefix)
+{
+    return send_stream(bb, to, cs, cs->start(comm_id(to), msg, prefix));
+}
+
+// Chunks are held as they arrive and copied into place only once the stream
+// is complete, or never for a stream collected to be relayed, so memory
+// tracks what was actually received.  Chunks must sit
+// on CONSUS_CHUNK_SIZE boundaries; repeats of an offset already held are
+// ignored.  A sender may have at most per_sender bytes waiting in partial
+// streams, and everyone together at most overall; a chunk that would exceed
+// either drops its stream.
+class chunk_reassembler
+{
+    public:
+        chunk_reassembler(uint64_t per_sender = CONSUS_CHUNK_MAX,
+                          uint64_t overall = CONSUS_CHUNK_BUFFERED_MAX);
+        ~chunk_reassembler() throw ();
+
+    public:
+        // consume one CONSUS_CHUNK message held in *msg, with up positioned
+        // just past the message type; returns true and replaces *msg with
+        // the original message once the stream is complete
+        bool reassemble(comm_id from, e::unpacker up, std::auto_ptr<e::buffer>* msg);
+        // as reassemble, but leaves a completed stream in *whole as the
+        // chunks it arrived in, for a caller that may relay it
+        bool collect(comm_id from, e::unpacker up,
+                     std::auto_ptr<e::buffer>* msg,
+                     std::auto_ptr<chunk_list>* whole);
+        // drop partial streams from a sender that went away, or that have
+        // not made progress since before the cutoff
+        void forget(comm_id from);
+        void expire(uint64_t cutoff);
+        size_t pending_streams();
+        uint64_t buffered_bytes();
+
+    private:
+        struct partial;
+        typedef std::map<std::pair<comm_id, uint64_t>, partial*> partial_map_t;
+        typedef std::map<comm_id, uint64_t> sender_map_t;
+
+    private:
+        void drop(partial_map_t::iterator it);
+
+    private:
+        const uint64_t m_per_sender;
+        const uint64_t m_overall;
+        po6::threads::mutex m_mtx;
+        partial_map_t m_partials;
+        sender_map_t m_senders;
+        uint64_t m_buffered;
+
+    private:
+        chunk_reassembler(const chunk_reassembler&);
+        chunk_reassembler& operator = (const chunk_reassembler&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_common_chunking_h_
@@ -57,4 +57,31 @@
 
 #define CONSUS_WRITE_TOMBSTONE 1
 
+// one per value of enum consus_priority
+#define CONSUS_PRIORITY_CLASSES 3
+
+// Messages larger than the threshold travel as a stream of chunks of at most
+// CONSUS_CHUNK_SIZE bytes, no more than CONSUS_CHUNK_WINDOW of them
+// unacknowledged at once, so that small messages sharing the connection can
+// slip in between them.  Nothing larger than CONSUS_CHUNK_MAX is reassembled,
+// and a receiver holds at most CONSUS_CHUNK_BUFFERED_MAX bytes of partial
+// messages from all senders together.
+#define CONSUS_CHUNK_THRESHOLD (1ULL << 20)
+#define CONSUS_CHUNK_SIZE (256ULL << 10)
+#define CONSUS_CHUNK_WINDOW 4
+#define CONSUS_CHUNK_MAX (1ULL << 30)
+#define CONSUS_CHUNK_BUFFERED_MAX (2ULL << 30)
+
+// Commit records are shipped to remote data centers in chunks of roughly this
+// many bytes, with at most CONSUS_COMMIT_RECORD_WINDOW unacknowledged chunks
+// outstanding to any one data center.
+#define CONSUS_COMMIT_RECORD_CHUNK (64ULL << 10)
+#define CONSUS_COMMIT_RECORD_WINDOW 8
+
+// Each transaction manager's change feed keeps two segments of this size on
+// disk (and in memory), and answers a reader with at most
+// CONSUS_CHANGE_FEED_BATCH bytes of changes at a time.
+#define CONSUS_CHANGE_FEED_SEGMENT (32ULL << 20)
+#define CONSUS_CHANGE_FEED_BATCH (1ULL << 20)
+
 #endif // consus_common_constants_h_
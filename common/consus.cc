@@ -48,6 +48,7 @@ consus :: operator << (std::ostream& lhs, const consus_returncode& rc)
         STRINGIFY(CONSUS_COORD_FAIL);
         STRINGIFY(CONSUS_UNAVAILABLE);
         STRINGIFY(CONSUS_SERVER_ERROR);
+        STRINGIFY(CONSUS_THROTTLED);
         STRINGIFY(CONSUS_INTERNAL);
         STRINGIFY(CONSUS_GARBAGE);
         default:
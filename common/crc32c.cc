@@ -80,6 +80,140 @@ crc32_sse42_quads(uint32_t init_crc, const uint8_t* data, size_t n)
     return crc;
 }
 
+// The CRC register is linear, so the register after A || B is the register
+// after A advanced over |B| zero bytes, xor the register after B alone.
+// Advancing over n zero bytes multiplies by x^(8n) mod P.  Three streams over
+// adjacent blocks run in parallel and are stitched together this way, hiding
+// the three-cycle latency of crc32q; the multiplication is a carry-less
+// multiply whose 64-bit product crc32 reduces back to 32 bits.
+#define CRC32C_LONG 4096
+#define CRC32C_SHORT 256
+#define CRC32C_POLY 0x82F63B78U
+
+// a * b mod P with both operands bit-reflected, one bit at a time
+static uint32_t
+crc32c_multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m = 1U << 31;
+    uint32_t p = 0;
+
+    while (m)
+    {
+        if (a & m)
+        {
+            p ^= b;
+        }
+
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+
+    return p;
+}
+
+// x^(8n) mod P, bit-reflected
+static uint32_t
+crc32c_x8nmodp(size_t n)
+{
+    uint32_t p = 1U << 31;
+    uint32_t x8 = 1U << 23;
+
+    while (n)
+    {
+        if (n & 1)
+        {
+            p = crc32c_multmodp(x8, p);
+        }
+
+        x8 = crc32c_multmodp(x8, x8);
+        n >>= 1;
+    }
+
+    return p;
+}
+
+static const uint32_t crc32c_long_1x = crc32c_x8nmodp(CRC32C_LONG);
+static const uint32_t crc32c_long_2x = crc32c_x8nmodp(2 * CRC32C_LONG);
+static const uint32_t crc32c_short_1x = crc32c_x8nmodp(CRC32C_SHORT);
+static const uint32_t crc32c_short_2x = crc32c_x8nmodp(2 * CRC32C_SHORT);
+
+static inline uint64_t
+crc32c_shift_clmul(uint64_t crc, uint64_t k)
+{
+    uint64_t product;
+    __asm__ ("movq %1, %%xmm0\n\t"
+             "movq %2, %%xmm1\n\t"
+             "pclmulqdq $0x00, %%xmm1, %%xmm0\n\t"
+             "movq %%xmm0, %0"
+             : "=r"(product) : "r"(crc), "r"(k) : "xmm0", "xmm1");
+    // the reflected product sits one bit low in the 64-bit result
+    product <<= 1;
+    uint64_t lo = product & 0xFFFFFFFFULL;
+    __asm__ ("crc32l %k2, %k0" : "=r"(lo) : "0"(uint64_t(0)), "r"(lo));
+    return lo ^ (product >> 32);
+}
+
+static inline uint64_t
+crc32c_3way_block(uint64_t crc, const uint64_t* body, size_t quads,
+                  uint64_t k1, uint64_t k2)
+{
+    const uint64_t* a = body;
+    const uint64_t* b = body + quads;
+    const uint64_t* c = body + 2 * quads;
+    uint64_t crc_a = crc;
+    uint64_t crc_b = 0;
+    uint64_t crc_c = 0;
+
+    for (size_t i = 0; i < quads; ++i)
+    {
+        __asm__ ("crc32q %2, %0" : "=r"(crc_a) : "0"(crc_a), "r"(a[i]));
+        __asm__ ("crc32q %2, %0" : "=r"(crc_b) : "0"(crc_b), "r"(b[i]));
+        __asm__ ("crc32q %2, %0" : "=r"(crc_c) : "0"(crc_c), "r"(c[i]));
+    }
+
+    return crc32c_shift_clmul(crc_a, k2) ^ crc32c_shift_clmul(crc_b, k1) ^ crc_c;
+}
+
+static uint32_t
+crc32_sse42_3way(uint32_t init_crc, const uint8_t* data, size_t n)
+{
+    if (n < 3 * CRC32C_SHORT)
+    {
+        return crc32_sse42_quads(init_crc, data, n);
+    }
+
+    uint64_t crc = init_crc ^ CRC_FFs;
+    const uintptr_t x = reinterpret_cast<uintptr_t>(data);
+    const size_t init = ((x + 7) & ~7ULL) - x;
+
+    for (size_t i = 0; i < init; ++i)
+    {
+        __asm__ __volatile__("crc32b %2, %0\n\t" : "=r"(crc) : "0"(crc), "r"(data[i]) : );
+    }
+
+    data += init;
+    n -= init;
+
+    while (n >= 3 * CRC32C_LONG)
+    {
+        crc = crc32c_3way_block(crc, reinterpret_cast<const uint64_t*>(data),
+                                CRC32C_LONG / 8, crc32c_long_1x, crc32c_long_2x);
+        data += 3 * CRC32C_LONG;
+        n -= 3 * CRC32C_LONG;
+    }
+
+    while (n >= 3 * CRC32C_SHORT)
+    {
+        crc = crc32c_3way_block(crc, reinterpret_cast<const uint64_t*>(data),
+                                CRC32C_SHORT / 8, crc32c_short_1x, crc32c_short_2x);
+        data += 3 * CRC32C_SHORT;
+        n -= 3 * CRC32C_SHORT;
+    }
+
+    // data is still aligned, so the tail goes straight to the quad loop
+    return crc32_sse42_quads(crc ^ CRC_FFs, data, n);
+}
+
 typedef uint32_t (*crc32c_func_t)(uint32_t init_crc, const uint8_t* data, size_t n);
 
 #if defined(__i386__)
@@ -108,6 +242,11 @@ choose_crc32c()
     cpuid_t xd;
     cpuid(xa, xb, xc, xd, 1);
 
+    if ((xc & (1<<20)) && (xc & (1<<1)))
+    {
+        return crc32_sse42_3way;
+    }
+
     if (xc & (1<<20))
     {
         return crc32_sse42_quads;
@@ -125,6 +264,12 @@ consus :: crc32c(uint32_t init, const unsigned char* data, size_t n)
     return crc32c_func(init, data, n);
 }
 
+uint32_t
+consus :: crc32c_portable(uint32_t init, const unsigned char* data, size_t n)
+{
+    return crc32_software(init, data, n);
+}
+
 /* This is Intel's slicing-by-8 implementation of CRC32.
  *
  * Retrieved From:  http://slicing-by-8.sourceforge.net/
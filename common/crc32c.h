@@ -39,6 +39,10 @@ BEGIN_CONSUS_NAMESPACE
 
 uint32_t
 crc32c(uint32_t init, const unsigned char* data, size_t n);
+// the table-driven implementation crc32c falls back on when the CPU lacks
+// SSE4.2; exposed so the accelerated paths can be checked against it
+uint32_t
+crc32c_portable(uint32_t init, const unsigned char* data, size_t n);
 
 END_CONSUS_NAMESPACE
 
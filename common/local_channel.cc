@@ -0,0 +1,459 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// C
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+// POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef CONSUS_LOCAL_CHANNEL
+#include <sys/eventfd.h>
+#endif
+
+// STL
+#include <sstream>
+
+// e
+#include <e/atomic.h>
+
+// BusyBee
+#include <busybee.h>
+
+// consus
+#include "common/local_channel.h"
+
+using consus::local_channel;
+
+#define RING_CAPACITY (4ULL << 20)
+#define BACKLOG_LIMIT (64ULL << 20)
+#define FRAME_WRAP 0xffffffffU
+
+// positions count bytes ever written/consumed; the producer owns tail, the
+// consumer owns head, and each keeps to its own cache line
+struct local_channel :: ring
+{
+    uint64_t head;
+    // the consumer is about to sleep on its bell
+    uint32_t waiting;
+    char pad0[64 - sizeof(uint64_t) - sizeof(uint32_t)];
+    uint64_t tail;
+    // the producer is waiting for space
+    uint32_t blocked;
+    char pad1[64 - sizeof(uint64_t) - sizeof(uint32_t)];
+    unsigned char data[RING_CAPACITY];
+};
+
+static size_t
+frame_size(size_t len)
+{
+    return (sizeof(uint32_t) + len + 7) & ~size_t(7);
+}
+
+static void
+ring_bell(int fd)
+{
+    uint64_t one = 1;
+    ssize_t ret = ::write(fd, &one, sizeof(one));
+    // a full counter still wakes the other side
+    (void) ret;
+}
+
+local_channel*
+local_channel :: create()
+{
+#ifdef CONSUS_LOCAL_CHANNEL
+#ifdef HAVE_MEMFD_CREATE
+    int shm = memfd_create("consus-local", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+    static uint64_t counter = 0;
+    char name[64];
+    snprintf(name, sizeof(name), "/consus-local-%d-%lu", getpid(),
+             static_cast<unsigned long>(e::atomic::increment_64_nobarrier(&counter, 1)));
+    int shm = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+#endif
+
+    if (shm < 0)
+    {
+        return NULL;
+    }
+
+#ifndef HAVE_MEMFD_CREATE
+    shm_unlink(name);
+#endif
+    int server_bell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int client_bell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    void* base = MAP_FAILED;
+
+    if (server_bell >= 0 && client_bell >= 0 &&
+        ftruncate(shm, 2 * sizeof(ring)) == 0 &&
+#ifdef HAVE_MEMFD_CREATE
+        // a client that shrank the file would fault the server on access
+        fcntl(shm, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == 0 &&
+#endif
+        true)
+    {
+        base = mmap(NULL, 2 * sizeof(ring), PROT_READ | PROT_WRITE, MAP_SHARED, shm, 0);
+    }
+
+    if (base == MAP_FAILED)
+    {
+        close(shm);
+        if (server_bell >= 0) close(server_bell);
+        if (client_bell >= 0) close(client_bell);
+        return NULL;
+    }
+
+    // the mapping starts zeroed, which is two empty rings
+    return new local_channel(SERVER, shm, server_bell, client_bell, base);
+#else
+    return NULL;
+#endif
+}
+
+local_channel*
+local_channel :: attach(int fds[DESCRIPTORS])
+{
+    struct stat st;
+    void* base = MAP_FAILED;
+
+    if (fstat(fds[0], &st) == 0 &&
+        st.st_size == static_cast<off_t>(2 * sizeof(ring)))
+    {
+        base = mmap(NULL, 2 * sizeof(ring), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    }
+
+    if (base == MAP_FAILED)
+    {
+        for (size_t i = 0; i < DESCRIPTORS; ++i)
+        {
+            close(fds[i]);
+        }
+
+        return NULL;
+    }
+
+    return new local_channel(CLIENT, fds[0], fds[1], fds[2], base);
+}
+
+local_channel :: local_channel(side_t side, int shm, int server_bell, int client_bell, void* base)
+    : m_side(side)
+    , m_shm(shm)
+    , m_server_bell(server_bell)
+    , m_client_bell(client_bell)
+    , m_base(base)
+    // clients send on the first ring and servers on the second
+    , m_out(static_cast<ring*>(base) + (side == CLIENT ? 0 : 1))
+    , m_in(static_cast<ring*>(base) + (side == CLIENT ? 1 : 0))
+    , m_in_head(0)
+    , m_out_tail(0)
+    , m_backlog()
+    , m_backlog_bytes(0)
+    , m_broken(false)
+{
+}
+
+local_channel :: ~local_channel() throw ()
+{
+    munmap(m_base, 2 * sizeof(ring));
+    close(m_shm);
+    close(m_server_bell);
+    close(m_client_bell);
+
+    for (std::list<e::buffer*>::iterator it = m_backlog.begin();
+            it != m_backlog.end(); ++it)
+    {
+        delete *it;
+    }
+}
+
+void
+local_channel :: descriptors(int fds[DESCRIPTORS]) const
+{
+    fds[0] = m_shm;
+    fds[1] = m_server_bell;
+    fds[2] = m_client_bell;
+}
+
+int
+local_channel :: bell() const
+{
+    return m_side == SERVER ? m_server_bell : m_client_bell;
+}
+
+void
+local_channel :: silence()
+{
+    uint64_t count;
+
+    while (::read(bell(), &count, sizeof(count)) == sizeof(count))
+    {
+    }
+}
+
+bool
+local_channel :: send(std::auto_ptr<e::buffer> msg)
+{
+    assert(msg->size() >= BUSYBEE_HEADER_SIZE);
+    const size_t sz = msg->size() - BUSYBEE_HEADER_SIZE;
+
+    if (m_broken || frame_size(sz) > RING_CAPACITY / 2)
+    {
+        return false;
+    }
+
+    if (m_backlog.empty() && write(*msg))
+    {
+        return true;
+    }
+
+    // a peer this far behind is not reading
+    if (m_backlog_bytes + sz > BACKLOG_LIMIT)
+    {
+        return false;
+    }
+
+    m_backlog.push_back(msg.release());
+    m_backlog_bytes += sz;
+    flush();
+    return true;
+}
+
+bool
+local_channel :: flush()
+{
+    while (!m_broken && !m_backlog.empty())
+    {
+        if (!write(*m_backlog.front()))
+        {
+            // ask the consumer to ring once it makes room, then look again
+            // in case it made room before it could see the request
+            e::atomic::compare_and_swap_32_fullbarrier(&m_out->blocked, 0, 1);
+
+            if (!write(*m_backlog.front()))
+            {
+                return false;
+            }
+        }
+
+        m_backlog_bytes -= m_backlog.front()->size() - BUSYBEE_HEADER_SIZE;
+        delete m_backlog.front();
+        m_backlog.pop_front();
+    }
+
+    return m_backlog.empty();
+}
+
+bool
+local_channel :: recv(std::auto_ptr<e::buffer>* msg)
+{
+    // the peer can write anything to the ring; positions this side owns
+    // are kept privately, and what the peer wrote is checked before use
+    ring* r = m_in;
+    const uint64_t tail = e::atomic::load_64_acquire(&r->tail);
+    uint64_t head = m_in_head;
+
+    if (m_broken || head == tail)
+    {
+        return false;
+    }
+
+    uint32_t len;
+    memmove(&len, r->data + head % RING_CAPACITY, sizeof(len));
+
+    if (len == FRAME_WRAP)
+    {
+        head += RING_CAPACITY - head % RING_CAPACITY;
+
+        if (tail - head > RING_CAPACITY || head == tail)
+        {
+            m_broken = true;
+            return false;
+        }
+
+        memmove(&len, r->data + head % RING_CAPACITY, sizeof(len));
+    }
+
+    const size_t off = head % RING_CAPACITY;
+
+    if (tail - head > RING_CAPACITY ||
+        frame_size(len) > RING_CAPACITY / 2 ||
+        off + frame_size(len) > RING_CAPACITY ||
+        frame_size(len) > tail - head)
+    {
+        m_broken = true;
+        return false;
+    }
+
+    msg->reset(e::buffer::create(BUSYBEE_HEADER_SIZE + len));
+    (*msg)->resize(BUSYBEE_HEADER_SIZE + len);
+    memmove((*msg)->data() + BUSYBEE_HEADER_SIZE, r->data + off + sizeof(len), len);
+    m_in_head = head + frame_size(len);
+    e::atomic::store_64_release(&r->head, m_in_head);
+
+    if (e::atomic::compare_and_swap_32_fullbarrier(&r->blocked, 1, 0) == 1)
+    {
+        ring_bell(m_side == SERVER ? m_client_bell : m_server_bell);
+    }
+
+    return true;
+}
+
+bool
+local_channel :: prepare_to_wait()
+{
+    // leaves the blocked flag set if the backlog is stuck
+    flush();
+    e::atomic::compare_and_swap_32_fullbarrier(&m_in->waiting, 0, 1);
+
+    if (!m_broken && e::atomic::load_64_acquire(&m_in->tail) != m_in_head)
+    {
+        e::atomic::compare_and_swap_32_fullbarrier(&m_in->waiting, 1, 0);
+        return false;
+    }
+
+    return true;
+}
+
+bool
+local_channel :: write(const e::buffer& msg)
+{
+    ring* r = m_out;
+    const uint32_t len = msg.size() - BUSYBEE_HEADER_SIZE;
+    const size_t need = frame_size(len);
+    const uint64_t head = e::atomic::load_64_acquire(&r->head);
+    uint64_t tail = m_out_tail;
+    const size_t to_end = RING_CAPACITY - tail % RING_CAPACITY;
+    const size_t total = need <= to_end ? need : to_end + need;
+
+    // the peer claims to have read what was never written
+    if (head > tail || tail - head > RING_CAPACITY)
+    {
+        m_broken = true;
+        return false;
+    }
+
+    if (tail + total - head > RING_CAPACITY)
+    {
+        return false;
+    }
+
+    // frames never straddle the end of the ring
+    if (need > to_end)
+    {
+        const uint32_t wrap = FRAME_WRAP;
+        memmove(r->data + tail % RING_CAPACITY, &wrap, sizeof(wrap));
+        tail += to_end;
+    }
+
+    const size_t off = tail % RING_CAPACITY;
+    memmove(r->data + off, &len, sizeof(len));
+    memmove(r->data + off + sizeof(len), msg.data() + BUSYBEE_HEADER_SIZE, len);
+    m_out_tail = tail + need;
+    e::atomic::store_64_release(&r->tail, m_out_tail);
+
+    if (e::atomic::compare_and_swap_32_fullbarrier(&r->waiting, 1, 0) == 1)
+    {
+        ring_bell(m_side == SERVER ? m_client_bell : m_server_bell);
+    }
+
+    return true;
+}
+
+std::string
+local_channel :: socket_name(const po6::net::location& loc)
+{
+    // Linux's abstract namespace:  nothing to clean up if the server dies
+    std::ostringstream ostr;
+    ostr << '\0' << "consus-txman-" << loc;
+    return ostr.str();
+}
+
+bool
+local_channel :: send_descriptors(int sock, int fds[DESCRIPTORS])
+{
+    char byte = 'C';
+    struct iovec iov;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    char control[CMSG_SPACE(DESCRIPTORS * sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control;
+    mh.msg_controllen = sizeof(control);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&mh);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(DESCRIPTORS * sizeof(int));
+    memmove(CMSG_DATA(cmsg), fds, DESCRIPTORS * sizeof(int));
+    return sendmsg(sock, &mh, MSG_NOSIGNAL) == 1;
+}
+
+bool
+local_channel :: recv_descriptors(int sock, int fds[DESCRIPTORS])
+{
+    char byte = 0;
+    struct iovec iov;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    char control[CMSG_SPACE(DESCRIPTORS * sizeof(int))];
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control;
+    mh.msg_controllen = sizeof(control);
+
+    if (recvmsg(sock, &mh, MSG_CMSG_CLOEXEC) != 1 || byte != 'C')
+    {
+        return false;
+    }
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&mh);
+
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(DESCRIPTORS * sizeof(int)))
+    {
+        return false;
+    }
+
+    memmove(fds, CMSG_DATA(cmsg), DESCRIPTORS * sizeof(int));
+    return true;
+}
@@ -0,0 +1,142 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_common_local_channel_h_
+#define consus_common_local_channel_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <list>
+#include <memory>
+#include <string>
+
+// po6
+#include <po6/net/location.h>
+
+// e
+#include <e/buffer.h>
+
+// consus
+#include "namespace.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// A message channel between a client and a transaction manager on the same
+// host, in place of TCP over loopback.  It is a pair of single-producer,
+// single-consumer rings in one shared mapping, one per direction, and a pair
+// of eventfds, one per side.  A side's eventfd rings when the other side sent
+// to it while it was asleep, or freed space in a ring it was waiting to send
+// on; as long as neither side waits, messages pass without a system call.
+//
+// Messages are framed as they are in BusyBee:  everything after the
+// BUSYBEE_HEADER_SIZE bytes the transport may use.  Both rings hold
+// messages up to half their capacity; anything larger has been chunked long
+// before it gets here (see common/chunking.h).
+//
+// The transaction manager creates the channel and hands its descriptors to
+// the client over a Unix socket whose name derives from the manager's
+// address; the socket stays open for as long as the channel is used, so
+// each side notices when the other goes away.  The socket has no permissions
+// of its own, so the manager only serves peers running as its own user, and
+// neither side trusts what the other writes into the rings.
+class local_channel
+{
+    public:
+        enum side_t { SERVER, CLIENT };
+        static const size_t DESCRIPTORS = 3;
+
+    public:
+        // the server's half of a new channel
+        static local_channel* create();
+        // the client's half of a channel created by the server; takes
+        // ownership of the descriptors, even on failure
+        static local_channel* attach(int fds[DESCRIPTORS]);
+        ~local_channel() throw ();
+
+    public:
+        // descriptors to hand to the client
+        void descriptors(int fds[DESCRIPTORS]) const;
+        // readable when this side should call recv() or flush()
+        int bell() const;
+        // drain the bell after it rang
+        void silence();
+        // enqueue msg; it's sent in order behind anything enqueued before it
+        // and does not fit yet.  false if msg can never fit, if the peer has
+        // let too much back up behind it, or if the channel is broken;
+        // either way, the caller should hang up
+        bool send(std::auto_ptr<e::buffer> msg);
+        // push as much of the backlog as fits; true when the backlog is gone
+        bool flush();
+        bool backlogged() const { return !m_backlog.empty(); }
+        // the next message, if there is one
+        bool recv(std::auto_ptr<e::buffer>* msg);
+        // the peer wrote something to the rings that cannot be right; it
+        // gets nothing further and the caller should hang up
+        bool broken() const { return m_broken; }
+        // call before waiting on bell(); if it returns false, there is a
+        // message waiting already and the caller must not wait
+        bool prepare_to_wait();
+
+    public:
+        // the Unix socket a transaction manager at loc listens on for local
+        // clients
+        static std::string socket_name(const po6::net::location& loc);
+        // pass/receive a channel's descriptors across a Unix socket
+        static bool send_descriptors(int sock, int fds[DESCRIPTORS]);
+        static bool recv_descriptors(int sock, int fds[DESCRIPTORS]);
+
+    private:
+        struct ring;
+        local_channel(side_t side, int shm, int server_bell, int client_bell, void* base);
+        bool write(const e::buffer& msg);
+
+    private:
+        const side_t m_side;
+        const int m_shm;
+        const int m_server_bell;
+        const int m_client_bell;
+        void* const m_base;
+        // this side sends on m_out and receives on m_in
+        ring* const m_out;
+        ring* const m_in;
+        // this side's own positions, never read back from the shared rings
+        uint64_t m_in_head;
+        uint64_t m_out_tail;
+        std::list<e::buffer*> m_backlog;
+        size_t m_backlog_bytes;
+        bool m_broken;
+
+    private:
+        local_channel(const local_channel&);
+        local_channel& operator = (const local_channel&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_common_local_channel_h_
@@ -41,6 +41,7 @@ BEGIN_CONSUS_NAMESPACE
 
 #define WOUND_XACT_ABORT 1
 #define WOUND_XACT_DROP_REQ 2
+#define WOUND_XACT_WAIT_FOR 4
 
 enum lock_op
 {
@@ -0,0 +1,133 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_common_message_h_
+#define consus_common_message_h_
+
+// C
+#include <stdint.h>
+
+// STL
+#include <memory>
+#include <vector>
+
+// e
+#include <e/buffer.h>
+#include <e/serialization.h>
+
+// BusyBee
+#include <busybee.h>
+
+// consus
+#include "namespace.h"
+#include "common/consus.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// Builds a BusyBee message from the fields it carries, in order:
+//
+//     std::auto_ptr<e::buffer> msg = (message() << KVS_RAW_RD << nonce
+//                                     << table << key << timestamp).create();
+//
+// The field list is written once; the buffer is sized from the same list it
+// is packed from, so the two can't disagree.  Each step holds references to
+// its operands, so the whole chain must be created within one expression.
+//
+// A reply that carries a payload from a message just received can instead be
+// written over that message with reuse(), which keeps the payload in place.
+
+inline size_t message_size(uint8_t) { return sizeof(uint8_t); }
+inline size_t message_size(uint16_t) { return sizeof(uint16_t); }
+inline size_t message_size(uint32_t) { return sizeof(uint32_t); }
+inline size_t message_size(uint64_t) { return sizeof(uint64_t); }
+inline size_t message_size(int64_t) { return sizeof(int64_t); }
+inline size_t message_size(const e::pack_varint&) { return VARINT_64_MAX_SIZE; }
+template <typename T> size_t message_size(const std::vector<T>& v) { return ::pack_size(v); }
+template <typename T> size_t message_size(const T& t) { return pack_size(t); }
+
+template <typename P, typename T>
+class message_field
+{
+    public:
+        message_field(const P& prev, const T& t) : m_prev(prev), m_t(t) {}
+
+    public:
+        size_t size() const { return m_prev.size() + message_size(m_t); }
+        e::packer pack(e::packer pa) const { return m_prev.pack(pa) << m_t; }
+        template <typename U>
+        message_field<message_field<P, T>, U> operator << (const U& u) const
+        { return message_field<message_field<P, T>, U>(*this, u); }
+        std::auto_ptr<e::buffer> create() const
+        {
+            std::auto_ptr<e::buffer> msg(e::buffer::create(BUSYBEE_HEADER_SIZE + size()));
+            pack(msg->pack_at(BUSYBEE_HEADER_SIZE));
+            return msg;
+        }
+        // Turns msg, a received message whose last field is the packed slice
+        // tail, into this message followed by tail, without copying tail.
+        // Only holds when this message packs to exactly the bytes that
+        // preceded tail, so it is for fixed-width fields; when the layouts
+        // differ it leaves msg alone and returns false.
+        bool reuse(e::buffer* msg, const e::slice& tail) const
+        {
+            const size_t start = BUSYBEE_HEADER_SIZE + size() + pack_size(tail) - tail.size();
+
+            if (!msg || tail.data() != msg->data() + start ||
+                start + tail.size() > msg->size())
+            {
+                return false;
+            }
+
+            pack(msg->pack_at(BUSYBEE_HEADER_SIZE));
+            msg->resize(start + tail.size());
+            return true;
+        }
+
+    private:
+        const P& m_prev;
+        const T& m_t;
+
+    private:
+        message_field& operator = (const message_field&);
+};
+
+class message
+{
+    public:
+        message() {}
+
+    public:
+        size_t size() const { return 0; }
+        e::packer pack(e::packer pa) const { return pa; }
+        template <typename U>
+        message_field<message, U> operator << (const U& u) const
+        { return message_field<message, U>(*this, u); }
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_common_message_h_
@@ -47,6 +47,10 @@ consus :: operator << (std::ostream& lhs, network_msgtype rhs)
         STRINGIFY(TXMAN_COMMIT);
         STRINGIFY(TXMAN_ABORT);
         STRINGIFY(TXMAN_WOUND);
+        STRINGIFY(TXMAN_WAIT_FOR);
+        STRINGIFY(TXMAN_DEADLOCK_PROBE);
+        STRINGIFY(TXMAN_CHANGES);
+        STRINGIFY(TXMAN_INDEX_LOOKUP);
         STRINGIFY(TXMAN_PAXOS_2A);
         STRINGIFY(TXMAN_PAXOS_2B);
         STRINGIFY(LV_VOTE_1A);
@@ -55,6 +59,7 @@ consus :: operator << (std::ostream& lhs, network_msgtype rhs)
         STRINGIFY(LV_VOTE_2B);
         STRINGIFY(LV_VOTE_LEARN);
         STRINGIFY(COMMIT_RECORD);
+        STRINGIFY(COMMIT_RECORD_ACK);
         STRINGIFY(GV_OUTCOME);
         STRINGIFY(GV_PROPOSE);
         STRINGIFY(GV_VOTE_1A);
@@ -65,6 +70,8 @@ consus :: operator << (std::ostream& lhs, network_msgtype rhs)
         STRINGIFY(KVS_REP_RD_RESP);
         STRINGIFY(KVS_REP_WR);
         STRINGIFY(KVS_REP_WR_RESP);
+        STRINGIFY(KVS_REP_SCAN);
+        STRINGIFY(KVS_REP_SCAN_RESP);
         STRINGIFY(KVS_RAW_RD);
         STRINGIFY(KVS_RAW_RD_RESP);
         STRINGIFY(KVS_RAW_WR);
@@ -74,9 +81,14 @@ consus :: operator << (std::ostream& lhs, network_msgtype rhs)
         STRINGIFY(KVS_RAW_LK);
         STRINGIFY(KVS_RAW_LK_RESP);
         STRINGIFY(KVS_WOUND_XACT);
+        STRINGIFY(KVS_RAW_LK_QUEUED);
+        STRINGIFY(KVS_RAW_SCAN);
+        STRINGIFY(KVS_RAW_SCAN_RESP);
         STRINGIFY(KVS_MIGRATE_SYN);
         STRINGIFY(KVS_MIGRATE_ACK);
         STRINGIFY(CONSUS_NOP);
+        STRINGIFY(CONSUS_CHUNK);
+        STRINGIFY(CONSUS_CHUNK_ACK);
         default:
             lhs << "unknown msgtype";
     }
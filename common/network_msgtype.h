@@ -50,6 +50,10 @@ enum network_msgtype
     TXMAN_COMMIT    = 7427,
     TXMAN_ABORT     = 7428,
     TXMAN_WOUND     = 7429,
+    TXMAN_WAIT_FOR  = 7430,
+    TXMAN_DEADLOCK_PROBE = 7431,
+    TXMAN_CHANGES   = 7432,
+    TXMAN_INDEX_LOOKUP = 7434,
 
     TXMAN_PAXOS_2A  = 7439,
     TXMAN_PAXOS_2B  = 7433,
@@ -61,6 +65,7 @@ enum network_msgtype
     LV_VOTE_LEARN   = 7504,
 
     COMMIT_RECORD   = 7505,
+    COMMIT_RECORD_ACK = 7506,
 
     GV_OUTCOME      = 7611,
     GV_PROPOSE      = 7606,
@@ -73,6 +78,8 @@ enum network_msgtype
     KVS_REP_RD_RESP = 7741,
     KVS_REP_WR      = 7742,
     KVS_REP_WR_RESP = 7743,
+    KVS_REP_SCAN    = 7744,
+    KVS_REP_SCAN_RESP = 7745,
 
     KVS_RAW_RD      = 7750,
     KVS_RAW_RD_RESP = 7751,
@@ -86,11 +93,17 @@ enum network_msgtype
     KVS_RAW_LK_RESP = 7757,
 
     KVS_WOUND_XACT  = 7758,
+    KVS_RAW_LK_QUEUED = 7759,
+
+    KVS_RAW_SCAN    = 7760,
+    KVS_RAW_SCAN_RESP = 7761,
 
     KVS_MIGRATE_SYN = 7800,
     KVS_MIGRATE_ACK = 7801,
 
-    CONSUS_NOP      = 7835
+    CONSUS_NOP      = 7835,
+    CONSUS_CHUNK    = 7836,
+    CONSUS_CHUNK_ACK = 7837
 };
 
 std::ostream&
@@ -0,0 +1,130 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// e
+#include <e/strescape.h>
+
+// consus
+#include "common/quota.h"
+
+using consus::quota;
+
+quota :: quota()
+    : scope(TABLE)
+    , name()
+    , ops_per_second(0)
+    , bytes_per_second(0)
+    , idle_timeout_ms(0)
+{
+}
+
+quota :: quota(scope_t s, const std::string& n,
+               uint64_t ops, uint64_t bytes, uint64_t idle)
+    : scope(s)
+    , name(n)
+    , ops_per_second(ops)
+    , bytes_per_second(bytes)
+    , idle_timeout_ms(idle)
+{
+}
+
+quota :: quota(const quota& other)
+    : scope(other.scope)
+    , name(other.name)
+    , ops_per_second(other.ops_per_second)
+    , bytes_per_second(other.bytes_per_second)
+    , idle_timeout_ms(other.idle_timeout_ms)
+{
+}
+
+quota :: ~quota() throw ()
+{
+}
+
+bool
+quota :: unlimited() const
+{
+    return !rate_limited() && idle_timeout_ms == 0;
+}
+
+bool
+quota :: rate_limited() const
+{
+    return ops_per_second != 0 || bytes_per_second != 0;
+}
+
+bool
+quota :: same_target(const quota& other) const
+{
+    return scope == other.scope && name == other.name;
+}
+
+std::ostream&
+consus :: operator << (std::ostream& lhs, const quota& rhs)
+{
+    lhs << "quota(";
+
+    if (rhs.scope == quota::TABLE)
+    {
+        lhs << "table=\"" << e::strescape(rhs.name) << "\"";
+    }
+    else
+    {
+        lhs << "client";
+    }
+
+    return lhs << ", ops_per_second=" << rhs.ops_per_second
+               << ", bytes_per_second=" << rhs.bytes_per_second
+               << ", idle_timeout_ms=" << rhs.idle_timeout_ms << ")";
+}
+
+e::packer
+consus :: operator << (e::packer lhs, const quota& rhs)
+{
+    return lhs << e::pack_uint8<quota::scope_t>(rhs.scope)
+               << e::slice(rhs.name)
+               << rhs.ops_per_second << rhs.bytes_per_second
+               << rhs.idle_timeout_ms;
+}
+
+e::unpacker
+consus :: operator >> (e::unpacker lhs, quota& rhs)
+{
+    e::slice name;
+    lhs = lhs >> e::unpack_uint8<quota::scope_t>(rhs.scope)
+              >> name >> rhs.ops_per_second >> rhs.bytes_per_second
+              >> rhs.idle_timeout_ms;
+    rhs.name = name.str();
+    return lhs;
+}
+
+size_t
+consus :: pack_size(const quota& q)
+{
+    return sizeof(uint8_t) + pack_size(e::slice(q.name))
+         + 3 * sizeof(uint64_t);
+}
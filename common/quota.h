@@ -0,0 +1,90 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_common_quota_h_
+#define consus_common_quota_h_
+
+// C
+#include <stdint.h>
+
+// C++
+#include <string>
+
+// consus
+#include "namespace.h"
+#include "common/ids.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// A quota bounds the rate at which transaction managers accept operations
+// and how long a transaction may sit idle while holding locks.  TABLE quotas
+// are shared by every client touching the named table; CLIENT quotas have no
+// name and apply to each client connection independently.  A limit of zero
+// means "unlimited".
+class quota
+{
+    public:
+        enum scope_t
+        {
+            TABLE = 1,
+            CLIENT = 2
+        };
+
+    public:
+        quota();
+        quota(scope_t scope, const std::string& name,
+              uint64_t ops_per_second, uint64_t bytes_per_second,
+              uint64_t idle_timeout_ms);
+        quota(const quota& other);
+        ~quota() throw ();
+
+    public:
+        bool unlimited() const;
+        bool rate_limited() const;
+        bool same_target(const quota& other) const;
+
+    public:
+        scope_t scope;
+        std::string name;
+        uint64_t ops_per_second;
+        uint64_t bytes_per_second;
+        uint64_t idle_timeout_ms;
+};
+
+std::ostream&
+operator << (std::ostream& lhs, const quota& rhs);
+
+e::packer
+operator << (e::packer lhs, const quota& rhs);
+e::unpacker
+operator >> (e::unpacker lhs, quota& rhs);
+size_t
+pack_size(const quota& q);
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_common_quota_h_
@@ -0,0 +1,104 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// e
+#include <e/strescape.h>
+
+// consus
+#include "common/secondary_index.h"
+
+using consus::secondary_index;
+
+secondary_index :: secondary_index()
+    : table()
+    , field()
+{
+}
+
+secondary_index :: secondary_index(const std::string& t, const std::string& f)
+    : table(t)
+    , field(f)
+{
+}
+
+secondary_index :: secondary_index(const secondary_index& other)
+    : table(other.table)
+    , field(other.field)
+{
+}
+
+secondary_index :: ~secondary_index() throw ()
+{
+}
+
+bool
+secondary_index :: same_target(const secondary_index& other) const
+{
+    return table == other.table && field == other.field;
+}
+
+std::string
+secondary_index :: index_table() const
+{
+    // the packed lengths keep "a"/"b.c" and "a.b"/"c" apart
+    std::string tmp;
+    e::packer(&tmp)
+        << e::slice("consus.index")
+        << e::slice(table)
+        << e::slice(field);
+    return tmp;
+}
+
+std::ostream&
+consus :: operator << (std::ostream& lhs, const secondary_index& rhs)
+{
+    return lhs << "secondary_index(table=\"" << e::strescape(rhs.table)
+               << "\", field=\"" << e::strescape(rhs.field) << "\")";
+}
+
+e::packer
+consus :: operator << (e::packer lhs, const secondary_index& rhs)
+{
+    return lhs << e::slice(rhs.table) << e::slice(rhs.field);
+}
+
+e::unpacker
+consus :: operator >> (e::unpacker lhs, secondary_index& rhs)
+{
+    e::slice table;
+    e::slice field;
+    lhs = lhs >> table >> field;
+    rhs.table = table.str();
+    rhs.field = field.str();
+    return lhs;
+}
+
+size_t
+consus :: pack_size(const secondary_index& si)
+{
+    return pack_size(e::slice(si.table)) + pack_size(e::slice(si.field));
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_common_secondary_index_h_
+#define consus_common_secondary_index_h_
+
+// C++
+#include <string>
+
+// e
+#include <e/serialization.h>
+
+// consus
+#include "namespace.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// A secondary index maps the value of one field of a table's JSON documents
+// back to the keys of the documents holding that value.  Transaction managers
+// maintain the index rows as part of every committed write to the table; the
+// rows live in a table of their own, named by index_table().
+class secondary_index
+{
+    public:
+        secondary_index();
+        secondary_index(const std::string& table, const std::string& field);
+        secondary_index(const secondary_index& other);
+        ~secondary_index() throw ();
+
+    public:
+        bool same_target(const secondary_index& other) const;
+        std::string index_table() const;
+
+    public:
+        std::string table;
+        std::string field;
+};
+
+std::ostream&
+operator << (std::ostream& lhs, const secondary_index& rhs);
+
+e::packer
+operator << (e::packer lhs, const secondary_index& rhs);
+e::unpacker
+operator >> (e::unpacker lhs, secondary_index& rhs);
+size_t
+pack_size(const secondary_index& si);
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_common_secondary_index_h_
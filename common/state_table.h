@@ -0,0 +1,569 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_common_state_table_h_
+#define consus_common_state_table_h_
+
+// C
+#include <assert.h>
+#include <stdint.h>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/atomic.h>
+#include <e/compat.h>
+#include <e/garbage_collector.h>
+
+// consus
+#include "namespace.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// A drop-in replacement for e::state_hash_table, built for the access pattern
+// of the daemons' state machines:  lookups on every message, an insert and a
+// removal over the lifetime of each state, and periodic walks by the pumping
+// threads.
+//
+// The table is an open-addressed array of (hash, entry) slots probed
+// linearly.  The probe takes no lock:  it compares the hash stored inline in
+// the slot and only then touches the entry, which holds the key, the state,
+// and the mutex a state_reference holds for as long as it refers to the
+// state.  Finding the entry is lock-free, but get_state then takes that
+// mutex, so looking up a state another thread holds waits for it, exactly as
+// with e::state_hash_table.  Inserts and removals serialize on a single
+// writer mutex.  A
+// removed slot becomes a tombstone, and a full or tombstone-heavy array is
+// rebuilt into a fresh one; removed entries and retired arrays are handed to
+// the garbage collector, so every thread that uses the table must be
+// registered with it and online.
+//
+// As with e::state_hash_table, T is constructed from its key, and a state is
+// removed when the last reference to it is released while it claims to be
+// finished().
+template <typename K, typename T>
+class state_table
+{
+    public:
+        class state_reference;
+        class iterator;
+
+    public:
+        state_table(e::garbage_collector* gc);
+        ~state_table() throw ();
+
+    public:
+        T* create_state(const K& key, state_reference* sr);
+        T* get_or_create_state(const K& key, state_reference* sr);
+        T* get_state(const K& key, state_reference* sr);
+
+    private:
+        struct entry;
+        struct slot;
+        struct array;
+        static const uint64_t MIN_CAPACITY = 64;
+        static uint64_t hash(const K& key);
+        static entry* tombstone() { return reinterpret_cast<entry*>(1); }
+        static bool is_garbage(entry* x) { return e::atomic::load_32_acquire(&x->garbage) != 0; }
+        entry* find(const K& key, uint64_t h);
+        void insert(uint64_t h, entry* x);
+        void remove(entry* x);
+        void rebuild();
+
+    private:
+        e::garbage_collector* m_gc;
+        po6::threads::mutex m_writer;
+        array* m_array;
+        // slots that are not empty, and how many of those are tombstones;
+        // both only change under m_writer
+        uint64_t m_used;
+        uint64_t m_tombstones;
+
+    private:
+        state_table(const state_table&);
+        state_table& operator = (const state_table&);
+};
+
+template <typename K, typename T>
+struct state_table<K, T>::entry
+{
+    entry(const K& k) : mtx(), garbage(0), key(k), state(k) {}
+    ~entry() throw () {}
+
+    po6::threads::mutex mtx;
+    // set with mtx held once the state is on its way out of the table
+    uint32_t garbage;
+    const K key;
+    T state;
+
+    private:
+        entry(const entry&);
+        entry& operator = (const entry&);
+};
+
+template <typename K, typename T>
+struct state_table<K, T>::slot
+{
+    slot() : hash(0), ent(NULL) {}
+    // written before ent is published, and never again
+    uint64_t hash;
+    entry* ent;
+};
+
+template <typename K, typename T>
+struct state_table<K, T>::array
+{
+    array(uint64_t capacity) : mask(capacity - 1), slots(new slot[capacity]) {}
+    ~array() throw () { delete[] slots; }
+
+    const uint64_t mask;
+    slot* const slots;
+
+    private:
+        array(const array&);
+        array& operator = (const array&);
+};
+
+template <typename K, typename T>
+class state_table<K, T>::state_reference
+{
+    public:
+        state_reference() : m_table(NULL), m_entry(NULL) {}
+        ~state_reference() throw () { release(); }
+
+    public:
+        void release();
+
+    private:
+        friend class state_table;
+        friend class iterator;
+        bool lock(state_table* table, entry* x);
+        void adopt(state_table* table, entry* x);
+        T* state() { return &m_entry->state; }
+        bool held() const { return m_entry != NULL; }
+
+    private:
+        state_table* m_table;
+        entry* m_entry;
+
+    private:
+        state_reference(const state_reference&);
+        state_reference& operator = (const state_reference&);
+};
+
+// Visits every state present when the walk began, holding each one while it
+// is the current state.  States created during the walk may or may not be
+// visited.
+template <typename K, typename T>
+class state_table<K, T>::iterator
+{
+    public:
+        iterator(state_table* table);
+        ~iterator() throw ();
+
+    public:
+        bool valid();
+        iterator& operator ++ ();
+        T* operator * ();
+
+    private:
+        void prime();
+
+    private:
+        state_table* m_table;
+        array* m_array;
+        uint64_t m_idx;
+        state_reference m_sr;
+
+    private:
+        iterator(const iterator&);
+        iterator& operator = (const iterator&);
+};
+
+template <typename K, typename T>
+state_table<K, T> :: state_table(e::garbage_collector* gc)
+    : m_gc(gc)
+    , m_writer()
+    , m_array(new array(MIN_CAPACITY))
+    , m_used(0)
+    , m_tombstones(0)
+{
+}
+
+template <typename K, typename T>
+state_table<K, T> :: ~state_table() throw ()
+{
+    for (uint64_t i = 0; i <= m_array->mask; ++i)
+    {
+        entry* x = m_array->slots[i].ent;
+
+        if (x && x != tombstone())
+        {
+            delete x;
+        }
+    }
+
+    delete m_array;
+}
+
+template <typename K, typename T>
+T*
+state_table<K, T> :: create_state(const K& key, state_reference* sr)
+{
+    assert(!sr->held());
+    const uint64_t h = hash(key);
+    entry* x = new entry(key);
+    // nobody may see the state before its creator holds it; otherwise a
+    // reader could release it as finished before it is ever initialized
+    x->mtx.lock();
+
+    {
+        po6::threads::mutex::hold hold(&m_writer);
+
+        if (find(key, h))
+        {
+            x->mtx.unlock();
+            delete x;
+            return NULL;
+        }
+
+        insert(h, x);
+    }
+
+    sr->adopt(this, x);
+    return sr->state();
+}
+
+template <typename K, typename T>
+T*
+state_table<K, T> :: get_or_create_state(const K& key, state_reference* sr)
+{
+    while (true)
+    {
+        T* t = get_state(key, sr);
+
+        if (t)
+        {
+            return t;
+        }
+
+        t = create_state(key, sr);
+
+        if (t)
+        {
+            return t;
+        }
+    }
+}
+
+template <typename K, typename T>
+T*
+state_table<K, T> :: get_state(const K& key, state_reference* sr)
+{
+    assert(!sr->held());
+    const uint64_t h = hash(key);
+
+    while (true)
+    {
+        entry* x = find(key, h);
+
+        if (!x)
+        {
+            return NULL;
+        }
+
+        // lost a race with the state's removal; look again
+        if (sr->lock(this, x))
+        {
+            return sr->state();
+        }
+    }
+}
+
+template <typename K, typename T>
+uint64_t
+state_table<K, T> :: hash(const K& key)
+{
+    // the hashes of ids are often the ids themselves; spread them so that
+    // consecutive ids don't form one long probe sequence
+    uint64_t h = e::compat::hash<K>()(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+template <typename K, typename T>
+typename state_table<K, T>::entry*
+state_table<K, T> :: find(const K& key, uint64_t h)
+{
+    array* a = e::atomic::load_ptr_acquire(&m_array);
+
+    for (uint64_t i = 0; i <= a->mask; ++i)
+    {
+        slot* s = &a->slots[(h + i) & a->mask];
+        entry* x = e::atomic::load_ptr_acquire(&s->ent);
+
+        if (!x)
+        {
+            break;
+        }
+
+        if (x != tombstone() && s->hash == h &&
+            x->key == key && !is_garbage(x))
+        {
+            return x;
+        }
+    }
+
+    return NULL;
+}
+
+template <typename K, typename T>
+void
+state_table<K, T> :: insert(uint64_t h, entry* x)
+{
+    // keep at least a quarter of the slots empty so probes stay short
+    if ((m_used + 1) * 4 > (m_array->mask + 1) * 3)
+    {
+        rebuild();
+    }
+
+    for (uint64_t i = 0; ; ++i)
+    {
+        slot* s = &m_array->slots[(h + i) & m_array->mask];
+
+        if (!s->ent)
+        {
+            s->hash = h;
+            e::atomic::store_ptr_release(&s->ent, x);
+            ++m_used;
+            return;
+        }
+    }
+}
+
+template <typename K, typename T>
+void
+state_table<K, T> :: remove(entry* x)
+{
+    po6::threads::mutex::hold hold(&m_writer);
+    const uint64_t h = hash(x->key);
+
+    for (uint64_t i = 0; i <= m_array->mask; ++i)
+    {
+        slot* s = &m_array->slots[(h + i) & m_array->mask];
+
+        if (!s->ent)
+        {
+            break;
+        }
+
+        if (s->ent == x)
+        {
+            e::atomic::store_ptr_release(&s->ent, tombstone());
+            ++m_tombstones;
+            m_gc->collect(x, e::garbage_collector::free_ptr<entry>);
+            return;
+        }
+    }
+
+    // a rebuild dropped it (and collected it) in the meantime
+}
+
+template <typename K, typename T>
+void
+state_table<K, T> :: rebuild()
+{
+    // size for the live states alone, at most half full afterwards; this
+    // shrinks the array again after a burst of states has come and gone
+    uint64_t capacity = MIN_CAPACITY;
+
+    while (capacity < (m_used - m_tombstones + 1) * 2)
+    {
+        capacity *= 2;
+    }
+
+    array* old = m_array;
+    array* a = new array(capacity);
+    uint64_t used = 0;
+
+    for (uint64_t i = 0; i <= old->mask; ++i)
+    {
+        entry* x = old->slots[i].ent;
+
+        if (!x || x == tombstone())
+        {
+            continue;
+        }
+
+        // its remover is waiting on m_writer, and won't find it here
+        if (is_garbage(x))
+        {
+            m_gc->collect(x, e::garbage_collector::free_ptr<entry>);
+            continue;
+        }
+
+        const uint64_t h = old->slots[i].hash;
+
+        for (uint64_t j = 0; ; ++j)
+        {
+            slot* s = &a->slots[(h + j) & a->mask];
+
+            if (!s->ent)
+            {
+                s->hash = h;
+                s->ent = x;
+                break;
+            }
+        }
+
+        ++used;
+    }
+
+    e::atomic::store_ptr_release(&m_array, a);
+    m_gc->collect(old, e::garbage_collector::free_ptr<array>);
+    m_used = used;
+    m_tombstones = 0;
+}
+
+template <typename K, typename T>
+void
+state_table<K, T> :: state_reference :: release()
+{
+    if (!m_entry)
+    {
+        return;
+    }
+
+    entry* x = m_entry;
+    state_table* table = m_table;
+    m_entry = NULL;
+    m_table = NULL;
+
+    if (x->state.finished())
+    {
+        e::atomic::store_32_release(&x->garbage, 1);
+        x->mtx.unlock();
+        table->remove(x);
+    }
+    else
+    {
+        x->mtx.unlock();
+    }
+}
+
+template <typename K, typename T>
+bool
+state_table<K, T> :: state_reference :: lock(state_table* table, entry* x)
+{
+    x->mtx.lock();
+
+    if (is_garbage(x))
+    {
+        x->mtx.unlock();
+        return false;
+    }
+
+    adopt(table, x);
+    return true;
+}
+
+template <typename K, typename T>
+void
+state_table<K, T> :: state_reference :: adopt(state_table* table, entry* x)
+{
+    m_table = table;
+    m_entry = x;
+}
+
+template <typename K, typename T>
+state_table<K, T> :: iterator :: iterator(state_table* table)
+    : m_table(table)
+    , m_array(e::atomic::load_ptr_acquire(&table->m_array))
+    , m_idx(0)
+    , m_sr()
+{
+}
+
+template <typename K, typename T>
+state_table<K, T> :: iterator :: ~iterator() throw ()
+{
+}
+
+template <typename K, typename T>
+bool
+state_table<K, T> :: iterator :: valid()
+{
+    prime();
+    return m_sr.held();
+}
+
+template <typename K, typename T>
+typename state_table<K, T>::iterator&
+state_table<K, T> :: iterator :: operator ++ ()
+{
+    prime();
+    m_sr.release();
+    ++m_idx;
+    return *this;
+}
+
+template <typename K, typename T>
+T*
+state_table<K, T> :: iterator :: operator * ()
+{
+    prime();
+    assert(m_sr.held());
+    return m_sr.state();
+}
+
+template <typename K, typename T>
+void
+state_table<K, T> :: iterator :: prime()
+{
+    // the array is retired through the garbage collector, so it stays
+    // readable for the whole walk even if a rebuild replaces it
+    while (!m_sr.held() && m_idx <= m_array->mask)
+    {
+        entry* x = e::atomic::load_ptr_acquire(&m_array->slots[m_idx].ent);
+
+        if (x && x != tombstone() && m_sr.lock(m_table, x))
+        {
+            break;
+        }
+
+        ++m_idx;
+    }
+}
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_common_state_table_h_
@@ -26,19 +26,23 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 // consus
+#include <consus.h>
 #include "common/transaction_id.h"
 
 using consus::transaction_id;
 
 transaction_id :: transaction_id()
     : group()
+    , priority(CONSUS_PRIORITY_NORMAL)
     , start(0)
     , number(0)
 {
 }
 
-transaction_id :: transaction_id(paxos_group_id g, uint64_t s, uint64_t n)
+transaction_id :: transaction_id(paxos_group_id g, uint8_t p,
+                                 uint64_t s, uint64_t n)
     : group(g)
+    , priority(p)
     , start(s)
     , number(n)
 {
@@ -46,6 +50,7 @@ transaction_id :: transaction_id(paxos_group_id g, uint64_t s, uint64_t n)
 
 transaction_id :: transaction_id(const transaction_id& other)
     : group(other.group)
+    , priority(other.priority)
     , start(other.start)
     , number(other.number)
 {
@@ -65,6 +70,12 @@ transaction_id :: hash() const
 bool
 transaction_id :: preempts(const transaction_id& other) const
 {
+    // a more urgent class always wins; within a class, the oldest wins
+    if (priority != other.priority)
+    {
+        return priority < other.priority;
+    }
+
     return start < other.start ||
            (start == other.start && number < other.number);
 }
@@ -81,7 +92,8 @@ std::ostream&
 consus :: operator << (std::ostream& lhs, const transaction_id& rhs)
 {
     return lhs << "transaction_id(group="
-               << rhs.group.get() << ", start="
+               << rhs.group.get() << ", priority="
+               << unsigned(rhs.priority) << ", start="
                << rhs.start << ", number="
                << rhs.number << ")";
 }
@@ -89,17 +101,17 @@ consus :: operator << (std::ostream& lhs, const transaction_id& rhs)
 e::packer
 consus :: operator << (e::packer pa, const transaction_id& rhs)
 {
-    return pa << rhs.group << rhs.start << rhs.number;
+    return pa << rhs.group << rhs.start << rhs.number << rhs.priority;
 }
 
 e::unpacker
 consus :: operator >> (e::unpacker up, transaction_id& rhs)
 {
-    return up >> rhs.group >> rhs.start >> rhs.number;
+    return up >> rhs.group >> rhs.start >> rhs.number >> rhs.priority;
 }
 
 size_t
 consus :: pack_size(const transaction_id& x)
 {
-    return pack_size(x.group) + 2 * sizeof(uint64_t);
+    return pack_size(x.group) + 2 * sizeof(uint64_t) + sizeof(uint8_t);
 }
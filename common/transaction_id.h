@@ -43,11 +43,18 @@
 
 BEGIN_CONSUS_NAMESPACE
 
+// The packed form is the group, start, and number, followed by the priority
+// byte.  It appears on the wire, in the txman's durable log, and in the lock
+// records the KVS keeps on disk.  Servers and clients from before the
+// priority byte cannot talk to those after it, so a cluster must be upgraded
+// as a whole; the txman log does not outlive a restart, and the KVS reads
+// its older lock records as belonging to the normal class.
 class transaction_id
 {
     public:
         transaction_id();
-        transaction_id(paxos_group_id g, uint64_t start, uint64_t number);
+        transaction_id(paxos_group_id g, uint8_t priority,
+                       uint64_t start, uint64_t number);
         transaction_id(const transaction_id& other);
         ~transaction_id() throw ();
 
@@ -57,6 +64,7 @@ class transaction_id
 
     public:
         paxos_group_id group;
+        uint8_t priority;
         uint64_t start;
         uint64_t number;
 };
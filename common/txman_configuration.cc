@@ -39,9 +39,11 @@ consus :: txman_configuration(e::unpacker up,
                               std::vector<data_center>* dcs,
                               std::vector<txman_state>* txmans,
                               std::vector<paxos_group>* txman_groups,
-                              std::vector<kvs>* kvss)
+                              std::vector<kvs>* kvss,
+                              std::vector<quota>* quotas,
+                              std::vector<secondary_index>* indexes)
 {
-    return up >> *cid >> *vid >> *flags >> *dcs >> *txmans >> *txman_groups >> *kvss;
+    return up >> *cid >> *vid >> *flags >> *dcs >> *txmans >> *txman_groups >> *kvss >> *quotas >> *indexes;
 }
 
 std::string
@@ -51,7 +53,9 @@ consus :: txman_configuration(const cluster_id& cid,
                               const std::vector<data_center>& dcs,
                               const std::vector<txman_state>& txmans,
                               const std::vector<paxos_group>& txman_groups,
-                              const std::vector<kvs>& kvss)
+                              const std::vector<kvs>& kvss,
+                              const std::vector<quota>& quotas,
+                              const std::vector<secondary_index>& indexes)
 {
     std::ostringstream ostr;
     ostr << cid << "\n"
@@ -129,5 +133,41 @@ consus :: txman_configuration(const cluster_id& cid,
         ostr << kvss[i] << "\n";
     }
 
+    if (quotas.empty())
+    {
+        ostr << "no quotas\n";
+    }
+    else if (quotas.size() == 1)
+    {
+        ostr << "1 quota:\n";
+    }
+    else
+    {
+        ostr << quotas.size() << " quotas:\n";
+    }
+
+    for (size_t i = 0; i < quotas.size(); ++i)
+    {
+        ostr << quotas[i] << "\n";
+    }
+
+    if (indexes.empty())
+    {
+        ostr << "no secondary indexes\n";
+    }
+    else if (indexes.size() == 1)
+    {
+        ostr << "1 secondary index:\n";
+    }
+    else
+    {
+        ostr << indexes.size() << " secondary indexes:\n";
+    }
+
+    for (size_t i = 0; i < indexes.size(); ++i)
+    {
+        ostr << indexes[i] << "\n";
+    }
+
     return ostr.str();
 }
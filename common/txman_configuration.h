@@ -34,6 +34,8 @@
 #include "common/ids.h"
 #include "common/kvs.h"
 #include "common/paxos_group.h"
+#include "common/quota.h"
+#include "common/secondary_index.h"
 #include "common/txman_state.h"
 
 BEGIN_CONSUS_NAMESPACE
@@ -45,14 +47,18 @@ e::unpacker txman_configuration(e::unpacker up,
                                 std::vector<data_center>* dcs,
                                 std::vector<txman_state>* txmans,
                                 std::vector<paxos_group>* txman_groups,
-                                std::vector<kvs>* kvss);
+                                std::vector<kvs>* kvss,
+                                std::vector<quota>* quotas,
+                                std::vector<secondary_index>* indexes);
 std::string txman_configuration(const cluster_id& cid,
                                 const version_id& vid,
                                 uint64_t flags,
                                 const std::vector<data_center>& dcs,
                                 const std::vector<txman_state>& txmans,
                                 const std::vector<paxos_group>& txman_groups,
-                                const std::vector<kvs>& kvss);
+                                const std::vector<kvs>& kvss,
+                                const std::vector<quota>& quotas,
+                                const std::vector<secondary_index>& indexes);
 
 END_CONSUS_NAMESPACE
 
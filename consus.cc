@@ -44,6 +44,8 @@ main(int argc, const char* argv[])
 	cmds.push_back(e::subcommand("coordinator",			"Start a new coordinator"));
     cmds.push_back(e::subcommand("create-data-center",  "Create a new data center"));
     cmds.push_back(e::subcommand("set-default-data-center", "Set the default data center for new servers"));
+    cmds.push_back(e::subcommand("set-quota",           "Limit request rates and idle time for a table or each client"));
+    cmds.push_back(e::subcommand("create-index",        "Index a table by the value of one field"));
     cmds.push_back(e::subcommand("availability-check",  "Check that the cluster has sufficient availability"));
     cmds.push_back(e::subcommand("debug",             	"Debug tools for Consus developers"));
     return dispatch_to_subcommands(argc, argv,
@@ -110,6 +110,8 @@ coordinator :: coordinator()
     , m_kvss_changed(false)
     , m_rings()
     , m_migrated()
+    , m_quotas()
+    , m_indexes()
 {
 }
 
@@ -543,6 +545,77 @@ coordinator :: kvs_migrated(rsm_context*, partition_id id)
     m_migrated.push_back(id);
 }
 
+void
+coordinator :: quota_set(rsm_context* ctx, const quota& q)
+{
+    if (!validate_quota(ctx, q))
+    {
+        return generate_response(ctx, COORD_MALFORMED);
+    }
+
+    quota merged(q);
+
+    for (size_t i = 0; i < m_quotas.size(); ++i)
+    {
+        if (m_quotas[i].same_target(q))
+        {
+            merged.idle_timeout_ms = m_quotas[i].idle_timeout_ms;
+        }
+    }
+
+    replace_quota(ctx, merged);
+    return generate_response(ctx, COORD_SUCCESS);
+}
+
+void
+coordinator :: idle_timeout_set(rsm_context* ctx, const quota& q)
+{
+    if (!validate_quota(ctx, q))
+    {
+        return generate_response(ctx, COORD_MALFORMED);
+    }
+
+    quota merged(q);
+    merged.ops_per_second = 0;
+    merged.bytes_per_second = 0;
+
+    for (size_t i = 0; i < m_quotas.size(); ++i)
+    {
+        if (m_quotas[i].same_target(q))
+        {
+            merged.ops_per_second = m_quotas[i].ops_per_second;
+            merged.bytes_per_second = m_quotas[i].bytes_per_second;
+        }
+    }
+
+    replace_quota(ctx, merged);
+    return generate_response(ctx, COORD_SUCCESS);
+}
+
+void
+coordinator :: index_create(rsm_context* ctx, const secondary_index& si)
+{
+    if (si.table.empty() || si.field.empty())
+    {
+        rsm_log(ctx, "cannot create %s: both table and field must be named", to_string(si).c_str());
+        return generate_response(ctx, COORD_MALFORMED);
+    }
+
+    for (size_t i = 0; i < m_indexes.size(); ++i)
+    {
+        if (m_indexes[i].same_target(si))
+        {
+            rsm_log(ctx, "cannot create %s: it already exists", to_string(si).c_str());
+            return generate_response(ctx, COORD_DUPLICATE);
+        }
+    }
+
+    m_indexes.push_back(si);
+    rsm_log(ctx, "created %s", to_string(si).c_str());
+    generate_next_configuration(ctx);
+    return generate_response(ctx, COORD_SUCCESS);
+}
+
 void
 coordinator :: is_stable(rsm_context* ctx)
 {
@@ -629,6 +702,18 @@ coordinator :: recreate(rsm_context* /*ctx*/,
             >> c->m_rings
             >> c->m_migrated;
 
+    // snapshots taken before quotas existed end here
+    if (!up.error() && up.remain())
+    {
+        up = up >> c->m_quotas;
+    }
+
+    // snapshots taken before secondary indexes existed end here
+    if (!up.error() && up.remain())
+    {
+        up = up >> c->m_indexes;
+    }
+
     if (up.error())
     {
         return NULL;
@@ -654,7 +739,9 @@ coordinator :: snapshot(rsm_context* /*ctx*/,
         << m_kvs_quiescence_counter
         << e::pack_uint8<bool>(m_kvss_changed)
         << m_rings
-        << m_migrated;
+        << m_migrated
+        << m_quotas
+        << m_indexes;
     char* ptr = static_cast<char*>(malloc(buf.size()));
     *data = ptr;
     *data_sz = buf.size();
@@ -701,7 +788,7 @@ coordinator :: generate_next_configuration(rsm_context* ctx)
     std::string txmanconf;
     e::packer(&txmanconf)
         << m_cluster << m_version << m_flags
-        << m_dcs << m_txmans << m_txman_groups << kvss;
+        << m_dcs << m_txmans << m_txman_groups << kvss << m_quotas << m_indexes;
     rsm_cond_broadcast_data(ctx, "txmanconf", txmanconf.data(), txmanconf.size());
 
     // kvs configuration
@@ -1406,3 +1493,47 @@ coordinator :: finish_migrations(rsm_context* ctx)
     m_migrated.clear();
     return ret;
 }
+
+bool
+coordinator :: validate_quota(rsm_context* ctx, const quota& q)
+{
+    if (q.scope != quota::TABLE && q.scope != quota::CLIENT)
+    {
+        rsm_log(ctx, "cannot set quota with unknown scope %d", int(q.scope));
+        return false;
+    }
+
+    if (q.scope == quota::CLIENT && !q.name.empty())
+    {
+        rsm_log(ctx, "cannot set %s: client quotas apply to every client and take no name", to_string(q).c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void
+coordinator :: replace_quota(rsm_context* ctx, const quota& q)
+{
+    for (size_t i = 0; i < m_quotas.size(); ++i)
+    {
+        if (m_quotas[i].same_target(q))
+        {
+            std::swap(m_quotas[i], m_quotas.back());
+            m_quotas.pop_back();
+            break;
+        }
+    }
+
+    if (q.unlimited())
+    {
+        rsm_log(ctx, "removed quota for %s", to_string(q).c_str());
+    }
+    else
+    {
+        m_quotas.push_back(q);
+        rsm_log(ctx, "set %s", to_string(q).c_str());
+    }
+
+    generate_next_configuration(ctx);
+}
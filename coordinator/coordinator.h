@@ -41,6 +41,8 @@
 #include "common/kvs.h"
 #include "common/kvs_state.h"
 #include "common/paxos_group.h"
+#include "common/quota.h"
+#include "common/secondary_index.h"
 #include "common/ring.h"
 #include "common/txman.h"
 #include "common/txman_state.h"
@@ -83,6 +85,15 @@ class coordinator
         void kvs_offline(rsm_context* ctx, comm_id id, const po6::net::location& bind_to, uint64_t nonce);
         void kvs_migrated(rsm_context* ctx, partition_id part);
 
+    // rate limits
+    public:
+        void quota_set(rsm_context* ctx, const quota& q);
+        void idle_timeout_set(rsm_context* ctx, const quota& q);
+
+    // secondary indexes
+    public:
+        void index_create(rsm_context* ctx, const secondary_index& si);
+
     // maintenance
     public:
         void is_stable(rsm_context* ctx);
@@ -104,6 +115,8 @@ class coordinator
         ring* get_or_create_ring(data_center_id id);
         void maintain_kvs_rings(rsm_context* ctx);
         bool finish_migrations(rsm_context* ctx);
+        bool validate_quota(rsm_context* ctx, const quota& q);
+        void replace_quota(rsm_context* ctx, const quota& q);
 
     private:
         // meta state
@@ -127,6 +140,10 @@ class coordinator
         // rings
         std::vector<ring> m_rings;
         std::vector<partition_id> m_migrated;
+        // rate limits
+        std::vector<quota> m_quotas;
+        // secondary indexes
+        std::vector<secondary_index> m_indexes;
 
     private:
         coordinator(const coordinator&);
@@ -50,6 +50,9 @@ struct state_machine CONSUS_API rsm = {
      {"kvs_online", consus_coordinator_kvs_online},
      {"kvs_offline", consus_coordinator_kvs_offline},
      {"kvs_migrated", consus_coordinator_kvs_migrated},
+     {"quota_set", consus_coordinator_quota_set},
+     {"idle_timeout_set", consus_coordinator_idle_timeout_set},
+     {"index_create", consus_coordinator_index_create},
      {"is_stable", consus_coordinator_is_stable},
      {"tick", consus_coordinator_tick},
      {NULL, NULL}}
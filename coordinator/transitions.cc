@@ -214,6 +214,39 @@ consus_coordinator_kvs_migrated(rsm_context* ctx, void* obj, const char* data, s
     c->kvs_migrated(ctx, id);
 }
 
+CONSUS_API void
+consus_coordinator_quota_set(rsm_context* ctx, void* obj, const char* data, size_t data_sz)
+{
+    PROTECT_UNINITIALIZED;
+    quota q;
+    e::unpacker up(data, data_sz);
+    up = up >> q;
+    CHECK_UNPACK(quota_set);
+    c->quota_set(ctx, q);
+}
+
+CONSUS_API void
+consus_coordinator_idle_timeout_set(rsm_context* ctx, void* obj, const char* data, size_t data_sz)
+{
+    PROTECT_UNINITIALIZED;
+    quota q;
+    e::unpacker up(data, data_sz);
+    up = up >> q;
+    CHECK_UNPACK(idle_timeout_set);
+    c->idle_timeout_set(ctx, q);
+}
+
+CONSUS_API void
+consus_coordinator_index_create(rsm_context* ctx, void* obj, const char* data, size_t data_sz)
+{
+    PROTECT_UNINITIALIZED;
+    secondary_index si;
+    e::unpacker up(data, data_sz);
+    up = up >> si;
+    CHECK_UNPACK(index_create);
+    c->index_create(ctx, si);
+}
+
 CONSUS_API void
 consus_coordinator_is_stable(rsm_context* ctx, void* obj, const char*, size_t)
 {
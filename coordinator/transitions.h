@@ -66,6 +66,11 @@ TRANSITION(kvs_online);
 TRANSITION(kvs_offline);
 TRANSITION(kvs_migrated);
 
+TRANSITION(quota_set);
+TRANSITION(idle_timeout_set);
+
+TRANSITION(index_create);
+
 TRANSITION(is_stable);
 TRANSITION(tick);
 
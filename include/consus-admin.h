@@ -39,9 +39,32 @@ extern "C"
 
 int consus_admin_create_data_center(struct consus_client* client, const char* name,
                                     enum consus_returncode* status);
+
+/* Abort transactions that go this long without client activity before they
+ * prepare, releasing their locks.  Applies to transactions touching table, or
+ * to every transaction when table is NULL; the shortest applicable timeout
+ * wins.  Zero restores the transaction managers' default. */
+int consus_admin_set_idle_timeout(struct consus_client* client, const char* table,
+                                  uint64_t milliseconds,
+                                  enum consus_returncode* status);
 int consus_admin_set_default_data_center(struct consus_client* client, const char* name,
                                          enum consus_returncode* status);
 
+/* Limit the operations and bytes per second that transaction managers accept
+ * for a table, or for each client when table is NULL.  A limit of zero is
+ * unlimited; setting both to zero removes the quota. */
+int consus_admin_set_quota(struct consus_client* client, const char* table,
+                           uint64_t ops_per_second, uint64_t bytes_per_second,
+                           enum consus_returncode* status);
+
+/* Index the documents in table by the value of field (a dotted path into the
+ * JSON document).  Writes committed after the transaction managers learn of
+ * the index maintain it; documents written earlier are not indexed until
+ * they're next written. */
+int consus_admin_create_index(struct consus_client* client,
+                              const char* table, const char* field,
+                              enum consus_returncode* status);
+
 struct consus_availability_requirements
 {
     unsigned txmans;
@@ -59,12 +59,23 @@ enum consus_returncode
     CONSUS_COORD_FAIL   = 6787,
     CONSUS_UNAVAILABLE  = 6788,
     CONSUS_SERVER_ERROR = 6789,
+    CONSUS_THROTTLED    = 6790,
 
     /* this should never happen */
     CONSUS_INTERNAL     = 6910,
     CONSUS_GARBAGE      = 6911
 };
 
+/* lower classes preempt higher classes in lock conflicts, are admitted first
+ * when a transaction manager is loaded, and have their state machines worked
+ * first */
+enum consus_priority
+{
+    CONSUS_PRIORITY_INTERACTIVE = 0,
+    CONSUS_PRIORITY_NORMAL      = 1,
+    CONSUS_PRIORITY_BATCH       = 2
+};
+
 struct consus_client;
 struct consus_transaction;
 
@@ -87,6 +98,10 @@ const char* consus_returncode_to_string(enum consus_returncode);
 int64_t consus_begin_transaction(struct consus_client* client,
                                  enum consus_returncode* status,
                                  struct consus_transaction** xact);
+int64_t consus_begin_transaction_with_priority(struct consus_client* client,
+                                               enum consus_priority priority,
+                                               enum consus_returncode* status,
+                                               struct consus_transaction** xact);
 int64_t consus_commit_transaction(struct consus_transaction* xact,
                                   enum consus_returncode* status);
 int64_t consus_abort_transaction(struct consus_transaction* xact,
@@ -95,6 +110,28 @@ int64_t consus_restart_transaction(struct consus_transaction* xact,
                                    enum consus_returncode* status);
 void consus_destroy_transaction(struct consus_transaction* xact);
 
+/* Run body in a transaction of the given priority until it commits.  body
+ * issues its operations (including the commit) and returns the first status
+ * that is not a success.  Aborted and transiently failed attempts are
+ * aborted if need be and restarted, with jittered backoff, up to
+ * max_attempts times; restarts keep the priority and, when the servers
+ * confirm the abort, the age of the first attempt.  Returns 0 on commit and
+ * -1 otherwise, with status set to the last failure. */
+typedef enum consus_returncode (*consus_transaction_body)(struct consus_transaction* xact, void* arg);
+int consus_retry_transaction(struct consus_client* client,
+                             enum consus_priority priority,
+                             consus_transaction_body body, void* arg,
+                             unsigned max_attempts,
+                             enum consus_returncode* status);
+
+/* Keep up to max_entries recently read values in the client, and answer
+ * consus_get() for those keys without contacting the servers.  When such a
+ * transaction commits, the servers check that every key it read from the
+ * cache is unchanged since it was cached, and abort the transaction if not;
+ * the stale entries are dropped so that the restarted transaction reads them
+ * anew.  Zero, the default, disables the cache. */
+void consus_set_read_cache(struct consus_client* client, size_t max_entries);
+
 int64_t consus_get(struct consus_transaction* xact,
                    const char* table,
                    const char* key, size_t key_sz,
@@ -106,6 +143,71 @@ int64_t consus_put(struct consus_transaction* xact,
                    const char* value, size_t value_sz,
                    enum consus_returncode* status);
 
+/* Like consus_get(), but the value is neither converted to JSON nor copied:
+ * it points at the document in its stored binary form (the input of
+ * treadstone_binary_to_json()), inside the buffer the server's response
+ * arrived in.  That buffer is returned as handle, and the value stays valid
+ * until the handle is passed to consus_release_value(), once.  A key that is
+ * not found yields a NULL handle. */
+struct consus_value;
+
+int64_t consus_get_view(struct consus_transaction* xact,
+                        const char* table,
+                        const char* key, size_t key_sz,
+                        enum consus_returncode* status,
+                        struct consus_value** handle,
+                        const char** value, size_t* value_sz);
+void consus_release_value(struct consus_value* handle);
+
+/* Every transaction manager keeps a durable feed of the writes committed by
+ * the transactions it executed, numbered in the order they committed there.
+ * A cursor names a transaction manager and a position in its feed; a zeroed
+ * cursor lets the client pick one.  Each call returns the next batch of
+ * changes, waiting a while for one if the cursor is caught up, and advances
+ * the cursor.  If the first change's position is past the cursor's previous
+ * position, the feed no longer held the changes in between.  The array and
+ * the strings it points to are a single allocation to release with free(). */
+struct consus_change_cursor
+{
+    uint64_t server;
+    uint64_t position;
+};
+
+struct consus_change
+{
+    uint64_t position;
+    uint64_t timestamp;
+    const char* table;
+    size_t table_sz;
+    const char* key;
+    size_t key_sz;
+    const char* value;
+    size_t value_sz;
+};
+
+int64_t consus_tail_changes(struct consus_client* client,
+                            struct consus_change_cursor* cursor,
+                            enum consus_returncode* status,
+                            struct consus_change** changes, size_t* changes_sz);
+
+/* Find the keys of the documents in table whose field holds value (JSON),
+ * using an index created with consus_admin_create_index().  The lookup runs
+ * outside any transaction and may return keys whose documents have changed
+ * since:  read each key in a transaction and check the field before relying
+ * on it.  The array and the keys it points to are a single allocation to
+ * release with free(). */
+struct consus_index_entry
+{
+    const char* key;
+    size_t key_sz;
+};
+
+int64_t consus_index_lookup(struct consus_client* client,
+                            const char* table, const char* field,
+                            const char* value, size_t value_sz,
+                            enum consus_returncode* status,
+                            struct consus_index_entry** keys, size_t* keys_sz);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif /* __cplusplus */
@@ -69,6 +69,7 @@
 #include "common/generate_token.h"
 #include "common/lock.h"
 #include "common/macros.h"
+#include "common/message.h"
 #include "common/network_msgtype.h"
 #include "common/transaction_group.h"
 #include "kvs/daemon.h"
@@ -91,6 +92,7 @@ using consus::daemon;
 uint32_t s_interrupts = 0;
 bool s_debug_dump = false;
 bool s_debug_mode = false;
+bool s_deadlock_detection = false;
 
 static void
 exit_on_signal(int /*signum*/)
@@ -342,9 +344,12 @@ daemon :: daemon()
     , m_locks(&m_gc)
     , m_repl_lk(&m_gc)
     , m_repl_rd(&m_gc)
+    , m_repl_scan(&m_gc)
     , m_repl_wr(&m_gc)
     , m_migrations(&m_gc)
     , m_migrate_thread(new migration_bgthread(this))
+    , m_chunks()
+    , m_chunk_sender()
     , m_pumping_thread(po6::threads::make_obj_func(&daemon::pump, this))
 {
 }
@@ -560,6 +565,9 @@ daemon :: loop(size_t thread)
                 done = true;
                 continue;
             case BUSYBEE_DISRUPTED:
+                m_chunks.forget(comm_id(_id));
+                m_chunk_sender.forget(comm_id(_id));
+                continue;
             case BUSYBEE_INTERRUPTED:
                 continue;
             case BUSYBEE_SEE_ERRNO:
@@ -577,6 +585,43 @@ daemon :: loop(size_t thread)
         e::unpacker up = msg->unpack_from(BUSYBEE_HEADER_SIZE);
         up = up >> mt;
 
+        // a large message arrives in pieces; process it once it is whole
+        if (!up.error() && mt == CONSUS_CHUNK_ACK)
+        {
+            std::auto_ptr<e::buffer> chunk = m_chunk_sender.acknowledged(id, up);
+
+            if (chunk.get())
+            {
+                send(id, chunk);
+            }
+
+            m_gc.quiescent_state(&ts);
+            continue;
+        }
+
+        if (!up.error() && mt == CONSUS_CHUNK)
+        {
+            std::auto_ptr<e::buffer> ack = make_chunk_ack(up);
+
+            if (ack.get())
+            {
+                send(id, ack);
+            }
+
+            std::auto_ptr<chunk_list> whole;
+
+            if (!m_chunks.collect(id, up, &msg, &whole) ||
+                process_rep_wr_chunks(id, &whole))
+            {
+                m_gc.quiescent_state(&ts);
+                continue;
+            }
+
+            msg = whole->flatten();
+            up = msg->unpack_from(BUSYBEE_HEADER_SIZE);
+            up = up >> mt;
+        }
+
         if (up.error())
         {
             LOG(WARNING) << "dropping message that has a malformed header";
@@ -617,6 +662,15 @@ daemon :: loop(size_t thread)
             case KVS_RAW_WR_RESP:
                 process_raw_wr_resp(id, msg, up);
                 break;
+            case KVS_REP_SCAN:
+                process_rep_scan(id, msg, up);
+                break;
+            case KVS_RAW_SCAN:
+                process_raw_scan(id, msg, up);
+                break;
+            case KVS_RAW_SCAN_RESP:
+                process_raw_scan_resp(id, msg, up);
+                break;
             case KVS_LOCK_OP:
                 process_lock_op(id, msg, up);
                 break;
@@ -626,6 +680,9 @@ daemon :: loop(size_t thread)
             case KVS_RAW_LK_RESP:
                 process_raw_lk_resp(id, msg, up);
                 break;
+            case KVS_RAW_LK_QUEUED:
+                process_raw_lk_queued(id, msg, up);
+                break;
             case KVS_WOUND_XACT:
                 process_wound_xact(id, msg, up);
                 break;
@@ -637,6 +694,8 @@ daemon :: loop(size_t thread)
                 break;
             case CONSUS_NOP:
                 break;
+            case CONSUS_CHUNK:
+            case CONSUS_CHUNK_ACK:
             case CLIENT_RESPONSE:
             case TXMAN_BEGIN:
             case TXMAN_READ:
@@ -644,6 +703,10 @@ daemon :: loop(size_t thread)
             case TXMAN_COMMIT:
             case TXMAN_ABORT:
             case TXMAN_WOUND:
+            case TXMAN_WAIT_FOR:
+            case TXMAN_DEADLOCK_PROBE:
+            case TXMAN_CHANGES:
+            case TXMAN_INDEX_LOOKUP:
             case TXMAN_PAXOS_2A:
             case TXMAN_PAXOS_2B:
             case LV_VOTE_1A:
@@ -652,6 +715,7 @@ daemon :: loop(size_t thread)
             case LV_VOTE_2B:
             case LV_VOTE_LEARN:
             case COMMIT_RECORD:
+            case COMMIT_RECORD_ACK:
             case GV_PROPOSE:
             case GV_VOTE_1A:
             case GV_VOTE_1B:
@@ -659,6 +723,7 @@ daemon :: loop(size_t thread)
             case GV_VOTE_2B:
             case KVS_REP_RD_RESP:
             case KVS_REP_WR_RESP:
+            case KVS_REP_SCAN_RESP:
             case KVS_LOCK_OP_RESP:
             default:
                 LOG(INFO) << "received " << mt << " message which key-value-stores do not process";
@@ -730,6 +795,46 @@ daemon :: process_rep_wr(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker u
     }
 }
 
+bool
+daemon :: process_rep_wr_chunks(comm_id id, std::auto_ptr<chunk_list>* msg)
+{
+    e::slice head((*msg)->chunk_at(0));
+    network_msgtype mt;
+    uint64_t nonce;
+    uint8_t flags;
+    e::slice table;
+    e::slice key;
+    uint64_t timestamp;
+    e::unpacker up(head.data(), head.size());
+    up = up >> mt >> nonce >> flags >> table >> key >> timestamp;
+
+    // the value is relayed as it came; the replicas unpack and check it
+    if (up.error() || mt != KVS_REP_WR)
+    {
+        return false;
+    }
+
+    e::compat::shared_ptr<const chunk_list> chunks(msg->release());
+
+    while (true)
+    {
+        uint64_t x = generate_id();
+        write_replicator_map_t::state_reference wsr;
+        write_replicator* w = m_repl_wr.create_state(x, &wsr);
+
+        if (!w)
+        {
+            continue;
+        }
+
+        w->init(id, nonce, flags, table, key, timestamp, chunks);
+        w->externally_work_state_machine(this);
+        break;
+    }
+
+    return true;
+}
+
 void
 daemon :: process_raw_rd(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
 {
@@ -759,16 +864,13 @@ daemon :: process_raw_rd(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
     consus_returncode rc = CONSUS_GARBAGE;
     rc = m_data->get(table, key, timestamp, &timestamp, &value, &ref);
 
-    const size_t sz = BUSYBEE_HEADER_SIZE
-                    + pack_size(KVS_RAW_RD_RESP)
-                    + sizeof(uint64_t)
-                    + pack_size(rc)
-                    + sizeof(uint64_t)
-                    + pack_size(value)
-                    + pack_size(rs);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(BUSYBEE_HEADER_SIZE)
-        << KVS_RAW_RD_RESP << nonce << rc << timestamp << value << rs;
+    std::auto_ptr<e::buffer> msg = (message()
+        << KVS_RAW_RD_RESP
+        << nonce
+        << rc
+        << timestamp
+        << value
+        << rs).create();
     send(id, msg);
 
     if (s_debug_mode)
@@ -839,13 +941,11 @@ daemon :: process_raw_wr(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
         rc = m_data->put(table, key, timestamp, value);
     }
 
-    const size_t sz = BUSYBEE_HEADER_SIZE
-                    + pack_size(KVS_RAW_WR_RESP)
-                    + sizeof(uint64_t)
-                    + pack_size(rc)
-                    + pack_size(rs);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(BUSYBEE_HEADER_SIZE) << KVS_RAW_WR_RESP << nonce << rc << rs;
+    std::auto_ptr<e::buffer> msg = (message()
+        << KVS_RAW_WR_RESP
+        << nonce
+        << rc
+        << rs).create();
     send(id, msg);
 
     if (s_debug_mode)
@@ -882,6 +982,123 @@ daemon :: process_raw_wr_resp(comm_id id, std::auto_ptr<e::buffer>, e::unpacker
     }
 }
 
+void
+daemon :: process_rep_scan(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up)
+{
+    uint64_t nonce;
+    e::slice table;
+    e::slice prefix;
+    up = up >> nonce >> table >> prefix;
+    CHECK_UNPACK(KVS_REP_SCAN, up);
+
+    while (true)
+    {
+        uint64_t x = generate_id();
+        scan_replicator_map_t::state_reference ssr;
+        scan_replicator* s = m_repl_scan.create_state(x, &ssr);
+
+        if (!s)
+        {
+            continue;
+        }
+
+        s->init(id, nonce, table, prefix, msg);
+        s->externally_work_state_machine(this);
+        break;
+    }
+}
+
+void
+daemon :: process_raw_scan(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
+{
+    uint64_t nonce;
+    e::slice table;
+    e::slice prefix;
+    uint64_t timestamp;
+    up = up >> nonce >> table >> prefix >> timestamp;
+    CHECK_UNPACK(KVS_RAW_SCAN, up);
+    configuration* c = get_config();
+    replica_set rs;
+
+    // a scan never leaves the partition of its prefix's leading bytes
+    if (!c->hash(m_us.dc, table, prefix, &rs))
+    {
+        if (s_debug_mode)
+        {
+            LOG(INFO) << logid(table, prefix) << "-S-RAW dropped because hashing failed";
+        }
+
+        return;
+    }
+
+    std::vector<datalayer::scan_entry> entries;
+    consus_returncode rc = m_data->scan(table, prefix, timestamp, &entries);
+    size_t sz = BUSYBEE_HEADER_SIZE
+              + pack_size(KVS_RAW_SCAN_RESP)
+              + sizeof(uint64_t)
+              + pack_size(rc)
+              + pack_size(rs)
+              + sizeof(uint64_t);
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        sz += pack_size(e::slice(entries[i].key))
+            + sizeof(uint64_t)
+            + pack_size(e::slice(entries[i].value));
+    }
+
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    e::packer pa = msg->pack_at(BUSYBEE_HEADER_SIZE)
+        << KVS_RAW_SCAN_RESP << nonce << rc << rs << uint64_t(entries.size());
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        pa = pa << e::slice(entries[i].key)
+                << entries[i].timestamp
+                << e::slice(entries[i].value);
+    }
+
+    send(id, msg);
+    LOG_IF(INFO, s_debug_mode) << logid(table, prefix) << "-S-RAW scanned "
+                               << entries.size() << " keys; nonce=" << nonce
+                               << " replicas=" << rs;
+}
+
+void
+daemon :: process_raw_scan_resp(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
+{
+    uint64_t nonce;
+    consus_returncode rc;
+    replica_set rs;
+    uint64_t count;
+    up = up >> nonce >> rc >> rs >> count;
+    std::vector<datalayer::scan_entry> entries;
+
+    for (uint64_t i = 0; !up.error() && i < count; ++i)
+    {
+        e::slice key;
+        e::slice value;
+        datalayer::scan_entry se;
+        up = up >> key >> se.timestamp >> value;
+        se.key = key.str();
+        se.value = value.str();
+        entries.push_back(se);
+    }
+
+    CHECK_UNPACK(KVS_RAW_SCAN_RESP, up);
+    scan_replicator_map_t::state_reference ssr;
+    scan_replicator* s = m_repl_scan.get_state(nonce, &ssr);
+
+    if (s)
+    {
+        s->response(id, rc, entries, rs, this);
+    }
+    else
+    {
+        LOG_IF(INFO, s_debug_mode) << "dropped raw scan; nonce=" << nonce << " rc=" << rc << " from=" << id;
+    }
+}
+
 void
 daemon :: process_lock_op(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up)
 {
@@ -958,6 +1175,28 @@ daemon :: process_raw_lk_resp(comm_id id, std::auto_ptr<e::buffer>, e::unpacker
     }
 }
 
+void
+daemon :: process_raw_lk_queued(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
+{
+    uint64_t nonce;
+    transaction_group tg;
+    uint64_t position;
+    replica_set rs;
+    up = up >> nonce >> tg >> position >> rs;
+    CHECK_UNPACK(KVS_RAW_LK_QUEUED, up);
+    lock_replicator_map_t::state_reference sr;
+    lock_replicator* lk = m_repl_lk.get_state(nonce, &sr);
+
+    if (lk)
+    {
+        lk->queued(id, tg, position, rs, this);
+    }
+    else
+    {
+        LOG_IF(INFO, s_debug_mode) << "dropped lock queued ack; nonce=" << nonce << " from=" << id;
+    }
+}
+
 void
 daemon :: process_wound_xact(comm_id, std::auto_ptr<e::buffer>, e::unpacker up)
 {
@@ -981,6 +1220,10 @@ daemon :: process_wound_xact(comm_id, std::auto_ptr<e::buffer>, e::unpacker up)
         {
             lk->drop(tg);
         }
+        else if ((flags & WOUND_XACT_WAIT_FOR))
+        {
+            lk->wait_for(tg, this);
+        }
     }
     else
     {
@@ -1089,6 +1332,14 @@ daemon :: debug_dump()
         }
     }
 
+    LOG(INFO) << "------------------------------- Replicating Scans ------------------------------";
+
+    for (scan_replicator_map_t::iterator it(&m_repl_scan); it.valid(); ++it)
+    {
+        scan_replicator* sr = *it;
+        LOG(INFO) << "request=" << sr->state_key() << " " << sr->debug_dump();
+    }
+
     LOG(INFO) << "------------------------------ Replicating Writes ------------------------------";
 
     for (write_replicator_map_t::iterator it(&m_repl_wr); it.valid(); ++it)
@@ -1171,8 +1422,25 @@ daemon :: send(comm_id id, std::auto_ptr<e::buffer> msg)
         return false;
     }
 
-    busybee_returncode rc = m_busybee->send(id.get(), msg);
+    return sent(send_chunked(m_busybee.get(), id.get(), &m_chunk_sender, msg));
+}
 
+bool
+daemon :: send(comm_id id, const e::compat::shared_ptr<const chunk_list>& msg,
+               const e::slice& prefix)
+{
+    if (id == comm_id())
+    {
+        LOG_IF(INFO, s_debug_mode) << "message not sent: dropped";
+        return false;
+    }
+
+    return sent(send_chunked(m_busybee.get(), id.get(), &m_chunk_sender, msg, prefix));
+}
+
+bool
+daemon :: sent(busybee_returncode rc)
+{
     switch (rc)
     {
         case BUSYBEE_SUCCESS:
@@ -1232,6 +1500,12 @@ daemon :: pump()
             rr->externally_work_state_machine(this);
         }
 
+        for (scan_replicator_map_t::iterator it(&m_repl_scan); it.valid(); ++it)
+        {
+            scan_replicator* sr = *it;
+            sr->externally_work_state_machine(this);
+        }
+
         for (write_replicator_map_t::iterator it(&m_repl_wr); it.valid(); ++it)
         {
             write_replicator* wr = *it;
@@ -1244,6 +1518,8 @@ daemon :: pump()
             m->externally_work_state_machine(this);
         }
 
+        m_chunks.expire(po6::monotonic_time() - chunk_timeout());
+        m_chunk_sender.expire(po6::monotonic_time() - chunk_timeout());
         m_gc.quiescent_state(&ts);
     }
 
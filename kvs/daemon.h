@@ -42,16 +42,17 @@
 // e
 #include <e/compat.h>
 #include <e/garbage_collector.h>
-#include <e/state_hash_table.h>
 
 // BusyBee
 #include <busybee.h>
 
 // consus
 #include "namespace.h"
+#include "common/chunking.h"
 #include "common/constants.h"
 #include "common/coordinator_link.h"
 #include "common/kvs.h"
+#include "common/state_table.h"
 #include "kvs/configuration.h"
 #include "kvs/controller.h"
 #include "kvs/datalayer.h"
@@ -59,6 +60,7 @@
 #include "kvs/lock_replicator.h"
 #include "kvs/migrator.h"
 #include "kvs/read_replicator.h"
+#include "kvs/scan_replicator.h"
 #include "kvs/write_replicator.h"
 
 BEGIN_CONSUS_NAMESPACE
@@ -85,15 +87,17 @@ class daemon
     private:
         struct coordinator_callback;
         class migration_bgthread;
-        typedef e::state_hash_table<uint64_t, lock_replicator> lock_replicator_map_t;
-        typedef e::state_hash_table<uint64_t, read_replicator> read_replicator_map_t;
-        typedef e::state_hash_table<uint64_t, write_replicator> write_replicator_map_t;
-        typedef e::state_hash_table<partition_id, migrator> migrator_map_t;
+        typedef state_table<uint64_t, lock_replicator> lock_replicator_map_t;
+        typedef state_table<uint64_t, read_replicator> read_replicator_map_t;
+        typedef state_table<uint64_t, scan_replicator> scan_replicator_map_t;
+        typedef state_table<uint64_t, write_replicator> write_replicator_map_t;
+        typedef state_table<partition_id, migrator> migrator_map_t;
         friend class controller;
         friend class lock_manager;
         friend class lock_replicator;
         friend class lock_state;
         friend class read_replicator;
+        friend class scan_replicator;
         friend class write_replicator;
         friend class migrator;
 
@@ -107,14 +111,21 @@ class daemon
 
         void process_rep_rd(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_rep_wr(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        // a KVS_REP_WR that arrived in chunks, relayed from them; false if
+        // *msg is something else, and must be reassembled
+        bool process_rep_wr_chunks(comm_id id, std::auto_ptr<chunk_list>* msg);
         void process_raw_rd(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_raw_rd_resp(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_raw_wr(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_raw_wr_resp(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_rep_scan(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_raw_scan(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_raw_scan_resp(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
 
         void process_lock_op(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_raw_lk(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_raw_lk_resp(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_raw_lk_queued(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_wound_xact(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
 
         void process_migrate_syn(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
@@ -128,7 +139,13 @@ class daemon
         void debug_dump();
         uint64_t generate_id();
         uint64_t resend_interval() { return PO6_SECONDS; }
+        // how often to re-check replicas that acknowledged a queued lock
+        uint64_t lock_probe_interval() { return 10 * PO6_SECONDS; }
+        uint64_t chunk_timeout() { return 30 * PO6_SECONDS; }
         bool send(comm_id id, std::auto_ptr<e::buffer> msg);
+        bool send(comm_id id, const e::compat::shared_ptr<const chunk_list>& msg,
+                  const e::slice& prefix);
+        bool sent(busybee_returncode rc);
         void pump();
 
     private:
@@ -144,9 +161,12 @@ class daemon
         lock_manager m_locks;
         lock_replicator_map_t m_repl_lk;
         read_replicator_map_t m_repl_rd;
+        scan_replicator_map_t m_repl_scan;
         write_replicator_map_t m_repl_wr;
         migrator_map_t m_migrations;
         std::auto_ptr<migration_bgthread> m_migrate_thread;
+        chunk_reassembler m_chunks;
+        chunk_sender m_chunk_sender;
 
         // state machine pumping
         po6::threads::thread m_pumping_thread;
@@ -28,6 +28,10 @@
 #ifndef consus_kvs_datalayer_h_
 #define consus_kvs_datalayer_h_
 
+// STL
+#include <string>
+#include <vector>
+
 // e
 #include <e/slice.h>
 
@@ -43,6 +47,7 @@ class datalayer
 {
     public:
         class reference;
+        struct scan_entry;
 
     public:
         datalayer();
@@ -63,6 +68,13 @@ class datalayer
         virtual consus_returncode del(const e::slice& table,
                                       const e::slice& key,
                                       uint64_t timestamp) = 0;
+        // Every key in table beginning with prefix, at its newest version no
+        // later than timestamp_le.  Deleted keys appear with empty values so
+        // that callers can reconcile the results of several replicas.
+        virtual consus_returncode scan(const e::slice& table,
+                                       const e::slice& prefix,
+                                       uint64_t timestamp_le,
+                                       std::vector<scan_entry>* entries) = 0;
         virtual consus_returncode read_lock(const e::slice& table,
                                             const e::slice& key,
                                             transaction_group* tg) = 0;
@@ -78,6 +90,16 @@ class datalayer::reference
         virtual ~reference() throw ();
 };
 
+struct datalayer::scan_entry
+{
+    scan_entry() : key(), timestamp(0), value() {}
+    ~scan_entry() throw () {}
+
+    std::string key;
+    uint64_t timestamp;
+    std::string value;
+};
+
 END_CONSUS_NAMESPACE
 
 #endif // consus_kvs_datalayer_h_
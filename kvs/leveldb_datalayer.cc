@@ -25,6 +25,8 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#define __STDC_LIMIT_MACROS
+
 // Google Log
 #include <glog/logging.h>
 
@@ -263,6 +265,61 @@ leveldb_datalayer :: del(const e::slice& table,
     return rc;
 }
 
+consus_returncode
+leveldb_datalayer :: scan(const e::slice& table,
+                          const e::slice& prefix,
+                          uint64_t timestamp_le,
+                          std::vector<scan_entry>* entries)
+{
+    // data keys are (table, key, timestamp) with the newest version of a key
+    // first, so seeking to the prefix at the largest timestamp lands on the
+    // first version of the first key in range
+    std::string start = data_key(table, prefix, UINT64_MAX);
+    const size_t start_sz = start.size() - 8;
+    std::auto_ptr<leveldb::Iterator> it(m_db->NewIterator(leveldb::ReadOptions()));
+    entries->clear();
+    std::string last;
+    bool have_last = false;
+
+    for (it->Seek(start); it->Valid(); it->Next())
+    {
+        leveldb::Slice k = it->key();
+
+        if (k.size() < start_sz + 8 ||
+            memcmp(k.data(), start.data(), start_sz) != 0)
+        {
+            break;
+        }
+
+        uint64_t timestamp;
+        e::unpack64be(k.data() + k.size() - 8, &timestamp);
+        const char* key = k.data() + start_sz - prefix.size();
+        const size_t key_sz = k.size() - 8 - start_sz + prefix.size();
+
+        if ((have_last && last.size() == key_sz &&
+             memcmp(last.data(), key, key_sz) == 0) ||
+            timestamp > timestamp_le)
+        {
+            continue;
+        }
+
+        last.assign(key, key_sz);
+        have_last = true;
+        entries->push_back(scan_entry());
+        entries->back().key = last;
+        entries->back().timestamp = timestamp;
+        entries->back().value.assign(it->value().data(), it->value().size());
+    }
+
+    if (!it->status().ok())
+    {
+        LOG(ERROR) << "leveldb error: " << it->status().ToString();
+        return CONSUS_SERVER_ERROR;
+    }
+
+    return CONSUS_SUCCESS;
+}
+
 consus_returncode
 leveldb_datalayer :: read_lock(const e::slice& table,
                                const e::slice& key,
@@ -286,6 +343,15 @@ leveldb_datalayer :: read_lock(const e::slice& table,
     e::unpacker up(val);
     up = up >> *tg;
 
+    // locks written before transaction ids carried a priority class lack the
+    // trailing byte; all of them were in the normal class
+    if (up.error() && val.size() + sizeof(uint8_t) == pack_size(transaction_group()))
+    {
+        up = e::unpacker(val);
+        up = up >> tg->group >> tg->txid.group >> tg->txid.start >> tg->txid.number;
+        tg->txid.priority = CONSUS_PRIORITY_NORMAL;
+    }
+
     if (up.error())
     {
         LOG(ERROR) << "corrupt lock (\""
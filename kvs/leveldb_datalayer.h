@@ -67,6 +67,10 @@ class leveldb_datalayer : public datalayer
         virtual consus_returncode del(const e::slice& table,
                                       const e::slice& key,
                                       uint64_t timestamp);
+        virtual consus_returncode scan(const e::slice& table,
+                                       const e::slice& prefix,
+                                       uint64_t timestamp_le,
+                                       std::vector<scan_entry>* entries);
         virtual consus_returncode read_lock(const e::slice& table,
                                             const e::slice& key,
                                             transaction_group* tg);
@@ -35,6 +35,7 @@
 #include "namespace.h"
 #include "common/ids.h"
 #include "common/lock.h"
+#include "common/state_table.h"
 #include "common/transaction_group.h"
 #include "kvs/lock_state.h"
 #include "kvs/table_key_pair.h"
@@ -58,7 +59,7 @@ class lock_manager
         std::string debug_dump();
 
     private:
-        typedef e::state_hash_table<table_key_pair, lock_state> lock_map_t;
+        typedef state_table<table_key_pair, lock_state> lock_map_t;
 
     private:
         lock_map_t m_locks;
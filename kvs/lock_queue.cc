@@ -0,0 +1,150 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// consus
+#include "kvs/lock_queue.h"
+
+using consus::lock_queue;
+
+lock_queue :: lock_queue()
+    : m_reqs()
+{
+}
+
+lock_queue :: ~lock_queue() throw ()
+{
+}
+
+bool
+lock_queue :: enqueue(comm_id id, uint64_t nonce, const transaction_group& tg,
+                      size_t* position, request* superseded)
+{
+    *superseded = request();
+    size_t idx = 0;
+
+    for (std::list<request>::iterator it = m_reqs.begin();
+            it != m_reqs.end(); ++it, ++idx)
+    {
+        if (it->tg != tg)
+        {
+            continue;
+        }
+
+        *position = idx;
+
+        // a retransmission from the same requester
+        if (it->nonce == nonce)
+        {
+            it->id = id;
+            return true;
+        }
+        // the previous requester has a higher nonce than the current
+        // requester; the current one takes over
+        else if (it->nonce > nonce)
+        {
+            *superseded = *it;
+            it->id = id;
+            it->nonce = nonce;
+            return true;
+        }
+        // else, the current requester should stop
+        else
+        {
+            return false;
+        }
+    }
+
+    // the front holds the lock, and nothing cuts in ahead of it
+    std::list<request>::iterator it = m_reqs.begin();
+    idx = 0;
+
+    if (it != m_reqs.end())
+    {
+        ++it;
+        ++idx;
+    }
+
+    while (it != m_reqs.end() && it->tg.txid.preempts(tg.txid))
+    {
+        ++it;
+        ++idx;
+    }
+
+    m_reqs.insert(it, request(id, nonce, tg));
+    *position = idx;
+    return true;
+}
+
+void
+lock_queue :: restore(const transaction_group& holder)
+{
+    m_reqs.push_back(request(comm_id(), 0, holder));
+}
+
+bool
+lock_queue :: next(request* r) const
+{
+    if (m_reqs.size() < 2)
+    {
+        return false;
+    }
+
+    const_iterator it = m_reqs.begin();
+    ++it;
+    *r = *it;
+    return true;
+}
+
+bool
+lock_queue :: remove(const transaction_group& tg, request* removed)
+{
+    for (std::list<request>::iterator it = m_reqs.begin();
+            it != m_reqs.end(); ++it)
+    {
+        if (it->tg == tg)
+        {
+            *removed = *it;
+            m_reqs.erase(it);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+lock_queue :: waiters(std::vector<request>* ws) const
+{
+    const_iterator it = m_reqs.begin();
+
+    if (it != m_reqs.end())
+    {
+        ++it;
+    }
+
+    ws->insert(ws->end(), it, m_reqs.end());
+}
@@ -0,0 +1,94 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_kvs_lock_queue_h_
+#define consus_kvs_lock_queue_h_
+
+// STL
+#include <list>
+#include <vector>
+
+// consus
+#include "namespace.h"
+#include "common/ids.h"
+#include "common/transaction_group.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// The transactions vying for one lock:  the holder at the front, then the
+// waiters in the order they will be granted the lock, most senior first.  A
+// transaction appears at most once; its latest requester (by nonce) speaks
+// for it.
+class lock_queue
+{
+    public:
+        struct request
+        {
+            request() : id(), nonce(), tg() {}
+            request(comm_id i, uint64_t n, const transaction_group& x)
+                : id(i), nonce(n), tg(x) {}
+            ~request() throw () {}
+            comm_id id;
+            uint64_t nonce;
+            transaction_group tg;
+        };
+        typedef std::list<request>::const_iterator const_iterator;
+
+    public:
+        lock_queue();
+        ~lock_queue() throw ();
+
+    public:
+        bool empty() const { return m_reqs.empty(); }
+        size_t size() const { return m_reqs.size(); }
+        const request& front() const { return m_reqs.front(); }
+        const_iterator begin() const { return m_reqs.begin(); }
+        const_iterator end() const { return m_reqs.end(); }
+        // queue tg's request, or update the one already queued for it.
+        // Returns false if the requester should stop replicating because one
+        // with a later nonce already speaks for tg.  Otherwise the requester
+        // should hear that it waits at *position, and *superseded is set when
+        // it replaced an earlier requester that should stop.
+        bool enqueue(comm_id id, uint64_t nonce, const transaction_group& tg,
+                     size_t* position, request* superseded);
+        // put back the holder recorded on disk
+        void restore(const transaction_group& holder);
+        // the request that holds the lock once the front lets go, if any
+        bool next(request* r) const;
+        void pop_front() { m_reqs.pop_front(); }
+        // take tg's request out of the queue, if it waits there
+        bool remove(const transaction_group& tg, request* removed);
+        // every waiter behind the holder
+        void waiters(std::vector<request>* ws) const;
+
+    private:
+        std::list<request> m_reqs;
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_kvs_lock_queue_h_
@@ -96,6 +96,22 @@ extern bool s_debug_mode;
 // holder will yield to a transaction of a lower timestamp by aborting its
 // transaction and subsequently unlocking the lock; otherwise, it will either
 // ignore the signal and continue executing or unlock a spuriously-locked lock.
+//
+// A transaction waiting behind another lock holder could be waiting for a long
+// time.  Rather than retransmit the lock request every resend interval for the
+// duration of the wait, each replica acknowledges a request it has enqueued
+// with its position in the queue.  The replica pushes the grant when the lock
+// is handed off, so the replicator only needs to probe queued replicas
+// occasionally to recover from a replica that lost its in-memory queue.  A
+// replica that restarts rejoins in a new configuration, so an acknowledgement
+// only counts until the configuration changes; after that the replicator
+// retransmits every resend interval until the replica queues it again.
+//
+// When the key-value store runs with --deadlock-detection, the signal to the
+// lock holder is replaced by a wait-for report to the waiter's transaction
+// manager.  The transaction managers chase probes along these edges and abort
+// the youngest transaction of any cycle they find, so transactions that merely
+// contend for a lock no longer abort one another.
 
 struct lock_replicator :: lock_stub
 {
@@ -106,6 +122,10 @@ struct lock_replicator :: lock_stub
     uint64_t last_request_time;
     transaction_group tg;
     replica_set rs;
+    bool queued;
+    uint64_t queued_position;
+    // the configuration the replica queued the request in
+    version_id queued_version;
 };
 
 lock_replicator :: lock_stub :: lock_stub(comm_id t)
@@ -113,6 +133,9 @@ lock_replicator :: lock_stub :: lock_stub(comm_id t)
     , last_request_time(0)
     , tg()
     , rs()
+    , queued(false)
+    , queued_position(0)
+    , queued_version()
 {
 }
 
@@ -196,9 +219,36 @@ lock_replicator :: response(comm_id id, const transaction_group& tg,
     LOG(INFO) << logid() << " response from=" << id;
     stub->tg = tg;
     stub->rs = rs;
+    stub->queued = false;
     work_state_machine(d);
 }
 
+void
+lock_replicator :: queued(comm_id id, const transaction_group& tg,
+                          uint64_t position, const replica_set& rs, daemon* d)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    lock_stub* stub = get_stub(id);
+
+    if (!stub || tg != m_tg || m_op != LOCK_LOCK)
+    {
+        LOG_IF(INFO, s_debug_mode) << logid() << " dropped queued ack from=" << id;
+        return;
+    }
+
+    LOG_IF(INFO, s_debug_mode) << logid() << " queued at position " << position << " on " << id;
+
+    // the lock may have already been granted by a response that overtook this
+    // acknowledgement
+    if (stub->tg != m_tg)
+    {
+        stub->rs = rs;
+        stub->queued = true;
+        stub->queued_position = position;
+        stub->queued_version = d->get_config()->version();
+    }
+}
+
 void
 lock_replicator :: abort(const transaction_group& tg, daemon* d)
 {
@@ -226,6 +276,27 @@ lock_replicator :: drop(const transaction_group& tg)
     }
 }
 
+void
+lock_replicator :: wait_for(const transaction_group& holder, daemon* d)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    if (!m_init || m_finished || m_op != LOCK_LOCK)
+    {
+        return;
+    }
+
+    const size_t sz = BUSYBEE_HEADER_SIZE
+                    + pack_size(TXMAN_WAIT_FOR)
+                    + sizeof(uint64_t)
+                    + pack_size(m_tg)
+                    + pack_size(holder);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(BUSYBEE_HEADER_SIZE) << TXMAN_WAIT_FOR << m_nonce << m_tg << holder;
+    LOG_IF(INFO, s_debug_mode) << logid() << " waits for " << transaction_group::log(holder);
+    d->send(m_id, msg);
+}
+
 void
 lock_replicator :: externally_work_state_machine(daemon* d)
 {
@@ -266,8 +337,15 @@ lock_replicator :: debug_dump()
              << " target=" << m_requests[i].target
              << " last_request_time=" << m_requests[i].last_request_time
              << " transaction_group=" << m_requests[i].tg
-             << " replica_set=" << m_requests[i].rs
-             << "\n";
+             << " replica_set=" << m_requests[i].rs;
+
+        if (m_requests[i].queued)
+        {
+            ostr << " queued_position=" << m_requests[i].queued_position
+                 << " queued_version=" << m_requests[i].queued_version;
+        }
+
+        ostr << "\n";
     }
 
     return ostr.str();
@@ -348,13 +426,13 @@ lock_replicator :: work_state_machine(daemon* d)
             continue;
         }
 
-        if (owner1->last_request_time + d->resend_interval() < now &&
+        if (owner1->last_request_time + retransmit_interval(owner1, d) < now &&
             (owner1->tg != m_tg || !agree))
         {
             send_lock_request(owner1, now, d);
         }
 
-        if (owner2 && owner2->last_request_time + d->resend_interval() < now &&
+        if (owner2 && owner2->last_request_time + retransmit_interval(owner2, d) < now &&
             (owner2->tg != m_tg || !agree))
         {
             send_lock_request(owner2, now, d);
@@ -393,6 +471,20 @@ lock_replicator :: work_state_machine(daemon* d)
     }
 }
 
+uint64_t
+lock_replicator :: retransmit_interval(lock_stub* stub, daemon* d)
+{
+    // a replica that queued the request will push the grant; only probe it
+    // to detect that it restarted and forgot about the request, unless the
+    // configuration changed since, as it does when a replica restarts
+    if (stub->queued && stub->queued_version == d->get_config()->version())
+    {
+        return d->lock_probe_interval();
+    }
+
+    return d->resend_interval();
+}
+
 void
 lock_replicator :: send_lock_request(lock_stub* stub, uint64_t now, daemon* d)
 {
@@ -61,8 +61,11 @@ class lock_replicator
                   std::auto_ptr<e::buffer> backing);
         void response(comm_id id, const transaction_group& tg,
                       const replica_set& rs, daemon* d);
+        void queued(comm_id id, const transaction_group& tg,
+                    uint64_t position, const replica_set& rs, daemon* d);
         void abort(const transaction_group& tg, daemon* d);
         void drop(const transaction_group& tg);
+        void wait_for(const transaction_group& holder, daemon* d);
         void externally_work_state_machine(daemon* d);
         std::string debug_dump();
 
@@ -75,6 +78,7 @@ class lock_replicator
         lock_stub* get_or_create_stub(comm_id id);
         void ensure_stub_exists(comm_id id) { get_or_create_stub(id); }
         void work_state_machine(daemon* d);
+        uint64_t retransmit_interval(lock_stub* stub, daemon* d);
         void send_lock_request(lock_stub* stub, uint64_t now, daemon* d);
 
     private:
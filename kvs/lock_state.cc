@@ -35,25 +35,17 @@
 #include <glog/logging.h>
 
 // consus
+#include "common/message.h"
 #include "common/network_msgtype.h"
 #include "kvs/configuration.h"
 #include "kvs/daemon.h"
 #include "kvs/lock_state.h"
 
+using consus::lock_queue;
 using consus::lock_state;
 
 extern bool s_debug_mode;
-
-struct lock_state::request
-{
-    request() : id(), nonce(), tg() {}
-    request(comm_id i, uint64_t n, const transaction_group& x)
-        : id(i), nonce(n), tg(x) {}
-    ~request() throw () {}
-    comm_id id;
-    uint64_t nonce;
-    transaction_group tg;
-};
+extern bool s_deadlock_detection;
 
 lock_state :: lock_state(const table_key_pair& tk)
     : m_state_key(tk)
@@ -110,41 +102,26 @@ lock_state :: enqueue_lock(comm_id id, uint64_t nonce,
         return;
     }
 
-    bool found = false;
+    size_t position = 0;
+    lock_queue::request superseded;
+    const bool ack = m_reqs.enqueue(id, nonce, tg, &position, &superseded);
 
-    // scan the enqueued transactions to see if this is already enqueued
-    for (std::list<request>::iterator it = m_reqs.begin();
-            it != m_reqs.end(); ++it)
+    // if the previous requester has a higher nonce than the current
+    // requester, tell prev to silently stop replicating
+    if (superseded.tg != transaction_group())
     {
-        // we found this transaction group vying for the lock
-        if (it->tg == tg)
-        {
-            found = true;
-
-            // if the previous requester has a higher nonce than the current
-            // requester, tell prev to silently stop replicating
-            if (it->nonce > nonce)
-            {
-                LOG_IF(INFO, s_debug_mode) << logid() << " drop-wounding "
-                    << transaction_group::log(tg) << "; nonce=" << it->nonce << " id=" << it->id;
-                send_wound_drop(it->id, it->nonce, it->tg, d);
-                it->id = id;
-                it->nonce = nonce;
-            }
-            // else, tell current to silently stop replicating
-            else
-            {
-                LOG_IF(INFO, s_debug_mode) << logid() << " drop-wounding "
-                                           << transaction_group::log(tg)
-                                           << "; nonce=" << nonce << " id=" << id;
-                send_wound_drop(id, nonce, tg, d);
-            }
-        }
+        LOG_IF(INFO, s_debug_mode) << logid() << " drop-wounding "
+            << transaction_group::log(tg) << "; nonce=" << superseded.nonce << " id=" << superseded.id;
+        send_wound_drop(superseded.id, superseded.nonce, superseded.tg, d);
     }
-
-    if (!found)
+    // else, if a later requester speaks for tg, tell current to silently stop
+    // replicating
+    else if (!ack)
     {
-        ordered_enqueue(request(id, nonce, tg));
+        LOG_IF(INFO, s_debug_mode) << logid() << " drop-wounding "
+                                   << transaction_group::log(tg)
+                                   << "; nonce=" << nonce << " id=" << id;
+        send_wound_drop(id, nonce, tg, d);
     }
 
     // if no one holds the lock, we take the lock
@@ -170,8 +147,23 @@ lock_state :: enqueue_lock(comm_id id, uint64_t nonce,
         send_response(id, nonce, tg, d);
         m_holder = tg;
     }
+    else if (ack)
+    {
+        // the requester waits in the queue; tell it so it can stop
+        // retransmitting and wait for the grant to be pushed to it
+        send_queued(id, nonce, tg, position, d);
+    }
 
-    if (tg.txid.preempts(m_holder.txid))
+    if (s_deadlock_detection)
+    {
+        // report the wait to the requester's transaction manager and let it
+        // decide whether the wait closes a cycle
+        if (ack && m_holder != tg)
+        {
+            send_wound_wait_for(id, nonce, m_holder, d);
+        }
+    }
+    else if (tg.txid.preempts(m_holder.txid))
     {
         send_wound_abort(id, nonce, m_holder, d);
         LOG_IF(INFO, s_debug_mode) << logid()
@@ -208,15 +200,8 @@ lock_state :: unlock(comm_id id, uint64_t nonce,
     {
         assert(!m_reqs.empty());
         assert(m_reqs.front().tg == tg);
-        request next;
-
-        if (m_reqs.size() > 1)
-        {
-            std::list<request>::iterator it = m_reqs.begin();
-            ++it;
-            assert(it != m_reqs.end());
-            next = *it;
-        }
+        lock_queue::request next;
+        m_reqs.next(&next);
 
         consus_returncode rc = d->m_data->write_lock(m_state_key.table,
                                                      m_state_key.key,
@@ -240,22 +225,28 @@ lock_state :: unlock(comm_id id, uint64_t nonce,
         {
             send_response(next.id, next.nonce, next.tg, d);
         }
+
+        if (s_deadlock_detection)
+        {
+            std::vector<lock_queue::request> ws;
+            m_reqs.waiters(&ws);
+
+            // everyone still waiting now waits on a different transaction
+            for (size_t i = 0; i < ws.size(); ++i)
+            {
+                send_wound_wait_for(ws[i].id, ws[i].nonce, m_holder, d);
+            }
+        }
     }
     else
     {
-        for (std::list<request>::iterator it = m_reqs.begin(); it != m_reqs.end(); )
+        lock_queue::request removed;
+
+        if (m_reqs.remove(tg, &removed))
         {
-            if (it->tg == tg)
-            {
-                it = m_reqs.erase(it);
-                LOG_IF(INFO, s_debug_mode) << logid() << " drop-wounding "
-                    << transaction_group::log(tg) << "; nonce=" << it->nonce << " id=" << it->id;
-                send_wound_drop(it->id, it->nonce, it->tg, d);
-            }
-            else
-            {
-                ++it;
-            }
+            LOG_IF(INFO, s_debug_mode) << logid() << " drop-wounding "
+                << transaction_group::log(tg) << "; nonce=" << removed.nonce << " id=" << removed.id;
+            send_wound_drop(removed.id, removed.nonce, removed.tg, d);
         }
     }
 
@@ -273,7 +264,7 @@ lock_state :: debug_dump()
     ostr << "lock holder=" << transaction_group::log(m_holder) << "\n";
     size_t i = 0;
 
-    for (std::list<request>::iterator it = m_reqs.begin();
+    for (lock_queue::const_iterator it = m_reqs.begin();
             it != m_reqs.end(); ++it, ++i)
     {
         ostr << "lock queue[" << i << "]"
@@ -302,10 +293,10 @@ lock_state :: invariant_check()
     {
         assert(m_holder == m_reqs.front().tg);
 
-        for (std::list<request>::iterator it1 = m_reqs.begin();
+        for (lock_queue::const_iterator it1 = m_reqs.begin();
                 it1 != m_reqs.end(); ++it1)
         {
-            for (std::list<request>::iterator it2 = m_reqs.begin();
+            for (lock_queue::const_iterator it2 = m_reqs.begin();
                     it2 != m_reqs.end(); ++it2)
             {
                 assert(it1 == it2 || it1->tg != it2->tg);
@@ -341,7 +332,7 @@ lock_state :: ensure_initialized(daemon* d)
     if (tg != transaction_group())
     {
         LOG_IF(INFO, s_debug_mode) << logid() << " restoring " << transaction_group::log(tg) << " as durable lock holder";
-        m_reqs.push_back(request(comm_id(), 0, tg));
+        m_reqs.restore(tg);
         m_holder = tg;
     }
 
@@ -350,24 +341,6 @@ lock_state :: ensure_initialized(daemon* d)
     return true;
 }
 
-void
-lock_state :: ordered_enqueue(const request& r)
-{
-    std::list<request>::iterator it = m_reqs.begin();
-
-    if (it != m_reqs.end())
-    {
-        ++it;
-    }
-
-    while (it != m_reqs.end() && it->tg.txid.preempts(r.tg.txid))
-    {
-        ++it;
-    }
-
-    m_reqs.insert(it, r);
-}
-
 void
 lock_state :: send_wound(comm_id id, uint64_t nonce, uint8_t action,
                          const transaction_group& tg,
@@ -405,6 +378,14 @@ lock_state :: send_wound_abort(comm_id id, uint64_t nonce,
     send_wound(id, nonce, WOUND_XACT_ABORT, tg, d);
 }
 
+void
+lock_state :: send_wound_wait_for(comm_id id, uint64_t nonce,
+                                  const transaction_group& tg,
+                                  daemon* d)
+{
+    send_wound(id, nonce, WOUND_XACT_WAIT_FOR, tg, d);
+}
+
 void
 lock_state :: send_response(comm_id id, uint64_t nonce,
                             const transaction_group& tg, daemon* d)
@@ -434,3 +415,34 @@ lock_state :: send_response(comm_id id, uint64_t nonce,
         << KVS_RAW_LK_RESP << nonce << tg << rs;
     d->send(id, msg);
 }
+
+void
+lock_state :: send_queued(comm_id id, uint64_t nonce,
+                          const transaction_group& tg,
+                          uint64_t position, daemon* d)
+{
+    if (id == comm_id())
+    {
+        return;
+    }
+
+    configuration* c = d->get_config();
+    replica_set rs;
+
+    if (!c->hash(d->m_us.dc, m_state_key.table, m_state_key.key, &rs))
+    {
+        LOG_IF(INFO, s_debug_mode) << logid() << " dropping queued ack to=" << id << " because hashing failed";
+        return;
+    }
+
+    LOG_IF(INFO, s_debug_mode) << logid() << " " << transaction_group::log(tg)
+                               << " queued at position " << position
+                               << "; nonce=" << nonce << " id=" << id;
+    std::auto_ptr<e::buffer> msg = (message()
+        << KVS_RAW_LK_QUEUED
+        << nonce
+        << tg
+        << position
+        << rs).create();
+    d->send(id, msg);
+}
@@ -28,9 +28,6 @@
 #ifndef consus_kvs_lock_state_h_
 #define consus_kvs_lock_state_h_
 
-// STL
-#include <list>
-
 // po6
 #include <po6/threads/mutex.h>
 
@@ -42,6 +39,7 @@
 #include "common/ids.h"
 #include "common/lock.h"
 #include "common/transaction_group.h"
+#include "kvs/lock_queue.h"
 #include "kvs/table_key_pair.h"
 
 BEGIN_CONSUS_NAMESPACE
@@ -67,13 +65,9 @@ class lock_state
         std::string debug_dump();
         std::string logid();
 
-    private:
-        struct request;
-
     private:
         void invariant_check();
         bool ensure_initialized(daemon* d);
-        void ordered_enqueue(const request& r);
         void send_wound(comm_id id, uint64_t nonce, uint8_t flags,
                         const transaction_group& tg,
                         daemon* d);
@@ -83,16 +77,22 @@ class lock_state
         void send_wound_abort(comm_id id, uint64_t nonce,
                               const transaction_group& tg,
                               daemon* d);
+        void send_wound_wait_for(comm_id id, uint64_t nonce,
+                                 const transaction_group& tg,
+                                 daemon* d);
         void send_response(comm_id id, uint64_t nonce,
                            const transaction_group& tg,
                            daemon* d);
+        void send_queued(comm_id id, uint64_t nonce,
+                         const transaction_group& tg,
+                         uint64_t position, daemon* d);
 
     private:
         const table_key_pair m_state_key;
         po6::threads::mutex m_mtx;
         bool m_init;
         transaction_group m_holder;
-        std::list<request> m_reqs;
+        lock_queue m_reqs;
 
     private:
         lock_state(const lock_state&);
@@ -54,6 +54,7 @@
 #include "tools/connect_opts.h"
 
 extern bool s_debug_mode;
+extern bool s_deadlock_detection;
 
 int
 main(int argc, const char* argv[])
@@ -108,6 +109,9 @@ main(int argc, const char* argv[])
     ap.arg().name('t', "threads")
             .description("the number of threads which will handle network traffic")
             .metavar("N").as_long(&threads);
+    ap.arg().long_name("deadlock-detection")
+            .description("report lock waits to the transaction managers instead of wounding younger lock holders")
+            .set_true(&s_deadlock_detection);
     ap.arg().long_name("log-immediate")
             .description("immediately flush all log output")
             .set_true(&log_immediate).hidden();
@@ -39,6 +39,7 @@
 // consus
 #include "common/constants.h"
 #include "common/consus.h"
+#include "common/message.h"
 #include "common/network_msgtype.h"
 #include "kvs/daemon.h"
 #include "kvs/read_replicator.h"
@@ -127,6 +128,14 @@ read_replicator :: response(comm_id id, consus_returncode rc,
                             std::auto_ptr<e::buffer> backing, daemon* d)
 {
     po6::threads::mutex::hold hold(&m_mtx);
+
+    if (m_finished)
+    {
+        // m_value went out with the response
+        LOG_IF(INFO, s_debug_mode) << logid() << " dropped response from " << id << "; already responded";
+        return;
+    }
+
     read_stub* stub = get_stub(id);
 
     if (!stub)
@@ -218,6 +227,11 @@ read_replicator :: get_stub(comm_id id)
 void
 read_replicator :: work_state_machine(daemon* d)
 {
+    if (m_finished)
+    {
+        return;
+    }
+
     configuration* c = d->get_config();
     replica_set rs;
 
@@ -262,15 +276,28 @@ read_replicator :: work_state_machine(daemon* d)
     if (complete >= quorum)
     {
         m_finished = true;
-        const size_t sz = BUSYBEE_HEADER_SIZE
-                        + pack_size(KVS_REP_RD_RESP)
-                        + sizeof(uint64_t)
-                        + pack_size(m_status)
-                        + sizeof(uint64_t)
-                        + pack_size(m_value);
-        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-        msg->pack_at(BUSYBEE_HEADER_SIZE)
-            << KVS_REP_RD_RESP << m_nonce << m_status << m_timestamp << m_value;
+        std::auto_ptr<e::buffer> msg;
+
+        // the response has the same shape as the KVS_RAW_RD_RESP that
+        // carried m_value here, so it goes out in that buffer, value in place
+        if ((message()
+                << KVS_REP_RD_RESP
+                << m_nonce
+                << m_status
+                << m_timestamp).reuse(m_vbacking.get(), m_value))
+        {
+            msg = m_vbacking;
+        }
+        else
+        {
+            msg = (message()
+                << KVS_REP_RD_RESP
+                << m_nonce
+                << m_status
+                << m_timestamp
+                << m_value).create();
+        }
+
         d->send(m_id, msg);
         LOG_IF(INFO, s_debug_mode) << "sending read response " << m_status
                                    << " nonce=" << m_nonce << " to " << m_id;
@@ -301,6 +328,7 @@ read_replicator :: returncode_is_final(consus_returncode rc)
         case CONSUS_COORD_FAIL:
         case CONSUS_UNAVAILABLE:
         case CONSUS_SERVER_ERROR:
+        case CONSUS_THROTTLED:
         case CONSUS_INTERNAL:
         case CONSUS_GARBAGE:
         default:
@@ -316,17 +344,12 @@ read_replicator :: send_read_request(read_stub* stub, uint64_t now, daemon* d)
         LOG(INFO) << logid() << " sending target=" << stub->target;
     }
 
-    const size_t sz = BUSYBEE_HEADER_SIZE
-                    + pack_size(KVS_RAW_RD)
-                    + sizeof(uint64_t)
-                    + sizeof(uint8_t)
-                    + pack_size(m_table)
-                    + pack_size(m_key)
-                    + sizeof(uint64_t)
-                    + pack_size(m_value);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(BUSYBEE_HEADER_SIZE)
-        << KVS_RAW_RD << m_state_key << m_table << m_key << uint64_t(UINT64_MAX);
+    std::auto_ptr<e::buffer> msg = (message()
+        << KVS_RAW_RD
+        << m_state_key
+        << m_table
+        << m_key
+        << uint64_t(UINT64_MAX)).create();
     d->send(stub->target, msg);
     stub->last_request_time = now;
 }
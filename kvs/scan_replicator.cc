@@ -0,0 +1,345 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// STL
+#include <sstream>
+
+// Google Log
+#include <glog/logging.h>
+
+// e
+#include <e/strescape.h>
+
+// BusyBee
+#include <busybee.h>
+
+// consus
+#include "common/constants.h"
+#include "common/consus.h"
+#include "common/network_msgtype.h"
+#include "kvs/daemon.h"
+#include "kvs/scan_replicator.h"
+
+using consus::scan_replicator;
+
+extern bool s_debug_mode;
+
+struct scan_replicator :: scan_stub
+{
+    scan_stub(comm_id t);
+    ~scan_stub() throw () {}
+
+    comm_id target;
+    replica_set rs;
+    uint64_t last_request_time;
+};
+
+scan_replicator :: scan_stub :: scan_stub(comm_id t)
+    : target(t)
+    , rs()
+    , last_request_time(0)
+{
+}
+
+scan_replicator :: scan_replicator(uint64_t key)
+    : m_state_key(key)
+    , m_mtx()
+    , m_init(false)
+    , m_finished(false)
+    , m_id()
+    , m_nonce()
+    , m_table()
+    , m_prefix()
+    , m_backing()
+    , m_status(CONSUS_SUCCESS)
+    , m_results()
+    , m_requests()
+{
+}
+
+scan_replicator :: ~scan_replicator() throw ()
+{
+}
+
+uint64_t
+scan_replicator :: state_key()
+{
+    return m_state_key;
+}
+
+bool
+scan_replicator :: finished()
+{
+    return !m_init || m_finished;
+}
+
+void
+scan_replicator :: init(comm_id id, uint64_t nonce,
+                        const e::slice& table, const e::slice& prefix,
+                        std::auto_ptr<e::buffer> backing)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    assert(!m_init);
+    m_id = id;
+    m_nonce = nonce;
+    m_table = table;
+    m_prefix = prefix;
+    m_backing = backing;
+    m_init = true;
+
+    if (s_debug_mode)
+    {
+        LOG(INFO) << logid() << " scan(\""
+                  << e::strescape(table.str()) << "\", \""
+                  << e::strescape(prefix.str()) << "\")";
+    }
+}
+
+void
+scan_replicator :: response(comm_id id, consus_returncode rc,
+                            const std::vector<datalayer::scan_entry>& entries,
+                            const replica_set& rs, daemon* d)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    scan_stub* stub = get_stub(id);
+
+    if (!stub)
+    {
+        if (s_debug_mode)
+        {
+            LOG(INFO) << logid() << " dropped response; no outstanding request to " << id;
+        }
+
+        return;
+    }
+
+    if (returncode_is_final(rc))
+    {
+        LOG_IF(INFO, s_debug_mode) << logid() << " response rc=" << rc
+                                   << " entries=" << entries.size()
+                                   << " from=" << id;
+        stub->rs = rs;
+
+        // replicas may each have missed different writes; keep the newest
+        // version of every key any of them has seen
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            version* v = &m_results[entries[i].key];
+
+            if (v->timestamp == 0 || entries[i].timestamp > v->timestamp)
+            {
+                v->timestamp = entries[i].timestamp;
+                v->value = entries[i].value;
+            }
+        }
+    }
+
+    work_state_machine(d);
+}
+
+void
+scan_replicator :: externally_work_state_machine(daemon* d)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    work_state_machine(d);
+}
+
+std::string
+scan_replicator :: debug_dump()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    std::ostringstream ostr;
+    ostr << "scan nonce=" << m_nonce << " from=" << m_id
+         << " keys=" << m_results.size()
+         << " requests=" << m_requests.size();
+    return ostr.str();
+}
+
+std::string
+scan_replicator :: logid()
+{
+    return daemon::logid(m_table, m_prefix) + "-S-REP";
+}
+
+scan_replicator::scan_stub*
+scan_replicator :: get_stub(comm_id id)
+{
+    for (size_t j = 0; j < m_requests.size(); ++j)
+    {
+        if (m_requests[j].target == id)
+        {
+            return &m_requests[j];
+        }
+    }
+
+    return NULL;
+}
+
+void
+scan_replicator :: work_state_machine(daemon* d)
+{
+    if (m_finished)
+    {
+        return;
+    }
+
+    configuration* c = d->get_config();
+    replica_set rs;
+
+    if (!c->hash(d->m_us.dc, m_table, m_prefix, &rs))
+    {
+        // XXX
+    }
+
+    const uint64_t now = po6::monotonic_time();
+    unsigned complete = 0;
+
+    for (unsigned i = 0; i < rs.num_replicas; ++i)
+    {
+        scan_stub* stub = get_stub(rs.replicas[i]);
+
+        if (!stub)
+        {
+            m_requests.push_back(scan_stub(rs.replicas[i]));
+            stub = &m_requests.back();
+        }
+
+        if (replica_sets_agree(rs.replicas[i], rs, stub->rs))
+        {
+            ++complete;
+        }
+        else if (stub->last_request_time + d->resend_interval() < now)
+        {
+            send_scan_request(stub, now, d);
+        }
+    }
+
+    if (rs.desired_replication > rs.num_replicas)
+    {
+        LOG_EVERY_N(WARNING, 1000) << "too few kvs daemons to achieve desired replication factor: "
+                                   << rs.desired_replication - rs.num_replicas
+                                   << " more daemons needed";
+        rs.desired_replication = rs.num_replicas;
+    }
+
+    const unsigned quorum = rs.desired_replication / 2 + 1;
+
+    if (complete < quorum)
+    {
+        return;
+    }
+
+    m_finished = true;
+    uint64_t count = 0;
+    size_t sz = BUSYBEE_HEADER_SIZE
+              + pack_size(KVS_REP_SCAN_RESP)
+              + sizeof(uint64_t)
+              + pack_size(m_status)
+              + sizeof(uint64_t);
+
+    for (result_map_t::iterator it = m_results.begin(); it != m_results.end(); ++it)
+    {
+        // an empty value is a tombstone that outlived every replica's copy
+        if (it->second.value.empty())
+        {
+            continue;
+        }
+
+        sz += pack_size(e::slice(it->first)) + pack_size(e::slice(it->second.value));
+        ++count;
+    }
+
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    e::packer pa = msg->pack_at(BUSYBEE_HEADER_SIZE)
+        << KVS_REP_SCAN_RESP << m_nonce << m_status << count;
+
+    for (result_map_t::iterator it = m_results.begin(); it != m_results.end(); ++it)
+    {
+        if (!it->second.value.empty())
+        {
+            pa = pa << e::slice(it->first) << e::slice(it->second.value);
+        }
+    }
+
+    d->send(m_id, msg);
+    LOG_IF(INFO, s_debug_mode) << "sending scan response " << m_status
+                               << " entries=" << count
+                               << " nonce=" << m_nonce << " to " << m_id;
+}
+
+// See the comment in read_replicator; scans share reads' notion of a final
+// returncode for now.
+bool
+scan_replicator :: returncode_is_final(consus_returncode rc)
+{
+    switch (rc)
+    {
+        case CONSUS_SUCCESS:
+        case CONSUS_NOT_FOUND:
+        case CONSUS_UNKNOWN_TABLE:
+            return true;
+        case CONSUS_LESS_DURABLE:
+        case CONSUS_ABORTED:
+        case CONSUS_COMMITTED:
+        case CONSUS_NONE_PENDING:
+        case CONSUS_INVALID:
+        case CONSUS_TIMEOUT:
+        case CONSUS_INTERRUPTED:
+        case CONSUS_SEE_ERRNO:
+        case CONSUS_COORD_FAIL:
+        case CONSUS_UNAVAILABLE:
+        case CONSUS_SERVER_ERROR:
+        case CONSUS_THROTTLED:
+        case CONSUS_INTERNAL:
+        case CONSUS_GARBAGE:
+        default:
+            return false;
+    }
+}
+
+void
+scan_replicator :: send_scan_request(scan_stub* stub, uint64_t now, daemon* d)
+{
+    if (s_debug_mode)
+    {
+        LOG(INFO) << logid() << " sending target=" << stub->target;
+    }
+
+    const size_t sz = BUSYBEE_HEADER_SIZE
+                    + pack_size(KVS_RAW_SCAN)
+                    + sizeof(uint64_t)
+                    + pack_size(m_table)
+                    + pack_size(m_prefix)
+                    + sizeof(uint64_t);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(BUSYBEE_HEADER_SIZE)
+        << KVS_RAW_SCAN << m_state_key << m_table << m_prefix << uint64_t(UINT64_MAX);
+    d->send(stub->target, msg);
+    stub->last_request_time = now;
+}
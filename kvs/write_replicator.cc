@@ -36,6 +36,7 @@
 
 // consus
 #include "common/consus.h"
+#include "common/message.h"
 #include "common/network_msgtype.h"
 #include "kvs/daemon.h"
 #include "kvs/write_replicator.h"
@@ -76,6 +77,7 @@ write_replicator :: write_replicator(uint64_t key)
     , m_timestamp()
     , m_value()
     , m_backing()
+    , m_chunks()
     , m_requests()
 {
 }
@@ -114,29 +116,26 @@ write_replicator :: init(comm_id id, uint64_t nonce, unsigned flags,
     m_value = value;
     m_backing = msg;
     m_init = true;
+    log_init();
+}
 
-    if (s_debug_mode)
-    {
-        std::string tmp;
-        const char* v = NULL;
-
-        if ((CONSUS_WRITE_TOMBSTONE & flags))
-        {
-            v = "TOMBSTONE";
-        }
-        else
-        {
-            tmp = e::strescape(value.str());
-            tmp = "\"" + tmp + "\"";
-            v = tmp.c_str();
-        }
-
-        LOG(INFO) << logid() << " write(\""
-                  << e::strescape(table.str()) << "\", \""
-                  << e::strescape(key.str())
-                  << "\", " << v << ")@" << timestamp
-                  << " from nonce=" << m_nonce << " id=" << m_id;
-    }
+void
+write_replicator :: init(comm_id id, uint64_t nonce, unsigned flags,
+                         const e::slice& table, const e::slice& key,
+                         uint64_t timestamp,
+                         const e::compat::shared_ptr<const chunk_list>& msg)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    assert(!m_init);
+    m_id = id;
+    m_nonce = nonce;
+    m_flags = flags;
+    m_table = table;
+    m_key = key;
+    m_timestamp = timestamp;
+    m_chunks = msg;
+    m_init = true;
+    log_init();
 }
 
 void
@@ -214,6 +213,42 @@ write_replicator :: debug_dump()
     return ostr.str();
 }
 
+void
+write_replicator :: log_init()
+{
+    if (!s_debug_mode)
+    {
+        return;
+    }
+
+    std::string tmp;
+    const char* v = NULL;
+
+    if ((CONSUS_WRITE_TOMBSTONE & m_flags))
+    {
+        v = "TOMBSTONE";
+    }
+    else if (m_chunks)
+    {
+        std::ostringstream ostr;
+        ostr << "<" << m_chunks->size() << " byte message>";
+        tmp = ostr.str();
+        v = tmp.c_str();
+    }
+    else
+    {
+        tmp = e::strescape(m_value.str());
+        tmp = "\"" + tmp + "\"";
+        v = tmp.c_str();
+    }
+
+    LOG(INFO) << logid() << " write(\""
+              << e::strescape(m_table.str()) << "\", \""
+              << e::strescape(m_key.str())
+              << "\", " << v << ")@" << m_timestamp
+              << " from nonce=" << m_nonce << " id=" << m_id;
+}
+
 std::string
 write_replicator :: logid()
 {
@@ -401,6 +436,7 @@ write_replicator :: returncode_is_final(consus_returncode rc)
         case CONSUS_COORD_FAIL:
         case CONSUS_UNAVAILABLE:
         case CONSUS_SERVER_ERROR:
+        case CONSUS_THROTTLED:
         case CONSUS_INTERNAL:
         case CONSUS_GARBAGE:
         default:
@@ -417,6 +453,18 @@ write_replicator :: send_write_request(write_stub* stub, uint64_t now, daemon* d
     }
 
     assert(!returncode_is_final(stub->status));
+
+    // KVS_RAW_WR lays out its fields as KVS_REP_WR does, so the message
+    // relays as it came, with this replicator's id in place of the nonce
+    if (m_chunks)
+    {
+        std::auto_ptr<e::buffer> prefix = (message() << KVS_RAW_WR << m_state_key).create();
+        d->send(stub->target, m_chunks, e::slice(prefix->data() + BUSYBEE_HEADER_SIZE,
+                                                 prefix->size() - BUSYBEE_HEADER_SIZE));
+        stub->last_request_time = now;
+        return;
+    }
+
     const size_t sz = BUSYBEE_HEADER_SIZE
                     + pack_size(KVS_RAW_WR)
                     + sizeof(uint64_t)
@@ -32,11 +32,13 @@
 #include <po6/threads/mutex.h>
 
 // e
+#include <e/compat.h>
 #include <e/slice.h>
 
 // consus
 #include <consus.h>
 #include "namespace.h"
+#include "common/chunking.h"
 #include "common/ids.h"
 
 BEGIN_CONSUS_NAMESPACE
@@ -57,6 +59,12 @@ class write_replicator
                   const e::slice& table, const e::slice& key,
                   uint64_t timestamp, const e::slice& value,
                   std::auto_ptr<e::buffer> msg);
+        // a write that arrived in chunks; table and key point into msg, and
+        // the replicas are sent msg itself under a new type and nonce
+        void init(comm_id id, uint64_t nonce, unsigned flags,
+                  const e::slice& table, const e::slice& key,
+                  uint64_t timestamp,
+                  const e::compat::shared_ptr<const chunk_list>& msg);
         void response(comm_id id, consus_returncode rc,
                       const replica_set& rs, daemon* d);
         void externally_work_state_machine(daemon* d);
@@ -77,6 +85,7 @@ class write_replicator
         void ensure_stub_exists(comm_id id) { get_or_create_stub(id); }
         void work_state_machine(daemon* d);
         bool returncode_is_final(consus_returncode rc);
+        void log_init();
         void send_write_request(write_stub* stub, uint64_t now, daemon* d);
 
     private:
@@ -92,6 +101,7 @@ class write_replicator
         uint64_t m_timestamp;
         e::slice m_value;
         std::auto_ptr<e::buffer> m_backing;
+        e::compat::shared_ptr<const chunk_list> m_chunks;
         std::vector<write_stub> m_requests;
 };
 
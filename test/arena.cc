@@ -0,0 +1,97 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdint.h>
+#include <string.h>
+
+// STL
+#include <string>
+#include <vector>
+
+// consus
+#include "test/th.h"
+#include "txman/arena.h"
+
+using consus::arena;
+
+TEST(Arena, SmallStaysInline)
+{
+    arena a;
+    e::slice s = a.copy(e::slice("hello", 5));
+    ASSERT_EQ(s.str(), std::string("hello"));
+    ASSERT_EQ(a.allocations(), 1U);
+    ASSERT_EQ(a.bytes(), 5U);
+    ASSERT_EQ(a.reserved(), 0U);
+    ASSERT_EQ(a.blocks(), 0U);
+}
+
+TEST(Arena, EmptyCopyAllocatesNothing)
+{
+    arena a;
+    e::slice s = a.copy(e::slice());
+    ASSERT_TRUE(s.empty());
+    ASSERT_EQ(a.allocations(), 0U);
+}
+
+// copies stay put and intact no matter how many more blocks get chained on
+TEST(Arena, CopiesSurviveGrowth)
+{
+    arena a;
+    std::vector<e::slice> copies;
+    uint64_t allocations = 0;
+
+    for (unsigned i = 0; i < 4096; ++i)
+    {
+        std::string s(i % 131, char('a' + i % 26));
+        copies.push_back(a.copy(e::slice(s)));
+        allocations += s.empty() ? 1 : 2;
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(a.allocate(1)) % 8, 0U);
+    }
+
+    for (unsigned i = 0; i < 4096; ++i)
+    {
+        ASSERT_EQ(copies[i].str(), std::string(i % 131, char('a' + i % 26)));
+    }
+
+    ASSERT_EQ(a.allocations(), allocations);
+    ASSERT_TRUE(a.blocks() > 0);
+    ASSERT_TRUE(a.reserved() >= a.bytes());
+}
+
+TEST(Arena, LargeGetsOwnBlock)
+{
+    arena a;
+    a.allocate(16);
+    char* big = static_cast<char*>(a.allocate(1 << 20));
+    memset(big, 0xff, 1 << 20);
+    ASSERT_EQ(a.blocks(), 1U);
+    // the inline region still serves small requests
+    char* small = static_cast<char*>(a.allocate(16));
+    ASSERT_TRUE(small < big || small >= big + (1 << 20));
+    ASSERT_EQ(a.blocks(), 1U);
+}
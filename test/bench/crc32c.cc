@@ -0,0 +1,76 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// C
+#include <stdlib.h>
+
+// STL
+#include <vector>
+
+// consus
+#include "test/th.h"
+#include "common/crc32c.h"
+
+using consus::crc32c;
+using consus::crc32c_portable;
+
+// The durable log checksums each record as it is appended; these cover the
+// short-record, page, and large-batch cases for the implementation the CPU
+// dispatch picks, and the portable one for comparison.
+
+static std::vector<unsigned char>
+random_buffer(size_t sz)
+{
+    std::vector<unsigned char> buf(sz);
+
+    for (size_t i = 0; i < buf.size(); ++i)
+    {
+        buf[i] = rand();
+    }
+
+    return buf;
+}
+
+#define CRC32C_BENCHMARK(NAME, FUNC, SIZE) \
+    BENCHMARK(CRC32C, NAME) \
+    { \
+        std::vector<unsigned char> buf(random_buffer(SIZE)); \
+        uint32_t crc = 0; \
+        set_bytes(SIZE); \
+        reset_timer(); \
+        for (uint64_t i = 0; i < iterations; ++i) \
+        { \
+            crc = FUNC(crc, &buf[0], buf.size()); \
+        } \
+        th::consume(crc); \
+    }
+
+CRC32C_BENCHMARK(Dispatch64, crc32c, 64)
+CRC32C_BENCHMARK(Dispatch4096, crc32c, 4096)
+CRC32C_BENCHMARK(Dispatch1M, crc32c, 1048576)
+CRC32C_BENCHMARK(Portable64, crc32c_portable, 64)
+CRC32C_BENCHMARK(Portable4096, crc32c_portable, 4096)
+CRC32C_BENCHMARK(Portable1M, crc32c_portable, 1048576)
@@ -0,0 +1,168 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// consus
+#include "test/th.h"
+#include "txman/generalized_paxos.h"
+#include "txman/paxos_synod.h"
+
+using namespace consus;
+
+// Every transaction decides its vote in each data center with a paxos_synod
+// (the local_voter) and then decides its outcome across data centers with
+// generalized paxos (the global_voter); both run once per commit.
+
+static paxos_group
+make_group(unsigned sz)
+{
+    paxos_group pg;
+    pg.id = paxos_group_id(1);
+    pg.dc = data_center_id(1);
+    pg.members_sz = sz;
+
+    for (unsigned i = 0; i < sz; ++i)
+    {
+        pg.members[i] = comm_id(i + 1);
+    }
+
+    return pg;
+}
+
+// the common case:  the implicit leader proposes and every acceptor votes
+BENCHMARK(PaxosSynod, FiveReplicaRound)
+{
+    const paxos_group pg(make_group(5));
+    uint64_t value = 0;
+
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        paxos_synod s[5];
+
+        for (unsigned j = 0; j < 5; ++j)
+        {
+            s[j].init(pg.members[j], pg, pg.members[0]);
+        }
+
+        bool send_p1a = false;
+        bool send_p2a = false;
+        bool send_learn = false;
+        paxos_synod::ballot b;
+        paxos_synod::pvalue p;
+        s[0].propose(i + 1);
+        s[0].advance(&send_p1a, &b, &send_p2a, &p, &send_learn, &value);
+
+        for (unsigned j = 0; send_p2a && j < 5; ++j)
+        {
+            bool accepted = false;
+            s[j].phase2a(p, &accepted);
+
+            if (accepted)
+            {
+                s[0].phase2b(pg.members[j], p);
+            }
+        }
+
+        s[0].advance(&send_p1a, &b, &send_p2a, &p, &send_learn, &value);
+    }
+
+    th::consume(value);
+}
+
+struct no_conflict_comparator : public generalized_paxos::comparator
+{
+    no_conflict_comparator() {}
+    virtual ~no_conflict_comparator() throw () {}
+
+    virtual bool conflict(const generalized_paxos::command&, const generalized_paxos::command&) const
+    {
+        return false;
+    }
+};
+no_conflict_comparator ncc;
+
+abstract_id _ids[] = {abstract_id(1),
+                      abstract_id(2),
+                      abstract_id(3),
+                      abstract_id(4),
+                      abstract_id(5)};
+
+// the FiveAcceptors unit test as a workload:  one leader, five commutative
+// commands from five proposers, learned everywhere
+BENCHMARK(GeneralizedPaxos, FiveAcceptorsFiveCommands)
+{
+    size_t learned = 0;
+
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        generalized_paxos gp[5];
+
+        for (unsigned j = 0; j < 5; ++j)
+        {
+            gp[j].init(&ncc, _ids[j], _ids, 5);
+        }
+
+        bool send_m1 = false;
+        bool send_m2 = false;
+        bool send_m3 = false;
+        generalized_paxos::message_p1a m1;
+        generalized_paxos::message_p2a m2;
+        generalized_paxos::message_p2b m3;
+        generalized_paxos::message_p1b r1;
+
+        gp[0].advance(true, &send_m1, &m1, &send_m2, &m2, &send_m3, &m3);
+
+        for (unsigned j = 0; j < 5; ++j)
+        {
+            bool send = false;
+            gp[j].process_p1a(m1, &send, &r1);
+
+            if (send)
+            {
+                gp[0].process_p1b(r1);
+            }
+        }
+
+        for (unsigned j = 0; j < 5; ++j)
+        {
+            gp[j].propose(generalized_paxos::command(static_cast<uint16_t>(j + 1), "hello world"));
+        }
+
+        for (unsigned r = 0; r < 11; ++r)
+        {
+            gp[r % 5].advance(r == 0, &send_m1, &m1, &send_m2, &m2, &send_m3, &m3);
+
+            for (unsigned j = 0; send_m3 && j < 5; ++j)
+            {
+                gp[j].process_p2b(m3);
+                gp[j].propose_from_p2b(m3);
+            }
+        }
+
+        learned += gp[0].learned().commands.size();
+    }
+
+    th::consume(learned);
+}
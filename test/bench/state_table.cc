@@ -0,0 +1,224 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <vector>
+
+// po6
+#include <po6/threads/thread.h>
+
+// e
+#include <e/compat.h>
+#include <e/garbage_collector.h>
+#include <e/state_hash_table.h>
+
+// consus
+#include "test/th.h"
+#include "common/state_table.h"
+
+// Every message to either daemon looks up (or creates) the state machine it
+// is for, and the pumping threads walk the tables several times a second.
+// These compare consus::state_table against the e::state_hash_table it
+// replaced, over a table holding as many states as a busy daemon does.
+
+namespace
+{
+
+class stub
+{
+    public:
+        stub(const uint64_t& key) : m_key(key), done(false) {}
+        ~stub() throw () {}
+
+    public:
+        const uint64_t& state_key() const { return m_key; }
+        bool finished() { return done; }
+
+    private:
+        const uint64_t m_key;
+
+    public:
+        bool done;
+
+    private:
+        stub(const stub&);
+        stub& operator = (const stub&);
+};
+
+const uint64_t RESIDENT = 16384;
+
+template <typename TABLE>
+void
+populate(TABLE* t)
+{
+    for (uint64_t i = 1; i <= RESIDENT; ++i)
+    {
+        typename TABLE::state_reference sr;
+        t->create_state(i, &sr);
+    }
+}
+
+template <typename TABLE>
+void
+lookup(TABLE* t, uint64_t iterations)
+{
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        typename TABLE::state_reference sr;
+        th::consume(t->get_state(i % RESIDENT + 1, &sr));
+    }
+}
+
+// several threads look up the same states at once, so each lookup is apt to
+// wait on an entry another thread holds; reported per lookup across threads
+const uint64_t CONTENDERS = 4;
+
+template <typename TABLE>
+class contender
+{
+    public:
+        contender(e::garbage_collector* gc, TABLE* t, uint64_t iterations)
+            : m_gc(gc), m_t(t), m_iterations(iterations) {}
+        ~contender() throw () {}
+
+    public:
+        void run()
+        {
+            e::garbage_collector::thread_state ts;
+            m_gc->register_thread(&ts);
+            lookup(m_t, m_iterations);
+            m_gc->deregister_thread(&ts);
+        }
+
+    private:
+        e::garbage_collector* m_gc;
+        TABLE* m_t;
+        uint64_t m_iterations;
+
+    private:
+        contender(const contender&);
+        contender& operator = (const contender&);
+};
+
+template <typename TABLE>
+void
+contended_lookup(e::garbage_collector* gc, TABLE* t, uint64_t iterations)
+{
+    contender<TABLE> c(gc, t, iterations / CONTENDERS + 1);
+    std::vector<e::compat::shared_ptr<po6::threads::thread> > threads;
+
+    for (uint64_t i = 0; i < CONTENDERS; ++i)
+    {
+        e::compat::shared_ptr<po6::threads::thread> th(new po6::threads::thread(po6::threads::make_obj_func(&contender<TABLE>::run, &c)));
+        threads.push_back(th);
+        th->start();
+    }
+
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i]->join();
+    }
+}
+
+// one state comes and goes per op, as with each kvs_read the txman issues
+template <typename TABLE>
+void
+churn(TABLE* t, uint64_t iterations)
+{
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        typename TABLE::state_reference sr;
+        stub* s = t->create_state(RESIDENT + 1 + i, &sr);
+        s->done = true;
+    }
+}
+
+// reported per state visited
+template <typename TABLE>
+void
+iterate(TABLE* t, uint64_t iterations)
+{
+    uint64_t seen = 0;
+
+    while (seen < iterations)
+    {
+        for (typename TABLE::iterator it(t); it.valid(); ++it)
+        {
+            th::consume(*it);
+            ++seen;
+        }
+    }
+}
+
+} // namespace
+
+#define STATE_TABLE_BENCHMARK(GROUP, TABLE, NAME, FUNC) \
+    BENCHMARK(GROUP, NAME) \
+    { \
+        e::garbage_collector gc; \
+        e::garbage_collector::thread_state ts; \
+        gc.register_thread(&ts); \
+        { \
+            TABLE t(&gc); \
+            populate(&t); \
+            reset_timer(); \
+            FUNC(&t, iterations); \
+            stop_timer(); \
+        } \
+        gc.deregister_thread(&ts); \
+    }
+
+// as above, but FUNC also takes the garbage collector for its threads
+#define STATE_TABLE_THREADED_BENCHMARK(GROUP, TABLE, NAME, FUNC) \
+    BENCHMARK(GROUP, NAME) \
+    { \
+        e::garbage_collector gc; \
+        e::garbage_collector::thread_state ts; \
+        gc.register_thread(&ts); \
+        { \
+            TABLE t(&gc); \
+            populate(&t); \
+            gc.offline(&ts); \
+            reset_timer(); \
+            FUNC(&gc, &t, iterations); \
+            stop_timer(); \
+            gc.online(&ts); \
+        } \
+        gc.deregister_thread(&ts); \
+    }
+
+typedef e::state_hash_table<uint64_t, stub> e_table;
+typedef consus::state_table<uint64_t, stub> consus_table;
+
+STATE_TABLE_BENCHMARK(EStateHashTable, e_table, Lookup, lookup)
+STATE_TABLE_BENCHMARK(EStateHashTable, e_table, Churn, churn)
+STATE_TABLE_BENCHMARK(EStateHashTable, e_table, Iterate, iterate)
+STATE_TABLE_THREADED_BENCHMARK(EStateHashTable, e_table, ContendedLookup, contended_lookup)
+STATE_TABLE_BENCHMARK(StateTable, consus_table, Lookup, lookup)
+STATE_TABLE_BENCHMARK(StateTable, consus_table, Churn, churn)
+STATE_TABLE_BENCHMARK(StateTable, consus_table, Iterate, iterate)
+STATE_TABLE_THREADED_BENCHMARK(StateTable, consus_table, ContendedLookup, contended_lookup)
@@ -0,0 +1,119 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// e
+#include <e/buffer.h>
+
+// consus
+#include "test/th.h"
+#include "common/message.h"
+#include "common/network_msgtype.h"
+#include "common/transaction_group.h"
+
+using namespace consus;
+
+// transaction_group is the key for the txman's transaction map and the unit
+// of nearly every message between transaction managers, so hashing it and
+// moving it on and off the wire sit on every hop.
+
+static transaction_group
+make_tg(uint64_t i)
+{
+    transaction_id txid(paxos_group_id(7), 0, 1490000000ULL + i, i);
+    return transaction_group(paxos_group_id(3), txid);
+}
+
+BENCHMARK(TransactionID, Hash)
+{
+    transaction_id txid(make_tg(0).txid);
+    size_t h = 0;
+
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        txid.number = i;
+        h ^= txid.hash();
+    }
+
+    th::consume(h);
+}
+
+BENCHMARK(TransactionGroup, Hash)
+{
+    transaction_group tg(make_tg(0));
+    size_t h = 0;
+
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        tg.txid.number = i;
+        h ^= tg.hash();
+    }
+
+    th::consume(h);
+}
+
+BENCHMARK(TransactionGroup, Pack)
+{
+    transaction_group tg(make_tg(0));
+    std::auto_ptr<e::buffer> buf(e::buffer::create(pack_size(tg)));
+
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        tg.txid.number = i;
+        buf->pack_at(0) << tg;
+    }
+
+    th::consume(buf->data()[0]);
+}
+
+BENCHMARK(TransactionGroup, Unpack)
+{
+    transaction_group tg(make_tg(0));
+    std::auto_ptr<e::buffer> buf(e::buffer::create(pack_size(tg)));
+    buf->pack_at(0) << tg;
+
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        transaction_group out;
+        e::unpacker up = buf->unpack_from(0) >> out;
+        th::consume(up.error());
+        th::consume(out);
+    }
+}
+
+// the same shape as the txman's TXMAN_PAXOS_2B, built and sent per op
+BENCHMARK(Message, Paxos2B)
+{
+    transaction_group tg(make_tg(0));
+
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        std::auto_ptr<e::buffer> msg = (message()
+            << TXMAN_PAXOS_2B
+            << tg
+            << i).create();
+        th::consume(msg->size());
+    }
+}
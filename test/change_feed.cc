@@ -0,0 +1,320 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdlib.h>
+
+// POSIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// STL
+#include <string>
+#include <vector>
+
+// consus
+#include <consus.h>
+#include "test/th.h"
+#include "common/constants.h"
+#include "txman/change_feed.h"
+
+using consus::change_feed;
+using consus::paxos_group_id;
+using consus::transaction_group;
+using consus::transaction_id;
+
+namespace
+{
+
+// a fresh directory for each feed; removed when the test is done
+class scratch
+{
+    public:
+        scratch()
+            : path()
+        {
+            char tmpl[] = "/tmp/consus-change-feed-XXXXXX";
+            char* d = mkdtemp(tmpl);
+            path = d ? d : "";
+        }
+        ~scratch() throw ()
+        {
+            unlink((path + "/changes_a").c_str());
+            unlink((path + "/changes_b").c_str());
+            rmdir(path.c_str());
+        }
+
+    public:
+        std::string path;
+
+    private:
+        scratch(const scratch&);
+        scratch& operator = (const scratch&);
+};
+
+transaction_group
+xact(uint64_t number)
+{
+    paxos_group_id g(1);
+    return transaction_group(g, transaction_id(g, CONSUS_PRIORITY_NORMAL, 1000, number));
+}
+
+uint64_t
+publish(change_feed* cf, const std::string& key, size_t count, size_t value_sz = 8)
+{
+    std::vector<change_feed::change> changes(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        changes[i].timestamp = 1000;
+        changes[i].table = "table";
+        changes[i].key = key;
+        changes[i].value = std::string(value_sz, 'v');
+    }
+
+    return cf->publish(&changes);
+}
+
+uint64_t
+file_size(const std::string& path)
+{
+    struct stat st;
+
+    if (stat(path.c_str(), &st) < 0)
+    {
+        return 0;
+    }
+
+    return st.st_size;
+}
+
+} // namespace
+
+TEST(ChangeFeed, PublishSyncRead)
+{
+    scratch s;
+    change_feed cf;
+    ASSERT_TRUE(cf.open(s.path));
+    ASSERT_EQ(publish(&cf, "a", 2), 3U);
+    ASSERT_EQ(publish(&cf, "b", 1), 4U);
+    std::vector<change_feed::change> empty;
+    ASSERT_EQ(cf.publish(&empty), 0U);
+
+    // nothing is visible until it is durable
+    std::vector<change_feed::change> changes;
+    ASSERT_EQ(cf.read(1, 1ULL << 20, &changes), 1U);
+    ASSERT_TRUE(changes.empty());
+
+    ASSERT_TRUE(cf.sync());
+    ASSERT_EQ(cf.read(1, 1ULL << 20, &changes), 4U);
+    ASSERT_EQ(changes.size(), 3U);
+    ASSERT_EQ(changes[0].position, 1U);
+    ASSERT_EQ(changes[0].key, "a");
+    ASSERT_EQ(changes[2].position, 3U);
+    ASSERT_EQ(changes[2].key, "b");
+
+    // a small budget still returns one change
+    changes.clear();
+    ASSERT_EQ(cf.read(2, 1, &changes), 3U);
+    ASSERT_EQ(changes.size(), 1U);
+    ASSERT_EQ(changes[0].position, 2U);
+}
+
+TEST(ChangeFeed, AcknowledgeOnceDurable)
+{
+    scratch s;
+    change_feed cf;
+    ASSERT_TRUE(cf.open(s.path));
+    uint64_t end1 = publish(&cf, "a", 1);
+    uint64_t end2 = publish(&cf, "b", 1);
+    ASSERT_FALSE(cf.durable_or_wait(end1, xact(1)));
+    ASSERT_FALSE(cf.durable_or_wait(end2, xact(2)));
+    // asking again does not remember the transaction twice
+    ASSERT_FALSE(cf.durable_or_wait(end2, xact(2)));
+
+    std::vector<transaction_group> tgs;
+    cf.durable_transactions(&tgs);
+    ASSERT_TRUE(tgs.empty());
+
+    ASSERT_TRUE(cf.sync());
+    cf.durable_transactions(&tgs);
+    ASSERT_EQ(tgs.size(), 2U);
+    ASSERT_TRUE((tgs[0] == xact(1) && tgs[1] == xact(2)) ||
+                (tgs[0] == xact(2) && tgs[1] == xact(1)));
+    tgs.clear();
+    cf.durable_transactions(&tgs);
+    ASSERT_TRUE(tgs.empty());
+
+    // later checks succeed outright
+    ASSERT_TRUE(cf.durable_or_wait(end2, xact(2)));
+    uint64_t end3 = publish(&cf, "c", 1);
+    ASSERT_FALSE(cf.durable_or_wait(end3, xact(3)));
+    ASSERT_TRUE(cf.sync());
+    cf.durable_transactions(&tgs);
+    ASSERT_EQ(tgs.size(), 1U);
+    ASSERT_TRUE(tgs[0] == xact(3));
+}
+
+TEST(ChangeFeed, ReopenRecovers)
+{
+    scratch s;
+
+    {
+        change_feed cf;
+        ASSERT_TRUE(cf.open(s.path));
+        publish(&cf, "a", 3);
+        publish(&cf, "b", 2);
+        ASSERT_TRUE(cf.sync());
+    }
+
+    change_feed cf;
+    ASSERT_TRUE(cf.open(s.path));
+    std::vector<change_feed::change> changes;
+    ASSERT_EQ(cf.read(1, 1ULL << 20, &changes), 6U);
+    ASSERT_EQ(changes.size(), 5U);
+    ASSERT_EQ(changes[3].key, "b");
+    // positions continue where the feed left off
+    ASSERT_EQ(publish(&cf, "c", 1), 7U);
+}
+
+TEST(ChangeFeed, TornTailIsTruncated)
+{
+    scratch s;
+    uint64_t good = 0;
+
+    {
+        change_feed cf;
+        ASSERT_TRUE(cf.open(s.path));
+        publish(&cf, "a", 2);
+        ASSERT_TRUE(cf.sync());
+        good = file_size(s.path + "/changes_a");
+        publish(&cf, "b", 2);
+        ASSERT_TRUE(cf.sync());
+    }
+
+    // flip a byte in the second record's body so its CRC fails
+    int fd = open((s.path + "/changes_a").c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+    char c = 0;
+    ASSERT_EQ(pread(fd, &c, 1, good + 12), 1);
+    c ^= 0x5a;
+    ASSERT_EQ(pwrite(fd, &c, 1, good + 12), 1);
+    close(fd);
+
+    {
+        change_feed cf;
+        ASSERT_TRUE(cf.open(s.path));
+        ASSERT_EQ(file_size(s.path + "/changes_a"), good);
+        std::vector<change_feed::change> changes;
+        ASSERT_EQ(cf.read(1, 1ULL << 20, &changes), 3U);
+        ASSERT_EQ(changes.size(), 2U);
+        // the corrupt record's positions are reused
+        ASSERT_EQ(publish(&cf, "c", 1), 4U);
+        ASSERT_TRUE(cf.sync());
+    }
+
+    // a record cut short by a crash is dropped as well
+    good = file_size(s.path + "/changes_a");
+
+    {
+        change_feed cf;
+        ASSERT_TRUE(cf.open(s.path));
+        publish(&cf, "d", 1);
+        ASSERT_TRUE(cf.sync());
+    }
+
+    ASSERT_EQ(truncate((s.path + "/changes_a").c_str(), file_size(s.path + "/changes_a") - 1), 0);
+    change_feed cf;
+    ASSERT_TRUE(cf.open(s.path));
+    ASSERT_EQ(file_size(s.path + "/changes_a"), good);
+    std::vector<change_feed::change> changes;
+    ASSERT_EQ(cf.read(1, 1ULL << 20, &changes), 4U);
+    ASSERT_EQ(changes.size(), 3U);
+    ASSERT_EQ(changes[2].key, "c");
+}
+
+TEST(ChangeFeed, SegmentsWrap)
+{
+    scratch s;
+    // enough to fill each segment more than once
+    const size_t value_sz = 1ULL << 20;
+    const size_t per_segment = CONSUS_CHANGE_FEED_SEGMENT / value_sz;
+    const size_t total = 3 * per_segment;
+
+    {
+        change_feed cf;
+        ASSERT_TRUE(cf.open(s.path));
+
+        for (size_t i = 0; i < total; ++i)
+        {
+            publish(&cf, "k", 1, value_sz);
+        }
+
+        ASSERT_TRUE(cf.sync());
+        ASSERT_LE(file_size(s.path + "/changes_a"), CONSUS_CHANGE_FEED_SEGMENT);
+        ASSERT_LE(file_size(s.path + "/changes_b"), CONSUS_CHANGE_FEED_SEGMENT);
+
+        // the oldest history is gone, and reading from before it starts at
+        // the oldest retained change
+        std::vector<change_feed::change> changes;
+        cf.read(1, 1, &changes);
+        ASSERT_EQ(changes.size(), 1U);
+        ASSERT_GT(changes[0].position, 1U);
+        ASSERT_LT(changes[0].position, uint64_t(total - per_segment));
+    }
+
+    // after a restart the retained history is contiguous and ends at the
+    // last change written
+    change_feed cf;
+    ASSERT_TRUE(cf.open(s.path));
+    std::vector<change_feed::change> changes;
+    uint64_t cursor = 1;
+    uint64_t prev = 0;
+
+    while (true)
+    {
+        changes.clear();
+        uint64_t next = cf.read(cursor, 1ULL << 20, &changes);
+
+        if (changes.empty())
+        {
+            break;
+        }
+
+        for (size_t i = 0; i < changes.size(); ++i)
+        {
+            ASSERT_TRUE(prev == 0 || changes[i].position == prev + 1);
+            prev = changes[i].position;
+        }
+
+        cursor = next;
+    }
+
+    ASSERT_EQ(prev, uint64_t(total));
+    ASSERT_EQ(publish(&cf, "k", 1), uint64_t(total + 2));
+}
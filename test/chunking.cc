@@ -0,0 +1,479 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <string.h>
+
+// STL
+#include <vector>
+
+// po6
+#include <po6/time.h>
+
+// e
+#include <e/compat.h>
+
+// BusyBee
+#include <busybee.h>
+
+// consus
+#include "test/th.h"
+#include "common/chunking.h"
+#include "common/network_msgtype.h"
+
+using consus::chunk_list;
+using consus::chunk_reassembler;
+using consus::chunk_sender;
+using consus::comm_id;
+
+namespace
+{
+
+typedef e::compat::shared_ptr<e::buffer> buffer_ptr;
+
+std::auto_ptr<e::buffer>
+make_msg(size_t sz)
+{
+    std::auto_ptr<e::buffer> msg(e::buffer::create(BUSYBEE_HEADER_SIZE + sz));
+    msg->resize(BUSYBEE_HEADER_SIZE + sz);
+
+    for (size_t i = 0; i < sz; ++i)
+    {
+        msg->data()[BUSYBEE_HEADER_SIZE + i] = (i * 131 + (i >> 12)) & 0xff;
+    }
+
+    return msg;
+}
+
+std::vector<buffer_ptr>
+chunks_of(uint64_t stream, const e::buffer& msg)
+{
+    std::vector<buffer_ptr> chunks;
+
+    for (uint64_t off = 0; off < msg.size() - BUSYBEE_HEADER_SIZE; off += CONSUS_CHUNK_SIZE)
+    {
+        chunks.push_back(buffer_ptr(consus::make_chunk(stream, msg, off).release()));
+    }
+
+    return chunks;
+}
+
+// a chunk that make_chunk would never produce
+std::auto_ptr<e::buffer>
+forge_chunk(uint64_t stream, uint64_t offset, uint64_t total, size_t len)
+{
+    std::vector<char> bytes(len, 'x');
+    e::slice s(len ? &bytes[0] : NULL, len);
+    std::auto_ptr<e::buffer> chunk(e::buffer::create(BUSYBEE_HEADER_SIZE + 64 + len));
+    chunk->pack_at(BUSYBEE_HEADER_SIZE)
+        << consus::CONSUS_CHUNK << stream << offset << total << s;
+    return chunk;
+}
+
+// returns true when chunk completes a stream, leaving the message in *out
+bool
+feed(chunk_reassembler* cr, comm_id from, const e::buffer& chunk, std::auto_ptr<e::buffer>* out)
+{
+    std::auto_ptr<e::buffer> msg(chunk.copy());
+    consus::network_msgtype mt;
+    e::unpacker up = msg->unpack_from(BUSYBEE_HEADER_SIZE);
+    up = up >> mt;
+
+    if (up.error() || mt != consus::CONSUS_CHUNK || !cr->reassemble(from, up, &msg))
+    {
+        return false;
+    }
+
+    *out = msg;
+    return true;
+}
+
+// as feed, but leaves a completed stream as the chunks it arrived in
+bool
+collect(chunk_reassembler* cr, comm_id from, const e::buffer& chunk, std::auto_ptr<chunk_list>* out)
+{
+    std::auto_ptr<e::buffer> msg(chunk.copy());
+    consus::network_msgtype mt;
+    e::unpacker up = msg->unpack_from(BUSYBEE_HEADER_SIZE);
+    up = up >> mt;
+    return !up.error() && mt == consus::CONSUS_CHUNK && cr->collect(from, up, &msg, out);
+}
+
+bool
+same(const e::buffer& lhs, const e::buffer& rhs)
+{
+    return lhs.size() == rhs.size() &&
+           memcmp(lhs.data() + BUSYBEE_HEADER_SIZE,
+                  rhs.data() + BUSYBEE_HEADER_SIZE,
+                  lhs.size() - BUSYBEE_HEADER_SIZE) == 0;
+}
+
+e::unpacker
+past_type(const e::buffer& msg)
+{
+    consus::network_msgtype mt;
+    e::unpacker up = msg.unpack_from(BUSYBEE_HEADER_SIZE);
+    return up >> mt;
+}
+
+class fake_busybee
+{
+    public:
+        fake_busybee() : sent() {}
+
+    public:
+        busybee_returncode send(uint64_t, std::auto_ptr<e::buffer> msg)
+        {
+            sent.push_back(buffer_ptr(msg.release()));
+            return BUSYBEE_SUCCESS;
+        }
+
+    public:
+        std::vector<buffer_ptr> sent;
+};
+
+const size_t LARGE = 3 * CONSUS_CHUNK_THRESHOLD + 12345;
+
+} // namespace
+
+TEST(ChunkReassembler, InOrder)
+{
+    std::auto_ptr<e::buffer> msg(make_msg(LARGE));
+    std::vector<buffer_ptr> chunks(chunks_of(1, *msg));
+    chunk_reassembler cr;
+    std::auto_ptr<e::buffer> out;
+
+    for (size_t i = 0; i + 1 < chunks.size(); ++i)
+    {
+        ASSERT_FALSE(feed(&cr, comm_id(1), *chunks[i], &out));
+    }
+
+    ASSERT_EQ(cr.pending_streams(), 1U);
+    ASSERT_TRUE(feed(&cr, comm_id(1), *chunks.back(), &out));
+    ASSERT_TRUE(same(*out, *msg));
+    ASSERT_EQ(cr.pending_streams(), 0U);
+    ASSERT_EQ(cr.buffered_bytes(), 0U);
+}
+
+TEST(ChunkReassembler, OutOfOrder)
+{
+    std::auto_ptr<e::buffer> msg(make_msg(LARGE));
+    std::vector<buffer_ptr> chunks(chunks_of(1, *msg));
+    chunk_reassembler cr;
+    std::auto_ptr<e::buffer> out;
+
+    for (size_t i = chunks.size() - 1; i > 0; --i)
+    {
+        ASSERT_FALSE(feed(&cr, comm_id(1), *chunks[i], &out));
+    }
+
+    ASSERT_TRUE(feed(&cr, comm_id(1), *chunks[0], &out));
+    ASSERT_TRUE(same(*out, *msg));
+    ASSERT_EQ(cr.buffered_bytes(), 0U);
+}
+
+TEST(ChunkReassembler, Interleaved)
+{
+    std::auto_ptr<e::buffer> msg1(make_msg(LARGE));
+    std::auto_ptr<e::buffer> msg2(make_msg(LARGE + CONSUS_CHUNK_SIZE));
+    std::vector<buffer_ptr> chunks1(chunks_of(7, *msg1));
+    std::vector<buffer_ptr> chunks2(chunks_of(7, *msg2));
+    chunk_reassembler cr;
+    std::auto_ptr<e::buffer> out;
+
+    // same stream id from two senders, and two streams from one sender
+    for (size_t i = 0; i + 1 < chunks1.size(); ++i)
+    {
+        ASSERT_FALSE(feed(&cr, comm_id(1), *chunks1[i], &out));
+        ASSERT_FALSE(feed(&cr, comm_id(2), *chunks2[i], &out));
+    }
+
+    ASSERT_EQ(cr.pending_streams(), 2U);
+    ASSERT_TRUE(feed(&cr, comm_id(1), *chunks1.back(), &out));
+    ASSERT_TRUE(same(*out, *msg1));
+    ASSERT_FALSE(feed(&cr, comm_id(2), *chunks2[chunks2.size() - 2], &out));
+    ASSERT_TRUE(feed(&cr, comm_id(2), *chunks2.back(), &out));
+    ASSERT_TRUE(same(*out, *msg2));
+}
+
+TEST(ChunkReassembler, Duplicates)
+{
+    std::auto_ptr<e::buffer> msg(make_msg(LARGE));
+    std::vector<buffer_ptr> chunks(chunks_of(1, *msg));
+    chunk_reassembler cr;
+    std::auto_ptr<e::buffer> out;
+
+    ASSERT_FALSE(feed(&cr, comm_id(1), *chunks[0], &out));
+    ASSERT_EQ(cr.buffered_bytes(), CONSUS_CHUNK_SIZE);
+    ASSERT_FALSE(feed(&cr, comm_id(1), *chunks[0], &out));
+    ASSERT_EQ(cr.buffered_bytes(), CONSUS_CHUNK_SIZE);
+
+    // resending every chunk but the last must not complete the stream
+    for (size_t i = 0; i + 1 < chunks.size(); ++i)
+    {
+        ASSERT_FALSE(feed(&cr, comm_id(1), *chunks[i], &out));
+        ASSERT_FALSE(feed(&cr, comm_id(1), *chunks[i], &out));
+    }
+
+    ASSERT_TRUE(feed(&cr, comm_id(1), *chunks.back(), &out));
+    ASSERT_TRUE(same(*out, *msg));
+    ASSERT_EQ(cr.buffered_bytes(), 0U);
+}
+
+TEST(ChunkReassembler, Malformed)
+{
+    chunk_reassembler cr;
+    std::auto_ptr<e::buffer> out;
+    const uint64_t total = 2 * CONSUS_CHUNK_SIZE;
+
+    // misaligned, short, and past the end
+    ASSERT_FALSE(feed(&cr, comm_id(1), *forge_chunk(1, 1, total, CONSUS_CHUNK_SIZE), &out));
+    ASSERT_FALSE(feed(&cr, comm_id(1), *forge_chunk(1, 0, total, 1), &out));
+    ASSERT_FALSE(feed(&cr, comm_id(1), *forge_chunk(1, total, total, 0), &out));
+    ASSERT_EQ(cr.pending_streams(), 0U);
+
+    // a stream may not change its length part way through
+    ASSERT_FALSE(feed(&cr, comm_id(1), *forge_chunk(1, 0, total, CONSUS_CHUNK_SIZE), &out));
+    ASSERT_EQ(cr.pending_streams(), 1U);
+    ASSERT_FALSE(feed(&cr, comm_id(1), *forge_chunk(1, CONSUS_CHUNK_SIZE, total + 1, CONSUS_CHUNK_SIZE), &out));
+    ASSERT_EQ(cr.pending_streams(), 0U);
+    ASSERT_EQ(cr.buffered_bytes(), 0U);
+}
+
+TEST(ChunkReassembler, Oversized)
+{
+    chunk_reassembler cr;
+    std::auto_ptr<e::buffer> out;
+
+    // claiming a huge total costs nothing until the bytes arrive
+    ASSERT_FALSE(feed(&cr, comm_id(1), *forge_chunk(1, 0, CONSUS_CHUNK_MAX + CONSUS_CHUNK_SIZE, CONSUS_CHUNK_SIZE), &out));
+    ASSERT_EQ(cr.pending_streams(), 0U);
+    ASSERT_FALSE(feed(&cr, comm_id(1), *forge_chunk(2, 0, CONSUS_CHUNK_MAX, CONSUS_CHUNK_SIZE), &out));
+    ASSERT_EQ(cr.pending_streams(), 1U);
+    ASSERT_EQ(cr.buffered_bytes(), CONSUS_CHUNK_SIZE);
+}
+
+TEST(ChunkReassembler, PerSenderCap)
+{
+    chunk_reassembler cr(2 * CONSUS_CHUNK_SIZE, 64 * CONSUS_CHUNK_SIZE);
+    std::auto_ptr<e::buffer> msg(make_msg(LARGE));
+    std::vector<buffer_ptr> chunks(chunks_of(1, *msg));
+    std::auto_ptr<e::buffer> out;
+
+    ASSERT_FALSE(feed(&cr, comm_id(1), *chunks[0], &out));
+    ASSERT_FALSE(feed(&cr, comm_id(1), *chunks[1], &out));
+    ASSERT_FALSE(feed(&cr, comm_id(2), *chunks[0], &out));
+    ASSERT_EQ(cr.buffered_bytes(), 3 * CONSUS_CHUNK_SIZE);
+
+    // the third chunk from sender 1 drops its stream, not sender 2's
+    ASSERT_FALSE(feed(&cr, comm_id(1), *chunks[2], &out));
+    ASSERT_EQ(cr.pending_streams(), 1U);
+    ASSERT_EQ(cr.buffered_bytes(), CONSUS_CHUNK_SIZE);
+
+    // and sender 1 may start over
+    ASSERT_FALSE(feed(&cr, comm_id(1), *chunks[2], &out));
+    ASSERT_EQ(cr.pending_streams(), 2U);
+}
+
+TEST(ChunkReassembler, OverallCap)
+{
+    chunk_reassembler cr(64 * CONSUS_CHUNK_SIZE, 3 * CONSUS_CHUNK_SIZE);
+    std::auto_ptr<e::buffer> msg(make_msg(LARGE));
+    std::vector<buffer_ptr> chunks(chunks_of(1, *msg));
+    std::auto_ptr<e::buffer> out;
+
+    ASSERT_FALSE(feed(&cr, comm_id(1), *chunks[0], &out));
+    ASSERT_FALSE(feed(&cr, comm_id(2), *chunks[0], &out));
+    ASSERT_FALSE(feed(&cr, comm_id(3), *chunks[0], &out));
+    ASSERT_FALSE(feed(&cr, comm_id(4), *chunks[0], &out));
+    ASSERT_EQ(cr.pending_streams(), 3U);
+    ASSERT_EQ(cr.buffered_bytes(), 3 * CONSUS_CHUNK_SIZE);
+}
+
+TEST(ChunkReassembler, ForgetAndExpire)
+{
+    std::auto_ptr<e::buffer> msg(make_msg(LARGE));
+    std::vector<buffer_ptr> chunks(chunks_of(1, *msg));
+    chunk_reassembler cr;
+    std::auto_ptr<e::buffer> out;
+
+    ASSERT_FALSE(feed(&cr, comm_id(1), *chunks[0], &out));
+    ASSERT_FALSE(feed(&cr, comm_id(2), *chunks[0], &out));
+    cr.forget(comm_id(1));
+    ASSERT_EQ(cr.pending_streams(), 1U);
+    ASSERT_EQ(cr.buffered_bytes(), CONSUS_CHUNK_SIZE);
+    cr.expire(0);
+    ASSERT_EQ(cr.pending_streams(), 1U);
+    cr.expire(po6::monotonic_time() + 1);
+    ASSERT_EQ(cr.pending_streams(), 0U);
+    ASSERT_EQ(cr.buffered_bytes(), 0U);
+}
+
+TEST(ChunkReassembler, Collect)
+{
+    std::auto_ptr<e::buffer> msg(make_msg(LARGE));
+    std::vector<buffer_ptr> chunks(chunks_of(1, *msg));
+    chunk_reassembler cr;
+    std::auto_ptr<chunk_list> out;
+
+    for (size_t i = chunks.size() - 1; i > 0; --i)
+    {
+        ASSERT_FALSE(collect(&cr, comm_id(1), *chunks[i], &out));
+    }
+
+    ASSERT_TRUE(collect(&cr, comm_id(1), *chunks[0], &out));
+    ASSERT_EQ(out->size(), LARGE);
+    ASSERT_EQ(cr.buffered_bytes(), 0U);
+    e::slice head(out->chunk_at(0));
+    ASSERT_EQ(head.size(), CONSUS_CHUNK_SIZE);
+    ASSERT_EQ(memcmp(head.data(), msg->data() + BUSYBEE_HEADER_SIZE, head.size()), 0);
+    ASSERT_TRUE(same(*out->flatten(), *msg));
+}
+
+TEST(ChunkSender, Window)
+{
+    std::auto_ptr<e::buffer> msg(make_msg(LARGE));
+    std::auto_ptr<e::buffer> orig(msg->copy());
+    const size_t expected = chunks_of(1, *msg).size();
+    chunk_sender cs;
+    chunk_reassembler cr;
+    std::vector<buffer_ptr> sent;
+    const uint64_t stream = cs.start(comm_id(1), msg);
+
+    for (std::auto_ptr<e::buffer> c = cs.next(comm_id(1), stream);
+            c.get(); c = cs.next(comm_id(1), stream))
+    {
+        sent.push_back(buffer_ptr(c.release()));
+    }
+
+    ASSERT_EQ(sent.size(), size_t(CONSUS_CHUNK_WINDOW));
+    std::auto_ptr<e::buffer> out;
+    bool done = false;
+
+    // the receiver acknowledges each chunk, which releases the next
+    for (size_t i = 0; i < sent.size(); ++i)
+    {
+        done = feed(&cr, comm_id(1), *sent[i], &out);
+        std::auto_ptr<e::buffer> ack(consus::make_chunk_ack(past_type(*sent[i])));
+        ASSERT_TRUE(ack.get() != NULL);
+        std::auto_ptr<e::buffer> c(cs.acknowledged(comm_id(1), past_type(*ack)));
+
+        if (c.get())
+        {
+            sent.push_back(buffer_ptr(c.release()));
+        }
+    }
+
+    ASSERT_EQ(sent.size(), expected);
+    ASSERT_TRUE(done);
+    ASSERT_TRUE(same(*out, *orig));
+    ASSERT_EQ(cs.pending_streams(), 0U);
+}
+
+TEST(ChunkSender, AcksFromElsewhere)
+{
+    chunk_sender cs;
+    const uint64_t stream = cs.start(comm_id(1), make_msg(LARGE));
+
+    while (cs.next(comm_id(1), stream).get())
+        ;
+
+    // another peer acknowledging the same stream id frees nothing
+    std::auto_ptr<e::buffer> chunk(consus::make_chunk(stream, *make_msg(LARGE), 0));
+    std::auto_ptr<e::buffer> ack(consus::make_chunk_ack(past_type(*chunk)));
+    ASSERT_TRUE(cs.acknowledged(comm_id(2), past_type(*ack)).get() == NULL);
+    ASSERT_TRUE(cs.acknowledged(comm_id(1), past_type(*ack)).get() != NULL);
+    cs.forget(comm_id(1));
+    ASSERT_EQ(cs.pending_streams(), 0U);
+}
+
+TEST(ChunkSender, SendChunked)
+{
+    fake_busybee bb;
+    chunk_sender cs;
+    ASSERT_EQ(consus::send_chunked(&bb, 1, &cs, make_msg(100)), BUSYBEE_SUCCESS);
+    ASSERT_EQ(bb.sent.size(), 1U);
+    ASSERT_EQ(consus::send_chunked(&bb, 1, &cs, make_msg(LARGE)), BUSYBEE_SUCCESS);
+    ASSERT_EQ(bb.sent.size(), size_t(1 + CONSUS_CHUNK_WINDOW));
+    ASSERT_EQ(cs.pending_streams(), 1U);
+
+    // a small message sent now is not queued behind the rest of the stream
+    ASSERT_EQ(consus::send_chunked(&bb, 1, &cs, make_msg(100)), BUSYBEE_SUCCESS);
+    ASSERT_EQ(bb.sent.size(), size_t(2 + CONSUS_CHUNK_WINDOW));
+    cs.expire(po6::monotonic_time() + 1);
+    ASSERT_EQ(cs.pending_streams(), 0U);
+}
+
+TEST(ChunkSender, Relay)
+{
+    std::auto_ptr<e::buffer> msg(make_msg(LARGE));
+    std::vector<buffer_ptr> chunks(chunks_of(1, *msg));
+    chunk_reassembler relay;
+    std::auto_ptr<chunk_list> pieces;
+
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        collect(&relay, comm_id(1), *chunks[i], &pieces);
+    }
+
+    ASSERT_TRUE(pieces.get() != NULL);
+    e::compat::shared_ptr<const chunk_list> shared(pieces.release());
+
+    // the relay rewrites the leading bytes and leaves the rest as it came
+    const char prefix[] = "relayed";
+    const size_t prefix_sz = sizeof(prefix) - 1;
+    memmove(msg->data() + BUSYBEE_HEADER_SIZE, prefix, prefix_sz);
+
+    // two receivers share the chunks without either copying them
+    for (uint64_t to = 2; to <= 3; ++to)
+    {
+        fake_busybee bb;
+        chunk_sender cs;
+        chunk_reassembler cr;
+        ASSERT_EQ(consus::send_chunked(&bb, to, &cs, shared, e::slice(prefix, prefix_sz)), BUSYBEE_SUCCESS);
+        ASSERT_EQ(bb.sent.size(), size_t(CONSUS_CHUNK_WINDOW));
+        std::auto_ptr<e::buffer> out;
+        bool done = false;
+
+        for (size_t i = 0; i < bb.sent.size(); ++i)
+        {
+            done = feed(&cr, comm_id(1), *bb.sent[i], &out);
+            std::auto_ptr<e::buffer> ack(consus::make_chunk_ack(past_type(*bb.sent[i])));
+            std::auto_ptr<e::buffer> c(cs.acknowledged(comm_id(to), past_type(*ack)));
+
+            if (c.get())
+            {
+                bb.sent.push_back(buffer_ptr(c.release()));
+            }
+        }
+
+        ASSERT_EQ(bb.sent.size(), chunks.size());
+        ASSERT_TRUE(done);
+        ASSERT_TRUE(same(*out, *msg));
+        ASSERT_EQ(cs.pending_streams(), 0U);
+    }
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdlib.h>
+
+// STL
+#include <vector>
+
+// consus
+#include "test/th.h"
+#include "common/crc32c.h"
+
+using consus::crc32c;
+using consus::crc32c_portable;
+
+TEST(CRC32C, KnownValue)
+{
+    const char* digits = "123456789";
+    const unsigned char* d = reinterpret_cast<const unsigned char*>(digits);
+    ASSERT_EQ(crc32c(0, d, 9), 0xE3069283U);
+    ASSERT_EQ(crc32c_portable(0, d, 9), 0xE3069283U);
+}
+
+// walks every length through the byte-at-a-time, quad, and three-way paths,
+// at every alignment, and compares against the portable implementation
+TEST(CRC32C, MatchesPortable)
+{
+    std::vector<unsigned char> buf(3 * 3 * 4096 + 3 * 256 + 64);
+    srand(0x1EDC6F41);
+
+    for (size_t i = 0; i < buf.size(); ++i)
+    {
+        buf[i] = rand();
+    }
+
+    for (size_t align = 0; align < 8; ++align)
+    {
+        for (size_t n = 0; n + align <= buf.size(); n += (n < 1024 ? 1 : 61))
+        {
+            const unsigned char* d = &buf[0] + align;
+            ASSERT_EQ(crc32c(0, d, n), crc32c_portable(0, d, n));
+            ASSERT_EQ(crc32c(0xDEADBEEF, d, n), crc32c_portable(0xDEADBEEF, d, n));
+        }
+    }
+}
+
+TEST(CRC32C, Incremental)
+{
+    std::vector<unsigned char> buf(2 * 3 * 4096 + 17);
+
+    for (size_t i = 0; i < buf.size(); ++i)
+    {
+        buf[i] = i * 7 + 3;
+    }
+
+    const uint32_t whole = crc32c(0, &buf[0], buf.size());
+
+    for (size_t split = 0; split <= buf.size(); split += 509)
+    {
+        uint32_t crc = crc32c(0, &buf[0], split);
+        crc = crc32c(crc, &buf[0] + split, buf.size() - split);
+        ASSERT_EQ(crc, whole);
+    }
+}
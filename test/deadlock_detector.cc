@@ -0,0 +1,147 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <vector>
+
+// consus
+#include <consus.h>
+#include "test/th.h"
+#include "txman/deadlock_detector.h"
+
+using consus::deadlock_detector;
+using consus::paxos_group_id;
+using consus::transaction_group;
+using consus::transaction_id;
+
+namespace
+{
+
+// lower numbers are older and so preempt higher ones
+transaction_group
+xact(uint64_t number)
+{
+    paxos_group_id g(1);
+    return transaction_group(g, transaction_id(g, CONSUS_PRIORITY_NORMAL, 1000, number));
+}
+
+const uint64_t INTERVAL = 10;
+const uint64_t TIMEOUT = 100;
+
+} // namespace
+
+TEST(DeadlockDetector, NewAndChangedEdges)
+{
+    deadlock_detector dd;
+    // only a new edge, or one whose holder changed, warrants a probe
+    ASSERT_TRUE(dd.wait_for(1, xact(1), xact(2), 0));
+    ASSERT_FALSE(dd.wait_for(1, xact(1), xact(2), 5));
+    ASSERT_TRUE(dd.wait_for(1, xact(1), xact(3), 6));
+    ASSERT_FALSE(dd.wait_for(1, xact(1), xact(3), 7));
+    ASSERT_TRUE(dd.wait_for(2, xact(1), xact(3), 8));
+}
+
+TEST(DeadlockDetector, HoldersAreDistinct)
+{
+    deadlock_detector dd;
+    // three members of the waiter's group report the same wait
+    dd.wait_for(1, xact(1), xact(2), 0);
+    dd.wait_for(2, xact(1), xact(2), 0);
+    dd.wait_for(3, xact(1), xact(2), 0);
+    dd.wait_for(4, xact(1), xact(3), 0);
+    dd.wait_for(5, xact(4), xact(5), 0);
+    std::vector<transaction_group> holders;
+    dd.holders_of(xact(1), &holders);
+    ASSERT_EQ(holders.size(), 2U);
+    ASSERT_TRUE(holders[0] == xact(2));
+    ASSERT_TRUE(holders[1] == xact(3));
+
+    dd.forget(4);
+    holders.clear();
+    dd.holders_of(xact(1), &holders);
+    ASSERT_EQ(holders.size(), 1U);
+    holders.clear();
+    dd.holders_of(xact(2), &holders);
+    ASSERT_EQ(holders.size(), 0U);
+}
+
+TEST(DeadlockDetector, ProbesForwardOnce)
+{
+    deadlock_detector dd;
+    ASSERT_TRUE(dd.first_visit(xact(1), 7, 0));
+    ASSERT_FALSE(dd.first_visit(xact(1), 7, 1));
+    ASSERT_TRUE(dd.first_visit(xact(1), 8, 1));
+    ASSERT_TRUE(dd.first_visit(xact(2), 7, 1));
+    ASSERT_EQ(dd.probes_seen(), 3U);
+
+    // the record of a probe lasts as long as the timeout
+    std::vector<deadlock_detector::edge> wound;
+    dd.periodic(TIMEOUT, INTERVAL, TIMEOUT, &wound);
+    ASSERT_EQ(dd.probes_seen(), 2U);
+    ASSERT_FALSE(dd.first_visit(xact(1), 8, TIMEOUT));
+    dd.periodic(TIMEOUT + 1, INTERVAL, TIMEOUT, &wound);
+    ASSERT_EQ(dd.probes_seen(), 0U);
+    ASSERT_TRUE(dd.first_visit(xact(1), 7, TIMEOUT + 2));
+}
+
+TEST(DeadlockDetector, WoundAfterTimeout)
+{
+    deadlock_detector dd;
+    // old waits for young, and young waits for old
+    dd.wait_for(1, xact(1), xact(2), 0);
+    dd.wait_for(2, xact(2), xact(1), 0);
+    std::vector<deadlock_detector::edge> wound;
+
+    dd.periodic(TIMEOUT - 1, INTERVAL, TIMEOUT, &wound);
+    ASSERT_EQ(wound.size(), 0U);
+
+    // only the older waiter wounds, breaking the cycle from one side
+    dd.periodic(TIMEOUT, INTERVAL, TIMEOUT, &wound);
+    ASSERT_EQ(wound.size(), 1U);
+    ASSERT_TRUE(wound[0].waiter == xact(1));
+    ASSERT_TRUE(wound[0].holder == xact(2));
+
+    // and no more often than once per interval
+    wound.clear();
+    dd.periodic(TIMEOUT + INTERVAL - 1, INTERVAL, TIMEOUT, &wound);
+    ASSERT_EQ(wound.size(), 0U);
+    dd.periodic(TIMEOUT + INTERVAL, INTERVAL, TIMEOUT, &wound);
+    ASSERT_EQ(wound.size(), 1U);
+}
+
+TEST(DeadlockDetector, ChangedHolderRestartsWait)
+{
+    deadlock_detector dd;
+    dd.wait_for(1, xact(1), xact(2), 0);
+    dd.wait_for(1, xact(1), xact(3), TIMEOUT - 1);
+    std::vector<deadlock_detector::edge> wound;
+    dd.periodic(TIMEOUT, INTERVAL, TIMEOUT, &wound);
+    ASSERT_EQ(wound.size(), 0U);
+    dd.periodic(2 * TIMEOUT - 1, INTERVAL, TIMEOUT, &wound);
+    ASSERT_EQ(wound.size(), 1U);
+    ASSERT_TRUE(wound[0].holder == xact(3));
+}
@@ -0,0 +1,198 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <map>
+#include <vector>
+
+// consus
+#include <consus.h>
+#include "test/th.h"
+#include "txman/deferred_queue.h"
+
+using consus::deferral;
+using consus::deferred_queue;
+using consus::paxos_group_id;
+using consus::transaction_group;
+using consus::transaction_id;
+
+namespace
+{
+
+transaction_group
+xact(uint64_t number)
+{
+    paxos_group_id g(1);
+    return transaction_group(g, transaction_id(g, CONSUS_PRIORITY_NORMAL, 1000, number));
+}
+
+// an owner thread and its transactions, reduced to how they defer passes of
+// the state machine:  a pass may defer other transactions, or its own
+class owner
+{
+    public:
+        owner() : m_queue(), m_xacts() {}
+
+    public:
+        struct fake
+        {
+            fake() : deferred(), passes(0), defers() {}
+            deferral deferred;
+            unsigned passes;
+            // deferred by the next pass, which then forgets them
+            std::vector<uint64_t> defers;
+        };
+
+    public:
+        fake& operator [] (uint64_t number) { return m_xacts[number]; }
+        void defer_state_machine(uint64_t number)
+        {
+            if (m_xacts[number].deferred.defer())
+            {
+                m_queue.push(xact(number));
+            }
+        }
+        void work_state_machine(uint64_t number)
+        {
+            fake& f(m_xacts[number]);
+            f.deferred.start_pass();
+            ++f.passes;
+            std::vector<uint64_t> defers;
+            defers.swap(f.defers);
+
+            for (size_t i = 0; i < defers.size(); ++i)
+            {
+                defer_state_machine(defers[i]);
+            }
+        }
+        void run_deferred()
+        {
+            std::vector<transaction_group> tgs;
+
+            while (m_queue.next_batch(&tgs))
+            {
+                for (size_t i = 0; i < tgs.size(); ++i)
+                {
+                    const uint64_t number = tgs[i].txid.number;
+
+                    if (m_xacts[number].deferred.pending())
+                    {
+                        work_state_machine(number);
+                    }
+                }
+            }
+        }
+        bool idle() const { return m_queue.empty(); }
+
+    private:
+        deferred_queue m_queue;
+        std::map<uint64_t, fake> m_xacts;
+};
+
+} // namespace
+
+TEST(Deferral, OncePerPass)
+{
+    deferral d;
+    ASSERT_FALSE(d.pending());
+    ASSERT_TRUE(d.defer());
+    ASSERT_FALSE(d.defer());
+    ASSERT_FALSE(d.defer());
+    ASSERT_TRUE(d.pending());
+    d.start_pass();
+    ASSERT_FALSE(d.pending());
+    ASSERT_TRUE(d.defer());
+}
+
+TEST(DeferredQueue, BatchesInOrder)
+{
+    deferred_queue q;
+    std::vector<transaction_group> batch;
+    ASSERT_FALSE(q.next_batch(&batch));
+    q.push(xact(1));
+    q.push(xact(2));
+    ASSERT_TRUE(q.next_batch(&batch));
+    ASSERT_EQ(batch.size(), 2U);
+    ASSERT_TRUE(batch[0] == xact(1));
+    ASSERT_TRUE(batch[1] == xact(2));
+
+    // queued while the batch is worked; the batch itself does not change
+    q.push(xact(3));
+    ASSERT_EQ(batch.size(), 2U);
+    ASSERT_TRUE(q.next_batch(&batch));
+    ASSERT_EQ(batch.size(), 1U);
+    ASSERT_TRUE(batch[0] == xact(3));
+    ASSERT_FALSE(q.next_batch(&batch));
+    ASSERT_TRUE(batch.empty());
+}
+
+TEST(DeferredQueue, BurstIsOnePass)
+{
+    owner o;
+
+    for (unsigned i = 0; i < 10; ++i)
+    {
+        o.defer_state_machine(1);
+    }
+
+    o.run_deferred();
+    ASSERT_EQ(o[1].passes, 1U);
+    ASSERT_TRUE(o.idle());
+}
+
+TEST(DeferredQueue, DeferDuringPassRunsAgain)
+{
+    owner o;
+    // 1's pass defers 2 and itself; 2's pass defers 1 again
+    o[1].defers.push_back(2);
+    o[1].defers.push_back(1);
+    o[2].defers.push_back(1);
+    o.defer_state_machine(1);
+    o.run_deferred();
+    // 1 runs again after its own pass, once:  2's deferral of 1 finds the
+    // pass 1 queued for itself still pending
+    ASSERT_EQ(o[1].passes, 2U);
+    ASSERT_EQ(o[2].passes, 1U);
+    ASSERT_FALSE(o[1].deferred.pending());
+    ASSERT_FALSE(o[2].deferred.pending());
+    ASSERT_TRUE(o.idle());
+}
+
+TEST(DeferredQueue, SkipsWhenWorkedDirectly)
+{
+    owner o;
+    o.defer_state_machine(1);
+    // e.g., a client message in the same batch works it on the spot
+    o.work_state_machine(1);
+    o.run_deferred();
+    ASSERT_EQ(o[1].passes, 1U);
+
+    // and deferring again afterwards is not swallowed
+    o.defer_state_machine(1);
+    o.run_deferred();
+    ASSERT_EQ(o[1].passes, 2U);
+}
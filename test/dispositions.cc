@@ -0,0 +1,97 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// e
+#include <e/garbage_collector.h>
+
+// consus
+#include <consus.h>
+#include "test/th.h"
+#include "txman/dispositions.h"
+
+using consus::dispositions;
+using consus::paxos_group_id;
+using consus::transaction_group;
+using consus::transaction_id;
+
+namespace
+{
+
+transaction_group
+xact(uint64_t number)
+{
+    paxos_group_id g(1);
+    return transaction_group(g, transaction_id(g, CONSUS_PRIORITY_NORMAL, 1000, number));
+}
+
+} // namespace
+
+TEST(Dispositions, InheritOnce)
+{
+    e::garbage_collector gc;
+    e::garbage_collector::thread_state ts;
+    gc.register_thread(&ts);
+
+    {
+        dispositions d(&gc);
+        ASSERT_FALSE(d.has(xact(1)));
+        ASSERT_FALSE(d.inherit(xact(1)));
+        d.abort(xact(1));
+        ASSERT_TRUE(d.has(xact(1)));
+
+        // one restart takes the start; every later one starts afresh
+        ASSERT_TRUE(d.inherit(xact(1)));
+        ASSERT_FALSE(d.inherit(xact(1)));
+        ASSERT_FALSE(d.inherit(xact(1)));
+        ASSERT_TRUE(d.has(xact(1)));
+
+        // nor does recording the abort again reopen it
+        d.abort(xact(1));
+        ASSERT_FALSE(d.inherit(xact(1)));
+    }
+
+    gc.deregister_thread(&ts);
+}
+
+TEST(Dispositions, CommittedNeverInherits)
+{
+    e::garbage_collector gc;
+    e::garbage_collector::thread_state ts;
+    gc.register_thread(&ts);
+
+    {
+        dispositions d(&gc);
+        d.commit(xact(1));
+        ASSERT_TRUE(d.has(xact(1)));
+        ASSERT_FALSE(d.inherit(xact(1)));
+        d.abort(xact(2));
+        ASSERT_FALSE(d.inherit(xact(3)));
+        ASSERT_TRUE(d.inherit(xact(2)));
+    }
+
+    gc.deregister_thread(&ts);
+}
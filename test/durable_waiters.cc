@@ -0,0 +1,370 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <stdint.h>
+#include <sched.h>
+
+// STL
+#include <vector>
+
+// po6
+#include <po6/threads/thread.h>
+#include <po6/time.h>
+
+// e
+#include <e/atomic.h>
+#include <e/compat.h>
+
+// consus
+#include "test/th.h"
+#include "txman/durable_waiters.h"
+
+using consus::comm_id;
+using consus::durable_waiters;
+using consus::paxos_group_id;
+using consus::transaction_group;
+using consus::transaction_id;
+
+namespace
+{
+
+durable_waiters::waiter*
+waiter(int64_t recno, uint64_t seqno = 0)
+{
+    return new durable_waiters::waiter(recno, transaction_group(), seqno);
+}
+
+void
+release(std::vector<durable_waiters::waiter*>* ws)
+{
+    for (size_t i = 0; i < ws->size(); ++i)
+    {
+        delete (*ws)[i];
+    }
+
+    ws->clear();
+}
+
+// producers take consecutive record numbers, as appends to the log do, and
+// push a waiter for each; pushed[r] is set once record r's waiter is in
+struct producers
+{
+    static const uint64_t PER_THREAD = 20000;
+
+    producers(size_t threads)
+        : waiters(), total(threads * PER_THREAD), next(0), pushed(total, 0) {}
+
+    void run()
+    {
+        for (uint64_t i = 0; i < PER_THREAD; ++i)
+        {
+            const uint64_t recno = e::atomic::increment_64_fullbarrier(&next, 1) - 1;
+            waiters.push(waiter(recno));
+            e::atomic::store_64_release(&pushed[recno], 1);
+        }
+    }
+
+    durable_waiters waiters;
+    const uint64_t total;
+    uint64_t next;
+    std::vector<uint64_t> pushed;
+
+    private:
+        producers(const producers&);
+        producers& operator = (const producers&);
+};
+
+const size_t THREADS = 4;
+
+void
+start(producers* p, std::vector<e::compat::shared_ptr<po6::threads::thread> >* threads)
+{
+    for (size_t i = 0; i < THREADS; ++i)
+    {
+        e::compat::shared_ptr<po6::threads::thread> t(new po6::threads::thread(po6::threads::make_obj_func(&producers::run, p)));
+        threads->push_back(t);
+        t->start();
+    }
+}
+
+void
+join(std::vector<e::compat::shared_ptr<po6::threads::thread> >* threads)
+{
+    for (size_t i = 0; i < threads->size(); ++i)
+    {
+        (*threads)[i]->join();
+    }
+}
+
+// each producer appends a record and pushes its waiter, then checks the
+// published bound and wakes the monitor if the record is already durable, as
+// the daemon's send_when_durable and callback_when_durable do
+struct appenders
+{
+    static const uint64_t PER_THREAD = 20000;
+
+    appenders(size_t threads)
+        : waiters(), total(threads * PER_THREAD), appended(0), bound(0), wakes(0) {}
+
+    void run()
+    {
+        for (uint64_t i = 0; i < PER_THREAD; ++i)
+        {
+            const uint64_t recno = e::atomic::increment_64_fullbarrier(&appended, 1) - 1;
+            waiters.push(waiter(recno));
+
+            if (recno < e::atomic::load_64_acquire(&bound))
+            {
+                e::atomic::increment_64_fullbarrier(&wakes, 1);
+            }
+        }
+    }
+
+    durable_waiters waiters;
+    const uint64_t total;
+    uint64_t appended;
+    uint64_t bound;
+    uint64_t wakes;
+
+    private:
+        appenders(const appenders&);
+        appenders& operator = (const appenders&);
+};
+
+} // namespace
+
+TEST(DurableWaiters, DrainBelowBound)
+{
+    durable_waiters dw;
+    const int64_t recnos[] = {7, 3, 12, 0, 5, 3, 9};
+
+    for (size_t i = 0; i < sizeof(recnos) / sizeof(recnos[0]); ++i)
+    {
+        dw.push(waiter(recnos[i], i));
+    }
+
+    std::vector<durable_waiters::waiter*> ready;
+    dw.drain(0, &ready);
+    ASSERT_TRUE(ready.empty());
+
+    dw.drain(6, &ready);
+    ASSERT_EQ(ready.size(), 4U);
+    ASSERT_EQ(ready[0]->recno, 0);
+    ASSERT_EQ(ready[1]->recno, 3);
+    ASSERT_EQ(ready[2]->recno, 3);
+    ASSERT_EQ(ready[3]->recno, 5);
+    release(&ready);
+
+    // the held waiters merge with new ones in log order
+    dw.push(waiter(8));
+    dw.push(waiter(20));
+    dw.drain(13, &ready);
+    ASSERT_EQ(ready.size(), 4U);
+    ASSERT_EQ(ready[0]->recno, 7);
+    ASSERT_EQ(ready[1]->recno, 8);
+    ASSERT_EQ(ready[2]->recno, 9);
+    ASSERT_EQ(ready[3]->recno, 12);
+    release(&ready);
+
+    // the destructor frees what is left
+    dw.push(waiter(30));
+}
+
+TEST(DurableWaiters, PushAfterDrain)
+{
+    durable_waiters dw;
+    std::vector<durable_waiters::waiter*> ready;
+
+    // the record became durable and the monitor drained before the waiter
+    // arrived; the next drain must still release it
+    dw.drain(10, &ready);
+    ASSERT_TRUE(ready.empty());
+    dw.push(waiter(4));
+    dw.drain(10, &ready);
+    ASSERT_EQ(ready.size(), 1U);
+    ASSERT_EQ(ready[0]->recno, 4);
+    release(&ready);
+}
+
+TEST(DurableWaiters, FoldCallbacks)
+{
+    paxos_group_id g(1);
+    const transaction_group a(g, transaction_id(g, 1, 1000, 1));
+    const transaction_group b(g, transaction_id(g, 1, 1000, 2));
+    durable_waiters dw;
+    dw.push(new durable_waiters::waiter(0, a, 3));
+    dw.push(new durable_waiters::waiter(1, b, 1));
+    dw.push(new durable_waiters::waiter(2, comm_id(7), e::buffer::create(1)));
+    dw.push(new durable_waiters::waiter(3, a, 1));
+    dw.push(new durable_waiters::waiter(4, b, 2));
+    dw.push(new durable_waiters::waiter(5, a, 4));
+    std::vector<durable_waiters::waiter*> ready;
+    dw.drain(6, &ready);
+    ASSERT_EQ(ready.size(), 6U);
+
+    // one callback per transaction, its seqnos in log order; the message is
+    // left for the caller
+    std::vector<durable_waiters::callback> cbs;
+    durable_waiters::fold_callbacks(ready, &cbs);
+    ASSERT_EQ(cbs.size(), 2U);
+    const size_t ia = cbs[0].tg == a ? 0 : 1;
+    const size_t ib = 1 - ia;
+    ASSERT_TRUE(cbs[ia].tg == a);
+    ASSERT_TRUE(cbs[ib].tg == b);
+    ASSERT_EQ(cbs[ia].seqnos.size(), 3U);
+    ASSERT_EQ(cbs[ia].seqnos[0], 3U);
+    ASSERT_EQ(cbs[ia].seqnos[1], 1U);
+    ASSERT_EQ(cbs[ia].seqnos[2], 4U);
+    ASSERT_EQ(cbs[ib].seqnos.size(), 2U);
+    ASSERT_EQ(cbs[ib].seqnos[0], 1U);
+    ASSERT_EQ(cbs[ib].seqnos[1], 2U);
+    release(&ready);
+}
+
+// the bound trails the pushes, as the log's durable bound trails the appends
+// whose waiters are already in; everything comes out once, in log order
+TEST(DurableWaiters, ConcurrentInOrder)
+{
+    producers p(THREADS);
+    std::vector<e::compat::shared_ptr<po6::threads::thread> > threads;
+    start(&p, &threads);
+    std::vector<durable_waiters::waiter*> ready;
+    uint64_t bound = 0;
+    uint64_t expect = 0;
+
+    while (expect < p.total)
+    {
+        while (bound < p.total && e::atomic::load_64_acquire(&p.pushed[bound]))
+        {
+            ++bound;
+        }
+
+        p.waiters.drain(bound, &ready);
+
+        for (size_t i = 0; i < ready.size(); ++i)
+        {
+            ASSERT_EQ(uint64_t(ready[i]->recno), expect);
+            ++expect;
+        }
+
+        release(&ready);
+    }
+
+    join(&threads);
+    p.waiters.drain(INT64_MAX, &ready);
+    ASSERT_TRUE(ready.empty());
+}
+
+// the bound runs ahead of the pushes, so waiters routinely arrive after the
+// drain that passed their record; none is released early and none is lost
+TEST(DurableWaiters, ConcurrentPushAfterDrain)
+{
+    producers p(THREADS);
+    std::vector<e::compat::shared_ptr<po6::threads::thread> > threads;
+    start(&p, &threads);
+    std::vector<durable_waiters::waiter*> ready;
+    std::vector<bool> seen(p.total, false);
+    uint64_t released = 0;
+    uint64_t early = 0;
+    uint64_t unordered = 0;
+
+    while (released < p.total)
+    {
+        const uint64_t bound = e::atomic::increment_64_fullbarrier(&p.next, 0);
+        p.waiters.drain(bound, &ready);
+
+        for (size_t i = 0; i < ready.size(); ++i)
+        {
+            const uint64_t recno = ready[i]->recno;
+            early += recno >= bound ? 1 : 0;
+            unordered += i > 0 && ready[i - 1]->recno > ready[i]->recno ? 1 : 0;
+
+            if (recno < p.total && !seen[recno])
+            {
+                seen[recno] = true;
+                ++released;
+            }
+        }
+
+        release(&ready);
+    }
+
+    join(&threads);
+    p.waiters.drain(INT64_MAX, &ready);
+    ASSERT_TRUE(ready.empty());
+    ASSERT_EQ(early, 0U);
+    ASSERT_EQ(unordered, 0U);
+    ASSERT_EQ(released, p.total);
+}
+
+// the monitor publishes the bound and drains while producers push and check
+// it; the monitor only looks again when the log advances or a producer wakes
+// it, so a waiter that neither side sees is stuck for good
+TEST(DurableWaiters, ConcurrentPublishAndDrain)
+{
+    appenders a(THREADS);
+    std::vector<e::compat::shared_ptr<po6::threads::thread> > threads;
+
+    for (size_t i = 0; i < THREADS; ++i)
+    {
+        e::compat::shared_ptr<po6::threads::thread> t(new po6::threads::thread(po6::threads::make_obj_func(&appenders::run, &a)));
+        threads.push_back(t);
+        t->start();
+    }
+
+    std::vector<durable_waiters::waiter*> ready;
+    uint64_t released = 0;
+    uint64_t bound = 0;
+    uint64_t wakes = 0;
+    uint64_t deadline = po6::monotonic_time() + 10 * PO6_SECONDS;
+
+    while (released < a.total && po6::monotonic_time() < deadline)
+    {
+        const uint64_t appended = e::atomic::load_64_acquire(&a.appended);
+        const uint64_t w = e::atomic::load_64_acquire(&a.wakes);
+
+        if (appended == bound && w == wakes)
+        {
+            sched_yield();
+            continue;
+        }
+
+        wakes = w;
+        bound = appended;
+        e::atomic::store_64_release(&a.bound, bound);
+        a.waiters.drain(bound, &ready);
+        released += ready.size();
+        release(&ready);
+        deadline = po6::monotonic_time() + 10 * PO6_SECONDS;
+    }
+
+    join(&threads);
+    ASSERT_EQ(released, a.total);
+}
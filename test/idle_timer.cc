@@ -0,0 +1,88 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <stdint.h>
+
+// consus
+#include "test/th.h"
+#include "txman/idle_timer.h"
+
+using consus::idle_timer;
+
+TEST(IdleTimer, DisabledWithoutTimeout)
+{
+    idle_timer it;
+    it.touch(1);
+    ASSERT_FALSE(it.expired(UINT64_MAX / 2));
+    it.tighten(0);
+    ASSERT_EQ(it.timeout(), 0U);
+    ASSERT_FALSE(it.expired(UINT64_MAX / 2));
+}
+
+TEST(IdleTimer, NotBeforeFirstActivity)
+{
+    idle_timer it;
+    it.set_timeout(100);
+    ASSERT_FALSE(it.expired(1000));
+    it.touch(1000);
+    ASSERT_FALSE(it.expired(1100));
+    ASSERT_TRUE(it.expired(1101));
+}
+
+TEST(IdleTimer, ActivityRestartsTheClock)
+{
+    idle_timer it;
+    it.set_timeout(100);
+    it.touch(1000);
+    ASSERT_FALSE(it.expired(1050));
+    it.touch(1050);
+    ASSERT_FALSE(it.expired(1101));
+    ASSERT_FALSE(it.expired(1150));
+    ASSERT_TRUE(it.expired(1151));
+}
+
+TEST(IdleTimer, TablesOnlyTighten)
+{
+    idle_timer it;
+    it.set_timeout(100);
+    it.tighten(200);
+    ASSERT_EQ(it.timeout(), 100U);
+    it.tighten(0);
+    ASSERT_EQ(it.timeout(), 100U);
+    it.tighten(50);
+    ASSERT_EQ(it.timeout(), 50U);
+    it.touch(1000);
+    ASSERT_TRUE(it.expired(1051));
+
+    // a table with a timeout enables one the transaction began without
+    idle_timer off;
+    off.tighten(75);
+    ASSERT_EQ(off.timeout(), 75U);
+}
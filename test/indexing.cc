@@ -0,0 +1,186 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// STL
+#include <string>
+#include <vector>
+
+// treadstone
+#include <treadstone.h>
+
+// consus
+#include "test/th.h"
+#include "txman/indexing.h"
+
+using consus::index_changes;
+using consus::index_extract;
+using consus::index_key;
+using consus::index_prefix;
+using consus::secondary_index;
+
+namespace
+{
+
+std::string
+binary(const char* json)
+{
+    unsigned char* bin = NULL;
+    size_t bin_sz = 0;
+    const int rc = treadstone_json_sz_to_binary(json, strlen(json), &bin, &bin_sz);
+    assert(rc >= 0);
+    std::string tmp(reinterpret_cast<const char*>(bin), bin_sz);
+    free(bin);
+    return tmp;
+}
+
+bool
+starts_with(const std::string& s, const std::string& prefix)
+{
+    return s.size() >= prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
+}
+
+} // namespace
+
+TEST(Indexing, PrefixGroupsValue)
+{
+    const std::string p(index_prefix("alice"));
+    ASSERT_TRUE(starts_with(index_key("alice", "k1"), p));
+    ASSERT_TRUE(starts_with(index_key("alice", "k2"), p));
+    ASSERT_NE(index_key("alice", "k1"), index_key("alice", "k2"));
+    ASSERT_NE(p, index_prefix("bob"));
+    ASSERT_EQ(p, index_prefix("alice"));
+}
+
+TEST(Indexing, PrefixIsNotAmbiguous)
+{
+    // the value is length-prefixed, so neither value's rows turn up in a
+    // scan for the other even when one value is a prefix of the other
+    const std::string p(index_prefix("ab"));
+    ASSERT_FALSE(starts_with(index_key("abc", ""), p));
+    ASSERT_FALSE(starts_with(index_key("ab", "c"), index_prefix("abc")));
+}
+
+TEST(Indexing, Extract)
+{
+    secondary_index si("users", "name");
+    const std::string doc(binary("{\"name\": \"alice\", \"age\": 30}"));
+    std::string value;
+    ASSERT_TRUE(index_extract(si, doc, &value));
+    ASSERT_EQ(value, binary("\"alice\""));
+
+    secondary_index age("users", "age");
+    ASSERT_TRUE(index_extract(age, doc, &value));
+    ASSERT_EQ(value, binary("30"));
+}
+
+TEST(Indexing, ExtractMissing)
+{
+    secondary_index si("users", "name");
+    std::string value("untouched");
+    ASSERT_FALSE(index_extract(si, e::slice(), &value));
+    ASSERT_FALSE(index_extract(si, binary("{\"age\": 30}"), &value));
+    ASSERT_FALSE(index_extract(si, binary("[1, 2, 3]"), &value));
+    ASSERT_FALSE(index_extract(si, e::slice("not a document"), &value));
+    ASSERT_EQ(value, "untouched");
+}
+
+TEST(Indexing, Changes)
+{
+    secondary_index si("users", "name");
+    const std::string alice(binary("{\"name\": \"alice\"}"));
+    const std::string bob(binary("{\"name\": \"bob\"}"));
+    const std::string nameless(binary("{\"age\": 30}"));
+    const std::string a(index_key(binary("\"alice\""), "k"));
+    const std::string b(index_key(binary("\"bob\""), "k"));
+
+    // insert
+    std::vector<std::string> tombstones;
+    std::vector<std::string> rows;
+    index_changes(si, "k", e::slice(), alice, &tombstones, &rows);
+    ASSERT_EQ(tombstones.size(), 0U);
+    ASSERT_EQ(rows.size(), 1U);
+    ASSERT_EQ(rows[0], a);
+
+    // update
+    tombstones.clear();
+    rows.clear();
+    index_changes(si, "k", alice, bob, &tombstones, &rows);
+    ASSERT_EQ(tombstones.size(), 1U);
+    ASSERT_EQ(tombstones[0], a);
+    ASSERT_EQ(rows.size(), 1U);
+    ASSERT_EQ(rows[0], b);
+
+    // unchanged
+    tombstones.clear();
+    rows.clear();
+    index_changes(si, "k", alice, alice, &tombstones, &rows);
+    ASSERT_EQ(tombstones.size(), 0U);
+    ASSERT_EQ(rows.size(), 1U);
+
+    // the field goes away
+    tombstones.clear();
+    rows.clear();
+    index_changes(si, "k", bob, nameless, &tombstones, &rows);
+    ASSERT_EQ(tombstones.size(), 1U);
+    ASSERT_EQ(tombstones[0], b);
+    ASSERT_EQ(rows.size(), 0U);
+}
+
+TEST(Indexing, RepeatedWritesInOneTransaction)
+{
+    // a transaction writes k three times: the committed alice, then bob, then
+    // carol; all writes share one timestamp
+    secondary_index si("users", "name");
+    const std::string alice(binary("{\"name\": \"alice\"}"));
+    const std::string bob(binary("{\"name\": \"bob\"}"));
+    const std::string carol(binary("{\"name\": \"carol\"}"));
+    const std::string b(index_key(binary("\"bob\""), "k"));
+
+    // diffing each write against the one before it would both write and
+    // tombstone bob's row at that one timestamp
+    std::vector<std::string> tombstones;
+    std::vector<std::string> rows;
+    index_changes(si, "k", alice, bob, &tombstones, &rows);
+    index_changes(si, "k", bob, carol, &tombstones, &rows);
+    ASSERT_EQ(rows[0], b);
+    ASSERT_EQ(tombstones[1], b);
+
+    // so only the last write diffs, against the committed document: alice's
+    // row is retired, carol's is written, and bob never appears
+    tombstones.clear();
+    rows.clear();
+    index_changes(si, "k", alice, carol, &tombstones, &rows);
+    ASSERT_EQ(tombstones.size(), 1U);
+    ASSERT_EQ(tombstones[0], index_key(binary("\"alice\""), "k"));
+    ASSERT_EQ(rows.size(), 1U);
+    ASSERT_EQ(rows[0], index_key(binary("\"carol\""), "k"));
+}
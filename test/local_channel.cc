@@ -0,0 +1,249 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// C
+#include <stdint.h>
+#include <string.h>
+
+// POSIX
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// BusyBee
+#include <busybee.h>
+
+// consus
+#include "test/th.h"
+#include "common/local_channel.h"
+
+#ifdef CONSUS_LOCAL_CHANNEL
+
+using consus::local_channel;
+
+static std::auto_ptr<e::buffer>
+make_msg(uint32_t tag, size_t sz)
+{
+    std::auto_ptr<e::buffer> msg(e::buffer::create(BUSYBEE_HEADER_SIZE + sz));
+    msg->resize(BUSYBEE_HEADER_SIZE + sz);
+    memset(msg->data() + BUSYBEE_HEADER_SIZE, tag & 0xff, sz);
+    memmove(msg->data() + BUSYBEE_HEADER_SIZE, &tag, sizeof(tag));
+    return msg;
+}
+
+static uint32_t
+msg_tag(const e::buffer& msg)
+{
+    uint32_t tag;
+    memmove(&tag, msg.data() + BUSYBEE_HEADER_SIZE, sizeof(tag));
+    return tag;
+}
+
+static local_channel*
+client_half(local_channel* server)
+{
+    int fds[local_channel::DESCRIPTORS];
+    server->descriptors(fds);
+
+    for (size_t i = 0; i < local_channel::DESCRIPTORS; ++i)
+    {
+        fds[i] = dup(fds[i]);
+    }
+
+    return local_channel::attach(fds);
+}
+
+TEST(LocalChannel, RoundTrip)
+{
+    std::auto_ptr<local_channel> server(local_channel::create());
+    ASSERT_TRUE(server.get() != NULL);
+    std::auto_ptr<local_channel> client(client_half(server.get()));
+    ASSERT_TRUE(client.get() != NULL);
+    std::auto_ptr<e::buffer> msg;
+    ASSERT_FALSE(server->recv(&msg));
+
+    ASSERT_TRUE(client->send(make_msg(1, 64)));
+    ASSERT_TRUE(client->send(make_msg(2, 4)));
+    ASSERT_TRUE(server->recv(&msg));
+    ASSERT_EQ(msg_tag(*msg), 1U);
+    ASSERT_EQ(msg->size(), size_t(BUSYBEE_HEADER_SIZE + 64));
+    ASSERT_TRUE(server->recv(&msg));
+    ASSERT_EQ(msg_tag(*msg), 2U);
+    ASSERT_FALSE(server->recv(&msg));
+
+    ASSERT_TRUE(server->send(make_msg(3, 100)));
+    ASSERT_TRUE(client->recv(&msg));
+    ASSERT_EQ(msg_tag(*msg), 3U);
+}
+
+// a side that waits hears about the next message, and only then
+TEST(LocalChannel, BellRingsForSleeper)
+{
+    std::auto_ptr<local_channel> server(local_channel::create());
+    std::auto_ptr<local_channel> client(client_half(server.get()));
+    uint64_t count;
+    ASSERT_TRUE(client->send(make_msg(1, 8)));
+    ASSERT_LT(read(server->bell(), &count, sizeof(count)), 0);
+    ASSERT_FALSE(server->prepare_to_wait());
+    std::auto_ptr<e::buffer> msg;
+    ASSERT_TRUE(server->recv(&msg));
+    ASSERT_TRUE(server->prepare_to_wait());
+    ASSERT_TRUE(client->send(make_msg(2, 8)));
+    ASSERT_EQ(read(server->bell(), &count, sizeof(count)), ssize_t(sizeof(count)));
+    ASSERT_TRUE(client->send(make_msg(3, 8)));
+    ASSERT_LT(read(server->bell(), &count, sizeof(count)), 0);
+}
+
+// messages wrap around the ring and back up behind a slow reader in order
+TEST(LocalChannel, BacklogKeepsOrder)
+{
+    std::auto_ptr<local_channel> server(local_channel::create());
+    std::auto_ptr<local_channel> client(client_half(server.get()));
+    const uint32_t count = 200;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        ASSERT_TRUE(client->send(make_msg(i, 100000 + i * 997)));
+    }
+
+    ASSERT_TRUE(client->backlogged());
+    std::auto_ptr<e::buffer> msg;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        while (!server->recv(&msg))
+        {
+            client->flush();
+        }
+
+        ASSERT_EQ(msg_tag(*msg), i);
+        ASSERT_EQ(msg->size(), size_t(BUSYBEE_HEADER_SIZE + 100000 + i * 997));
+        ASSERT_EQ(unsigned(msg->data()[msg->size() - 1]), i & 0xffU);
+    }
+
+    ASSERT_TRUE(client->flush());
+    ASSERT_FALSE(client->backlogged());
+}
+
+TEST(LocalChannel, RefusesOversized)
+{
+    std::auto_ptr<local_channel> server(local_channel::create());
+    ASSERT_FALSE(server->send(make_msg(0, 8 << 20)));
+    ASSERT_FALSE(server->backlogged());
+}
+
+TEST(LocalChannel, PassDescriptors)
+{
+    int sv[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    std::auto_ptr<local_channel> server(local_channel::create());
+    int fds[local_channel::DESCRIPTORS];
+    server->descriptors(fds);
+    ASSERT_TRUE(local_channel::send_descriptors(sv[0], fds));
+    ASSERT_TRUE(local_channel::recv_descriptors(sv[1], fds));
+    std::auto_ptr<local_channel> client(local_channel::attach(fds));
+    ASSERT_TRUE(client.get() != NULL);
+    ASSERT_TRUE(server->send(make_msg(7, 16)));
+    std::auto_ptr<e::buffer> msg;
+    ASSERT_TRUE(client->recv(&msg));
+    ASSERT_EQ(msg_tag(*msg), 7U);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+// the client-to-server ring leads the mapping:  head and flag on one cache
+// line, tail and flag on the next, then the data
+static unsigned char*
+client_ring(local_channel* server)
+{
+    int fds[local_channel::DESCRIPTORS];
+    server->descriptors(fds);
+    void* base = mmap(NULL, 128 + sizeof(uint32_t), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    return base == MAP_FAILED ? NULL : static_cast<unsigned char*>(base);
+}
+
+TEST(LocalChannel, OversizedFrameBreaks)
+{
+    std::auto_ptr<local_channel> server(local_channel::create());
+    std::auto_ptr<local_channel> client(client_half(server.get()));
+    ASSERT_TRUE(client->send(make_msg(1, 8)));
+    unsigned char* ring = client_ring(server.get());
+    ASSERT_TRUE(ring != NULL);
+    const uint32_t len = 0x7fffffffU;
+    memmove(ring + 128, &len, sizeof(len));
+    std::auto_ptr<e::buffer> msg;
+    ASSERT_FALSE(server->recv(&msg));
+    ASSERT_TRUE(server->broken());
+    ASSERT_FALSE(server->send(make_msg(2, 8)));
+    munmap(ring, 128 + sizeof(uint32_t));
+}
+
+TEST(LocalChannel, RunawayTailBreaks)
+{
+    std::auto_ptr<local_channel> server(local_channel::create());
+    unsigned char* ring = client_ring(server.get());
+    ASSERT_TRUE(ring != NULL);
+    const uint64_t tail = 1ULL << 40;
+    memmove(ring + 64, &tail, sizeof(tail));
+    std::auto_ptr<e::buffer> msg;
+    ASSERT_FALSE(server->recv(&msg));
+    ASSERT_TRUE(server->broken());
+    munmap(ring, 128 + sizeof(uint32_t));
+}
+
+#ifdef HAVE_MEMFD_CREATE
+TEST(LocalChannel, SealedAgainstResizing)
+{
+    std::auto_ptr<local_channel> server(local_channel::create());
+    int fds[local_channel::DESCRIPTORS];
+    server->descriptors(fds);
+    ASSERT_LT(ftruncate(fds[0], 4096), 0);
+}
+#endif
+
+// a peer that stops reading gets hung up on rather than queued for forever
+TEST(LocalChannel, BacklogIsBounded)
+{
+    std::auto_ptr<local_channel> server(local_channel::create());
+    std::auto_ptr<local_channel> client(client_half(server.get()));
+    unsigned sent = 0;
+
+    while (server->send(make_msg(sent, 1 << 20)))
+    {
+        ++sent;
+        ASSERT_LT(sent, 128U);
+    }
+
+    ASSERT_GT(sent, 64U);
+    ASSERT_FALSE(server->broken());
+}
+
+#endif // CONSUS_LOCAL_CHANNEL
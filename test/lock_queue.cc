@@ -0,0 +1,152 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <vector>
+
+// consus
+#include <consus.h>
+#include "test/th.h"
+#include "kvs/lock_queue.h"
+
+using consus::comm_id;
+using consus::lock_queue;
+using consus::paxos_group_id;
+using consus::transaction_group;
+using consus::transaction_id;
+
+namespace
+{
+
+// lower numbers are older and so are granted the lock sooner
+transaction_group
+xact(uint64_t number, uint8_t priority = CONSUS_PRIORITY_NORMAL)
+{
+    paxos_group_id g(1);
+    return transaction_group(g, transaction_id(g, priority, 1000, number));
+}
+
+// queue a request that is expected to be acknowledged and to replace no one
+size_t
+enqueue(lock_queue* q, uint64_t id, uint64_t nonce, const transaction_group& tg)
+{
+    size_t position = 0;
+    lock_queue::request superseded;
+    const bool ack = q->enqueue(comm_id(id), nonce, tg, &position, &superseded);
+    return ack && superseded.tg == transaction_group() ? position : size_t(-1);
+}
+
+} // namespace
+
+TEST(LockQueue, PositionsFollowSeniority)
+{
+    lock_queue q;
+    // the first request holds the lock, however junior it is
+    ASSERT_EQ(enqueue(&q, 1, 1, xact(9)), 0U);
+    ASSERT_EQ(enqueue(&q, 2, 1, xact(5)), 1U);
+    ASSERT_EQ(enqueue(&q, 3, 1, xact(7)), 2U);
+    // more senior waiters go ahead of junior ones, never of the holder
+    ASSERT_EQ(enqueue(&q, 4, 1, xact(3)), 1U);
+    ASSERT_EQ(enqueue(&q, 5, 1, xact(8, CONSUS_PRIORITY_INTERACTIVE)), 1U);
+    ASSERT_EQ(q.size(), 5U);
+
+    std::vector<lock_queue::request> ws;
+    q.waiters(&ws);
+    ASSERT_EQ(ws.size(), 4U);
+    ASSERT_TRUE(ws[0].tg == xact(8, CONSUS_PRIORITY_INTERACTIVE));
+    ASSERT_TRUE(ws[1].tg == xact(3));
+    ASSERT_TRUE(ws[2].tg == xact(5));
+    ASSERT_TRUE(ws[3].tg == xact(7));
+    ASSERT_TRUE(q.front().tg == xact(9));
+}
+
+TEST(LockQueue, RetransmissionIsReacknowledged)
+{
+    lock_queue q;
+    enqueue(&q, 1, 1, xact(1));
+    enqueue(&q, 2, 7, xact(4));
+    enqueue(&q, 3, 1, xact(2));
+
+    // the same requester asking again, perhaps from a new connection, hears
+    // its current position and changes nothing else
+    ASSERT_EQ(enqueue(&q, 9, 7, xact(4)), 2U);
+    ASSERT_EQ(q.size(), 3U);
+    lock_queue::request r;
+    ASSERT_TRUE(q.remove(xact(4), &r));
+    ASSERT_EQ(r.id, comm_id(9));
+    ASSERT_EQ(r.nonce, 7U);
+    ASSERT_FALSE(q.remove(xact(4), &r));
+}
+
+TEST(LockQueue, LowerNonceTakesOver)
+{
+    lock_queue q;
+    enqueue(&q, 1, 1, xact(1));
+    enqueue(&q, 2, 7, xact(4));
+
+    // a lower nonce replaces the queued requester, which is told to stop
+    size_t position = 0;
+    lock_queue::request superseded;
+    ASSERT_TRUE(q.enqueue(comm_id(3), 5, xact(4), &position, &superseded));
+    ASSERT_EQ(position, 1U);
+    ASSERT_EQ(superseded.id, comm_id(2));
+    ASSERT_EQ(superseded.nonce, 7U);
+
+    // a higher nonce is the one that stops
+    ASSERT_FALSE(q.enqueue(comm_id(4), 6, xact(4), &position, &superseded));
+    ASSERT_TRUE(superseded.tg == transaction_group());
+    ASSERT_EQ(q.size(), 2U);
+
+    lock_queue::request next;
+    ASSERT_TRUE(q.next(&next));
+    ASSERT_EQ(next.id, comm_id(3));
+    ASSERT_EQ(next.nonce, 5U);
+}
+
+TEST(LockQueue, HandOff)
+{
+    lock_queue q;
+    lock_queue::request next;
+    ASSERT_FALSE(q.next(&next));
+
+    // a holder restored from disk has no requester to answer
+    q.restore(xact(6));
+    ASSERT_FALSE(q.next(&next));
+    ASSERT_EQ(q.front().id, comm_id());
+    ASSERT_EQ(enqueue(&q, 1, 1, xact(8)), 1U);
+    ASSERT_EQ(enqueue(&q, 2, 1, xact(7)), 1U);
+
+    ASSERT_TRUE(q.next(&next));
+    ASSERT_TRUE(next.tg == xact(7));
+    q.pop_front();
+    ASSERT_TRUE(q.front().tg == xact(7));
+    // the remaining waiter moved up
+    ASSERT_EQ(enqueue(&q, 1, 1, xact(8)), 1U);
+    q.pop_front();
+    q.pop_front();
+    ASSERT_TRUE(q.empty());
+}
@@ -0,0 +1,157 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <string.h>
+
+// STL
+#include <vector>
+
+// e
+#include <e/compat.h>
+
+// BusyBee
+#include <busybee.h>
+
+// consus
+#include "test/th.h"
+#include "common/message.h"
+
+using consus::message;
+
+namespace
+{
+
+// a received message: a type, two fixed-width fields, the payload, and
+// whatever trails it
+std::auto_ptr<e::buffer>
+received(const char* payload, e::slice* value)
+{
+    std::auto_ptr<e::buffer> msg = (message()
+                                        << uint8_t(1)
+                                        << uint64_t(7)
+                                        << uint64_t(9)
+                                        << e::slice(payload)
+                                        << uint64_t(0xdeadbeef)).create();
+    uint8_t type;
+    uint64_t a;
+    uint64_t b;
+    e::unpacker up = msg->unpack_from(BUSYBEE_HEADER_SIZE);
+    up = up >> type >> a >> b >> *value;
+    return up.error() ? std::auto_ptr<e::buffer>() : msg;
+}
+
+} // namespace
+
+TEST(Message, CreatePacksInOrder)
+{
+    std::auto_ptr<e::buffer> msg = (message()
+                                        << uint8_t(3)
+                                        << uint64_t(42)
+                                        << e::slice("value")).create();
+    ASSERT_EQ(msg->size(), BUSYBEE_HEADER_SIZE + sizeof(uint8_t)
+                         + sizeof(uint64_t) + pack_size(e::slice("value")));
+    uint8_t type;
+    uint64_t x;
+    e::slice value;
+    e::unpacker up = msg->unpack_from(BUSYBEE_HEADER_SIZE);
+    up = up >> type >> x >> value;
+    ASSERT_FALSE(up.error());
+    ASSERT_EQ(type, 3U);
+    ASSERT_EQ(x, 42U);
+    ASSERT_TRUE(value == e::slice("value"));
+    ASSERT_EQ(up.remain(), 0U);
+}
+
+TEST(Message, ReuseKeepsPayloadInPlace)
+{
+    e::slice value;
+    std::auto_ptr<e::buffer> msg = received("the value", &value);
+    ASSERT_TRUE(msg.get());
+    const uint8_t* where = value.data();
+
+    ASSERT_TRUE((message()
+                    << uint8_t(2)
+                    << uint64_t(11)
+                    << uint64_t(13)).reuse(msg.get(), value));
+
+    // the reply's fields are in front of the payload, which did not move,
+    // and the trailing field is gone
+    uint8_t type;
+    uint64_t a;
+    uint64_t b;
+    e::slice reply;
+    e::unpacker up = msg->unpack_from(BUSYBEE_HEADER_SIZE);
+    up = up >> type >> a >> b >> reply;
+    ASSERT_FALSE(up.error());
+    ASSERT_EQ(type, 2U);
+    ASSERT_EQ(a, 11U);
+    ASSERT_EQ(b, 13U);
+    ASSERT_EQ(up.remain(), 0U);
+    ASSERT_TRUE(reply.data() == where);
+    ASSERT_TRUE(reply == e::slice("the value"));
+}
+
+TEST(Message, ReuseRefusesOtherLayouts)
+{
+    e::slice value;
+    std::auto_ptr<e::buffer> msg = received("the value", &value);
+    ASSERT_TRUE(msg.get());
+    const std::vector<uint8_t> before(msg->data(), msg->data() + msg->size());
+
+    // fields that pack shorter or longer than the ones they would replace
+    ASSERT_FALSE((message() << uint8_t(2) << uint64_t(11)).reuse(msg.get(), value));
+    ASSERT_FALSE((message() << uint8_t(2) << uint64_t(11) << uint64_t(13)
+                            << uint8_t(0)).reuse(msg.get(), value));
+    // a payload that is not in the message
+    e::slice elsewhere("the value");
+    ASSERT_FALSE((message() << uint8_t(2) << uint64_t(11)
+                            << uint64_t(13)).reuse(msg.get(), elsewhere));
+    ASSERT_FALSE((message() << uint8_t(2) << uint64_t(11)
+                            << uint64_t(13)).reuse(NULL, value));
+
+    // a refused reuse leaves the message as it was
+    ASSERT_EQ(msg->size(), before.size());
+    ASSERT_TRUE(memcmp(msg->data(), &before[0], before.size()) == 0);
+}
+
+TEST(Message, SharedBackingOutlivesReceiver)
+{
+    // the path a read value takes through the transaction manager: the
+    // response buffer becomes a shared reference, the transaction keeps a
+    // slice into it, and whoever received the response lets go first
+    e::slice value;
+    std::auto_ptr<e::buffer> msg = received("kept alive", &value);
+    ASSERT_TRUE(msg.get());
+    e::compat::shared_ptr<e::buffer> shared(msg.release());
+    e::compat::shared_ptr<e::buffer> held(shared);
+    shared.reset();
+    ASSERT_TRUE(held.get());
+    ASSERT_TRUE(value.data() >= held->data());
+    ASSERT_TRUE(value.data() + value.size() <= held->data() + held->size());
+    ASSERT_TRUE(value == e::slice("kept alive"));
+}
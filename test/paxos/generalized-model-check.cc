@@ -0,0 +1,867 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// STL
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+#include <po6/threads/thread.h>
+#include <po6/time.h>
+
+// e
+#include <e/atomic.h>
+#include <e/compat.h>
+#include <e/popt.h>
+#include <e/serialization.h>
+
+// consus
+#include "common/ids.h"
+#include "txman/generalized_paxos.h"
+
+using namespace consus;
+
+// Exhaustively explores the executions of a small generalized Paxos
+// deployment, up to configurable bounds, and checks every state it reaches:
+//
+//  - each acceptor's learned history only ever grows,
+//  - the learned histories of any two acceptors agree on the order of
+//    conflicting commands,
+//  - only proposed commands are learned, and each at most once.
+//
+// A step proposes the next command at some acceptor, delivers a message to
+// some acceptor, or lets some acceptor advance.  Messages to an acceptor queue
+// in order, without duplicates; --reorder bounds how far past the head of its
+// queue a delivery may reach.  States are hashed, and a state that has been
+// seen before, by any path at least as short, is not explored again.  Worker
+// threads each explore depth-first from their own deque and steal from the
+// front of other deques when theirs runs dry.
+
+#define MAX_ACCEPTORS 9
+
+struct comparator : public generalized_paxos::comparator
+{
+    comparator() {}
+    virtual ~comparator() throw () {}
+    virtual bool conflict(const generalized_paxos::command& a,
+                          const generalized_paxos::command& b) const { return a.type == b.type; }
+};
+
+comparator cmp;
+
+struct bounds
+{
+    bounds()
+        : acceptors(3), commands(2), types(1), leaders(1)
+        , reorder(1), depth(10), implicit_leader(false) {}
+    unsigned acceptors;
+    unsigned commands;
+    unsigned types;
+    unsigned leaders;
+    unsigned reorder;
+    unsigned depth;
+    bool implicit_leader;
+};
+
+bounds B;
+
+struct message
+{
+    message()
+        : has_p1a(false), p1a()
+        , has_p1b(false), p1b()
+        , has_p2a(false), p2a()
+        , has_p2b(false), p2b()
+    {
+    }
+
+    bool has_p1a;
+    generalized_paxos::message_p1a p1a;
+    bool has_p1b;
+    generalized_paxos::message_p1b p1b;
+    bool has_p2a;
+    generalized_paxos::message_p2a p2a;
+    bool has_p2b;
+    generalized_paxos::message_p2b p2b;
+};
+
+bool
+operator == (const message& lhs, const message& rhs)
+{
+    return lhs.has_p1a == rhs.has_p1a && (!lhs.has_p1a || lhs.p1a == rhs.p1a) &&
+           lhs.has_p1b == rhs.has_p1b && (!lhs.has_p1b || lhs.p1b == rhs.p1b) &&
+           lhs.has_p2a == rhs.has_p2a && (!lhs.has_p2a || lhs.p2a == rhs.p2a) &&
+           lhs.has_p2b == rhs.has_p2b && (!lhs.has_p2b || lhs.p2b == rhs.p2b);
+}
+
+e::packer
+operator << (e::packer pa, const message& m)
+{
+    if (m.has_p1a)
+    {
+        pa = pa << uint8_t(1) << m.p1a;
+    }
+
+    if (m.has_p1b)
+    {
+        pa = pa << uint8_t(2) << m.p1b;
+    }
+
+    if (m.has_p2a)
+    {
+        pa = pa << uint8_t(3) << m.p2a;
+    }
+
+    if (m.has_p2b)
+    {
+        pa = pa << uint8_t(4) << m.p2b;
+    }
+
+    return pa;
+}
+
+enum action_t
+{
+    PROPOSE,
+    DELIVER,
+    ADVANCE
+};
+
+struct action
+{
+    action() : type(PROPOSE), acceptor(0), index(0) {}
+    action(action_t t, unsigned a, unsigned i) : type(t), acceptor(a), index(i) {}
+    action_t type;
+    unsigned acceptor;
+    unsigned index;
+};
+
+std::ostream&
+operator << (std::ostream& lhs, const action& rhs)
+{
+    switch (rhs.type)
+    {
+        case PROPOSE:
+            return lhs << "propose command at acceptor " << rhs.acceptor + 1;
+        case DELIVER:
+            return lhs << "deliver message " << rhs.index << " to acceptor " << rhs.acceptor + 1;
+        case ADVANCE:
+            return lhs << "advance acceptor " << rhs.acceptor + 1;
+        default:
+            return lhs << "unknown action";
+    }
+}
+
+class world
+{
+    public:
+        world();
+        ~world() throw ();
+
+    public:
+        void init();
+        void copy_from(const world& other);
+        void actions(std::vector<action>* acts) const;
+        void apply(const action& a);
+        void learn(unsigned idx);
+        uint64_t hash() const;
+
+    public:
+        generalized_paxos gp[MAX_ACCEPTORS];
+        std::deque<message> queues[MAX_ACCEPTORS];
+        generalized_paxos::cstruct learned[MAX_ACCEPTORS];
+        unsigned proposed;
+        std::vector<action> trace;
+
+    private:
+        void send_to_all(const message& m);
+
+    private:
+        world(const world&);
+        world& operator = (const world&);
+};
+
+world :: world()
+    : proposed(0)
+    , trace()
+{
+}
+
+world :: ~world() throw ()
+{
+}
+
+void
+world :: init()
+{
+    abstract_id ids[MAX_ACCEPTORS];
+
+    for (unsigned i = 0; i < B.acceptors; ++i)
+    {
+        ids[i] = abstract_id(i + 1);
+    }
+
+    for (unsigned i = 0; i < B.acceptors; ++i)
+    {
+        gp[i].init(&cmp, ids[i], ids, B.acceptors);
+
+        if (B.implicit_leader)
+        {
+            gp[i].default_leader(ids[0], generalized_paxos::ballot::FAST);
+        }
+    }
+}
+
+void
+world :: copy_from(const world& other)
+{
+    for (unsigned i = 0; i < B.acceptors; ++i)
+    {
+        gp[i].copy_from(other.gp[i]);
+        queues[i] = other.queues[i];
+        learned[i] = other.learned[i];
+    }
+
+    proposed = other.proposed;
+    trace = other.trace;
+}
+
+void
+world :: actions(std::vector<action>* acts) const
+{
+    acts->clear();
+
+    for (unsigned i = 0; proposed < B.commands && i < B.acceptors; ++i)
+    {
+        acts->push_back(action(PROPOSE, i, 0));
+    }
+
+    for (unsigned i = 0; i < B.acceptors; ++i)
+    {
+        for (unsigned j = 0; j < B.reorder && j < queues[i].size(); ++j)
+        {
+            acts->push_back(action(DELIVER, i, j));
+        }
+    }
+
+    for (unsigned i = 0; i < B.acceptors; ++i)
+    {
+        acts->push_back(action(ADVANCE, i, 0));
+    }
+}
+
+void
+world :: apply(const action& a)
+{
+    generalized_paxos* g = &gp[a.acceptor];
+    trace.push_back(a);
+
+    if (a.type == PROPOSE)
+    {
+        generalized_paxos::command c;
+        c.type = proposed % B.types;
+        e::packer(&c.value) << uint64_t(proposed);
+        ++proposed;
+        g->propose(c);
+    }
+    else if (a.type == DELIVER)
+    {
+        assert(a.index < queues[a.acceptor].size());
+        message m = queues[a.acceptor][a.index];
+        queues[a.acceptor].erase(queues[a.acceptor].begin() + a.index);
+
+        if (m.has_p1a)
+        {
+            bool send = false;
+            message r;
+            g->process_p1a(m.p1a, &send, &r.p1b);
+            r.has_p1b = true;
+
+            if (send)
+            {
+                send_to_all(r);
+            }
+        }
+
+        if (m.has_p1b)
+        {
+            g->process_p1b(m.p1b);
+        }
+
+        if (m.has_p2a)
+        {
+            bool send = false;
+            message r;
+            g->process_p2a(m.p2a, &send, &r.p2b);
+            r.has_p2b = true;
+
+            if (send)
+            {
+                send_to_all(r);
+            }
+        }
+
+        if (m.has_p2b)
+        {
+            g->process_p2b(m.p2b);
+            g->propose_from_p2b(m.p2b);
+        }
+    }
+    else if (a.type == ADVANCE)
+    {
+        message m1;
+        message m2;
+        message m3;
+        g->advance(a.acceptor < B.leaders,
+                   &m1.has_p1a, &m1.p1a,
+                   &m2.has_p2a, &m2.p2a,
+                   &m3.has_p2b, &m3.p2b);
+
+        if (m1.has_p1a)
+        {
+            send_to_all(m1);
+        }
+
+        if (m2.has_p2a)
+        {
+            send_to_all(m2);
+        }
+
+        if (m3.has_p2b)
+        {
+            send_to_all(m3);
+        }
+    }
+}
+
+void
+world :: learn(unsigned idx)
+{
+    learned[idx] = gp[idx].learned();
+}
+
+uint64_t
+world :: hash() const
+{
+    std::string s;
+    e::packer(&s) << uint64_t(proposed);
+
+    for (unsigned i = 0; i < B.acceptors; ++i)
+    {
+        std::string g;
+        gp[i].encode_state(&g);
+        s += g;
+        std::string q;
+        e::packer pa(&q);
+        pa = pa << uint64_t(queues[i].size());
+
+        for (size_t j = 0; j < queues[i].size(); ++j)
+        {
+            pa = pa << queues[i][j];
+        }
+
+        s += q;
+    }
+
+    // a word at a time; this runs once per transition and dominates the
+    // cost of exploring when done a byte at a time
+    uint64_t h = s.size();
+    size_t i = 0;
+
+    for (; i + sizeof(uint64_t) <= s.size(); i += sizeof(uint64_t))
+    {
+        uint64_t w;
+        memmove(&w, s.data() + i, sizeof(w));
+        h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
+    }
+
+    for (; i < s.size(); ++i)
+    {
+        h = (h ^ static_cast<unsigned char>(s[i])) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
+    }
+
+    return h;
+}
+
+void
+world :: send_to_all(const message& m)
+{
+    // acceptors resend on every advance; a copy of a message that is still
+    // queued adds nothing but states, as every message is idempotent
+    for (unsigned i = 0; i < B.acceptors; ++i)
+    {
+        if (std::find(queues[i].begin(), queues[i].end(), m) == queues[i].end())
+        {
+            queues[i].push_back(m);
+        }
+    }
+}
+
+// the commands of one type, in the order a history executes them
+static std::vector<generalized_paxos::command>
+of_type(const generalized_paxos::cstruct& c, uint16_t t)
+{
+    std::vector<generalized_paxos::command> ret;
+
+    for (size_t i = 0; i < c.commands.size(); ++i)
+    {
+        if (c.commands[i].type == t)
+        {
+            ret.push_back(c.commands[i]);
+        }
+    }
+
+    return ret;
+}
+
+static bool
+is_prefix(const std::vector<generalized_paxos::command>& a,
+          const std::vector<generalized_paxos::command>& b)
+{
+    return a.size() <= b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+static const char*
+check(const world& parent, const world& child, unsigned idx)
+{
+    const generalized_paxos::cstruct& L(child.learned[idx]);
+    std::set<generalized_paxos::command> seen;
+
+    for (size_t i = 0; i < L.commands.size(); ++i)
+    {
+        uint64_t v = UINT64_MAX;
+        e::unpacker up(L.commands[i].value);
+        up = up >> v;
+
+        if (up.error() || v >= child.proposed)
+        {
+            return "learned a command that was never proposed";
+        }
+
+        if (!seen.insert(L.commands[i]).second)
+        {
+            return "learned a command twice";
+        }
+    }
+
+    for (uint16_t t = 0; t < B.types; ++t)
+    {
+        std::vector<generalized_paxos::command> a(of_type(L, t));
+
+        if (!is_prefix(of_type(parent.learned[idx], t), a))
+        {
+            return "an acceptor's learned history shrank or was reordered";
+        }
+
+        for (unsigned i = 0; i < B.acceptors; ++i)
+        {
+            std::vector<generalized_paxos::command> b(of_type(child.learned[i], t));
+
+            if (i != idx && !is_prefix(a, b) && !is_prefix(b, a))
+            {
+                return "two acceptors learned conflicting commands in different orders";
+            }
+        }
+    }
+
+    return NULL;
+}
+
+class explorer
+{
+    public:
+        explorer(unsigned threads);
+        ~explorer() throw ();
+
+    public:
+        bool run();
+
+    private:
+        struct stripe;
+        struct work_queue;
+
+    private:
+        void worker(unsigned idx);
+        void expand(unsigned idx, world* w);
+        bool visit(uint64_t h, size_t depth);
+        void push(unsigned idx, world* w);
+        world* pop(unsigned idx);
+        void violation(const world& w, const char* what);
+
+    private:
+        const unsigned m_threads;
+        stripe* m_seen;
+        work_queue* m_queues;
+        uint64_t m_pushed;
+        uint64_t m_finished;
+        uint64_t m_failed;
+        po6::threads::mutex m_report_mtx;
+
+    private:
+        explorer(const explorer&);
+        explorer& operator = (const explorer&);
+};
+
+#define SEEN_STRIPES 1024
+
+struct explorer::stripe
+{
+    stripe() : mtx(), seen() {}
+    po6::threads::mutex mtx;
+    // state hash -> shallowest depth it was reached at
+    std::map<uint64_t, size_t> seen;
+};
+
+struct explorer::work_queue
+{
+    work_queue() : mtx(), work() {}
+    po6::threads::mutex mtx;
+    std::deque<world*> work;
+};
+
+explorer :: explorer(unsigned threads)
+    : m_threads(threads)
+    , m_seen(new stripe[SEEN_STRIPES])
+    , m_queues(new work_queue[threads])
+    , m_pushed(0)
+    , m_finished(0)
+    , m_failed(0)
+    , m_report_mtx()
+{
+}
+
+explorer :: ~explorer() throw ()
+{
+    for (unsigned i = 0; i < m_threads; ++i)
+    {
+        for (size_t j = 0; j < m_queues[i].work.size(); ++j)
+        {
+            delete m_queues[i].work[j];
+        }
+    }
+
+    delete[] m_seen;
+    delete[] m_queues;
+}
+
+bool
+explorer :: run()
+{
+    world* w = new world();
+    w->init();
+
+    for (unsigned i = 0; i < B.acceptors; ++i)
+    {
+        w->learn(i);
+    }
+
+    visit(w->hash(), 0);
+    push(0, w);
+
+    std::vector<e::compat::shared_ptr<po6::threads::thread> > threads;
+    const uint64_t start = po6::monotonic_time();
+
+    for (unsigned i = 0; i < m_threads; ++i)
+    {
+        e::compat::shared_ptr<po6::threads::thread> t(new po6::threads::thread(po6::threads::make_obj_func(&explorer::worker, this, i)));
+        threads.push_back(t);
+        t->start();
+    }
+
+    uint64_t last = 0;
+    uint64_t last_report = start;
+
+    while (true)
+    {
+        usleep(10000);
+        const uint64_t finished = e::atomic::load_64_acquire(&m_finished);
+        const uint64_t pushed = e::atomic::load_64_acquire(&m_pushed);
+
+        if (finished == pushed || e::atomic::load_64_acquire(&m_failed))
+        {
+            break;
+        }
+
+        const uint64_t now = po6::monotonic_time();
+
+        if (now - last_report < 1000000000ULL)
+        {
+            continue;
+        }
+
+        po6::threads::mutex::hold hold(&m_report_mtx);
+        std::cout << "explored " << finished << " states ("
+                  << uint64_t((finished - last) * 1e9 / (now - last_report))
+                  << " states/s), " << pushed - finished << " queued" << std::endl;
+        last = finished;
+        last_report = now;
+    }
+
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i]->join();
+    }
+
+    const double elapsed = (po6::monotonic_time() - start) / 1e9;
+    const uint64_t finished = e::atomic::load_64_acquire(&m_finished);
+    std::cout << "explored " << finished << " states in " << elapsed
+              << "s (" << uint64_t(finished / elapsed) << " states/s)" << std::endl;
+    return !e::atomic::load_64_acquire(&m_failed);
+}
+
+void
+explorer :: worker(unsigned idx)
+{
+    while (!e::atomic::load_64_acquire(&m_failed))
+    {
+        world* w = pop(idx);
+
+        if (w)
+        {
+            expand(idx, w);
+            delete w;
+            e::atomic::increment_64_fullbarrier(&m_finished, 1);
+            continue;
+        }
+
+        // read finished before pushed:  if they match, nothing was in flight
+        // when finished was read, so nothing more can be pushed
+        const uint64_t finished = e::atomic::load_64_acquire(&m_finished);
+        const uint64_t pushed = e::atomic::load_64_acquire(&m_pushed);
+
+        if (finished == pushed)
+        {
+            break;
+        }
+
+        sched_yield();
+    }
+}
+
+void
+explorer :: expand(unsigned idx, world* w)
+{
+    if (w->trace.size() >= B.depth)
+    {
+        return;
+    }
+
+    std::vector<action> acts;
+    w->actions(&acts);
+
+    for (size_t i = 0; i < acts.size(); ++i)
+    {
+        std::auto_ptr<world> child(new world());
+        child->copy_from(*w);
+        child->apply(acts[i]);
+        // a step changes only the acceptor it acts on
+        child->learn(acts[i].acceptor);
+        const char* what = check(*w, *child, acts[i].acceptor);
+
+        if (what)
+        {
+            violation(*child, what);
+            return;
+        }
+
+        if (visit(child->hash(), child->trace.size()))
+        {
+            push(idx, child.release());
+        }
+    }
+}
+
+bool
+explorer :: visit(uint64_t h, size_t depth)
+{
+    // with a bound on depth, a state first reached by a long path must be
+    // explored again when a shorter path reaches it, or the states within
+    // the bound that lie beyond it would be missed
+    stripe* s = &m_seen[h % SEEN_STRIPES];
+    po6::threads::mutex::hold hold(&s->mtx);
+    std::map<uint64_t, size_t>::iterator it = s->seen.find(h);
+
+    if (it == s->seen.end())
+    {
+        s->seen.insert(std::make_pair(h, depth));
+        return true;
+    }
+
+    if (depth < it->second)
+    {
+        it->second = depth;
+        return true;
+    }
+
+    return false;
+}
+
+void
+explorer :: push(unsigned idx, world* w)
+{
+    e::atomic::increment_64_fullbarrier(&m_pushed, 1);
+    po6::threads::mutex::hold hold(&m_queues[idx].mtx);
+    m_queues[idx].work.push_back(w);
+}
+
+world*
+explorer :: pop(unsigned idx)
+{
+    // our own work, newest first, keeps the search depth-first and the
+    // frontier small
+    {
+        po6::threads::mutex::hold hold(&m_queues[idx].mtx);
+
+        if (!m_queues[idx].work.empty())
+        {
+            world* w = m_queues[idx].work.back();
+            m_queues[idx].work.pop_back();
+            return w;
+        }
+    }
+
+    // steal the oldest, and so likely the largest, subtree from someone else
+    for (unsigned i = 1; i < m_threads; ++i)
+    {
+        work_queue* q = &m_queues[(idx + i) % m_threads];
+        po6::threads::mutex::hold hold(&q->mtx);
+
+        if (!q->work.empty())
+        {
+            world* w = q->work.front();
+            q->work.pop_front();
+            return w;
+        }
+    }
+
+    return NULL;
+}
+
+void
+explorer :: violation(const world& w, const char* what)
+{
+    po6::threads::mutex::hold hold(&m_report_mtx);
+
+    if (e::atomic::increment_64_fullbarrier(&m_failed, 1) > 1)
+    {
+        return;
+    }
+
+    std::cerr << "violation: " << what << "\n";
+
+    for (size_t i = 0; i < w.trace.size(); ++i)
+    {
+        std::cerr << "  " << i + 1 << ". " << w.trace[i] << "\n";
+    }
+
+    for (unsigned i = 0; i < B.acceptors; ++i)
+    {
+        std::cerr << "acceptor " << i + 1 << " learned " << w.learned[i] << "\n";
+    }
+
+    std::cerr << std::flush;
+}
+
+int
+main(int argc, const char* argv[])
+{
+    long acceptors = B.acceptors;
+    long commands = B.commands;
+    long types = B.types;
+    long leaders = B.leaders;
+    long reorder = B.reorder;
+    long depth = B.depth;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    bool implicit_leader = false;
+    e::argparser ap;
+    ap.autohelp();
+    ap.arg().name('a', "acceptors")
+            .description("how many acceptors to use (default: 3)")
+            .as_long(&acceptors);
+    ap.arg().name('c', "commands")
+            .description("how many commands to propose (default: 2)")
+            .as_long(&commands);
+    ap.arg().name('T', "types")
+            .description("how many command types; commands of the same type conflict (default: 1)")
+            .as_long(&types);
+    ap.arg().name('l', "leaders")
+            .description("how many acceptors may try to lead (default: 1)")
+            .as_long(&leaders);
+    ap.arg().name('r', "reorder")
+            .description("how far past the head of a queue a message may be delivered (default: 1, in order)")
+            .as_long(&reorder);
+    ap.arg().name('d', "depth")
+            .description("how many steps an execution may take (default: 10)")
+            .as_long(&depth);
+    ap.arg().name('t', "threads")
+            .description("how many threads to explore with (default: one per CPU)")
+            .as_long(&threads);
+    ap.arg().name('i', "implicit-leader")
+            .description("start with acceptor 1 leading a fast ballot, as the txman does")
+            .set_true(&implicit_leader);
+
+    if (!ap.parse(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (acceptors <= 0 || acceptors > MAX_ACCEPTORS ||
+        commands < 0 || types <= 0 || types > UINT16_MAX ||
+        leaders < 0 || reorder <= 0 || depth <= 0 || threads <= 0)
+    {
+        std::cerr << "bounds must be positive, with at most " << MAX_ACCEPTORS << " acceptors\n" << std::endl;
+        ap.usage();
+        return EXIT_FAILURE;
+    }
+
+    B.acceptors = acceptors;
+    B.commands = commands;
+    B.types = types;
+    B.leaders = leaders;
+    B.reorder = reorder;
+    B.depth = depth;
+    B.implicit_leader = implicit_leader;
+    explorer ex(threads);
+    return ex.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
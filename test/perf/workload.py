@@ -0,0 +1,114 @@
+# Runs a fixed workload against the cluster the enclosing gremlin started,
+# records throughput and latency percentiles, and compares them against the
+# stored baseline.
+#
+#   python workload.py <workload> <topology>
+#
+# Results are written as JSON to $CONSUS_PERF_RESULTS/<workload>.<topology>.json
+# when CONSUS_PERF_RESULTS is set.  The baseline is read from
+# $CONSUS_PERF_BASELINE (default test/perf/baseline.json in the source tree).
+# A run fails when throughput drops, or any latency percentile grows, by more
+# than the tolerance:  the entry's own "tolerance", else $CONSUS_PERF_TOLERANCE,
+# else 0.25.  Workloads without a baseline entry are recorded but not judged.
+
+import json
+import os
+import sys
+import time
+
+import consus
+
+WARMUP = 100
+OPERATIONS = 1000
+PERCENTILES = (50, 90, 99, 99.9)
+
+def single_put(c, i):
+    t = c.begin_transaction()
+    assert t.put('perf', 'key-%d' % i, 'value-%d' % i)
+    t.commit()
+
+def single_get(c, i):
+    t = c.begin_transaction()
+    assert t.get('perf', 'key-%d' % (i % OPERATIONS)) == 'value-%d' % (i % OPERATIONS)
+    t.commit()
+
+def single_get_setup(c):
+    for i in range(OPERATIONS):
+        single_put(c, i)
+
+def put_get_separate_commits(c, i):
+    single_put(c, i)
+    t = c.begin_transaction()
+    assert t.get('perf', 'key-%d' % i) == 'value-%d' % i
+    t.commit()
+
+# name -> (setup, one operation)
+WORKLOADS = {
+    'single-put': (None, single_put),
+    'single-get': (single_get_setup, single_get),
+    'put-get-separate-commits': (None, put_get_separate_commits),
+}
+
+def percentile(latencies, p):
+    idx = int(round(p / 100.0 * (len(latencies) - 1)))
+    return latencies[idx]
+
+def run(workload):
+    setup, op = WORKLOADS[workload]
+    c = consus.Client()
+    if setup is not None:
+        setup(c)
+    for i in range(WARMUP):
+        op(c, OPERATIONS + i)
+    latencies = []
+    start = time.time()
+    for i in range(OPERATIONS):
+        t = time.time()
+        op(c, i)
+        latencies.append(time.time() - t)
+    elapsed = time.time() - start
+    latencies.sort()
+    result = {'operations': OPERATIONS,
+              'throughput': OPERATIONS / elapsed}
+    for p in PERCENTILES:
+        result['p%s' % p] = percentile(latencies, p) * 1000.
+    return result
+
+def compare(result, baseline):
+    tolerance = baseline.get('tolerance', float(os.environ.get('CONSUS_PERF_TOLERANCE', 0.25)))
+    failures = []
+    if 'throughput' in baseline and result['throughput'] < baseline['throughput'] * (1 - tolerance):
+        failures.append('throughput %.1f op/s below baseline %.1f op/s' %
+                        (result['throughput'], baseline['throughput']))
+    for p in PERCENTILES:
+        key = 'p%s' % p
+        if key in baseline and result[key] > baseline[key] * (1 + tolerance):
+            failures.append('%s latency %.2f ms above baseline %.2f ms' %
+                            (key, result[key], baseline[key]))
+    return failures
+
+def main(workload, topology):
+    name = '%s.%s' % (workload, topology)
+    result = run(workload)
+    print('%s %s' % (name, json.dumps(result, sort_keys=True)))
+    results = os.environ.get('CONSUS_PERF_RESULTS')
+    if results:
+        if not os.path.isdir(results):
+            os.makedirs(results)
+        with open(os.path.join(results, name + '.json'), 'w') as fout:
+            json.dump(result, fout, sort_keys=True, indent=4)
+    path = os.environ.get('CONSUS_PERF_BASELINE',
+                          os.path.join(os.environ.get('CONSUS_SRCDIR', '.'), 'test/perf/baseline.json'))
+    baseline = {}
+    if os.path.exists(path):
+        baseline = json.load(open(path))
+    if name not in baseline:
+        print('%s has no baseline; not compared' % name)
+        return 0
+    failures = compare(result, baseline[name])
+    for f in failures:
+        print('%s regressed: %s' % (name, f))
+    return 1 if failures else 0
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1], sys.argv[2]))
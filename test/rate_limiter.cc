@@ -0,0 +1,183 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/time.h>
+
+// consus
+#include "test/th.h"
+#include "common/quota.h"
+#include "txman/rate_limiter.h"
+
+using consus::comm_id;
+using consus::quota;
+using consus::rate_limiter;
+
+namespace
+{
+
+const uint64_t START = 1000 * PO6_SECONDS;
+const comm_id ALICE(1);
+const comm_id BOB(2);
+
+std::vector<quota>
+quotas(const quota& q)
+{
+    return std::vector<quota>(1, q);
+}
+
+// admit a zero-byte operation at time now
+bool
+op(rate_limiter* rl, comm_id client, const char* table, uint64_t now)
+{
+    uint64_t retry_after = 0;
+    return rl->admit(client, e::slice(table), 0, now, &retry_after);
+}
+
+} // namespace
+
+TEST(RateLimiter, Unlimited)
+{
+    rate_limiter rl;
+    uint64_t retry_after = 1;
+
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        ASSERT_TRUE(rl.admit(ALICE, e::slice("t"), 1ULL << 20, START, &retry_after));
+        ASSERT_EQ(retry_after, 0U);
+    }
+}
+
+TEST(RateLimiter, ClientOpsRefill)
+{
+    rate_limiter rl;
+    rl.reconfigure(quotas(quota(quota::CLIENT, "", 10, 0, 0)), START);
+
+    // a fresh bucket holds a second's burst
+    for (size_t i = 0; i < 10; ++i)
+    {
+        ASSERT_TRUE(op(&rl, ALICE, "t", START));
+    }
+
+    uint64_t retry_after = 0;
+    ASSERT_FALSE(rl.admit(ALICE, e::slice("t"), 0, START, &retry_after));
+    ASSERT_GT(retry_after, 0U);
+    ASSERT_LE(retry_after, PO6_SECONDS / 10 + 1);
+
+    // each client has its own bucket
+    ASSERT_TRUE(op(&rl, BOB, "t", START));
+
+    // refusals charge nothing, so the hint is good
+    ASSERT_FALSE(op(&rl, ALICE, "t", START + retry_after - 2));
+    ASSERT_TRUE(op(&rl, ALICE, "t", START + retry_after));
+    ASSERT_FALSE(op(&rl, ALICE, "t", START + retry_after));
+
+    // refill stops at one second's worth
+    const uint64_t later = START + 100 * PO6_SECONDS;
+
+    for (size_t i = 0; i < 10; ++i)
+    {
+        ASSERT_TRUE(op(&rl, ALICE, "t", later));
+    }
+
+    ASSERT_FALSE(op(&rl, ALICE, "t", later));
+}
+
+TEST(RateLimiter, BytesMayOverdraw)
+{
+    rate_limiter rl;
+    rl.reconfigure(quotas(quota(quota::CLIENT, "", 0, 1000, 0)), START);
+    uint64_t retry_after = 0;
+
+    // a write larger than the bucket is admitted when the bucket is full...
+    ASSERT_TRUE(rl.admit(ALICE, e::slice("t"), 3000, START, &retry_after));
+    // ...and the debt delays what follows until it is paid off
+    ASSERT_FALSE(rl.admit(ALICE, e::slice("t"), 1, START, &retry_after));
+    ASSERT_GT(retry_after, 2 * PO6_SECONDS);
+    ASSERT_FALSE(rl.admit(ALICE, e::slice("t"), 1, START + 2 * PO6_SECONDS, &retry_after));
+    ASSERT_TRUE(rl.admit(ALICE, e::slice("t"), 1, START + 2 * PO6_SECONDS + retry_after, &retry_after));
+}
+
+TEST(RateLimiter, TableIsShared)
+{
+    rate_limiter rl;
+    rl.reconfigure(quotas(quota(quota::TABLE, "limited", 2, 0, 0)), START);
+    ASSERT_TRUE(op(&rl, ALICE, "limited", START));
+    ASSERT_TRUE(op(&rl, BOB, "limited", START));
+    ASSERT_FALSE(op(&rl, ALICE, "limited", START));
+    ASSERT_FALSE(op(&rl, BOB, "limited", START));
+
+    // other tables, and operations naming none, are not affected
+    ASSERT_TRUE(op(&rl, ALICE, "other", START));
+    ASSERT_TRUE(op(&rl, ALICE, "", START));
+}
+
+TEST(RateLimiter, ReconfigureKeepsTokens)
+{
+    rate_limiter rl;
+    rl.reconfigure(quotas(quota(quota::TABLE, "t", 2, 0, 0)), START);
+    ASSERT_TRUE(op(&rl, ALICE, "t", START));
+    ASSERT_TRUE(op(&rl, ALICE, "t", START));
+    ASSERT_FALSE(op(&rl, ALICE, "t", START));
+
+    // a new configuration with the same quota does not hand out a new burst
+    rl.reconfigure(quotas(quota(quota::TABLE, "t", 2, 0, 0)), START);
+    ASSERT_FALSE(op(&rl, ALICE, "t", START));
+
+    // lifting the quota, then restoring it, starts over with a full bucket
+    rl.reconfigure(std::vector<quota>(), START);
+    ASSERT_TRUE(op(&rl, ALICE, "t", START));
+    rl.reconfigure(quotas(quota(quota::TABLE, "t", 2, 0, 0)), START);
+    ASSERT_TRUE(op(&rl, ALICE, "t", START));
+    ASSERT_TRUE(op(&rl, ALICE, "t", START));
+    ASSERT_FALSE(op(&rl, ALICE, "t", START));
+}
+
+TEST(RateLimiter, PruneIdleClients)
+{
+    rate_limiter rl;
+    rl.reconfigure(quotas(quota(quota::CLIENT, "", 10, 0, 0)), START);
+    ASSERT_TRUE(op(&rl, ALICE, "t", START));
+    ASSERT_TRUE(op(&rl, BOB, "t", START + 30 * PO6_SECONDS));
+    ASSERT_NE(rl.debug_dump().find("tracking 2 clients"), std::string::npos);
+
+    // not idle long enough
+    rl.prune(START + 60 * PO6_SECONDS);
+    ASSERT_NE(rl.debug_dump().find("tracking 2 clients"), std::string::npos);
+
+    rl.prune(START + 61 * PO6_SECONDS);
+    ASSERT_NE(rl.debug_dump().find("tracking 1 clients"), std::string::npos);
+    ASSERT_NE(rl.debug_dump().find("client=2 "), std::string::npos);
+    ASSERT_EQ(rl.debug_dump().find("client=1 "), std::string::npos);
+
+    rl.prune(START + 100 * PO6_SECONDS);
+    ASSERT_NE(rl.debug_dump().find("tracking 0 clients"), std::string::npos);
+}
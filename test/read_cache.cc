@@ -0,0 +1,133 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <string>
+
+// consus
+#include "test/th.h"
+#include "client/read_cache.h"
+
+using consus::read_cache;
+
+namespace
+{
+
+bool
+cached(read_cache* rc, const char* table, const char* key,
+       uint64_t expect_ts, const char* expect_value)
+{
+    uint64_t ts = 0;
+    std::string value;
+    return rc->lookup(table, key, &ts, &value) &&
+           ts == expect_ts && value == expect_value;
+}
+
+bool
+missing(read_cache* rc, const char* table, const char* key)
+{
+    uint64_t ts = 0;
+    std::string value;
+    return !rc->lookup(table, key, &ts, &value);
+}
+
+} // namespace
+
+TEST(ReadCache, DisabledByDefault)
+{
+    read_cache rc;
+    ASSERT_FALSE(rc.enabled());
+    rc.insert("t", "k", 1, e::slice("v"));
+    ASSERT_TRUE(missing(&rc, "t", "k"));
+}
+
+TEST(ReadCache, HitAndMiss)
+{
+    read_cache rc;
+    rc.set_capacity(4);
+    ASSERT_TRUE(rc.enabled());
+    rc.insert("t", "k", 5, e::slice("v5"));
+    ASSERT_TRUE(cached(&rc, "t", "k", 5, "v5"));
+    ASSERT_TRUE(missing(&rc, "t", "other"));
+    // the table is part of the key
+    ASSERT_TRUE(missing(&rc, "u", "k"));
+    rc.insert("u", "k", 7, e::slice("u7"));
+    ASSERT_TRUE(cached(&rc, "t", "k", 5, "v5"));
+    ASSERT_TRUE(cached(&rc, "u", "k", 7, "u7"));
+}
+
+TEST(ReadCache, NewerVersionsOnly)
+{
+    read_cache rc;
+    rc.set_capacity(4);
+    rc.insert("t", "k", 5, e::slice("v5"));
+    rc.insert("t", "k", 9, e::slice("v9"));
+    ASSERT_TRUE(cached(&rc, "t", "k", 9, "v9"));
+    // a slow response for an older version leaves the newer one
+    rc.insert("t", "k", 6, e::slice("v6"));
+    ASSERT_TRUE(cached(&rc, "t", "k", 9, "v9"));
+}
+
+TEST(ReadCache, Invalidate)
+{
+    read_cache rc;
+    rc.set_capacity(4);
+    rc.insert("t", "k1", 1, e::slice("a"));
+    rc.insert("t", "k2", 2, e::slice("b"));
+    rc.invalidate("t", "k1");
+    ASSERT_TRUE(missing(&rc, "t", "k1"));
+    ASSERT_TRUE(cached(&rc, "t", "k2", 2, "b"));
+    // invalidating what isn't there is harmless
+    rc.invalidate("t", "k1");
+    rc.invalidate("t", "k3");
+    ASSERT_TRUE(cached(&rc, "t", "k2", 2, "b"));
+    // and an invalidated key may be cached again
+    rc.insert("t", "k1", 3, e::slice("c"));
+    ASSERT_TRUE(cached(&rc, "t", "k1", 3, "c"));
+}
+
+TEST(ReadCache, EvictsLeastRecentlyUsed)
+{
+    read_cache rc;
+    rc.set_capacity(2);
+    rc.insert("t", "a", 1, e::slice("a"));
+    rc.insert("t", "b", 1, e::slice("b"));
+    // a lookup makes "a" the most recently used
+    ASSERT_TRUE(cached(&rc, "t", "a", 1, "a"));
+    rc.insert("t", "c", 1, e::slice("c"));
+    ASSERT_TRUE(missing(&rc, "t", "b"));
+    ASSERT_TRUE(cached(&rc, "t", "a", 1, "a"));
+    ASSERT_TRUE(cached(&rc, "t", "c", 1, "c"));
+
+    // shrinking evicts down to the new size; zero disables and empties
+    rc.set_capacity(1);
+    ASSERT_TRUE(missing(&rc, "t", "a"));
+    ASSERT_TRUE(cached(&rc, "t", "c", 1, "c"));
+    rc.set_capacity(0);
+    ASSERT_FALSE(rc.enabled());
+    ASSERT_TRUE(missing(&rc, "t", "c"));
+}
@@ -0,0 +1,296 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <vector>
+
+// po6
+#include <po6/threads/thread.h>
+
+// e
+#include <e/atomic.h>
+#include <e/compat.h>
+#include <e/garbage_collector.h>
+
+// consus
+#include "test/th.h"
+#include "common/state_table.h"
+
+using consus::state_table;
+
+namespace
+{
+
+class counter
+{
+    public:
+        counter(const uint64_t& key) : m_key(key), count(0), done(false) {}
+        ~counter() throw () {}
+
+    public:
+        const uint64_t& state_key() const { return m_key; }
+        bool finished() { return done; }
+
+    private:
+        const uint64_t m_key;
+
+    public:
+        uint64_t count;
+        bool done;
+
+    private:
+        counter(const counter&);
+        counter& operator = (const counter&);
+};
+
+typedef state_table<uint64_t, counter> counter_table;
+
+size_t
+count_states(counter_table* t)
+{
+    size_t n = 0;
+
+    for (counter_table::iterator it(t); it.valid(); ++it)
+    {
+        ++n;
+    }
+
+    return n;
+}
+
+} // namespace
+
+TEST(StateTable, CreateGetRelease)
+{
+    e::garbage_collector gc;
+    e::garbage_collector::thread_state ts;
+    gc.register_thread(&ts);
+
+    {
+        counter_table t(&gc);
+        counter_table::state_reference sr1;
+        counter* c1 = t.create_state(5, &sr1);
+        ASSERT_TRUE(c1 != NULL);
+        ASSERT_EQ(c1->state_key(), 5U);
+        c1->count = 1;
+        sr1.release();
+
+        // still there, because it isn't finished
+        counter_table::state_reference sr2;
+        ASSERT_TRUE(t.create_state(5, &sr2) == NULL);
+        counter* c2 = t.get_state(5, &sr2);
+        ASSERT_TRUE(c2 == c1);
+        ASSERT_EQ(c2->count, 1U);
+        c2->done = true;
+        sr2.release();
+
+        // gone with the last reference once it is finished
+        counter_table::state_reference sr3;
+        ASSERT_TRUE(t.get_state(5, &sr3) == NULL);
+        counter* c3 = t.get_or_create_state(5, &sr3);
+        ASSERT_TRUE(c3 != NULL);
+        ASSERT_EQ(c3->count, 0U);
+    }
+
+    gc.deregister_thread(&ts);
+}
+
+// enough states to rebuild the array several times on the way up, and again
+// on the way down as the tombstones pile up
+TEST(StateTable, GrowAndShrink)
+{
+    e::garbage_collector gc;
+    e::garbage_collector::thread_state ts;
+    gc.register_thread(&ts);
+
+    {
+        const uint64_t N = 10000;
+        counter_table t(&gc);
+
+        for (uint64_t i = 1; i <= N; ++i)
+        {
+            counter_table::state_reference sr;
+            counter* c = t.create_state(i, &sr);
+            ASSERT_TRUE(c != NULL);
+            c->count = i;
+        }
+
+        ASSERT_EQ(count_states(&t), N);
+
+        for (uint64_t i = 1; i <= N; ++i)
+        {
+            counter_table::state_reference sr;
+            counter* c = t.get_state(i, &sr);
+            ASSERT_TRUE(c != NULL);
+            ASSERT_EQ(c->count, i);
+
+            if (i % 2 == 0)
+            {
+                c->done = true;
+            }
+        }
+
+        ASSERT_EQ(count_states(&t), N / 2);
+
+        for (uint64_t i = 1; i <= N; ++i)
+        {
+            counter_table::state_reference sr;
+            counter* c = t.get_state(i, &sr);
+            ASSERT_EQ(c != NULL, i % 2 == 1);
+
+            if (c)
+            {
+                c->done = true;
+            }
+
+            gc.quiescent_state(&ts);
+        }
+
+        ASSERT_EQ(count_states(&t), 0U);
+    }
+
+    gc.deregister_thread(&ts);
+}
+
+TEST(StateTable, IteratorSkipsRemoved)
+{
+    e::garbage_collector gc;
+    e::garbage_collector::thread_state ts;
+    gc.register_thread(&ts);
+
+    {
+        counter_table t(&gc);
+
+        for (uint64_t i = 1; i <= 100; ++i)
+        {
+            counter_table::state_reference sr;
+            t.create_state(i, &sr);
+        }
+
+        // finish every state through the iterator itself
+        size_t seen = 0;
+
+        for (counter_table::iterator it(&t); it.valid(); ++it)
+        {
+            (*it)->done = true;
+            ++seen;
+        }
+
+        ASSERT_EQ(seen, 100U);
+        ASSERT_EQ(count_states(&t), 0U);
+    }
+
+    gc.deregister_thread(&ts);
+}
+
+namespace
+{
+
+// each thread bumps every key in a small key space; a thread that finds a
+// key's count complete retires it, and it is recreated from zero by the next
+// thread to reach it, so creation, lookup, removal and rebuilds all race
+struct hammer
+{
+    static const uint64_t KEYS = 257;
+    static const uint64_t ROUNDS = 2000;
+
+    hammer(size_t threads)
+        : gc(), table(&gc), nthreads(threads), increments(0), retired(0) {}
+
+    void run(size_t idx)
+    {
+        e::garbage_collector::thread_state ts;
+        gc.register_thread(&ts);
+
+        for (uint64_t r = 0; r < ROUNDS; ++r)
+        {
+            for (uint64_t k = 0; k < KEYS; ++k)
+            {
+                const uint64_t key = (k * 7 + idx) % KEYS + 1;
+                counter_table::state_reference sr;
+                counter* c = table.get_or_create_state(key, &sr);
+                ++c->count;
+                e::atomic::increment_64_nobarrier(&increments, 1);
+
+                if (c->count == nthreads)
+                {
+                    c->done = true;
+                    e::atomic::increment_64_nobarrier(&retired, 1);
+                }
+            }
+
+            gc.quiescent_state(&ts);
+        }
+
+        gc.deregister_thread(&ts);
+    }
+
+    e::garbage_collector gc;
+    counter_table table;
+    const size_t nthreads;
+    uint64_t increments;
+    uint64_t retired;
+
+    private:
+        hammer(const hammer&);
+        hammer& operator = (const hammer&);
+};
+
+} // namespace
+
+TEST(StateTable, Concurrent)
+{
+    const size_t THREADS = 4;
+    hammer h(THREADS);
+    std::vector<e::compat::shared_ptr<po6::threads::thread> > threads;
+
+    for (size_t i = 0; i < THREADS; ++i)
+    {
+        e::compat::shared_ptr<po6::threads::thread> t(new po6::threads::thread(po6::threads::make_obj_func(&hammer::run, &h, i)));
+        threads.push_back(t);
+        t->start();
+    }
+
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i]->join();
+    }
+
+    e::garbage_collector::thread_state ts;
+    h.gc.register_thread(&ts);
+    uint64_t left = 0;
+
+    for (counter_table::iterator it(&h.table); it.valid(); ++it)
+    {
+        left += (*it)->count;
+    }
+
+    // no increment is lost:  each retired state took exactly nthreads
+    ASSERT_EQ(h.increments, h.retired * THREADS + left);
+    ASSERT_EQ(h.increments, hammer::KEYS * hammer::ROUNDS * THREADS);
+    h.gc.deregister_thread(&ts);
+}
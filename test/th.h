@@ -30,6 +30,7 @@
 
 // C
 #include <cstdlib>
+#include <stdint.h>
 
 // C++
 #include <iostream>
@@ -116,6 +117,63 @@ class predicate
 
 #undef BINARY_PREDICATE
 
+int
+run_benchmarks(const char* filter, uint64_t benchtime, uint64_t warmup, uint64_t iterations);
+
+class benchmark_base
+{
+    public:
+        benchmark_base(const char* group,
+                       const char* name,
+                       const char* file,
+                       size_t line);
+        virtual ~benchmark_base() throw () {}
+
+    public:
+        bool matches(const char* filter) const;
+        void run(uint64_t benchtime, uint64_t warmup, uint64_t iterations);
+
+    public:
+        bool operator < (const benchmark_base& rhs) const;
+
+    protected:
+        // exclude setup from the measurement:  the timer is running when
+        // _run is called, and reset_timer discards everything so far
+        void start_timer();
+        void stop_timer();
+        void reset_timer();
+        // report throughput for benchmarks that process a buffer per op
+        void set_bytes(uint64_t bytes) { m_bytes = bytes; }
+
+    private:
+        virtual void _run(uint64_t iterations) = 0;
+        void run_n(uint64_t iterations);
+
+    private:
+        benchmark_base(const benchmark_base&);
+        benchmark_base& operator = (const benchmark_base&);
+
+    private:
+        const char* m_group;
+        const char* m_name;
+        const char* m_file;
+        size_t m_line;
+        bool m_timing;
+        uint64_t m_start;
+        uint64_t m_start_allocs;
+        uint64_t m_elapsed;
+        uint64_t m_allocs;
+        uint64_t m_bytes;
+};
+
+// keep the compiler from discarding a result that is otherwise unused
+template <typename T>
+inline void
+consume(const T& t)
+{
+    __asm__ __volatile__ ("" : : "r"(&t) : "memory");
+}
+
 } // namespace th
 
 #define TEST(GROUP, NAME) \
@@ -131,6 +189,19 @@ class predicate
         TH_CONCAT(_test_instance_, TH_CONCAT(GROUP, TH_CONCAT(_, TH_CONCAT(NAME, TH_CONCAT(_, __LINE__))))); \
     void TH_CONCAT(GROUP, TH_CONCAT(_, TH_CONCAT(NAME, TH_CONCAT(_, __LINE__)))) :: _run()
 
+#define BENCHMARK(GROUP, NAME) \
+    class TH_CONCAT(bench_, TH_CONCAT(GROUP, TH_CONCAT(_, TH_CONCAT(NAME, TH_CONCAT(_, __LINE__))))) : public th::benchmark_base \
+    { \
+        public: \
+            TH_CONCAT(bench_, TH_CONCAT(GROUP, TH_CONCAT(_, TH_CONCAT(NAME, TH_CONCAT(_, __LINE__)))))() \
+                : benchmark_base(TH_STR(GROUP), TH_STR(NAME), __FILE__, __LINE__) {} \
+        protected: \
+            virtual void _run(uint64_t iterations); \
+    }; \
+    TH_CONCAT(bench_, TH_CONCAT(GROUP, TH_CONCAT(_, TH_CONCAT(NAME, TH_CONCAT(_, __LINE__))))) \
+        TH_CONCAT(_bench_instance_, TH_CONCAT(GROUP, TH_CONCAT(_, TH_CONCAT(NAME, TH_CONCAT(_, __LINE__))))); \
+    void TH_CONCAT(bench_, TH_CONCAT(GROUP, TH_CONCAT(_, TH_CONCAT(NAME, TH_CONCAT(_, __LINE__))))) :: _run(uint64_t iterations)
+
 #define ASSERT_TRUE(P)  th::predicate(__FILE__, __LINE__, TH_STR(P), NULL).assert_true(P)
 #define ASSERT_FALSE(P) th::predicate(__FILE__, __LINE__, TH_STR(P), NULL).assert_false(P)
 #define ASSERT_LT(a, b) th::predicate(__FILE__, __LINE__, TH_STR(a), TH_STR(b)).assert_lt(a, b)
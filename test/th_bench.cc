@@ -0,0 +1,301 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// C
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// C++
+#include <new>
+
+// STL
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/time.h>
+
+// th
+#include "th.h"
+
+// Every allocation made through operator new bumps this counter; benchmarks
+// report the difference across their timed region as allocs/op.  The
+// benchmarks run one at a time on the main thread, but a benchmark may start
+// threads of its own, so the counter is bumped atomically.
+static uint64_t _th_allocs = 0;
+
+#if __cplusplus >= 201103L
+#define TH_THROW_BAD_ALLOC
+#define TH_NOTHROW noexcept
+#else
+#define TH_THROW_BAD_ALLOC throw (std::bad_alloc)
+#define TH_NOTHROW throw ()
+#endif
+
+void*
+operator new (size_t sz) TH_THROW_BAD_ALLOC
+{
+    __sync_add_and_fetch(&_th_allocs, 1);
+    void* ptr = malloc(sz ? sz : 1);
+
+    if (!ptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return ptr;
+}
+
+void*
+operator new[] (size_t sz) TH_THROW_BAD_ALLOC
+{
+    return operator new (sz);
+}
+
+void
+operator delete (void* ptr) TH_NOTHROW
+{
+    free(ptr);
+}
+
+void
+operator delete[] (void* ptr) TH_NOTHROW
+{
+    free(ptr);
+}
+
+#ifdef __cpp_sized_deallocation
+void
+operator delete (void* ptr, size_t) TH_NOTHROW
+{
+    free(ptr);
+}
+
+void
+operator delete[] (void* ptr, size_t) TH_NOTHROW
+{
+    free(ptr);
+}
+#endif
+
+static std::vector<th::benchmark_base*>* _th_benchmarks = NULL;
+
+th :: benchmark_base :: benchmark_base(const char* group,
+                                       const char* name,
+                                       const char* file,
+                                       size_t line)
+    : m_group(group)
+    , m_name(name)
+    , m_file(file)
+    , m_line(line)
+    , m_timing(false)
+    , m_start(0)
+    , m_start_allocs(0)
+    , m_elapsed(0)
+    , m_allocs(0)
+    , m_bytes(0)
+{
+    if (_th_benchmarks == NULL)
+    {
+        _th_benchmarks = new std::vector<th::benchmark_base*>();
+    }
+
+    _th_benchmarks->push_back(this);
+}
+
+bool
+th :: benchmark_base :: matches(const char* filter) const
+{
+    if (!filter)
+    {
+        return true;
+    }
+
+    std::string full(m_group);
+    full += "::";
+    full += m_name;
+    return full.find(filter) != std::string::npos;
+}
+
+static uint64_t
+predict_iterations(uint64_t n, uint64_t elapsed, uint64_t target)
+{
+    // overshoot the estimate by 20%, but grow no more than 100x per round so
+    // that one unusually fast round cannot send the count off a cliff
+    const uint64_t max_iterations = 1000000000ULL;
+    uint64_t next = n * 100;
+
+    if (elapsed > 0)
+    {
+        next = static_cast<uint64_t>(static_cast<double>(target) * n / elapsed * 1.2);
+    }
+
+    next = std::min(next, n * 100);
+    next = std::max(next, n + 1);
+    return std::min(next, max_iterations);
+}
+
+void
+th :: benchmark_base :: run(uint64_t benchtime, uint64_t warmup, uint64_t iterations)
+{
+    // warm up, and learn roughly how long one iteration takes
+    uint64_t n = 1;
+    run_n(n);
+
+    while (m_elapsed < warmup && n < 1000000000ULL)
+    {
+        n = predict_iterations(n, m_elapsed, warmup);
+        run_n(n);
+    }
+
+    if (iterations > 0)
+    {
+        n = iterations;
+        run_n(n);
+    }
+    else
+    {
+        n = predict_iterations(n, m_elapsed, benchtime);
+        run_n(n);
+
+        while (m_elapsed < benchtime && n < 1000000000ULL)
+        {
+            n = predict_iterations(n, m_elapsed, benchtime);
+            run_n(n);
+        }
+    }
+
+    printf("%s::%s\t%llu\t%.1f ns/op\t%.2f allocs/op",
+           m_group, m_name, static_cast<unsigned long long>(n),
+           static_cast<double>(m_elapsed) / n,
+           static_cast<double>(m_allocs) / n);
+
+    if (m_bytes > 0 && m_elapsed > 0)
+    {
+        printf("\t%.2f MB/s", static_cast<double>(m_bytes) * n * 1e3 / m_elapsed);
+    }
+
+    printf("\n");
+    fflush(stdout);
+}
+
+bool
+th :: benchmark_base :: operator < (const benchmark_base& rhs) const
+{
+    int cmp = strcmp(m_file, rhs.m_file);
+
+    if (cmp != 0)
+    {
+        return cmp < 0;
+    }
+
+    return m_line < rhs.m_line;
+}
+
+void
+th :: benchmark_base :: start_timer()
+{
+    if (!m_timing)
+    {
+        m_start = po6::monotonic_time();
+        m_start_allocs = _th_allocs;
+        m_timing = true;
+    }
+}
+
+void
+th :: benchmark_base :: stop_timer()
+{
+    if (m_timing)
+    {
+        m_elapsed += po6::monotonic_time() - m_start;
+        m_allocs += _th_allocs - m_start_allocs;
+        m_timing = false;
+    }
+}
+
+void
+th :: benchmark_base :: reset_timer()
+{
+    m_elapsed = 0;
+    m_allocs = 0;
+
+    if (m_timing)
+    {
+        m_start = po6::monotonic_time();
+        m_start_allocs = _th_allocs;
+    }
+}
+
+void
+th :: benchmark_base :: run_n(uint64_t iterations)
+{
+    m_elapsed = 0;
+    m_allocs = 0;
+    start_timer();
+    this->_run(iterations);
+    stop_timer();
+}
+
+static bool
+compare_benchmark_base_ptrs(const th::benchmark_base* lhs, const th::benchmark_base* rhs)
+{
+    return *lhs < *rhs;
+}
+
+int
+th :: run_benchmarks(const char* filter, uint64_t benchtime, uint64_t warmup, uint64_t iterations)
+{
+    if (!_th_benchmarks)
+    {
+        return 0;
+    }
+
+    std::sort(_th_benchmarks->begin(), _th_benchmarks->end(), compare_benchmark_base_ptrs);
+    const std::vector<th::benchmark_base*>& th_benchmarks(*_th_benchmarks);
+    int failures = 0;
+
+    for (size_t i = 0; i < th_benchmarks.size(); ++i)
+    {
+        if (!th_benchmarks[i]->matches(filter))
+        {
+            continue;
+        }
+
+        try
+        {
+            th_benchmarks[i]->run(benchtime, warmup, iterations);
+        }
+        catch (...)
+        {
+            ++failures;
+        }
+    }
+
+    return failures;
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// C
+#include <cstdlib>
+#include <cstring>
+
+// th
+#include "th.h"
+
+// Usage:  <benchmark> [--benchtime=MS] [--warmup=MS] [--iterations=N] [FILTER]
+//
+// Each benchmark matching FILTER (a substring of "group::name") is run until
+// it has been timed for at least --benchtime milliseconds, after warming up
+// for --warmup milliseconds.  --iterations fixes the iteration count instead.
+// Results go to stdout, one tab-separated line per benchmark.
+
+static bool
+parse_flag(const char* arg, const char* flag, uint64_t* value)
+{
+    const size_t flag_sz = strlen(flag);
+
+    if (strncmp(arg, flag, flag_sz) != 0 || arg[flag_sz] != '=')
+    {
+        return false;
+    }
+
+    *value = strtoull(arg + flag_sz + 1, NULL, 10);
+    return true;
+}
+
+int
+main(int argc, char* argv[])
+{
+    const char* filter = NULL;
+    uint64_t benchtime = 1000;
+    uint64_t warmup = 100;
+    uint64_t iterations = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!parse_flag(argv[i], "--benchtime", &benchtime) &&
+            !parse_flag(argv[i], "--warmup", &warmup) &&
+            !parse_flag(argv[i], "--iterations", &iterations))
+        {
+            filter = argv[i];
+        }
+    }
+
+    return th::run_benchmarks(filter, benchtime * 1000000ULL, warmup * 1000000ULL, iterations);
+}
@@ -0,0 +1,124 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <string.h>
+
+// STL
+#include <string>
+
+// consus
+#include "test/th.h"
+#include "client/value_view.h"
+
+using consus::make_value_view;
+using consus::release_value_view;
+
+namespace
+{
+
+// a response buffer whose tail is the value, like the one a read arrives in
+std::auto_ptr<e::buffer>
+response(const char* value, e::slice* in_place)
+{
+    const size_t sz = strlen(value);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(16 + sz));
+    msg->resize(16 + sz);
+    memset(msg->data(), 0, 16);
+    memmove(msg->data() + 16, value, sz);
+    *in_place = e::slice(msg->data() + 16, sz);
+    return msg;
+}
+
+} // namespace
+
+TEST(ValueView, InPlaceWhenBacked)
+{
+    e::slice value;
+    std::auto_ptr<e::buffer> msg = response("in place", &value);
+    e::buffer* const expected = msg.get();
+    const char* data = NULL;
+    e::buffer* view = make_value_view(value, msg, &data);
+
+    // the response itself is the view; nothing was copied
+    ASSERT_TRUE(view == expected);
+    ASSERT_TRUE(data == value.cdata());
+    ASSERT_TRUE(memcmp(data, "in place", 8) == 0);
+    release_value_view(view);
+}
+
+TEST(ValueView, CopiesWithoutBacking)
+{
+    // a value from the read cache, which may be evicted while viewed
+    std::string* cached = new std::string("from the cache");
+    const char* data = NULL;
+    e::buffer* view = make_value_view(e::slice(*cached), std::auto_ptr<e::buffer>(), &data);
+    ASSERT_TRUE(view != NULL);
+    ASSERT_TRUE(data != cached->data());
+    delete cached;
+    ASSERT_EQ(view->size(), 14U);
+    ASSERT_TRUE(memcmp(data, "from the cache", 14) == 0);
+    release_value_view(view);
+}
+
+TEST(ValueView, CopiesWhenOutsideBacking)
+{
+    e::slice unused;
+    std::auto_ptr<e::buffer> msg = response("unrelated", &unused);
+    std::string elsewhere("elsewhere");
+    const char* data = NULL;
+    e::buffer* view = make_value_view(e::slice(elsewhere), msg, &data);
+    ASSERT_TRUE(view != NULL);
+    ASSERT_TRUE(data == reinterpret_cast<const char*>(view->data()));
+    ASSERT_EQ(view->size(), 9U);
+    ASSERT_TRUE(memcmp(data, "elsewhere", 9) == 0);
+
+    release_value_view(view);
+}
+
+TEST(ValueView, OutlivesItsSource)
+{
+    // the transaction and its pending read are gone by the time the caller
+    // looks at the value; only the view keeps it
+    const char* data = NULL;
+    e::buffer* view = NULL;
+
+    {
+        e::slice value;
+        std::auto_ptr<e::buffer> msg = response("still here", &value);
+        view = make_value_view(value, msg, &data);
+    }
+
+    ASSERT_TRUE(memcmp(data, "still here", 10) == 0);
+    release_value_view(view);
+}
+
+TEST(ValueView, ReleaseNotFound)
+{
+    // a key that is not found yields a NULL handle, which may be released
+    release_value_view(NULL);
+}
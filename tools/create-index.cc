@@ -0,0 +1,82 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// e
+#include <e/guard.h>
+#include <e/popt.h>
+
+// consus
+#include <consus-admin.h>
+#include "tools/common.h"
+
+int
+main(int argc, const char* argv[])
+{
+    consus::connect_opts conn;
+    e::argparser ap;
+    ap.autohelp();
+    ap.option_string("[OPTIONS] <table> <field>");
+    ap.add("Connect to a cluster:", conn.parser());
+
+    if (!ap.parse(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (!conn.validate())
+    {
+        std::cerr << "consus-create-index: invalid host:port specification\n" << std::endl;
+        ap.usage();
+        return EXIT_FAILURE;
+    }
+
+    if (ap.args_sz() != 2)
+    {
+        std::cerr << "consus-create-index takes two positional arguments\n" << std::endl;
+        ap.usage();
+        return EXIT_FAILURE;
+    }
+
+    consus_client* cl = consus_create_conn_str(conn.conn_str());
+
+    if (!cl)
+    {
+        std::cerr << "consus-create-index: memory allocation failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    e::guard g_cl = e::makeguard(consus_destroy, cl);
+    consus_returncode rc;
+
+    if (consus_admin_create_index(cl, ap.args()[0], ap.args()[1], &rc) < 0)
+    {
+        std::cerr << "consus-create-index: " << consus_error_message(cl) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
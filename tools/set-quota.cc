@@ -0,0 +1,121 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <algorithm>
+
+// e
+#include <e/guard.h>
+#include <e/popt.h>
+
+// consus
+#include <consus-admin.h>
+#include "tools/common.h"
+
+int
+main(int argc, const char* argv[])
+{
+    long ops = -1;
+    long bytes = -1;
+    long idle = -1;
+    consus::connect_opts conn;
+    e::argparser ap;
+    ap.autohelp();
+    ap.option_string("[OPTIONS] [table]");
+    ap.arg().long_name("ops")
+            .description("accept at most N operations per second (0 for unlimited)")
+            .metavar("N").as_long(&ops);
+    ap.arg().long_name("bytes")
+            .description("accept at most N bytes of keys and values per second (0 for unlimited)")
+            .metavar("N").as_long(&bytes);
+    ap.arg().long_name("idle-timeout")
+            .description("abort transactions whose client is idle for MS milliseconds (default: unchanged, 0 for the server default)")
+            .metavar("MS").as_long(&idle);
+    ap.add("Connect to a cluster:", conn.parser());
+
+    if (!ap.parse(argc, argv))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (!conn.validate())
+    {
+        std::cerr << "consus-set-quota: invalid host:port specification\n" << std::endl;
+        ap.usage();
+        return EXIT_FAILURE;
+    }
+
+    if (ap.args_sz() > 1)
+    {
+        std::cerr << "consus-set-quota takes at most one positional argument\n" << std::endl;
+        ap.usage();
+        return EXIT_FAILURE;
+    }
+
+    if (ops < -1 || bytes < -1 || idle < -1)
+    {
+        std::cerr << "consus-set-quota: negative values make no sense\n" << std::endl;
+        ap.usage();
+        return EXIT_FAILURE;
+    }
+
+    if (ops < 0 && bytes < 0 && idle < 0)
+    {
+        std::cerr << "consus-set-quota: specify at least one of --ops, --bytes, or --idle-timeout\n" << std::endl;
+        ap.usage();
+        return EXIT_FAILURE;
+    }
+
+    consus_client* cl = consus_create_conn_str(conn.conn_str());
+
+    if (!cl)
+    {
+        std::cerr << "consus-set-quota: memory allocation failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    e::guard g_cl = e::makeguard(consus_destroy, cl);
+    consus_returncode rc;
+    // without a table, the quota applies to each client
+    const char* table = ap.args_sz() == 1 ? ap.args()[0] : NULL;
+
+    if ((ops >= 0 || bytes >= 0) &&
+        consus_admin_set_quota(cl, table, std::max(ops, 0L), std::max(bytes, 0L), &rc) < 0)
+    {
+        std::cerr << "consus-set-quota: " << consus_error_message(cl) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (idle >= 0 &&
+        consus_admin_set_idle_timeout(cl, table, idle, &rc) < 0)
+    {
+        std::cerr << "consus-set-quota: " << consus_error_message(cl) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <assert.h>
+#include <string.h>
+
+// STL
+#include <algorithm>
+#include <new>
+
+// consus
+#include "txman/arena.h"
+
+using consus::arena;
+
+struct arena::block
+{
+    block* next;
+    size_t size;
+    // followed by size bytes of storage
+};
+
+static size_t
+round_up(size_t sz)
+{
+    return (sz + 7) & ~size_t(7);
+}
+
+arena :: arena()
+    : m_ptr(reinterpret_cast<char*>(m_inline))
+    , m_end(reinterpret_cast<char*>(m_inline) + INLINE_SIZE)
+    , m_blocks_head(NULL)
+    , m_next_block(MIN_BLOCK)
+    , m_allocations(0)
+    , m_bytes(0)
+    , m_reserved(0)
+    , m_blocks(0)
+{
+}
+
+arena :: ~arena() throw ()
+{
+    while (m_blocks_head)
+    {
+        block* b = m_blocks_head;
+        m_blocks_head = b->next;
+        free(b);
+    }
+}
+
+void*
+arena :: allocate(size_t sz)
+{
+    ++m_allocations;
+    m_bytes += sz;
+    sz = round_up(sz);
+
+    if (static_cast<size_t>(m_end - m_ptr) < sz)
+    {
+        return allocate_slow(sz);
+    }
+
+    void* ret = m_ptr;
+    m_ptr += sz;
+    return ret;
+}
+
+e::slice
+arena :: copy(const e::slice& s)
+{
+    if (s.empty())
+    {
+        return e::slice();
+    }
+
+    void* ptr = allocate(s.size());
+    memmove(ptr, s.data(), s.size());
+    return e::slice(ptr, s.size());
+}
+
+void*
+arena :: allocate_slow(size_t sz)
+{
+    // a request bigger than a quarter of the next block gets a block of its
+    // own, so the current block stays available for the small ones
+    const bool dedicated = sz > m_next_block / 4;
+    const size_t body = dedicated ? sz : m_next_block;
+    const size_t header = round_up(sizeof(block));
+    block* b = static_cast<block*>(malloc(header + body));
+
+    if (!b)
+    {
+        throw std::bad_alloc();
+    }
+
+    b->next = m_blocks_head;
+    b->size = body;
+    m_blocks_head = b;
+    m_reserved += header + body;
+    ++m_blocks;
+    char* storage = reinterpret_cast<char*>(b) + header;
+
+    if (dedicated)
+    {
+        return storage;
+    }
+
+    m_next_block = std::min(m_next_block * 2, size_t(MAX_BLOCK));
+    m_ptr = storage + sz;
+    m_end = storage + body;
+    return storage;
+}
@@ -0,0 +1,94 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_txman_arena_h_
+#define consus_txman_arena_h_
+
+// C
+#include <stdint.h>
+#include <stdlib.h>
+
+// e
+#include <e/slice.h>
+
+// consus
+#include "namespace.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// A region that the bytes a transaction keeps for its lifetime (copies of
+// keys and values, values read on its behalf) are carved out of.  Nothing is
+// freed piecemeal; all of it goes at once with the arena.  The first few
+// hundred bytes live inside the arena itself, which covers the common small
+// transaction without touching malloc; beyond that it allocates blocks that
+// double in size up to a cap, and gives oversized requests a block of their
+// own.
+class arena
+{
+    public:
+        arena();
+        ~arena() throw ();
+
+    public:
+        // 8-byte aligned
+        void* allocate(size_t sz);
+        e::slice copy(const e::slice& s);
+
+    public:
+        // calls to allocate/copy, and the bytes they asked for
+        uint64_t allocations() const { return m_allocations; }
+        uint64_t bytes() const { return m_bytes; }
+        // bytes held from malloc, and the number of blocks holding them
+        uint64_t reserved() const { return m_reserved; }
+        uint64_t blocks() const { return m_blocks; }
+
+    private:
+        struct block;
+        static const size_t INLINE_SIZE = 512;
+        static const size_t MIN_BLOCK = 2048;
+        static const size_t MAX_BLOCK = 65536;
+        void* allocate_slow(size_t sz);
+
+    private:
+        char* m_ptr;
+        char* m_end;
+        block* m_blocks_head;
+        size_t m_next_block;
+        uint64_t m_allocations;
+        uint64_t m_bytes;
+        uint64_t m_reserved;
+        uint64_t m_blocks;
+        uint64_t m_inline[INLINE_SIZE / sizeof(uint64_t)];
+
+    private:
+        arena(const arena&);
+        arena& operator = (const arena&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_txman_arena_h_
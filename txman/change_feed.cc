@@ -0,0 +1,618 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <assert.h>
+#include <string.h>
+
+// POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// STL
+#include <algorithm>
+#include <sstream>
+
+// e
+#include <e/endian.h>
+
+// consus
+#include "common/constants.h"
+#include "common/crc32c.h"
+#include "txman/change_feed.h"
+
+using consus::change_feed;
+
+#define RECORD_HEADER_SIZE sizeof(uint64_t)
+#define RECORD_FOOTER_SIZE sizeof(uint32_t)
+
+struct change_feed :: segment
+{
+    segment(int x) : fd(x), offset(0), first(0) {}
+    po6::io::fd fd;
+    uint64_t offset;
+    // position of the first change in the segment; 0 when empty
+    uint64_t first;
+
+    private:
+        segment(const segment&);
+        segment& operator = (const segment&);
+};
+
+change_feed :: change :: change()
+    : position(0)
+    , timestamp(0)
+    , txid()
+    , table()
+    , key()
+    , value()
+{
+}
+
+change_feed :: change :: ~change() throw ()
+{
+}
+
+change_feed :: waiter :: waiter()
+    : id()
+    , nonce(0)
+    , cursor(0)
+    , max_bytes(0)
+    , deadline(0)
+{
+}
+
+change_feed :: waiter :: ~waiter() throw ()
+{
+}
+
+change_feed :: change_feed()
+    : m_mtx()
+    , m_cond(&m_mtx)
+    , m_dir()
+    , m_active(0)
+    , m_error(0)
+    , m_changes()
+    , m_next_position(1)
+    , m_durable_position(1)
+    , m_waiters()
+    , m_durable_waiters()
+{
+    m_segments[0] = NULL;
+    m_segments[1] = NULL;
+}
+
+change_feed :: ~change_feed() throw ()
+{
+    delete m_segments[0];
+    delete m_segments[1];
+}
+
+bool
+change_feed :: open(const std::string& dir)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    struct stat st;
+    int ret = stat(dir.c_str(), &st);
+
+    if (ret < 0 && errno == ENOENT)
+    {
+        if (mkdir(dir.c_str(), S_IRWXU) < 0)
+        {
+            m_error = errno;
+            return false;
+        }
+
+        ret = stat(dir.c_str(), &st);
+    }
+
+    if (ret < 0)
+    {
+        m_error = errno;
+        return false;
+    }
+    else if (!S_ISDIR(st.st_mode))
+    {
+        m_error = errno = ENOTDIR;
+        return false;
+    }
+
+    m_dir = ::open(dir.c_str(), O_RDONLY);
+
+    if (m_dir.get() < 0)
+    {
+        m_error = errno;
+        return false;
+    }
+
+    int file_a = openat(m_dir.get(), "changes_a", O_RDWR|O_CREAT, S_IRUSR|S_IWUSR);
+    int file_b = openat(m_dir.get(), "changes_b", O_RDWR|O_CREAT, S_IRUSR|S_IWUSR);
+
+    if (file_a < 0 || file_b < 0)
+    {
+        m_error = errno;
+        ::close(file_a);
+        ::close(file_b);
+        return false;
+    }
+
+    m_segments[0] = new segment(file_a);
+    m_segments[1] = new segment(file_b);
+    std::vector<change> changes[2];
+
+    if (!replay(m_segments[0], &changes[0]) ||
+        !replay(m_segments[1], &changes[1]))
+    {
+        return false;
+    }
+
+    // the segment with the newer changes is the one to keep appending to
+    unsigned older = 0;
+    unsigned newer = 1;
+
+    if (m_segments[1]->first < m_segments[0]->first)
+    {
+        std::swap(older, newer);
+    }
+
+    if (changes[newer].empty())
+    {
+        std::swap(older, newer);
+    }
+
+    m_active = newer;
+
+    // only keep the older segment's changes if they lead right up to the
+    // newer segment's; the deque must be contiguous
+    if (!changes[older].empty() && !changes[newer].empty() &&
+        changes[older].back().position + 1 == changes[newer].front().position)
+    {
+        m_changes.insert(m_changes.end(), changes[older].begin(), changes[older].end());
+    }
+
+    m_changes.insert(m_changes.end(), changes[newer].begin(), changes[newer].end());
+
+    if (!m_changes.empty())
+    {
+        m_next_position = m_changes.back().position + 1;
+    }
+
+    m_durable_position = m_next_position;
+    return true;
+}
+
+void
+change_feed :: close()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    if (m_error == 0)
+    {
+        m_error = -1;
+    }
+
+    m_cond.broadcast();
+}
+
+int
+change_feed :: error()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return m_error;
+}
+
+uint64_t
+change_feed :: publish(std::vector<change>* changes)
+{
+    if (changes->empty())
+    {
+        return 0;
+    }
+
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    // a failed feed never becomes durable again, so this position is never
+    // reached and the transaction is never acknowledged
+    if (m_error != 0)
+    {
+        return m_next_position + changes->size();
+    }
+
+    std::string body;
+    e::packer pa(&body);
+    pa = pa << uint64_t(changes->size());
+
+    for (size_t i = 0; i < changes->size(); ++i)
+    {
+        (*changes)[i].position = m_next_position + i;
+        pa = pa << (*changes)[i];
+    }
+
+    unsigned char header[RECORD_HEADER_SIZE];
+    unsigned char footer[RECORD_FOOTER_SIZE];
+    e::pack64be(body.size(), header);
+    e::pack32be(crc32c(0, reinterpret_cast<const unsigned char*>(body.data()), body.size()), footer);
+    std::string record;
+    record.reserve(RECORD_HEADER_SIZE + body.size() + RECORD_FOOTER_SIZE);
+    record.append(reinterpret_cast<const char*>(header), RECORD_HEADER_SIZE);
+    record.append(body);
+    record.append(reinterpret_cast<const char*>(footer), RECORD_FOOTER_SIZE);
+    segment* seg = m_segments[m_active];
+
+    if (seg->offset > 0 && seg->offset + record.size() > CONSUS_CHANGE_FEED_SEGMENT)
+    {
+        rotate();
+        seg = m_segments[m_active];
+    }
+
+    if (m_error != 0 ||
+        pwrite(seg->fd.get(), record.data(), record.size(), seg->offset) < 0)
+    {
+        m_error = m_error != 0 ? m_error : errno;
+        m_cond.broadcast();
+        return m_next_position + changes->size();
+    }
+
+    seg->offset += record.size();
+
+    if (seg->first == 0)
+    {
+        seg->first = m_next_position;
+    }
+
+    m_next_position += changes->size();
+    m_changes.insert(m_changes.end(), changes->begin(), changes->end());
+    m_cond.broadcast();
+    return m_next_position;
+}
+
+bool
+change_feed :: sync()
+{
+    uint64_t target;
+    int fds[2];
+
+    {
+        po6::threads::mutex::hold hold(&m_mtx);
+
+        while (m_error == 0 && m_durable_position == m_next_position)
+        {
+            m_cond.wait();
+        }
+
+        if (m_error != 0)
+        {
+            return false;
+        }
+
+        target = m_next_position;
+        fds[0] = m_segments[0]->fd.get();
+        fds[1] = m_segments[1]->fd.get();
+    }
+
+    // a rotation may have put some of the changes in the other segment
+    if (fsync(fds[0]) < 0 || fsync(fds[1]) < 0)
+    {
+        int e = errno;
+        po6::threads::mutex::hold hold(&m_mtx);
+        m_error = e;
+        return false;
+    }
+
+    po6::threads::mutex::hold hold(&m_mtx);
+    m_durable_position = std::max(m_durable_position, target);
+    return m_error == 0;
+}
+
+bool
+change_feed :: durable_or_wait(uint64_t position, const transaction_group& tg)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    if (position <= m_durable_position)
+    {
+        return true;
+    }
+
+    for (size_t i = 0; i < m_durable_waiters.size(); ++i)
+    {
+        if (m_durable_waiters[i].second == tg)
+        {
+            return false;
+        }
+    }
+
+    m_durable_waiters.push_back(std::make_pair(position, tg));
+    return false;
+}
+
+void
+change_feed :: durable_transactions(std::vector<transaction_group>* tgs)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    for (size_t i = 0; i < m_durable_waiters.size(); )
+    {
+        if (m_durable_waiters[i].first <= m_durable_position)
+        {
+            tgs->push_back(m_durable_waiters[i].second);
+            m_durable_waiters[i] = m_durable_waiters.back();
+            m_durable_waiters.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+uint64_t
+change_feed :: read(uint64_t cursor, uint64_t max_bytes, std::vector<change>* changes)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return read_lock_held(cursor, max_bytes, changes);
+}
+
+bool
+change_feed :: read_or_wait(const waiter& w, std::vector<change>* changes, uint64_t* next)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    if (!available(w.cursor))
+    {
+        m_waiters.push_back(w);
+        return false;
+    }
+
+    *next = read_lock_held(w.cursor, w.max_bytes, changes);
+    return true;
+}
+
+void
+change_feed :: ready_waiters(uint64_t now, std::vector<waiter>* ws)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    for (size_t i = 0; i < m_waiters.size(); )
+    {
+        if (m_waiters[i].deadline <= now || available(m_waiters[i].cursor))
+        {
+            ws->push_back(m_waiters[i]);
+            m_waiters[i] = m_waiters.back();
+            m_waiters.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+std::string
+change_feed :: debug_dump()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    std::ostringstream ostr;
+    ostr << "retained=[" << (m_changes.empty() ? m_next_position : m_changes.front().position)
+         << ", " << m_next_position << ") durable<" << m_durable_position
+         << " waiters=" << m_waiters.size() << "\n";
+
+    for (unsigned i = 0; i < 2; ++i)
+    {
+        if (m_segments[i])
+        {
+            ostr << "segment " << i << (i == m_active ? " (active)" : "")
+                 << ": bytes=" << m_segments[i]->offset
+                 << " first=" << m_segments[i]->first << "\n";
+        }
+    }
+
+    return ostr.str();
+}
+
+bool
+change_feed :: replay(segment* seg, std::vector<change>* changes)
+{
+    struct stat st;
+
+    if (fstat(seg->fd.get(), &st) < 0)
+    {
+        m_error = errno;
+        return false;
+    }
+
+    std::vector<unsigned char> buf(st.st_size);
+
+    if (!buf.empty() && seg->fd.xread(&buf[0], buf.size()) != ssize_t(buf.size()))
+    {
+        m_error = errno;
+        return false;
+    }
+
+    uint64_t offset = 0;
+
+    // stop at the first torn or corrupt record; it and what follows were
+    // never acknowledged as durable
+    while (offset + RECORD_HEADER_SIZE + RECORD_FOOTER_SIZE <= buf.size())
+    {
+        uint64_t sz;
+        uint32_t crc;
+        e::unpack64be(&buf[offset], &sz);
+
+        if (sz > buf.size() - offset - RECORD_HEADER_SIZE - RECORD_FOOTER_SIZE)
+        {
+            break;
+        }
+
+        const unsigned char* body = &buf[offset + RECORD_HEADER_SIZE];
+        e::unpack32be(body + sz, &crc);
+
+        if (crc32c(0, body, sz) != crc)
+        {
+            break;
+        }
+
+        e::unpacker up(reinterpret_cast<const char*>(body), sz);
+        uint64_t count;
+        up = up >> count;
+        std::vector<change> record;
+
+        for (uint64_t i = 0; !up.error() && i < count; ++i)
+        {
+            record.push_back(change());
+            up = up >> record.back();
+        }
+
+        if (up.error() ||
+            (!changes->empty() && !record.empty() &&
+             changes->back().position + 1 != record.front().position))
+        {
+            break;
+        }
+
+        changes->insert(changes->end(), record.begin(), record.end());
+        offset += RECORD_HEADER_SIZE + sz + RECORD_FOOTER_SIZE;
+    }
+
+    if (ftruncate(seg->fd.get(), offset) < 0)
+    {
+        m_error = errno;
+        return false;
+    }
+
+    seg->offset = offset;
+    seg->first = changes->empty() ? 0 : changes->front().position;
+    return true;
+}
+
+bool
+change_feed :: available(uint64_t cursor)
+{
+    if (m_changes.empty())
+    {
+        return false;
+    }
+
+    // a cursor from before the retained history, or from a feed that has
+    // since been lost, starts over at the oldest change
+    if (cursor < m_changes.front().position || cursor > m_next_position)
+    {
+        cursor = m_changes.front().position;
+    }
+
+    return cursor < m_durable_position;
+}
+
+uint64_t
+change_feed :: read_lock_held(uint64_t cursor, uint64_t max_bytes, std::vector<change>* changes)
+{
+    if (m_changes.empty())
+    {
+        return cursor;
+    }
+
+    if (cursor < m_changes.front().position || cursor > m_next_position)
+    {
+        cursor = m_changes.front().position;
+    }
+
+    size_t bytes = 0;
+
+    for (size_t idx = cursor - m_changes.front().position;
+            idx < m_changes.size() && m_changes[idx].position < m_durable_position; ++idx)
+    {
+        const size_t sz = pack_size(m_changes[idx]);
+
+        if (!changes->empty() && bytes + sz > max_bytes)
+        {
+            break;
+        }
+
+        changes->push_back(m_changes[idx]);
+        bytes += sz;
+        cursor = m_changes[idx].position + 1;
+    }
+
+    return cursor;
+}
+
+void
+change_feed :: rotate()
+{
+    // the inactive segment holds the oldest changes; they go away with it
+    const unsigned other = 1 - m_active;
+    const uint64_t keep = m_segments[m_active]->first;
+
+    while (!m_changes.empty() && m_changes.front().position < keep)
+    {
+        m_changes.pop_front();
+    }
+
+    if (ftruncate(m_segments[other]->fd.get(), 0) < 0)
+    {
+        m_error = errno;
+        return;
+    }
+
+    m_segments[other]->offset = 0;
+    m_segments[other]->first = 0;
+    m_active = other;
+}
+
+e::packer
+consus :: operator << (e::packer pa, const change_feed::change& rhs)
+{
+    return pa << rhs.position << rhs.timestamp << rhs.txid
+              << e::slice(rhs.table) << e::slice(rhs.key) << e::slice(rhs.value);
+}
+
+e::unpacker
+consus :: operator >> (e::unpacker up, change_feed::change& rhs)
+{
+    e::slice table;
+    e::slice key;
+    e::slice value;
+    up = up >> rhs.position >> rhs.timestamp >> rhs.txid
+            >> table >> key >> value;
+    rhs.table = table.str();
+    rhs.key = key.str();
+    rhs.value = value.str();
+    return up;
+}
+
+size_t
+consus :: pack_size(const change_feed::change& c)
+{
+    return 2 * sizeof(uint64_t)
+         + pack_size(c.txid)
+         + pack_size(e::slice(c.table))
+         + pack_size(e::slice(c.key))
+         + pack_size(e::slice(c.value));
+}
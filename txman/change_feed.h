@@ -0,0 +1,158 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_txman_change_feed_h_
+#define consus_txman_change_feed_h_
+
+// STL
+#include <deque>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/io/fd.h>
+#include <po6/threads/cond.h>
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/serialization.h>
+
+// consus
+#include "namespace.h"
+#include "common/ids.h"
+#include "common/transaction_group.h"
+#include "common/transaction_id.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// The change feed is the durable record of the writes committed by the
+// transactions this transaction manager executed, numbered by position in the
+// order they committed here.  It lives in a pair of segment files that are
+// written alternately; when the active one fills, the other is truncated and
+// takes over, so the feed retains between one and two segments of history.
+// Everything on disk is also held in memory to serve readers, so memory is
+// bounded by the same two segments.
+//
+// Transactions append their writes before acknowledging the commit and wait
+// for the feed to reach disk, so every acknowledged commit is in the feed.
+class change_feed
+{
+    public:
+        struct change
+        {
+            change();
+            ~change() throw ();
+
+            uint64_t position;
+            uint64_t timestamp;
+            transaction_id txid;
+            std::string table;
+            std::string key;
+            std::string value;
+        };
+        // a reader waiting for changes past its cursor
+        struct waiter
+        {
+            waiter();
+            ~waiter() throw ();
+
+            comm_id id;
+            uint64_t nonce;
+            uint64_t cursor;
+            uint64_t max_bytes;
+            uint64_t deadline;
+        };
+
+    public:
+        change_feed();
+        ~change_feed() throw ();
+
+    public:
+        bool open(const std::string& dir);
+        void close();
+        int error();
+        // assign positions to and append the writes of one transaction; they
+        // become visible to readers once sync() makes them durable.  Returns
+        // the position just past the last of them, or 0 if there were none.
+        uint64_t publish(std::vector<change>* changes);
+        // block until there are published changes and make them durable;
+        // returns false once the feed is closed or has failed
+        bool sync();
+        // true if everything before position is durable; otherwise tg is
+        // remembered until it is
+        bool durable_or_wait(uint64_t position, const transaction_group& tg);
+        // remove the remembered transactions whose writes are now durable
+        void durable_transactions(std::vector<transaction_group>* tgs);
+        // collect durable changes at or after cursor, up to max_bytes but
+        // always at least one if any is available; a cursor older than the
+        // retained history starts at the oldest retained change.  Returns the
+        // cursor for the next read.
+        uint64_t read(uint64_t cursor, uint64_t max_bytes, std::vector<change>* changes);
+        // as above, but if there is nothing to read, park w and return false
+        bool read_or_wait(const waiter& w, std::vector<change>* changes, uint64_t* next);
+        // remove the parked readers that now have something to read or that
+        // have waited past their deadline
+        void ready_waiters(uint64_t now, std::vector<waiter>* ws);
+        std::string debug_dump();
+
+    private:
+        struct segment;
+
+    private:
+        bool replay(segment* seg, std::vector<change>* changes);
+        bool available(uint64_t cursor);
+        uint64_t read_lock_held(uint64_t cursor, uint64_t max_bytes, std::vector<change>* changes);
+        void rotate();
+
+    private:
+        po6::threads::mutex m_mtx;
+        po6::threads::cond m_cond;
+        po6::io::fd m_dir;
+        segment* m_segments[2];
+        unsigned m_active;
+        int m_error;
+        std::deque<change> m_changes;
+        uint64_t m_next_position;
+        uint64_t m_durable_position;
+        std::vector<waiter> m_waiters;
+        std::vector<std::pair<uint64_t, transaction_group> > m_durable_waiters;
+
+    private:
+        change_feed(const change_feed&);
+        change_feed& operator = (const change_feed&);
+};
+
+e::packer
+operator << (e::packer pa, const change_feed::change& rhs);
+e::unpacker
+operator >> (e::unpacker up, change_feed::change& rhs);
+size_t
+pack_size(const change_feed::change& c);
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_txman_change_feed_h_
@@ -25,9 +25,15 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+// C
+#include <string.h>
+
 // STL
 #include <set>
 
+// po6
+#include <po6/time.h>
+
 // consus
 #include "common/txman_configuration.h"
 #include "txman/configuration.h"
@@ -42,6 +48,8 @@ configuration :: configuration()
     , m_txmans()
     , m_paxos_groups()
     , m_kvss()
+    , m_quotas()
+    , m_indexes()
 {
 }
 
@@ -219,14 +227,76 @@ configuration :: choose_kvs(data_center_id dc) const
     return comm_id();
 }
 
+uint64_t
+configuration :: idle_timeout() const
+{
+    for (size_t i = 0; i < m_quotas.size(); ++i)
+    {
+        if (m_quotas[i].scope == quota::CLIENT)
+        {
+            return m_quotas[i].idle_timeout_ms * PO6_MILLIS;
+        }
+    }
+
+    return 0;
+}
+
+uint64_t
+configuration :: idle_timeout(const e::slice& table) const
+{
+    for (size_t i = 0; i < m_quotas.size(); ++i)
+    {
+        if (m_quotas[i].scope == quota::TABLE &&
+            m_quotas[i].name.size() == table.size() &&
+            memcmp(m_quotas[i].name.data(), table.data(), table.size()) == 0)
+        {
+            return m_quotas[i].idle_timeout_ms * PO6_MILLIS;
+        }
+    }
+
+    return 0;
+}
+
+void
+configuration :: indexes_for(const e::slice& table, std::vector<secondary_index>* indexes) const
+{
+    indexes->clear();
+
+    for (size_t i = 0; i < m_indexes.size(); ++i)
+    {
+        if (m_indexes[i].table.size() == table.size() &&
+            memcmp(m_indexes[i].table.data(), table.data(), table.size()) == 0)
+        {
+            indexes->push_back(m_indexes[i]);
+        }
+    }
+}
+
+const secondary_index*
+configuration :: get_index(const e::slice& table, const e::slice& field) const
+{
+    for (size_t i = 0; i < m_indexes.size(); ++i)
+    {
+        if (m_indexes[i].table.size() == table.size() &&
+            memcmp(m_indexes[i].table.data(), table.data(), table.size()) == 0 &&
+            m_indexes[i].field.size() == field.size() &&
+            memcmp(m_indexes[i].field.data(), field.data(), field.size()) == 0)
+        {
+            return &m_indexes[i];
+        }
+    }
+
+    return NULL;
+}
+
 std::string
 configuration :: dump() const
 {
-    return txman_configuration(m_cluster, m_version, m_flags, m_dcs, m_txmans, m_paxos_groups, m_kvss);
+    return txman_configuration(m_cluster, m_version, m_flags, m_dcs, m_txmans, m_paxos_groups, m_kvss, m_quotas, m_indexes);
 }
 
 e::unpacker
 consus :: operator >> (e::unpacker up, configuration& c)
 {
-    return txman_configuration(up, &c.m_cluster, &c.m_version, &c.m_flags, &c.m_dcs, &c.m_txmans, &c.m_paxos_groups, &c.m_kvss);
+    return txman_configuration(up, &c.m_cluster, &c.m_version, &c.m_flags, &c.m_dcs, &c.m_txmans, &c.m_paxos_groups, &c.m_kvss, &c.m_quotas, &c.m_indexes);
 }
@@ -34,6 +34,8 @@
 #include "common/ids.h"
 #include "common/kvs.h"
 #include "common/paxos_group.h"
+#include "common/quota.h"
+#include "common/secondary_index.h"
 #include "common/txman.h"
 #include "common/txman_state.h"
 
@@ -70,6 +72,18 @@ class configuration
     public:
         comm_id choose_kvs(data_center_id dc) const;
 
+    // rate limits
+    public:
+        const std::vector<quota>& quotas() const { return m_quotas; }
+        // idle timeouts in nanoseconds; zero when none is configured
+        uint64_t idle_timeout() const;
+        uint64_t idle_timeout(const e::slice& table) const;
+
+    // secondary indexes
+    public:
+        void indexes_for(const e::slice& table, std::vector<secondary_index>* indexes) const;
+        const secondary_index* get_index(const e::slice& table, const e::slice& field) const;
+
     // debug/internal
     public:
         std::string dump() const;
@@ -85,6 +99,8 @@ class configuration
         std::vector<txman_state> m_txmans;
         std::vector<paxos_group> m_paxos_groups;
         std::vector<kvs> m_kvss;
+        std::vector<quota> m_quotas;
+        std::vector<secondary_index> m_indexes;
 
     private:
         configuration(const configuration& other);
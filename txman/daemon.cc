@@ -42,6 +42,7 @@
 
 // STL
 #include <algorithm>
+#include <sstream>
 
 // Google Log
 #include <glog/logging.h>
@@ -51,6 +52,7 @@
 #include <po6/errno.h>
 #include <po6/io/fd.h>
 #include <po6/path.h>
+#include <po6/time.h>
 
 // e
 #include <e/atomic.h>
@@ -61,11 +63,15 @@
 #include <e/strescape.h>
 
 // consus
+#include "common/background_thread.h"
 #include "common/coordinator_returncode.h"
 #include "common/generate_token.h"
 #include "common/macros.h"
+#include "common/message.h"
 #include "common/util.h"
 #include "txman/daemon.h"
+#include "txman/deferred_queue.h"
+#include "txman/indexing.h"
 #include "txman/log_entry_t.h"
 
 using consus::daemon;
@@ -88,6 +94,7 @@ using consus::daemon;
 uint32_t s_interrupts = 0;
 bool s_debug_dump = false;
 bool s_debug_mode = false;
+long s_idle_timeout = 60;
 
 static void
 exit_on_signal(int /*signum*/)
@@ -108,6 +115,15 @@ handle_debug_mode(int /*signum*/)
     s_debug_mode = !s_debug_mode;
 }
 
+// bound on the length of a wait-for path a deadlock probe will follow
+static const uint64_t s_deadlock_probe_hops = 16;
+
+static const consus::transaction_group&
+younger(const consus::transaction_group& lhs, const consus::transaction_group& rhs)
+{
+    return lhs.txid.preempts(rhs.txid) ? rhs : lhs;
+}
+
 struct daemon::coordinator_callback : public coordinator_link::callback
 {
     coordinator_callback(daemon* d);
@@ -148,6 +164,7 @@ daemon :: coordinator_callback :: new_config(const char* data, size_t data_sz)
 
     configuration* old_config = d->get_config();
     d->m_us.dc = c->get_data_center(d->m_us.id);
+    d->m_limiter.reconfigure(c->quotas(), po6::monotonic_time());
     e::atomic::store_ptr_release(&d->m_config, c.release());
     d->m_gc.collect(old_config, e::garbage_collector::free_ptr<configuration>);
     LOG(INFO) << "updating to configuration " << d->get_config()->version();
@@ -232,15 +249,33 @@ daemon :: daemon()
     , m_global_voters(&m_gc)
     , m_dispositions(&m_gc)
     , m_readers(&m_gc)
+    , m_scanners(&m_gc)
     , m_writers(&m_gc)
     , m_lock_ops(&m_gc)
+    , m_deadlocks()
+    , m_limiter()
+    , m_chunks()
+    , m_chunk_sender()
     , m_log()
     , m_durable_thread(po6::threads::make_obj_func(&daemon::durable, this))
-    , m_durable_mtx()
-    , m_durable_up_to(-1)
-    , m_durable_msgs()
-    , m_durable_cbs()
+    , m_durable_bound(0)
+    , m_durable_waiters()
+    , m_owners()
+    , m_changes()
+    , m_changes_thread(po6::threads::make_obj_func(&daemon::changes, this))
     , m_pumping_thread(po6::threads::make_obj_func(&daemon::pump, this))
+    , m_local(this)
+    , m_local_thread(po6::threads::make_obj_func(&daemon::local, this))
+    , m_class_active()
+    , m_class_begun()
+    , m_class_committed()
+    , m_class_aborted()
+    , m_idle_aborts(0)
+    , m_arena_txns(0)
+    , m_arena_allocations(0)
+    , m_arena_bytes(0)
+    , m_arena_reserved(0)
+    , m_arena_blocks(0)
 {
 }
 
@@ -290,6 +325,12 @@ daemon :: run(bool background,
         return EXIT_FAILURE;
     }
 
+    if (!m_changes.open(po6::path::join(data, "changes")))
+    {
+        LOG(ERROR) << "could not open change feed: " << po6::strerror(m_changes.error());
+        return EXIT_FAILURE;
+    }
+
     bool saved;
     uint64_t id;
     std::string rendezvous(coordinator);
@@ -342,8 +383,18 @@ daemon :: run(bool background,
     }
 
     m_busybee.reset(busybee_server::create(&m_busybee_controller, id, bind_to, &m_gc));
+
+    for (size_t i = 0; i < std::max(threads, 1U); ++i)
+    {
+        e::compat::shared_ptr<owner_thread> o(new owner_thread(this, i));
+        m_owners.push_back(o);
+        o->start();
+    }
+
     m_durable_thread.start();
+    m_changes_thread.start();
     m_pumping_thread.start();
+    m_local_thread.start();
 
     for (size_t i = 0; i < threads; ++i)
     {
@@ -404,8 +455,17 @@ daemon :: run(bool background,
     }
 
     m_log.close();
+    m_changes.close();
     m_pumping_thread.join();
+    m_local_thread.join();
     m_durable_thread.join();
+
+    for (size_t i = 0; i < m_owners.size(); ++i)
+    {
+        m_owners[i]->shutdown();
+    }
+
+    m_changes_thread.join();
     LOG(ERROR) << "consus is gracefully shutting down";
     return EXIT_SUCCESS;
 }
@@ -459,6 +519,9 @@ daemon :: loop(size_t thread)
                 done = true;
                 continue;
             case BUSYBEE_DISRUPTED:
+                m_chunks.forget(comm_id(_id));
+                m_chunk_sender.forget(comm_id(_id));
+                continue;
             case BUSYBEE_INTERRUPTED:
                 continue;
             case BUSYBEE_TIMEOUT:
@@ -477,6 +540,39 @@ daemon :: loop(size_t thread)
         e::unpacker up = msg->unpack_from(BUSYBEE_HEADER_SIZE);
         up = up >> mt;
 
+        // a large message arrives in pieces; process it once it is whole
+        if (!up.error() && mt == CONSUS_CHUNK_ACK)
+        {
+            std::auto_ptr<e::buffer> chunk = m_chunk_sender.acknowledged(id, up);
+
+            if (chunk.get())
+            {
+                send(id, chunk);
+            }
+
+            m_gc.quiescent_state(&ts);
+            continue;
+        }
+
+        if (!up.error() && mt == CONSUS_CHUNK)
+        {
+            std::auto_ptr<e::buffer> ack = make_chunk_ack(up);
+
+            if (ack.get())
+            {
+                send(id, ack);
+            }
+
+            if (!m_chunks.reassemble(id, up, &msg))
+            {
+                m_gc.quiescent_state(&ts);
+                continue;
+            }
+
+            up = msg->unpack_from(BUSYBEE_HEADER_SIZE);
+            up = up >> mt;
+        }
+
         if (up.error())
         {
             LOG(WARNING) << "dropping message that has a malformed header";
@@ -497,95 +593,15 @@ daemon :: loop(size_t thread)
         }
 #endif
 
-        switch (mt)
+        transaction_group tg;
+
+        if (owning_group(mt, up, &tg))
         {
-            case TXMAN_BEGIN:
-                process_begin(id, msg, up);
-                break;
-            case TXMAN_READ:
-                process_read(id, msg, up);
-                break;
-            case TXMAN_WRITE:
-                process_write(id, msg, up);
-                break;
-            case TXMAN_COMMIT:
-                process_commit(id, msg, up);
-                break;
-            case TXMAN_ABORT:
-                process_abort(id, msg, up);
-                break;
-            case TXMAN_WOUND:
-                process_wound(id, msg, up);
-                break;
-            case TXMAN_PAXOS_2A:
-                process_paxos_2a(id, msg, up);
-                break;
-            case TXMAN_PAXOS_2B:
-                process_paxos_2b(id, msg, up);
-                break;
-            case LV_VOTE_1A:
-                process_lv_vote_1a(id, msg, up);
-                break;
-            case LV_VOTE_1B:
-                process_lv_vote_1b(id, msg, up);
-                break;
-            case LV_VOTE_2A:
-                process_lv_vote_2a(id, msg, up);
-                break;
-            case LV_VOTE_2B:
-                process_lv_vote_2b(id, msg, up);
-                break;
-            case LV_VOTE_LEARN:
-                process_lv_vote_learn(id, msg, up);
-                break;
-            case COMMIT_RECORD:
-                process_commit_record(id, msg, up);
-                break;
-            case GV_OUTCOME:
-                process_gv_outcome(id, msg, up);
-                break;
-            case GV_PROPOSE:
-                process_gv_propose(id, msg, up);
-                break;
-            case GV_VOTE_1A:
-                process_gv_vote_1a(id, msg, up);
-                break;
-            case GV_VOTE_1B:
-                process_gv_vote_1b(id, msg, up);
-                break;
-            case GV_VOTE_2A:
-                process_gv_vote_2a(id, msg, up);
-                break;
-            case GV_VOTE_2B:
-                process_gv_vote_2b(id, msg, up);
-                break;
-            case KVS_REP_RD_RESP:
-                process_kvs_rep_rd_resp(id, msg, up);
-                break;
-            case KVS_REP_WR_RESP:
-                process_kvs_rep_wr_resp(id, msg, up);
-                break;
-            case KVS_LOCK_OP_RESP:
-                process_kvs_lock_op_resp(id, msg, up);
-                break;
-            case CONSUS_NOP:
-                break;
-            case CLIENT_RESPONSE:
-            case KVS_REP_RD:
-            case KVS_REP_WR:
-            case KVS_RAW_RD:
-            case KVS_RAW_RD_RESP:
-            case KVS_RAW_WR:
-            case KVS_RAW_WR_RESP:
-            case KVS_LOCK_OP:
-            case KVS_RAW_LK:
-            case KVS_RAW_LK_RESP:
-            case KVS_WOUND_XACT:
-            case KVS_MIGRATE_SYN:
-            case KVS_MIGRATE_ACK:
-            default:
-                LOG(INFO) << "received " << mt << " message which transaction-managers do not process";
-                break;
+            route(new owned_work(tg, id, mt, msg));
+        }
+        else
+        {
+            dispatch(id, mt, msg, up);
         }
 
         m_gc.quiescent_state(&ts);
@@ -595,52 +611,320 @@ daemon :: loop(size_t thread)
     LOG(INFO) << "network thread shutting down";
 }
 
+bool
+daemon :: owning_group(network_msgtype mt, e::unpacker up, transaction_group* tg)
+{
+    uint64_t nonce = 0;
+    *tg = transaction_group();
+
+    switch (mt)
+    {
+        case TXMAN_READ:
+        case TXMAN_WRITE:
+        case TXMAN_COMMIT:
+        case TXMAN_ABORT:
+        {
+            transaction_id txid;
+            up = up >> txid;
+            *tg = transaction_group(txid);
+            break;
+        }
+        case TXMAN_PAXOS_2A:
+        {
+            e::slice log_entry;
+            log_entry_t t = LOG_ENTRY_NOP;
+            up = up >> log_entry;
+
+            if (!up.error())
+            {
+                up = e::unpacker(log_entry) >> t >> *tg;
+            }
+
+            break;
+        }
+        case TXMAN_WOUND:
+        case TXMAN_PAXOS_2B:
+        case LV_VOTE_1A:
+        case LV_VOTE_1B:
+        case LV_VOTE_2A:
+        case LV_VOTE_2B:
+        case LV_VOTE_LEARN:
+        case COMMIT_RECORD:
+        case COMMIT_RECORD_ACK:
+        case GV_OUTCOME:
+        case GV_PROPOSE:
+        case GV_VOTE_1A:
+        case GV_VOTE_1B:
+        case GV_VOTE_2A:
+        case GV_VOTE_2B:
+            up = up >> *tg;
+            break;
+        // a key-value store response belongs to the transaction its
+        // operation calls back
+        case KVS_REP_RD_RESP:
+        {
+            up = up >> nonce;
+            read_map_t::state_reference ksr;
+            kvs_read* kv = m_readers.get_state(nonce, &ksr);
+            *tg = kv ? kv->callback_group() : transaction_group();
+            break;
+        }
+        case KVS_REP_WR_RESP:
+        {
+            up = up >> nonce;
+            write_map_t::state_reference ksr;
+            kvs_write* kv = m_writers.get_state(nonce, &ksr);
+            *tg = kv ? kv->callback_group() : transaction_group();
+            break;
+        }
+        case KVS_LOCK_OP_RESP:
+        {
+            up = up >> nonce;
+            lock_op_map_t::state_reference ksr;
+            kvs_lock_op* kv = m_lock_ops.get_state(nonce, &ksr);
+            *tg = kv ? kv->callback_group() : transaction_group();
+            break;
+        }
+        default:
+            return false;
+    }
+
+    // malformed messages are left to the usual handler to complain about
+    return !up.error() && *tg != transaction_group();
+}
+
+void
+daemon :: route(owned_work* w)
+{
+    owner(w->tg)->push(w);
+}
+
+daemon::owner_thread*
+daemon :: owner(const transaction_group& tg)
+{
+    return m_owners[tg.hash() % m_owners.size()].get();
+}
+
+void
+daemon :: defer_state_machine(const transaction_group& tg)
+{
+    owner(tg)->defer(tg);
+}
+
+void
+daemon :: dispatch(comm_id id, network_msgtype mt, std::auto_ptr<e::buffer> msg, e::unpacker up)
+{
+    switch (mt)
+    {
+        case TXMAN_BEGIN:
+            process_begin(id, msg, up);
+            break;
+        case TXMAN_READ:
+            process_read(id, msg, up);
+            break;
+        case TXMAN_WRITE:
+            process_write(id, msg, up);
+            break;
+        case TXMAN_COMMIT:
+            process_commit(id, msg, up);
+            break;
+        case TXMAN_ABORT:
+            process_abort(id, msg, up);
+            break;
+        case TXMAN_WOUND:
+            process_wound(id, msg, up);
+            break;
+        case TXMAN_WAIT_FOR:
+            process_wait_for(id, msg, up);
+            break;
+        case TXMAN_DEADLOCK_PROBE:
+            process_deadlock_probe(id, msg, up);
+            break;
+        case TXMAN_CHANGES:
+            process_changes(id, msg, up);
+            break;
+        case TXMAN_INDEX_LOOKUP:
+            process_index_lookup(id, msg, up);
+            break;
+        case TXMAN_PAXOS_2A:
+            process_paxos_2a(id, msg, up);
+            break;
+        case TXMAN_PAXOS_2B:
+            process_paxos_2b(id, msg, up);
+            break;
+        case LV_VOTE_1A:
+            process_lv_vote_1a(id, msg, up);
+            break;
+        case LV_VOTE_1B:
+            process_lv_vote_1b(id, msg, up);
+            break;
+        case LV_VOTE_2A:
+            process_lv_vote_2a(id, msg, up);
+            break;
+        case LV_VOTE_2B:
+            process_lv_vote_2b(id, msg, up);
+            break;
+        case LV_VOTE_LEARN:
+            process_lv_vote_learn(id, msg, up);
+            break;
+        case COMMIT_RECORD:
+            process_commit_record(id, msg, up);
+            break;
+        case COMMIT_RECORD_ACK:
+            process_commit_record_ack(id, msg, up);
+            break;
+        case GV_OUTCOME:
+            process_gv_outcome(id, msg, up);
+            break;
+        case GV_PROPOSE:
+            process_gv_propose(id, msg, up);
+            break;
+        case GV_VOTE_1A:
+            process_gv_vote_1a(id, msg, up);
+            break;
+        case GV_VOTE_1B:
+            process_gv_vote_1b(id, msg, up);
+            break;
+        case GV_VOTE_2A:
+            process_gv_vote_2a(id, msg, up);
+            break;
+        case GV_VOTE_2B:
+            process_gv_vote_2b(id, msg, up);
+            break;
+        case KVS_REP_RD_RESP:
+            process_kvs_rep_rd_resp(id, msg, up);
+            break;
+        case KVS_REP_WR_RESP:
+            process_kvs_rep_wr_resp(id, msg, up);
+            break;
+        case KVS_REP_SCAN_RESP:
+            process_kvs_rep_scan_resp(id, msg, up);
+            break;
+        case KVS_LOCK_OP_RESP:
+            process_kvs_lock_op_resp(id, msg, up);
+            break;
+        case CONSUS_NOP:
+            break;
+        case CONSUS_CHUNK:
+        case CONSUS_CHUNK_ACK:
+        case CLIENT_RESPONSE:
+        case KVS_REP_RD:
+        case KVS_REP_WR:
+        case KVS_REP_SCAN:
+        case KVS_RAW_RD:
+        case KVS_RAW_RD_RESP:
+        case KVS_RAW_WR:
+        case KVS_RAW_WR_RESP:
+        case KVS_LOCK_OP:
+        case KVS_RAW_LK:
+        case KVS_RAW_LK_RESP:
+        case KVS_WOUND_XACT:
+        case KVS_RAW_LK_QUEUED:
+        case KVS_RAW_SCAN:
+        case KVS_RAW_SCAN_RESP:
+        case KVS_MIGRATE_SYN:
+        case KVS_MIGRATE_ACK:
+        default:
+            LOG(INFO) << "received " << mt << " message which transaction-managers do not process";
+            break;
+    }
+}
+
 void
 daemon :: process_begin(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
 {
     uint64_t nonce;
+    uint8_t priority = CONSUS_PRIORITY_NORMAL;
+    transaction_id previous;
+    bool restart = false;
     up = up >> e::unpack_varint(nonce);
+
+    if (!up.error() && up.remain())
+    {
+        up = up >> priority;
+    }
+
+    // a restarted transaction names its previous incarnation so that it
+    // can keep its place in the wound-wait order
+    if (!up.error() && up.remain())
+    {
+        up = up >> previous;
+        restart = true;
+    }
+
     CHECK_UNPACK(TXMAN_BEGIN, up);
-    configuration* c = get_config();
+    priority = std::min(priority, uint8_t(CONSUS_PRIORITY_BATCH));
+    const uint64_t start = restart ? inherited_start(previous) : 0;
+
+    if (!admit(priority))
+    {
+        LOG_IF(INFO, s_debug_mode) << "refusing to begin class " << unsigned(priority)
+                                   << " transaction for " << id << "; too many active transactions";
+        std::auto_ptr<e::buffer> msg = (message()
+            << CLIENT_RESPONSE
+            << nonce
+            << CONSUS_UNAVAILABLE).create();
+        send(id, msg);
+        return;
+    }
 
-    while (true)
+    uint64_t retry_after = 0;
+
+    if (!m_limiter.admit(id, e::slice(), 0, po6::monotonic_time(), &retry_after))
     {
-        transaction_id txid = generate_txid();
-        const paxos_group* group = c->get_group(txid.group);
+        LOG_IF(INFO, s_debug_mode) << "throttling begin for " << id << " for " << retry_after << "ns";
+        send_throttled(id, nonce, retry_after);
+        return;
+    }
 
-        if (!group)
-        {
-            LOG(ERROR) << "generated txid with invalid paxos group";
-            // XXX reply with an error
-            return;
-        }
+    begin_transaction(id, nonce, priority, start);
+}
 
-        transaction_group tg(txid);
-        transaction_map_t::state_reference tsr;
-        transaction* xact = m_transactions.create_state(tg, &tsr);
+void
+daemon :: begin_transaction(comm_id id, uint64_t nonce, uint8_t priority, uint64_t start)
+{
+    transaction_id txid = generate_txid(priority, start);
+    route(new owned_work(transaction_group(txid), id, nonce));
+}
 
-        if (!xact)
-        {
-            continue;
-        }
+void
+daemon :: owned_begin(const transaction_group& tg, comm_id id, uint64_t nonce)
+{
+    configuration* c = get_config();
+    const paxos_group* group = c->get_group(tg.txid.group);
+
+    if (!group)
+    {
+        LOG(ERROR) << "generated txid with invalid paxos group";
+        // XXX reply with an error
+        return;
+    }
 
-        std::vector<paxos_group_id> dcs;
+    transaction_map_t::state_reference tsr;
+    transaction* xact = m_transactions.create_state(tg, &tsr);
 
-        if (!c->choose_groups(txid.group, &dcs))
-        {
-            LOG(ERROR) << "not enough dcs online";
-            // XXX reply with an error
-            return;
-        }
+    if (!xact)
+    {
+        // the txid is taken; a fresh one most likely has a different owner
+        begin_transaction(id, nonce, tg.txid.priority, tg.txid.start);
+        return;
+    }
+
+    std::vector<paxos_group_id> dcs;
 
-        uint64_t ts = po6::wallclock_time();
-        xact->begin(id, nonce, ts, *group, dcs, this);
-        break;
+    if (!c->choose_groups(tg.txid.group, &dcs))
+    {
+        LOG(ERROR) << "not enough dcs online";
+        // XXX reply with an error
+        return;
     }
+
+    uint64_t ts = po6::wallclock_time();
+    xact->begin(id, nonce, ts, *group, dcs, this);
 }
 
 void
-daemon :: process_read(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up)
+daemon :: process_read(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
 {
     transaction_id txid;
     uint64_t nonce;
@@ -672,11 +956,11 @@ daemon :: process_read(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up)
     transaction_map_t::state_reference tsr;
     transaction* xact = m_transactions.get_or_create_state(transaction_group(txid), &tsr);
     assert(xact);
-    xact->read(id, nonce, seqno, table, key, msg, this);
+    xact->read(id, nonce, seqno, table, key, this);
 }
 
 void
-daemon :: process_write(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up)
+daemon :: process_write(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
 {
     transaction_id txid;
     uint64_t nonce;
@@ -700,7 +984,7 @@ daemon :: process_write(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up
     transaction_map_t::state_reference tsr;
     transaction* xact = m_transactions.get_or_create_state(transaction_group(txid), &tsr);
     assert(xact);
-    xact->write(id, nonce, seqno, table, key, value, msg, this);
+    xact->write(id, nonce, seqno, table, key, value, this);
 }
 
 void
@@ -712,6 +996,31 @@ daemon :: process_commit(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
     up = up >> txid
             >> e::unpack_varint(nonce)
             >> e::unpack_varint(seqno);
+    // reads the client served from its cache ride along with the commit
+    uint64_t cached = 0;
+    std::vector<uint64_t> cached_seqnos;
+    std::vector<e::slice> cached_tables;
+    std::vector<e::slice> cached_keys;
+    std::vector<uint64_t> cached_timestamps;
+
+    if (!up.error() && up.remain())
+    {
+        up = up >> e::unpack_varint(cached);
+    }
+
+    for (uint64_t i = 0; !up.error() && i < cached; ++i)
+    {
+        uint64_t s;
+        e::slice t;
+        e::slice k;
+        uint64_t ts;
+        up = up >> e::unpack_varint(s) >> t >> k >> ts;
+        cached_seqnos.push_back(s);
+        cached_tables.push_back(t);
+        cached_keys.push_back(k);
+        cached_timestamps.push_back(ts);
+    }
+
     CHECK_UNPACK(TXMAN_COMMIT, up);
 
     if (!get_config()->get_group(txid.group))
@@ -724,6 +1033,13 @@ daemon :: process_commit(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
     transaction_map_t::state_reference tsr;
     transaction* xact = m_transactions.get_or_create_state(transaction_group(txid), &tsr);
     assert(xact);
+
+    for (size_t i = 0; i < cached_seqnos.size(); ++i)
+    {
+        xact->cached_read(cached_seqnos[i], cached_tables[i], cached_keys[i],
+                          cached_timestamps[i], this);
+    }
+
     xact->prepare(id, nonce, seqno, this);
 }
 
@@ -787,6 +1103,128 @@ daemon :: process_wound(comm_id, std::auto_ptr<e::buffer> msg, e::unpacker up)
     }
 }
 
+void
+daemon :: process_wait_for(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
+{
+    uint64_t nonce;
+    transaction_group waiter;
+    transaction_group holder;
+    up = up >> nonce >> waiter >> holder;
+    CHECK_UNPACK(TXMAN_WAIT_FOR, up);
+    lock_op_map_t::state_reference ksr;
+    kvs_lock_op* kv = m_lock_ops.get_state(nonce, &ksr);
+
+    if (!kv || waiter == holder)
+    {
+        LOG_IF(INFO, s_debug_mode) << "dropped wait-for report from=" << id << " nonce=" << nonce;
+        return;
+    }
+
+    // every member of the waiter's group hears of the wait; one probe
+    // from one of them is enough
+    if (m_deadlocks.wait_for(nonce, waiter, holder, po6::monotonic_time()) &&
+        deadlock_peer(waiter) == m_us.id)
+    {
+        LOG_IF(INFO, s_debug_mode) << transaction_group::log(waiter)
+                                   << " waits for "
+                                   << transaction_group::log(holder);
+        send_deadlock_probe(waiter, nonce, younger(waiter, holder), holder, 1);
+    }
+}
+
+void
+daemon :: process_deadlock_probe(comm_id, std::auto_ptr<e::buffer>, e::unpacker up)
+{
+    transaction_group initiator;
+    uint64_t probe;
+    transaction_group victim;
+    transaction_group target;
+    uint64_t hops;
+    up = up >> initiator >> probe >> victim >> target >> hops;
+    CHECK_UNPACK(TXMAN_DEADLOCK_PROBE, up);
+
+    // reached us by another path already; we forwarded it then
+    if (!m_deadlocks.first_visit(initiator, probe, po6::monotonic_time()))
+    {
+        return;
+    }
+
+    std::vector<transaction_group> holders;
+    m_deadlocks.holders_of(target, &holders);
+
+    for (size_t i = 0; i < holders.size(); ++i)
+    {
+        // the probe came back around to where it started; every transaction
+        // on the path is waiting on the next, so abort the youngest of them
+        if (holders[i] == initiator)
+        {
+            LOG_IF(INFO, s_debug_mode) << transaction_group::log(initiator)
+                                       << " is deadlocked; wounding "
+                                       << transaction_group::log(victim);
+            send_wound(victim);
+        }
+        else if (hops < s_deadlock_probe_hops)
+        {
+            send_deadlock_probe(initiator, probe, younger(victim, holders[i]), holders[i], hops + 1);
+        }
+    }
+}
+
+void
+daemon :: process_changes(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
+{
+    change_feed::waiter w;
+    up = up >> e::unpack_varint(w.nonce) >> w.cursor >> w.max_bytes;
+    CHECK_UNPACK(TXMAN_CHANGES, up);
+    w.id = id;
+    w.max_bytes = std::min(w.max_bytes, uint64_t(CONSUS_CHANGE_FEED_BATCH));
+    w.deadline = po6::monotonic_time() + changes_timeout();
+    std::vector<change_feed::change> changes;
+    uint64_t next;
+
+    // with nothing to read yet, the reader waits for the next commit
+    if (m_changes.read_or_wait(w, &changes, &next))
+    {
+        send_changes(w, changes, next);
+    }
+}
+
+void
+daemon :: process_index_lookup(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
+{
+    uint64_t nonce;
+    e::slice table;
+    e::slice field;
+    e::slice value;
+    up = up >> e::unpack_varint(nonce) >> table >> field >> value;
+    CHECK_UNPACK(TXMAN_INDEX_LOOKUP, up);
+    configuration* c = get_config();
+    const secondary_index* si = c->get_index(table, field);
+
+    if (!si)
+    {
+        LOG_IF(INFO, s_debug_mode) << "index lookup on \"" << e::strescape(table.str())
+                                   << "\".\"" << e::strescape(field.str())
+                                   << "\" refused: no such index";
+        const consus_returncode rc = CONSUS_UNKNOWN_TABLE;
+        const size_t sz = BUSYBEE_HEADER_SIZE
+                        + pack_size(CLIENT_RESPONSE)
+                        + sizeof(uint64_t)
+                        + pack_size(rc);
+        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+        msg->pack_at(BUSYBEE_HEADER_SIZE) << CLIENT_RESPONSE << nonce << rc;
+        send(id, msg);
+        return;
+    }
+
+    const std::string index_table(si->index_table());
+    const std::string prefix(index_prefix(value));
+    scan_map_t::state_reference sr;
+    kvs_scan* kv = create_scan(&sr);
+    kv->callback_client(id, nonce);
+    kv->scan(e::slice(index_table), e::slice(prefix), this);
+}
+
 void
 daemon :: process_paxos_2a(comm_id, std::auto_ptr<e::buffer> msg, e::unpacker up)
 {
@@ -912,26 +1350,51 @@ daemon :: process_lv_vote_learn(comm_id id, std::auto_ptr<e::buffer>, e::unpacke
 }
 
 void
-daemon :: process_commit_record(comm_id, std::auto_ptr<e::buffer> msg, e::unpacker up)
+daemon :: process_commit_record(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up)
 {
     transaction_group tg;
-    e::slice commit_record;
-    up = up >> tg >> commit_record;
+    paxos_group_id from;
+    uint64_t index;
+    uint64_t count;
+    e::slice entries;
+    up = up >> tg >> from >> index >> count >> entries;
     CHECK_UNPACK(COMMIT_RECORD, up);
     transaction_map_t::state_reference tsr;
     transaction* xact = m_transactions.get_or_create_state(tg, &tsr);
     assert(xact);
-    xact->commit_record(commit_record, msg, this);
+    xact->commit_record(id, from, index, count, entries, msg, this);
 }
 
 void
-daemon :: process_gv_outcome(comm_id, std::auto_ptr<e::buffer>, e::unpacker up)
+daemon :: process_commit_record_ack(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
 {
     transaction_group tg;
-    uint64_t index;
-    uint64_t outcomes[CONSUS_MAX_REPLICATION_FACTOR];
-    up = up >> tg >> e::unpack_varint(index) >> e::unpack_array<uint64_t>(outcomes, CONSUS_MAX_REPLICATION_FACTOR);
-    CHECK_UNPACK(GV_OUTCOME, up);
+    paxos_group_id from;
+    uint64_t applied;
+    std::vector<uint64_t> received;
+    up = up >> tg >> from >> applied >> received;
+    CHECK_UNPACK(COMMIT_RECORD_ACK, up);
+    transaction_map_t::state_reference tsr;
+    transaction* xact = m_transactions.get_state(tg, &tsr);
+
+    if (xact)
+    {
+        xact->commit_record_ack(id, from, applied, received, this);
+    }
+    else
+    {
+        LOG_IF(INFO, s_debug_mode) << transaction_group::log(tg) << " dropped commit record ack from=" << id;
+    }
+}
+
+void
+daemon :: process_gv_outcome(comm_id, std::auto_ptr<e::buffer>, e::unpacker up)
+{
+    transaction_group tg;
+    uint64_t index;
+    uint64_t outcomes[CONSUS_MAX_REPLICATION_FACTOR];
+    up = up >> tg >> e::unpack_varint(index) >> e::unpack_array<uint64_t>(outcomes, CONSUS_MAX_REPLICATION_FACTOR);
+    CHECK_UNPACK(GV_OUTCOME, up);
 
     global_voter_map_t::state_reference gvsr;
     global_voter* gv = m_global_voters.get_or_create_state(tg, &gvsr);
@@ -1070,7 +1533,7 @@ daemon :: process_gv_vote_2b(comm_id, std::auto_ptr<e::buffer>, e::unpacker up)
 }
 
 void
-daemon :: process_kvs_rep_rd_resp(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
+daemon :: process_kvs_rep_rd_resp(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up)
 {
     uint64_t nonce;
     consus_returncode rc;
@@ -1084,7 +1547,7 @@ daemon :: process_kvs_rep_rd_resp(comm_id id, std::auto_ptr<e::buffer>, e::unpac
 
     if (kv)
     {
-        kv->response(rc, timestamp, value, this);
+        kv->response(rc, timestamp, value, msg, this);
     }
     else
     {
@@ -1113,6 +1576,37 @@ daemon :: process_kvs_rep_wr_resp(comm_id id, std::auto_ptr<e::buffer>, e::unpac
     }
 }
 
+void
+daemon :: process_kvs_rep_scan_resp(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
+{
+    uint64_t nonce;
+    consus_returncode rc;
+    uint64_t count;
+    up = up >> nonce >> rc >> count;
+    std::vector<e::slice> values;
+
+    for (uint64_t i = 0; !up.error() && i < count; ++i)
+    {
+        e::slice key;
+        e::slice value;
+        up = up >> key >> value;
+        values.push_back(value);
+    }
+
+    CHECK_UNPACK(KVS_REP_SCAN_RESP, up);
+    scan_map_t::state_reference ksr;
+    kvs_scan* kv = m_scanners.get_state(nonce, &ksr);
+
+    if (kv)
+    {
+        kv->response(rc, values, this);
+    }
+    else
+    {
+        LOG(INFO) << "dropped scan response from=" << id << " nonce=" << nonce;
+    }
+}
+
 void
 daemon :: process_kvs_lock_op_resp(comm_id id, std::auto_ptr<e::buffer>, e::unpacker up)
 {
@@ -1126,6 +1620,7 @@ daemon :: process_kvs_lock_op_resp(comm_id id, std::auto_ptr<e::buffer>, e::unpa
 
     if (kv)
     {
+        m_deadlocks.forget(nonce);
         kv->response(rc, this);
     }
     else
@@ -1176,6 +1671,27 @@ daemon :: create_write(write_map_t::state_reference* sr)
     }
 }
 
+consus::kvs_scan*
+daemon :: create_scan(scan_map_t::state_reference* sr)
+{
+    while (true)
+    {
+        uint64_t kv_nonce = generate_nonce();
+
+        if (kv_nonce == 0)
+        {
+            continue;
+        }
+
+        kvs_scan* kv = m_scanners.create_state(kv_nonce, sr);
+
+        if (kv)
+        {
+            return kv;
+        }
+    }
+}
+
 consus::kvs_lock_op*
 daemon :: create_lock_op(lock_op_map_t::state_reference* sr)
 {
@@ -1197,6 +1713,82 @@ daemon :: create_lock_op(lock_op_map_t::state_reference* sr)
     }
 }
 
+comm_id
+daemon :: deadlock_peer(const transaction_group& tg)
+{
+    const paxos_group* g = get_config()->get_group(tg.group);
+
+    if (!g || g->members_sz == 0)
+    {
+        return comm_id();
+    }
+
+    // every member of the group issues the transaction's lock operations and
+    // so hears of all of its waits; agree on one of them to speak for it
+    return g->members[tg.hash() % g->members_sz];
+}
+
+void
+daemon :: send_deadlock_probe(const transaction_group& initiator,
+                              uint64_t probe,
+                              const transaction_group& victim,
+                              const transaction_group& target,
+                              uint64_t hops)
+{
+    const size_t sz = BUSYBEE_HEADER_SIZE
+                    + pack_size(TXMAN_DEADLOCK_PROBE)
+                    + pack_size(initiator)
+                    + sizeof(uint64_t)
+                    + pack_size(victim)
+                    + pack_size(target)
+                    + sizeof(uint64_t);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(BUSYBEE_HEADER_SIZE)
+        << TXMAN_DEADLOCK_PROBE << initiator << probe << victim << target << hops;
+    send(deadlock_peer(target), msg);
+}
+
+void
+daemon :: send_wound(const transaction_group& tg)
+{
+    const size_t sz = BUSYBEE_HEADER_SIZE
+                    + pack_size(TXMAN_WOUND)
+                    + pack_size(tg);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(BUSYBEE_HEADER_SIZE) << TXMAN_WOUND << tg;
+    send(tg.group, msg);
+}
+
+void
+daemon :: pump_deadlocks()
+{
+    std::vector<uint64_t> nonces;
+    m_deadlocks.nonces(&nonces);
+
+    // the lock operation finished or was collected along with its transaction
+    for (size_t i = 0; i < nonces.size(); ++i)
+    {
+        lock_op_map_t::state_reference ksr;
+        kvs_lock_op* kv = m_lock_ops.get_state(nonces[i], &ksr);
+
+        if (!kv || kv->finished())
+        {
+            m_deadlocks.forget(nonces[i]);
+        }
+    }
+
+    std::vector<deadlock_detector::edge> wound;
+    m_deadlocks.periodic(po6::monotonic_time(), resend_interval(), deadlock_timeout(), &wound);
+
+    for (size_t i = 0; i < wound.size(); ++i)
+    {
+        LOG_IF(INFO, s_debug_mode) << transaction_group::log(wound[i].waiter)
+                                   << " waited too long; wounding "
+                                   << transaction_group::log(wound[i].holder);
+        send_wound(wound[i].holder);
+    }
+}
+
 consus::configuration*
 daemon :: get_config()
 {
@@ -1257,6 +1849,52 @@ daemon :: debug_dump()
         }
     }
 
+    LOG(INFO) << "-------------------------------- Priority Classes ------------------------------";
+
+    for (unsigned i = 0; i < CONSUS_PRIORITY_CLASSES; ++i)
+    {
+        LOG(INFO) << "class[" << i << "]"
+                  << " active=" << e::atomic::increment_64_nobarrier(&m_class_active[i], 0)
+                  << " begun=" << e::atomic::increment_64_nobarrier(&m_class_begun[i], 0)
+                  << " committed=" << e::atomic::increment_64_nobarrier(&m_class_committed[i], 0)
+                  << " aborted=" << e::atomic::increment_64_nobarrier(&m_class_aborted[i], 0);
+    }
+
+    LOG(INFO) << "aborted for inactivity=" << e::atomic::increment_64_nobarrier(&m_idle_aborts, 0);
+    const uint64_t arena_txns = std::max(e::atomic::increment_64_nobarrier(&m_arena_txns, 0), uint64_t(1));
+    LOG(INFO) << "per-transaction arena:"
+              << " allocations=" << e::atomic::increment_64_nobarrier(&m_arena_allocations, 0) / arena_txns
+              << " bytes=" << e::atomic::increment_64_nobarrier(&m_arena_bytes, 0) / arena_txns
+              << " reserved=" << e::atomic::increment_64_nobarrier(&m_arena_reserved, 0) / arena_txns
+              << " blocks=" << e::atomic::increment_64_nobarrier(&m_arena_blocks, 0) / arena_txns;
+
+    LOG(INFO) << "partially received messages=" << m_chunks.pending_streams();
+    LOG(INFO) << "local clients=" << m_local.clients();
+
+    LOG(INFO) << "---------------------------------- Change Feed ---------------------------------";
+    std::vector<std::string> feed = split_by_newlines(m_changes.debug_dump());
+
+    for (size_t i = 0; i < feed.size(); ++i)
+    {
+        LOG(INFO) << feed[i];
+    }
+
+    LOG(INFO) << "---------------------------------- Rate Limits ---------------------------------";
+    std::vector<std::string> limits = split_by_newlines(m_limiter.debug_dump());
+
+    for (size_t i = 0; i < limits.size(); ++i)
+    {
+        LOG(INFO) << limits[i];
+    }
+
+    LOG(INFO) << "------------------------------- Lock Wait-For Graph ----------------------------";
+    std::vector<std::string> edges = split_by_newlines(m_deadlocks.debug_dump());
+
+    for (size_t i = 0; i < edges.size(); ++i)
+    {
+        LOG(INFO) << edges[i];
+    }
+
 #if 0
     LOG(INFO) << "--------------------------------- Dispositions ---------------------------------";
     LOG(INFO) << "-------------------------------- Read Operations -------------------------------";
@@ -1278,8 +1916,26 @@ daemon :: generate_nonce()
     return x;
 }
 
+uint64_t
+daemon :: inherited_start(const transaction_id& previous)
+{
+    // only a group that issued the transaction can vouch for its age, and it
+    // only passes that age on, to one restart, once the transaction has
+    // aborted; anything else starts afresh
+    if (!get_config()->is_member(previous.group, m_us.id) ||
+        !m_dispositions.inherit(transaction_group(previous)))
+    {
+        LOG_IF(INFO, s_debug_mode) << "not carrying the start of " << previous
+                                   << " forward: it did not abort here, or"
+                                   << " another restart already took it";
+        return 0;
+    }
+
+    return previous.start;
+}
+
 consus::transaction_id
-daemon :: generate_txid()
+daemon :: generate_txid(uint8_t priority, uint64_t start)
 {
     uint64_t x = generate_nonce();
     paxos_group_id id;
@@ -1287,7 +1943,114 @@ daemon :: generate_txid()
     // XXX groups.size() == 0?
     size_t idx = x % groups.size();
     id = groups[idx];
-    return transaction_id(id, po6::wallclock_time(), x);
+    const uint64_t now = po6::wallclock_time();
+
+    if (start == 0 || start > now)
+    {
+        start = now;
+    }
+
+    return transaction_id(id, priority, start, x);
+}
+
+bool
+daemon :: admit(uint8_t priority)
+{
+    uint64_t active = 0;
+
+    for (unsigned i = 0; i < CONSUS_PRIORITY_CLASSES; ++i)
+    {
+        active += e::atomic::increment_64_nobarrier(&m_class_active[i], 0);
+    }
+
+    return active < admission_limit(priority);
+}
+
+void
+daemon :: send_throttled(comm_id id, uint64_t nonce, uint64_t retry_after)
+{
+    std::auto_ptr<e::buffer> msg = (message()
+        << CLIENT_RESPONSE
+        << nonce
+        << CONSUS_THROTTLED
+        << retry_after).create();
+    send(id, msg);
+}
+
+void
+daemon :: send_changes(const change_feed::waiter& w)
+{
+    std::vector<change_feed::change> changes;
+    uint64_t next = m_changes.read(w.cursor, w.max_bytes, &changes);
+    send_changes(w, changes, next);
+}
+
+void
+daemon :: send_changes(const change_feed::waiter& w,
+                       const std::vector<change_feed::change>& changes,
+                       uint64_t next)
+{
+    size_t sz = BUSYBEE_HEADER_SIZE
+              + pack_size(CLIENT_RESPONSE)
+              + sizeof(uint64_t)
+              + pack_size(CONSUS_SUCCESS)
+              + 2 * sizeof(uint64_t);
+
+    for (size_t i = 0; i < changes.size(); ++i)
+    {
+        sz += pack_size(changes[i]);
+    }
+
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    e::packer pa = msg->pack_at(BUSYBEE_HEADER_SIZE);
+    pa = pa << CLIENT_RESPONSE << w.nonce << CONSUS_SUCCESS
+            << next << uint64_t(changes.size());
+
+    for (size_t i = 0; i < changes.size(); ++i)
+    {
+        pa = pa << changes[i];
+    }
+
+    send(w.id, msg);
+}
+
+void
+daemon :: answer_change_waiters()
+{
+    std::vector<change_feed::waiter> ws;
+    m_changes.ready_waiters(po6::monotonic_time(), &ws);
+
+    for (size_t i = 0; i < ws.size(); ++i)
+    {
+        send_changes(ws[i]);
+    }
+}
+
+void
+daemon :: metrics_begin(const transaction_id& txid)
+{
+    const unsigned p = std::min(unsigned(txid.priority), unsigned(CONSUS_PRIORITY_CLASSES - 1));
+    e::atomic::increment_64_nobarrier(&m_class_active[p], 1);
+    e::atomic::increment_64_nobarrier(&m_class_begun[p], 1);
+}
+
+void
+daemon :: metrics_terminated(const transaction_id& txid, bool committed, const arena& a)
+{
+    const unsigned p = std::min(unsigned(txid.priority), unsigned(CONSUS_PRIORITY_CLASSES - 1));
+    e::atomic::increment_64_nobarrier(&m_class_active[p], -1);
+    e::atomic::increment_64_nobarrier(committed ? &m_class_committed[p] : &m_class_aborted[p], 1);
+    e::atomic::increment_64_nobarrier(&m_arena_txns, 1);
+    e::atomic::increment_64_nobarrier(&m_arena_allocations, a.allocations());
+    e::atomic::increment_64_nobarrier(&m_arena_bytes, a.bytes());
+    e::atomic::increment_64_nobarrier(&m_arena_reserved, a.reserved());
+    e::atomic::increment_64_nobarrier(&m_arena_blocks, a.blocks());
+}
+
+void
+daemon :: metrics_idle_abort()
+{
+    e::atomic::increment_64_nobarrier(&m_idle_aborts, 1);
 }
 
 bool
@@ -1323,7 +2086,9 @@ daemon :: send(comm_id id, std::auto_ptr<e::buffer> msg)
         return true;
     }
 
-    busybee_returncode rc = m_busybee->send(id.get(), msg);
+    busybee_returncode rc = m_local.serves(id)
+                          ? send_chunked(&m_local, id.get(), &m_chunk_sender, msg)
+                          : send_chunked(m_busybee.get(), id.get(), &m_chunk_sender, msg);
 
     switch (rc)
     {
@@ -1374,7 +2139,7 @@ daemon :: send(const paxos_group& g, std::auto_ptr<e::buffer> msg)
             continue;
         }
 
-        busybee_returncode rc = m_busybee->send(g.members[i].get(), m);
+        busybee_returncode rc = send_chunked(m_busybee.get(), g.members[i].get(), &m_chunk_sender, m);
 
         switch (rc)
         {
@@ -1419,27 +2184,6 @@ daemon :: send(const paxos_group& g, std::auto_ptr<e::buffer> msg)
     return count;
 }
 
-struct daemon::durable_msg
-{
-    durable_msg() : recno(), client(), msg(NULL) {}
-    durable_msg(int64_t r, comm_id c, e::buffer* m) : recno(r), client(c), msg(m) {}
-    durable_msg(const durable_msg& other)
-        : recno(other.recno), client(other.client), msg(other.msg) {}
-    ~durable_msg() throw () {}
-    durable_msg& operator = (const durable_msg& rhs)
-    {
-        // no self-assign check needed
-        recno = rhs.recno;
-        client = rhs.client;
-        msg = rhs.msg;
-        return *this;
-    }
-    bool operator < (const durable_msg& rhs) { return rhs.recno > recno; }
-    int64_t recno;
-    comm_id client;
-    e::buffer* msg;
-};
-
 void
 daemon :: send_when_durable(const std::string& entry, comm_id id, std::auto_ptr<e::buffer> msg)
 {
@@ -1495,29 +2239,26 @@ daemon :: send_when_durable(int64_t idx, const comm_id* ids, e::buffer** msgs, s
         return;
     }
 
-    bool send_now = false;
-
+    if (record_durable(idx))
     {
-        po6::threads::mutex::hold hold(&m_durable_mtx);
-        send_now = idx <= m_durable_up_to;
-
-        if (!send_now)
+        for (size_t i = 0; i < sz; ++i)
         {
-            for (size_t i = 0; i < sz; ++i)
-            {
-                durable_msg d(idx, ids[i], msgs[i]);
-                m_durable_msgs.push_back(d);
-                std::push_heap(m_durable_msgs.begin(), m_durable_msgs.end());
-            }
+            send(ids[i], std::auto_ptr<e::buffer>(msgs[i]));
         }
+
+        return;
     }
 
-    if (send_now)
+    for (size_t i = 0; i < sz; ++i)
     {
-        for (size_t i = 0; i < sz; ++i)
-        {
-            send(ids[i], std::auto_ptr<e::buffer>(msgs[i]));
-        }
+        m_durable_waiters.push(new durable_waiters::waiter(idx, ids[i], msgs[i]));
+    }
+
+    // the monitor may have drained the waiters between the check and the
+    // push; make it look again
+    if (record_durable(idx))
+    {
+        m_log.wake();
     }
 }
 
@@ -1552,12 +2293,7 @@ daemon :: send_if_durable(int64_t idx, comm_id id, std::auto_ptr<e::buffer> msg)
 void
 daemon :: send_if_durable(int64_t idx, const comm_id* ids, e::buffer** msgs, size_t sz)
 {
-    bool should_send = false;
-    m_durable_mtx.lock();
-    should_send = idx <= m_durable_up_to;
-    m_durable_mtx.unlock();
-
-    if (idx < 0 || !should_send)
+    if (!record_durable(idx))
     {
         for (size_t i = 0; i < sz; ++i)
         {
@@ -1573,27 +2309,381 @@ daemon :: send_if_durable(int64_t idx, const comm_id* ids, e::buffer** msgs, siz
     }
 }
 
-struct daemon::durable_cb
+// Work for the thread that owns a transaction group:  a message naming the
+// group, the start of a new transaction, operations that became durable, or a
+// periodic poke of the transaction's state machine.
+struct daemon::owned_work
+{
+    enum kind_t { MESSAGE, BEGIN, DURABLE, PUMP };
+
+    owned_work(const transaction_group& tg, comm_id id,
+               network_msgtype mt, std::auto_ptr<e::buffer> msg);
+    owned_work(const transaction_group& tg, comm_id id, uint64_t nonce);
+    owned_work(const transaction_group& tg, const std::vector<uint64_t>& seqnos);
+    explicit owned_work(const transaction_group& tg);
+    ~owned_work() throw ();
+
+    kind_t kind;
+    transaction_group tg;
+    comm_id id;
+    // MESSAGE
+    network_msgtype mt;
+    e::buffer* msg;
+    // BEGIN
+    uint64_t nonce;
+    // DURABLE
+    std::vector<uint64_t> seqnos;
+    owned_work* next;
+
+    private:
+        owned_work(const owned_work&);
+        owned_work& operator = (const owned_work&);
+};
+
+daemon :: owned_work :: owned_work(const transaction_group& t, comm_id i,
+                                   network_msgtype m, std::auto_ptr<e::buffer> b)
+    : kind(MESSAGE)
+    , tg(t)
+    , id(i)
+    , mt(m)
+    , msg(b.release())
+    , nonce(0)
+    , seqnos()
+    , next(NULL)
+{
+}
+
+daemon :: owned_work :: owned_work(const transaction_group& t, comm_id i, uint64_t n)
+    : kind(BEGIN)
+    , tg(t)
+    , id(i)
+    , mt(CONSUS_NOP)
+    , msg(NULL)
+    , nonce(n)
+    , seqnos()
+    , next(NULL)
+{
+}
+
+daemon :: owned_work :: owned_work(const transaction_group& t,
+                                   const std::vector<uint64_t>& s)
+    : kind(DURABLE)
+    , tg(t)
+    , id()
+    , mt(CONSUS_NOP)
+    , msg(NULL)
+    , nonce(0)
+    , seqnos(s)
+    , next(NULL)
+{
+}
+
+daemon :: owned_work :: owned_work(const transaction_group& t)
+    : kind(PUMP)
+    , tg(t)
+    , id()
+    , mt(CONSUS_NOP)
+    , msg(NULL)
+    , nonce(0)
+    , seqnos()
+    , next(NULL)
+{
+}
+
+daemon :: owned_work :: ~owned_work() throw ()
 {
-    durable_cb() : recno(), tg(), seqno() {}
-    durable_cb(int64_t r, transaction_group t, uint64_t s) : recno(r), tg(t), seqno(s) {}
-    durable_cb(const durable_cb& other)
-        : recno(other.recno), tg(other.tg), seqno(other.seqno) {}
-    ~durable_cb() throw () {}
-    durable_cb& operator = (const durable_cb& rhs)
+    if (msg)
     {
-        // no self-assign check needed
-        recno = rhs.recno;
-        tg = rhs.tg;
-        seqno = rhs.seqno;
-        return *this;
+        delete msg;
     }
-    bool operator < (const durable_cb& rhs) { return rhs.recno > recno; }
-    int64_t recno;
-    transaction_group tg;
-    uint64_t seqno;
+}
+
+// Runs everything for the transaction groups that hash to it, so a
+// transaction is only ever worked by one thread and needs no lock of its own.
+// Any thread may hand it work without taking a lock:  work goes onto one
+// lock-free stack per priority class, which the owner swaps out whole and
+// runs in arrival order, interactive before normal before batch.  Between
+// items of a less urgent class it checks for more urgent work and, if there
+// is some, leaves the rest for its next pass.  A transaction's work is all in
+// its own class, so it still runs in the order it arrived.  Only the push
+// that makes a stack non-empty takes the mutex, to wake the owner if it went
+// to sleep.
+//
+// Callbacks from the key-value store, Paxos, and the durable log defer their
+// transaction's state machine instead of running it; after each batch of
+// work the owner runs it once for every transaction that asked.
+class daemon::owner_thread : public consus::background_thread
+{
+    public:
+        owner_thread(daemon* d, size_t idx);
+        virtual ~owner_thread() throw ();
+
+    public:
+        // takes ownership of w
+        void push(owned_work* w);
+        // only from this thread
+        void defer(const transaction_group& tg);
+
+    protected:
+        virtual const char* thread_name();
+        virtual bool have_work();
+        virtual void do_work();
+
+    private:
+        static unsigned priority_class(const owned_work* w);
+        owned_work* take(unsigned p);
+        bool more_urgent(unsigned p);
+        void run(owned_work* w);
+        void run_deferred();
+
+    private:
+        owner_thread(const owner_thread&);
+        owner_thread& operator = (const owner_thread&);
+
+    private:
+        daemon* m_d;
+        std::string m_name;
+        // pushed by any thread, newest first
+        owned_work* m_heads[CONSUS_PRIORITY_CLASSES];
+        // taken from m_heads but not yet run, oldest first
+        owned_work* m_ready[CONSUS_PRIORITY_CLASSES];
+        deferred_queue m_deferred;
 };
 
+daemon :: owner_thread :: owner_thread(daemon* d, size_t idx)
+    : background_thread(&d->m_gc)
+    , m_d(d)
+    , m_name()
+    , m_deferred()
+{
+    for (unsigned p = 0; p < CONSUS_PRIORITY_CLASSES; ++p)
+    {
+        m_heads[p] = NULL;
+        m_ready[p] = NULL;
+    }
+
+    std::ostringstream ostr;
+    ostr << "transaction owner " << idx;
+    m_name = ostr.str();
+}
+
+daemon :: owner_thread :: ~owner_thread() throw ()
+{
+    shutdown();
+
+    for (unsigned p = 0; p < CONSUS_PRIORITY_CLASSES; ++p)
+    {
+        owned_work* lists[] = {m_ready[p], take(p)};
+
+        for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); ++i)
+        {
+            owned_work* w = lists[i];
+
+            while (w)
+            {
+                owned_work* tmp = w;
+                w = w->next;
+                delete tmp;
+            }
+        }
+    }
+}
+
+void
+daemon :: owner_thread :: push(owned_work* w)
+{
+    owned_work** head = &m_heads[priority_class(w)];
+
+    while (true)
+    {
+        owned_work* h = e::atomic::load_ptr_acquire(head);
+        w->next = h;
+
+        if (e::atomic::compare_and_swap_ptr_fullbarrier(head, h, w) == h)
+        {
+            if (!h)
+            {
+                po6::threads::mutex::hold hold(mtx());
+                wakeup();
+            }
+
+            return;
+        }
+    }
+}
+
+void
+daemon :: owner_thread :: defer(const transaction_group& tg)
+{
+    m_deferred.push(tg);
+}
+
+const char*
+daemon :: owner_thread :: thread_name()
+{
+    return m_name.c_str();
+}
+
+bool
+daemon :: owner_thread :: have_work()
+{
+    for (unsigned p = 0; p < CONSUS_PRIORITY_CLASSES; ++p)
+    {
+        if (m_ready[p] || e::atomic::load_ptr_acquire(&m_heads[p]) != NULL)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+daemon :: owner_thread :: do_work()
+{
+    // anything still ready was taken before what is on the stack now
+    for (unsigned p = 0; p < CONSUS_PRIORITY_CLASSES; ++p)
+    {
+        if (!m_ready[p])
+        {
+            m_ready[p] = take(p);
+        }
+    }
+
+    for (unsigned p = 0; p < CONSUS_PRIORITY_CLASSES; ++p)
+    {
+        while (m_ready[p] && !more_urgent(p))
+        {
+            owned_work* w = m_ready[p];
+            m_ready[p] = w->next;
+            run(w);
+            delete w;
+        }
+    }
+
+    run_deferred();
+}
+
+unsigned
+daemon :: owner_thread :: priority_class(const owned_work* w)
+{
+    return std::min(unsigned(w->tg.txid.priority), unsigned(CONSUS_PRIORITY_CLASSES - 1));
+}
+
+daemon::owned_work*
+daemon :: owner_thread :: take(unsigned p)
+{
+    owned_work* h = NULL;
+
+    while (true)
+    {
+        h = e::atomic::load_ptr_acquire(&m_heads[p]);
+
+        if (!h || e::atomic::compare_and_swap_ptr_fullbarrier(&m_heads[p], h, static_cast<owned_work*>(NULL)) == h)
+        {
+            break;
+        }
+    }
+
+    // the stack is newest-first
+    owned_work* fifo = NULL;
+
+    while (h)
+    {
+        owned_work* tmp = h;
+        h = h->next;
+        tmp->next = fifo;
+        fifo = tmp;
+    }
+
+    return fifo;
+}
+
+bool
+daemon :: owner_thread :: more_urgent(unsigned p)
+{
+    for (unsigned q = 0; q < p; ++q)
+    {
+        if (e::atomic::load_ptr_acquire(&m_heads[q]) != NULL)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+daemon :: owner_thread :: run(owned_work* w)
+{
+    // The get_state calls here and in run_deferred take the entry's mutex.
+    // Besides this thread, only the pumping thread's walk and debug_dump
+    // ever take it, so it is uncontended but for a moment a few times a
+    // second; it is what lets those walks hold a state this thread may
+    // finish and remove.
+    switch (w->kind)
+    {
+        case owned_work::MESSAGE:
+        {
+            std::auto_ptr<e::buffer> msg(w->msg);
+            w->msg = NULL;
+            e::unpacker up = msg->unpack_from(BUSYBEE_HEADER_SIZE + pack_size(w->mt));
+            m_d->dispatch(w->id, w->mt, msg, up);
+            break;
+        }
+        case owned_work::BEGIN:
+            m_d->owned_begin(w->tg, w->id, w->nonce);
+            break;
+        case owned_work::DURABLE:
+        {
+            transaction_map_t::state_reference tsr;
+            transaction* xact = m_d->m_transactions.get_state(w->tg, &tsr);
+
+            if (xact)
+            {
+                xact->callback_durable(w->seqnos, m_d);
+            }
+
+            break;
+        }
+        case owned_work::PUMP:
+        {
+            transaction_map_t::state_reference tsr;
+            transaction* xact = m_d->m_transactions.get_state(w->tg, &tsr);
+
+            if (xact)
+            {
+                xact->externally_work_state_machine(m_d);
+            }
+
+            break;
+        }
+        default:
+            abort();
+    }
+}
+
+void
+daemon :: owner_thread :: run_deferred()
+{
+    std::vector<transaction_group> tgs;
+
+    // a state machine may defer another while this runs
+    while (m_deferred.next_batch(&tgs))
+    {
+        for (size_t i = 0; i < tgs.size(); ++i)
+        {
+            transaction_map_t::state_reference tsr;
+            transaction* xact = m_d->m_transactions.get_state(tgs[i], &tsr);
+
+            if (xact)
+            {
+                xact->run_deferred_state_machine(m_d);
+            }
+        }
+    }
+}
+
 void
 daemon :: callback_when_durable(const std::string& entry, const transaction_group& tg, uint64_t seqno)
 {
@@ -1604,22 +2694,20 @@ daemon :: callback_when_durable(const std::string& entry, const transaction_grou
         return;
     }
 
-    bool wake = false;
-
-    {
-        po6::threads::mutex::hold hold(&m_durable_mtx);
-        durable_cb d(x, tg, seqno);
-        m_durable_cbs.push_back(d);
-        std::push_heap(m_durable_cbs.begin(), m_durable_cbs.end());
-        wake = x <= m_durable_up_to;
-    }
+    m_durable_waiters.push(new durable_waiters::waiter(x, tg, seqno));
 
-    if (wake)
+    if (record_durable(x))
     {
         m_log.wake();
     }
 }
 
+bool
+daemon :: record_durable(int64_t idx)
+{
+    return idx >= 0 && static_cast<uint64_t>(idx) < e::atomic::load_64_acquire(&m_durable_bound);
+}
+
 void
 daemon :: durable()
 {
@@ -1655,52 +2743,94 @@ daemon :: durable()
             break;
         }
 
-        std::vector<durable_msg> msgs;
-        std::vector<durable_cb> cbs;
+        if (x >= 0)
+        {
+            e::atomic::store_64_release(&m_durable_bound, x);
+        }
 
+        // drain fences the store above against its reads of the waiters, so
+        // a waiter pushed concurrently is either drained now or its pusher
+        // sees the new bound and wakes this thread
+        std::vector<durable_waiters::waiter*> ready;
+        m_durable_waiters.drain(x, &ready);
+        // hand the callbacks to the owners of their transactions so that
+        // this thread gets back to waiting on the log
+        std::vector<durable_waiters::callback> cbs;
+        durable_waiters::fold_callbacks(ready, &cbs);
+
+        for (size_t i = 0; i < ready.size(); ++i)
         {
-            po6::threads::mutex::hold hold(&m_durable_mtx);
-            m_durable_up_to = x;
+            durable_waiters::waiter* w = ready[i];
 
-            while (!m_durable_msgs.empty() &&
-                   m_durable_msgs[0].recno < x)
+            if (w->msg)
             {
-                msgs.push_back(m_durable_msgs[0]);
-                std::pop_heap(m_durable_msgs.begin(), m_durable_msgs.end());
-                m_durable_msgs.pop_back();
+                std::auto_ptr<e::buffer> msg(w->msg);
+                w->msg = NULL;
+                send(w->id, msg);
             }
 
-            while (!m_durable_cbs.empty() &&
-                   m_durable_cbs[0].recno < x)
-            {
-                cbs.push_back(m_durable_cbs[0]);
-                std::pop_heap(m_durable_cbs.begin(), m_durable_cbs.end());
-                m_durable_cbs.pop_back();
-            }
+            delete w;
         }
 
-        for (size_t i = 0; i < msgs.size(); ++i)
+        for (size_t i = 0; i < cbs.size(); ++i)
         {
-            std::auto_ptr<e::buffer> msg(msgs[i].msg);
-            send(msgs[i].client, msg);
+            route(new owned_work(cbs[i].tg, cbs[i].seqnos));
         }
 
-        for (size_t i = 0; i < cbs.size(); ++i)
-        {
-            transaction_map_t::state_reference tsr;
-            transaction* xact = m_transactions.get_state(cbs[i].tg, &tsr);
+        m_gc.quiescent_state(&ts);
+    }
 
-            if (xact)
+    m_gc.deregister_thread(&ts);
+    LOG(INFO) << "durability monitor shutting down";
+}
+
+void
+daemon :: changes()
+{
+    sigset_t ss;
+
+    if (sigfillset(&ss) < 0 ||
+        pthread_sigmask(SIG_BLOCK, &ss, NULL) < 0)
+    {
+        LOG(ERROR) << "could not successfully block signals; this could result in undefined behavior";
+        return;
+    }
+
+    LOG(INFO) << "change feed started";
+    e::garbage_collector::thread_state ts;
+    m_gc.register_thread(&ts);
+
+    while (true)
+    {
+        m_gc.offline(&ts);
+        bool ok = m_changes.sync();
+        m_gc.online(&ts);
+
+        if (!ok)
+        {
+            if (e::atomic::increment_32_nobarrier(&s_interrupts, 0) == 0)
             {
-                xact->callback_durable(cbs[i].seqno, this);
+                LOG(ERROR) << "change feed: " << po6::strerror(m_changes.error());
             }
+
+            break;
+        }
+
+        // commits waiting on the feed may now be acknowledged
+        std::vector<transaction_group> tgs;
+        m_changes.durable_transactions(&tgs);
+
+        for (size_t i = 0; i < tgs.size(); ++i)
+        {
+            route(new owned_work(tgs[i]));
         }
 
+        answer_change_waiters();
         m_gc.quiescent_state(&ts);
     }
 
     m_gc.deregister_thread(&ts);
-    LOG(INFO) << "durability monitor shutting down";
+    LOG(INFO) << "change feed shutting down";
 }
 
 void
@@ -1730,16 +2860,58 @@ daemon :: pump()
             break;
         }
 
-        // a transaction implicitly pumps a local or global voter
-        for (transaction_map_t::iterator it(&m_transactions); it.valid(); ++it)
+        // a transaction implicitly pumps a local or global voter; queue the
+        // most urgent class first so batch work runs behind it on its owner
+        for (unsigned p = 0; p < CONSUS_PRIORITY_CLASSES; ++p)
         {
-            transaction* xact = *it;
-            xact->externally_work_state_machine(this);
+            for (transaction_map_t::iterator it(&m_transactions); it.valid(); ++it)
+            {
+                transaction* xact = *it;
+
+                if (std::min(unsigned(xact->state_key().txid.priority),
+                             unsigned(CONSUS_PRIORITY_CLASSES - 1)) == p)
+                {
+                    route(new owned_work(xact->state_key()));
+                }
+            }
         }
 
+        pump_deadlocks();
+        m_limiter.prune(po6::monotonic_time());
+        m_chunks.expire(po6::monotonic_time() - chunk_timeout());
+        m_chunk_sender.expire(po6::monotonic_time() - chunk_timeout());
+        answer_change_waiters();
         m_gc.quiescent_state(&ts);
     }
 
     m_gc.deregister_thread(&ts);
     LOG(INFO) << "pumping thread shutting down";
 }
+
+void
+daemon :: local()
+{
+    sigset_t ss;
+
+    if (sigfillset(&ss) < 0 ||
+        pthread_sigmask(SIG_BLOCK, &ss, NULL) < 0)
+    {
+        LOG(ERROR) << "could not successfully block signals; this could result in undefined behavior";
+        return;
+    }
+
+    if (!m_local.listen(m_us.bind_to))
+    {
+        PLOG(WARNING) << "not accepting clients over shared memory; they will use TCP instead";
+        return;
+    }
+
+    LOG(INFO) << "local client thread started";
+
+    while (e::atomic::increment_32_nobarrier(&s_interrupts, 0) == 0)
+    {
+        m_local.poll(250);
+    }
+
+    LOG(INFO) << "local client thread shutting down";
+}
@@ -40,7 +40,6 @@
 #include <e/compat.h>
 #include <e/garbage_collector.h>
 #include <e/serialization.h>
-#include <e/state_hash_table.h>
 
 // BusyBee
 #include <busybee.h>
@@ -49,21 +48,32 @@
 #include <replicant.h>
 
 // consus
+#include <consus.h>
 #include "namespace.h"
+#include "common/chunking.h"
+#include "common/constants.h"
 #include "common/coordinator_link.h"
 #include "common/ids.h"
 #include "common/network_msgtype.h"
+#include "common/state_table.h"
 #include "common/transaction_id.h"
 #include "common/transaction_group.h"
 #include "common/txman.h"
+#include "txman/change_feed.h"
 #include "txman/configuration.h"
 #include "txman/controller.h"
+#include "txman/deadlock_detector.h"
+#include "txman/dispositions.h"
 #include "txman/durable_log.h"
+#include "txman/durable_waiters.h"
 #include "txman/global_voter.h"
 #include "txman/kvs_lock_op.h"
 #include "txman/kvs_read.h"
+#include "txman/kvs_scan.h"
 #include "txman/kvs_write.h"
+#include "txman/local_server.h"
 #include "txman/local_voter.h"
+#include "txman/rate_limiter.h"
 #include "txman/transaction.h"
 
 BEGIN_CONSUS_NAMESPACE
@@ -89,33 +99,49 @@ class daemon
 
     private:
         struct coordinator_callback;
-        struct durable_msg;
-        struct durable_cb;
-        typedef e::state_hash_table<uint64_t, kvs_read> read_map_t;
-        typedef e::state_hash_table<uint64_t, kvs_write> write_map_t;
-        typedef e::state_hash_table<uint64_t, kvs_lock_op> lock_op_map_t;
-        typedef e::state_hash_table<transaction_group, transaction> transaction_map_t;
-        typedef e::state_hash_table<transaction_group, local_voter> local_voter_map_t;
-        typedef e::state_hash_table<transaction_group, global_voter> global_voter_map_t;
-        typedef e::nwf_hash_map<transaction_group, uint64_t, transaction_group::hash> disposition_map_t;
-        typedef std::vector<durable_msg> durable_msg_heap_t;
-        typedef std::vector<durable_cb> durable_cb_heap_t;
+        struct owned_work;
+        class owner_thread;
+        typedef state_table<uint64_t, kvs_read> read_map_t;
+        typedef state_table<uint64_t, kvs_scan> scan_map_t;
+        typedef state_table<uint64_t, kvs_write> write_map_t;
+        typedef state_table<uint64_t, kvs_lock_op> lock_op_map_t;
+        typedef state_table<transaction_group, transaction> transaction_map_t;
+        typedef state_table<transaction_group, local_voter> local_voter_map_t;
+        typedef state_table<transaction_group, global_voter> global_voter_map_t;
         friend class controller;
         friend class transaction;
         friend class local_voter;
         friend class global_voter;
         friend class kvs_lock_op;
         friend class kvs_read;
+        friend class kvs_scan;
         friend class kvs_write;
+        friend class local_server;
 
     private:
         void loop(size_t thread);
+        // everything said to or about a transaction group runs on the thread
+        // that owns the group; the rest runs where it was received
+        bool owning_group(network_msgtype mt, e::unpacker up, transaction_group* tg);
+        void route(owned_work* w);
+        owner_thread* owner(const transaction_group& tg);
+        // from tg's owning thread only:  work tg's state machine once the
+        // owner has run the work it has in hand, however many times this is
+        // called before then
+        void defer_state_machine(const transaction_group& tg);
+        void dispatch(comm_id id, network_msgtype mt, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void begin_transaction(comm_id id, uint64_t nonce, uint8_t priority, uint64_t start);
+        void owned_begin(const transaction_group& tg, comm_id id, uint64_t nonce);
         void process_begin(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_read(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_write(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_commit(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_abort(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_wound(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_wait_for(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_deadlock_probe(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_changes(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_index_lookup(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_paxos_2a(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_paxos_2b(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_lv_vote_1a(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
@@ -124,6 +150,7 @@ class daemon
         void process_lv_vote_2b(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_lv_vote_learn(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_commit_record(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_commit_record_ack(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_gv_outcome(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_gv_propose(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_gv_vote_1a(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
@@ -132,17 +159,51 @@ class daemon
         void process_gv_vote_2b(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_kvs_rep_rd_resp(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_kvs_rep_wr_resp(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
+        void process_kvs_rep_scan_resp(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         void process_kvs_lock_op_resp(comm_id id, std::auto_ptr<e::buffer> msg, e::unpacker up);
         kvs_read* create_read(read_map_t::state_reference* sr);
         kvs_write* create_write(write_map_t::state_reference* sr);
+        kvs_scan* create_scan(scan_map_t::state_reference* sr);
         kvs_lock_op* create_lock_op(lock_op_map_t::state_reference* sr);
+        comm_id deadlock_peer(const transaction_group& tg);
+        void send_deadlock_probe(const transaction_group& initiator,
+                                 uint64_t probe,
+                                 const transaction_group& victim,
+                                 const transaction_group& target,
+                                 uint64_t hops);
+        void send_wound(const transaction_group& tg);
+        void pump_deadlocks();
+        void send_changes(const change_feed::waiter& w);
+        void send_changes(const change_feed::waiter& w,
+                          const std::vector<change_feed::change>& changes,
+                          uint64_t next);
+        void answer_change_waiters();
 
     public:
         configuration* get_config();
         void debug_dump();
         uint64_t generate_nonce();
-        transaction_id generate_txid();
+        // the start a restart of previous may keep, or 0 for a fresh one
+        uint64_t inherited_start(const transaction_id& previous);
+        transaction_id generate_txid(uint8_t priority, uint64_t start);
+        // active transactions beyond which new transactions of a class are
+        // turned away; interactive work keeps headroom past the other classes
+        // but is bounded too, so it cannot exhaust the server on its own
+        uint64_t admission_limit(uint8_t priority)
+        { return priority == CONSUS_PRIORITY_INTERACTIVE ? 16384
+               : priority == CONSUS_PRIORITY_NORMAL ? 8192 : 1024; }
+        bool admit(uint8_t priority);
+        void send_throttled(comm_id id, uint64_t nonce, uint64_t retry_after);
+        void metrics_begin(const transaction_id& txid);
+        void metrics_terminated(const transaction_id& txid, bool committed, const arena& a);
+        void metrics_idle_abort();
         uint64_t resend_interval() { return PO6_SECONDS; }
+        // how long a lock wait may last before falling back to wound-wait
+        uint64_t deadlock_timeout() { return 5 * PO6_SECONDS; }
+        uint64_t chunk_timeout() { return 30 * PO6_SECONDS; }
+        // how long a change feed reader waits for something to read before
+        // getting an empty batch back
+        uint64_t changes_timeout() { return 10 * PO6_SECONDS; }
         bool send(comm_id id, std::auto_ptr<e::buffer> msg);
         unsigned send(paxos_group_id g, std::auto_ptr<e::buffer> msg);
         unsigned send(const paxos_group& g, std::auto_ptr<e::buffer> msg);
@@ -156,8 +217,11 @@ class daemon
         void send_if_durable(int64_t idx, comm_id id, std::auto_ptr<e::buffer> msg);
         void send_if_durable(int64_t idx, const comm_id* ids, e::buffer** msgs, size_t sz);
         void callback_when_durable(const std::string& entry, const transaction_group& tg, uint64_t seqno);
+        bool record_durable(int64_t idx);
         void durable();
+        void changes();
         void pump();
+        void local();
 
     private:
         txman m_us;
@@ -171,22 +235,50 @@ class daemon
         transaction_map_t m_transactions;
         local_voter_map_t m_local_voters;
         global_voter_map_t m_global_voters;
-        disposition_map_t m_dispositions;
+        dispositions m_dispositions;
         read_map_t m_readers;
+        scan_map_t m_scanners;
         write_map_t m_writers;
         lock_op_map_t m_lock_ops;
+        deadlock_detector m_deadlocks;
+        rate_limiter m_limiter;
+        chunk_reassembler m_chunks;
+        chunk_sender m_chunk_sender;
         durable_log m_log;
 
         // awaiting durability
         po6::threads::thread m_durable_thread;
-        po6::threads::mutex m_durable_mtx;
-        int64_t m_durable_up_to;
-        durable_msg_heap_t m_durable_msgs;
-        durable_cb_heap_t m_durable_cbs;
+        // records below the bound are on disk
+        uint64_t m_durable_bound;
+        durable_waiters m_durable_waiters;
+
+        // transaction owners
+        std::vector<e::compat::shared_ptr<owner_thread> > m_owners;
+
+        // committed writes
+        change_feed m_changes;
+        po6::threads::thread m_changes_thread;
 
         // state machine pumping
         po6::threads::thread m_pumping_thread;
 
+        // clients on this host
+        local_server m_local;
+        po6::threads::thread m_local_thread;
+
+        // per-priority-class accounting
+        uint64_t m_class_active[CONSUS_PRIORITY_CLASSES];
+        uint64_t m_class_begun[CONSUS_PRIORITY_CLASSES];
+        uint64_t m_class_committed[CONSUS_PRIORITY_CLASSES];
+        uint64_t m_class_aborted[CONSUS_PRIORITY_CLASSES];
+        uint64_t m_idle_aborts;
+        // transaction arenas, summed over every transaction that terminated
+        uint64_t m_arena_txns;
+        uint64_t m_arena_allocations;
+        uint64_t m_arena_bytes;
+        uint64_t m_arena_reserved;
+        uint64_t m_arena_blocks;
+
     private:
         daemon(const daemon&);
         daemon& operator = (const daemon&);
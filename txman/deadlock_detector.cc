@@ -0,0 +1,229 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <algorithm>
+#include <sstream>
+
+// consus
+#include "txman/deadlock_detector.h"
+
+using consus::deadlock_detector;
+
+deadlock_detector :: edge :: edge()
+    : nonce()
+    , waiter()
+    , holder()
+    , since()
+    , last_wound()
+{
+}
+
+deadlock_detector :: edge :: edge(uint64_t n,
+                                  const transaction_group& w,
+                                  const transaction_group& h,
+                                  uint64_t now)
+    : nonce(n)
+    , waiter(w)
+    , holder(h)
+    , since(now)
+    , last_wound(0)
+{
+}
+
+deadlock_detector :: edge :: ~edge() throw ()
+{
+}
+
+deadlock_detector :: deadlock_detector()
+    : m_mtx()
+    , m_edges()
+    , m_probes()
+{
+}
+
+deadlock_detector :: ~deadlock_detector() throw ()
+{
+}
+
+bool
+deadlock_detector :: wait_for(uint64_t nonce,
+                              const transaction_group& waiter,
+                              const transaction_group& holder,
+                              uint64_t now)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    edge_map_t::iterator it = m_edges.find(nonce);
+
+    if (it == m_edges.end())
+    {
+        m_edges.insert(std::make_pair(nonce, edge(nonce, waiter, holder, now)));
+        return true;
+    }
+
+    if (it->second.holder == holder)
+    {
+        return false;
+    }
+
+    // the lock changed hands; the wait starts anew
+    it->second = edge(nonce, waiter, holder, now);
+    return true;
+}
+
+void
+deadlock_detector :: forget(uint64_t nonce)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    m_edges.erase(nonce);
+}
+
+void
+deadlock_detector :: holders_of(const transaction_group& waiter,
+                                std::vector<transaction_group>* holders)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    for (edge_map_t::iterator it = m_edges.begin(); it != m_edges.end(); ++it)
+    {
+        // every member of the waiter's group may have reported the same
+        // wait under its own lock operation
+        if (it->second.waiter == waiter &&
+            std::find(holders->begin(), holders->end(), it->second.holder) == holders->end())
+        {
+            holders->push_back(it->second.holder);
+        }
+    }
+}
+
+void
+deadlock_detector :: nonces(std::vector<uint64_t>* ns)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    for (edge_map_t::iterator it = m_edges.begin(); it != m_edges.end(); ++it)
+    {
+        ns->push_back(it->first);
+    }
+}
+
+bool
+deadlock_detector :: first_visit(const transaction_group& initiator, uint64_t probe, uint64_t now)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return m_probes.insert(std::make_pair(probe_t(initiator, probe), now)).second;
+}
+
+void
+deadlock_detector :: periodic(uint64_t now, uint64_t interval, uint64_t timeout,
+                              std::vector<edge>* wound)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    for (edge_map_t::iterator it = m_edges.begin(); it != m_edges.end(); ++it)
+    {
+        edge* e = &it->second;
+
+        // Every cycle contains at least one edge where the waiter is older
+        // than the holder, so wounding along such edges after the timeout
+        // guarantees progress even if probes are lost.
+        if (e->since + timeout <= now &&
+            e->last_wound + interval <= now &&
+            e->waiter.txid.preempts(e->holder.txid))
+        {
+            e->last_wound = now;
+            wound->push_back(*e);
+        }
+    }
+
+    // a copy of a probe arriving after this long would be one of many
+    // anyway; the timeout has taken over from the probe by then
+    for (probe_map_t::iterator it = m_probes.begin(); it != m_probes.end(); )
+    {
+        if (it->second + timeout <= now)
+        {
+            m_probes.erase(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+size_t
+deadlock_detector :: probes_seen()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return m_probes.size();
+}
+
+std::string
+deadlock_detector :: debug_dump()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    std::ostringstream ostr;
+
+    for (edge_map_t::iterator it = m_edges.begin(); it != m_edges.end(); ++it)
+    {
+        ostr << "nonce=" << it->first
+             << " waiter=" << transaction_group::log(it->second.waiter)
+             << " holder=" << transaction_group::log(it->second.holder)
+             << " since=" << it->second.since << "\n";
+    }
+
+    return ostr.str();
+}
+
+bool
+deadlock_detector :: probe_lt :: operator () (const probe_t& lhs, const probe_t& rhs) const
+{
+    const transaction_id& l(lhs.first.txid);
+    const transaction_id& r(rhs.first.txid);
+
+    if (lhs.first.group != rhs.first.group)
+    {
+        return lhs.first.group < rhs.first.group;
+    }
+
+    if (l.group != r.group)
+    {
+        return l.group < r.group;
+    }
+
+    if (l.start != r.start)
+    {
+        return l.start < r.start;
+    }
+
+    if (l.number != r.number)
+    {
+        return l.number < r.number;
+    }
+
+    return lhs.second < rhs.second;
+}
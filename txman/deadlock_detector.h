@@ -0,0 +1,125 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_txman_deadlock_detector_h_
+#define consus_txman_deadlock_detector_h_
+
+// STL
+#include <map>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// consus
+#include "namespace.h"
+#include "common/transaction_group.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// The deadlock detector tracks the wait-for edges reported by the key-value
+// stores for lock operations issued by this transaction manager.  Each edge
+// is keyed by the nonce of the kvs_lock_op that is blocked, so that
+// retransmitted reports from different replicas collapse into one edge.
+//
+// Edges are only a hint.  They are used to chase probes through the wait-for
+// graph (which may span many transaction managers) and to fall back to
+// wound-wait for waits that outlive the deadlock timeout.  A probe is sent
+// once, when its edge appears or changes holder; a probe that is lost is
+// covered by the timeout rather than by resending it.
+//
+// Probes are named by their initiator and an id the initiator picks, and
+// each transaction manager forwards a given probe at most once, so a probe
+// costs at most one message per edge no matter how many paths reach it.
+class deadlock_detector
+{
+    public:
+        struct edge
+        {
+            edge();
+            edge(uint64_t nonce,
+                 const transaction_group& waiter,
+                 const transaction_group& holder,
+                 uint64_t now);
+            ~edge() throw ();
+
+            uint64_t nonce;
+            transaction_group waiter;
+            transaction_group holder;
+            uint64_t since;
+            uint64_t last_wound;
+        };
+
+    public:
+        deadlock_detector();
+        ~deadlock_detector() throw ();
+
+    public:
+        // returns true if the edge is new or now points at a different holder
+        bool wait_for(uint64_t nonce,
+                      const transaction_group& waiter,
+                      const transaction_group& holder,
+                      uint64_t now);
+        void forget(uint64_t nonce);
+        // each distinct holder the waiter waits for
+        void holders_of(const transaction_group& waiter,
+                        std::vector<transaction_group>* holders);
+        void nonces(std::vector<uint64_t>* ns);
+        // returns true the first time a probe passes through; false for
+        // every copy that arrives afterwards by another path
+        bool first_visit(const transaction_group& initiator, uint64_t probe, uint64_t now);
+        // collect the edges whose holder should be wounded because the
+        // waiter has waited longer than timeout, at most once per interval,
+        // and forget probes seen more than timeout ago
+        void periodic(uint64_t now, uint64_t interval, uint64_t timeout,
+                      std::vector<edge>* wound);
+        size_t probes_seen();
+        std::string debug_dump();
+
+    private:
+        typedef std::map<uint64_t, edge> edge_map_t;
+        typedef std::pair<transaction_group, uint64_t> probe_t;
+        struct probe_lt
+        {
+            bool operator () (const probe_t& lhs, const probe_t& rhs) const;
+        };
+        typedef std::map<probe_t, uint64_t, probe_lt> probe_map_t;
+
+    private:
+        po6::threads::mutex m_mtx;
+        edge_map_t m_edges;
+        probe_map_t m_probes;
+
+    private:
+        deadlock_detector(const deadlock_detector&);
+        deadlock_detector& operator = (const deadlock_detector&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_txman_deadlock_detector_h_
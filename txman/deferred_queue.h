@@ -0,0 +1,83 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_txman_deferred_queue_h_
+#define consus_txman_deferred_queue_h_
+
+// STL
+#include <vector>
+
+// consus
+#include "namespace.h"
+#include "common/transaction_group.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// Whether a transaction's state machine has a deferred pass queued.  A pass
+// clears it as it starts, so a deferral made while the pass runs queues
+// another rather than being lost.
+class deferral
+{
+    public:
+        deferral() : m_pending(false) {}
+
+    public:
+        // true if the transaction must be queued; false if a pass already is
+        bool defer();
+        void start_pass() { m_pending = false; }
+        bool pending() const { return m_pending; }
+
+    private:
+        bool m_pending;
+};
+
+// The transactions an owner thread will work once it has run the batch of
+// work in hand, in the order they asked.  Only the owner touches it.
+class deferred_queue
+{
+    public:
+        deferred_queue();
+        ~deferred_queue() throw ();
+
+    public:
+        bool empty() const { return m_queue.empty(); }
+        void push(const transaction_group& tg) { m_queue.push_back(tg); }
+        // moves everything queued so far into batch, so that working it may
+        // queue more; false once nothing is left
+        bool next_batch(std::vector<transaction_group>* batch);
+
+    private:
+        std::vector<transaction_group> m_queue;
+
+    private:
+        deferred_queue(const deferred_queue&);
+        deferred_queue& operator = (const deferred_queue&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_txman_deferred_queue_h_
@@ -0,0 +1,69 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// consus
+#include "common/constants.h"
+#include "txman/dispositions.h"
+
+// an abort whose start a restart has already taken
+#define CONSUS_VOTE_ABORT_INHERITED 0x696e686572697400ULL
+
+using consus::dispositions;
+
+dispositions :: dispositions(e::garbage_collector* gc)
+    : m_map(gc)
+{
+}
+
+dispositions :: ~dispositions() throw ()
+{
+}
+
+bool
+dispositions :: has(const transaction_group& tg)
+{
+    return m_map.has(tg);
+}
+
+void
+dispositions :: commit(const transaction_group& tg)
+{
+    m_map.put(tg, CONSUS_VOTE_COMMIT);
+}
+
+void
+dispositions :: abort(const transaction_group& tg)
+{
+    // recording the abort again must not make it inheritable again
+    m_map.put_ine(tg, CONSUS_VOTE_ABORT);
+}
+
+bool
+dispositions :: inherit(const transaction_group& tg)
+{
+    return m_map.cas(tg, CONSUS_VOTE_ABORT, CONSUS_VOTE_ABORT_INHERITED);
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_txman_dispositions_h_
+#define consus_txman_dispositions_h_
+
+// e
+#include <e/garbage_collector.h>
+#include <e/nwf_hash_map.h>
+
+// consus
+#include "namespace.h"
+#include "common/transaction_group.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// The outcome each transaction group reached here.  A restarted transaction
+// may keep the start of the incarnation it replaces, but only once:  the
+// first restart to inherit an aborted transaction's start marks the abort as
+// inherited, and any later restart naming the same transaction starts
+// afresh.
+class dispositions
+{
+    public:
+        dispositions(e::garbage_collector* gc);
+        ~dispositions() throw ();
+
+    public:
+        bool has(const transaction_group& tg);
+        void commit(const transaction_group& tg);
+        void abort(const transaction_group& tg);
+        // true for the first call on a transaction that aborted
+        bool inherit(const transaction_group& tg);
+
+    private:
+        typedef e::nwf_hash_map<transaction_group, uint64_t, transaction_group::hash> disposition_map_t;
+        disposition_map_t m_map;
+
+    private:
+        dispositions(const dispositions&);
+        dispositions& operator = (const dispositions&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_txman_dispositions_h_
@@ -0,0 +1,229 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define __STDC_LIMIT_MACROS
+
+// C
+#include <stdint.h>
+
+// STL
+#include <algorithm>
+
+// e
+#include <e/atomic.h>
+
+// consus
+#include "txman/durable_waiters.h"
+
+using consus::durable_waiters;
+
+durable_waiters :: waiter :: waiter(int64_t r, comm_id i, e::buffer* m)
+    : recno(r)
+    , id(i)
+    , msg(m)
+    , tg()
+    , seqno(0)
+    , next(NULL)
+{
+}
+
+durable_waiters :: waiter :: waiter(int64_t r, const transaction_group& t, uint64_t s)
+    : recno(r)
+    , id()
+    , msg(NULL)
+    , tg(t)
+    , seqno(s)
+    , next(NULL)
+{
+}
+
+durable_waiters :: waiter :: ~waiter() throw ()
+{
+    if (msg)
+    {
+        delete msg;
+    }
+}
+
+durable_waiters :: callback :: callback(const transaction_group& t)
+    : tg(t)
+    , seqnos()
+{
+}
+
+durable_waiters :: callback :: ~callback() throw ()
+{
+}
+
+durable_waiters :: durable_waiters()
+    : m_held()
+{
+    for (size_t i = 0; i < STRIPES; ++i)
+    {
+        m_stripes[i] = NULL;
+    }
+}
+
+durable_waiters :: ~durable_waiters() throw ()
+{
+    std::vector<waiter*> all;
+    drain(INT64_MAX, &all);
+
+    for (size_t i = 0; i < all.size(); ++i)
+    {
+        delete all[i];
+    }
+}
+
+void
+durable_waiters :: push(waiter* w)
+{
+    // consecutive records land on different stripes, so threads appending to
+    // the log at the same time rarely contend on the same head
+    waiter** head = &m_stripes[static_cast<uint64_t>(w->recno) % STRIPES];
+
+    while (true)
+    {
+        waiter* h = e::atomic::load_ptr_acquire(head);
+        w->next = h;
+
+        if (e::atomic::compare_and_swap_ptr_fullbarrier(head, h, w) == h)
+        {
+            return;
+        }
+    }
+}
+
+void
+durable_waiters :: drain(int64_t bound, std::vector<waiter*>* ready)
+{
+    const size_t start = ready->size();
+    // the caller published bound before calling; order that store before the
+    // loads of the stripes below.  A pusher orders its push before its read
+    // of the bound, so at least one side sees the other:  either the drain
+    // finds the waiter or the pusher sees the new bound and wakes the
+    // monitor.
+    e::atomic::memory_barrier();
+
+    for (size_t i = 0; i < STRIPES; ++i)
+    {
+        waiter* h = NULL;
+
+        while (true)
+        {
+            h = e::atomic::load_ptr_acquire(&m_stripes[i]);
+
+            if (!h || e::atomic::compare_and_swap_ptr_fullbarrier(&m_stripes[i], h, static_cast<waiter*>(NULL)) == h)
+            {
+                break;
+            }
+        }
+
+        while (h)
+        {
+            waiter* w = h;
+            h = h->next;
+            w->next = NULL;
+
+            if (w->recno < bound)
+            {
+                ready->push_back(w);
+            }
+            else
+            {
+                m_held.push_back(w);
+                std::push_heap(m_held.begin(), m_held.end(), recno_greater);
+            }
+        }
+    }
+
+    while (!m_held.empty() && m_held[0]->recno < bound)
+    {
+        ready->push_back(m_held[0]);
+        std::pop_heap(m_held.begin(), m_held.end(), recno_greater);
+        m_held.pop_back();
+    }
+
+    std::stable_sort(ready->begin() + start, ready->end(), recno_less);
+}
+
+void
+durable_waiters :: fold_callbacks(const std::vector<waiter*>& ready,
+                                  std::vector<callback>* cbs)
+{
+    std::vector<waiter*> ws;
+
+    for (size_t i = 0; i < ready.size(); ++i)
+    {
+        if (!ready[i]->msg)
+        {
+            ws.push_back(ready[i]);
+        }
+    }
+
+    // a stable sort keeps each transaction's operations in log order
+    std::stable_sort(ws.begin(), ws.end(), hash_less);
+
+    for (size_t i = 0; i < ws.size(); ++i)
+    {
+        if (!ws[i])
+        {
+            continue;
+        }
+
+        const size_t h = ws[i]->tg.hash();
+        cbs->push_back(callback(ws[i]->tg));
+        cbs->back().seqnos.push_back(ws[i]->seqno);
+
+        for (size_t j = i + 1; j < ws.size() && (!ws[j] || ws[j]->tg.hash() == h); ++j)
+        {
+            if (ws[j] && ws[j]->tg == ws[i]->tg)
+            {
+                cbs->back().seqnos.push_back(ws[j]->seqno);
+                ws[j] = NULL;
+            }
+        }
+    }
+}
+
+bool
+durable_waiters :: recno_less(const waiter* lhs, const waiter* rhs)
+{
+    return lhs->recno < rhs->recno;
+}
+
+bool
+durable_waiters :: recno_greater(const waiter* lhs, const waiter* rhs)
+{
+    return lhs->recno > rhs->recno;
+}
+
+bool
+durable_waiters :: hash_less(const waiter* lhs, const waiter* rhs)
+{
+    return lhs->tg.hash() < rhs->tg.hash();
+}
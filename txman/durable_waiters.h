@@ -0,0 +1,118 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_txman_durable_waiters_h_
+#define consus_txman_durable_waiters_h_
+
+// STL
+#include <vector>
+
+// e
+#include <e/buffer.h>
+
+// consus
+#include "namespace.h"
+#include "common/ids.h"
+#include "common/transaction_group.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// Messages and callbacks waiting for a record of the durable log to reach
+// disk.  Any number of threads may add waiters without taking a lock:  each
+// goes onto one of several striped lock-free stacks.  A single thread (the
+// durability monitor) drains the waiters whose records are below the log's
+// durable bound; those that are not yet durable stay behind in a heap only
+// that thread touches, which stays small because waiters are added just after
+// their record is appended.
+class durable_waiters
+{
+    public:
+        struct waiter
+        {
+            waiter(int64_t recno, comm_id id, e::buffer* msg);
+            waiter(int64_t recno, const transaction_group& tg, uint64_t seqno);
+            ~waiter() throw ();
+
+            int64_t recno;
+            // send msg to id...
+            comm_id id;
+            e::buffer* msg;
+            // ...or when msg is NULL, call back tg's transaction for seqno
+            transaction_group tg;
+            uint64_t seqno;
+            waiter* next;
+
+            private:
+                waiter(const waiter&);
+                waiter& operator = (const waiter&);
+        };
+        // a transaction's operations that became durable, in log order
+        struct callback
+        {
+            callback(const transaction_group& tg);
+            ~callback() throw ();
+
+            transaction_group tg;
+            std::vector<uint64_t> seqnos;
+        };
+
+    public:
+        durable_waiters();
+        ~durable_waiters() throw ();
+
+    public:
+        // takes ownership of w
+        void push(waiter* w);
+        // append every waiter whose record is below bound, in log order; the
+        // caller owns them afterwards.  A pusher that finds its record below
+        // a bound published before this call must make the caller drain
+        // again; this call is a full barrier to make that check reliable.
+        void drain(int64_t bound, std::vector<waiter*>* ready);
+        // fold the callbacks among the drained waiters into one per
+        // transaction, so each transaction's state machine runs once for the
+        // lot; messages are skipped
+        static void fold_callbacks(const std::vector<waiter*>& ready,
+                                   std::vector<callback>* cbs);
+
+    private:
+        static const size_t STRIPES = 16;
+        static bool recno_less(const waiter* lhs, const waiter* rhs);
+        static bool recno_greater(const waiter* lhs, const waiter* rhs);
+        static bool hash_less(const waiter* lhs, const waiter* rhs);
+
+    private:
+        waiter* m_stripes[STRIPES];
+        std::vector<waiter*> m_held;
+
+    private:
+        durable_waiters(const durable_waiters&);
+        durable_waiters& operator = (const durable_waiters&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_txman_durable_waiters_h_
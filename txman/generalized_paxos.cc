@@ -394,6 +394,56 @@ generalized_paxos :: all_accepted_commands(std::vector<command>* commands)
     commands->resize(it - commands->begin());
 }
 
+void
+generalized_paxos :: copy_from(const generalized_paxos& other)
+{
+    m_init = other.m_init;
+    m_interfere = other.m_interfere;
+    m_state = other.m_state;
+    m_us = other.m_us;
+    m_acceptors = other.m_acceptors;
+    m_proposed = other.m_proposed;
+    m_acceptor_ballot = other.m_acceptor_ballot;
+    m_acceptor_value = other.m_acceptor_value;
+    m_acceptor_value_src = other.m_acceptor_value_src;
+    m_leader_ballot = other.m_leader_ballot;
+    m_leader_value = other.m_leader_value;
+    m_promises = other.m_promises;
+    m_accepted = other.m_accepted;
+    m_learned_cached = other.m_learned_cached;
+}
+
+void
+generalized_paxos :: encode_state(std::string* out) const
+{
+    // everything but the comparator and the membership, which are fixed at
+    // init; two instances with equal encodings behave identically
+    out->clear();
+    e::packer pa(out);
+    pa = pa << uint8_t(m_state) << m_us
+            << uint64_t(m_proposed.size());
+
+    for (size_t i = 0; i < m_proposed.size(); ++i)
+    {
+        pa = pa << m_proposed[i];
+    }
+
+    pa = pa << m_acceptor_ballot << m_acceptor_value << m_acceptor_value_src
+            << m_leader_ballot << m_leader_value;
+
+    for (size_t i = 0; i < m_promises.size(); ++i)
+    {
+        pa = pa << m_promises[i];
+    }
+
+    for (size_t i = 0; i < m_accepted.size(); ++i)
+    {
+        pa = pa << m_accepted[i];
+    }
+
+    pa = pa << m_learned_cached;
+}
+
 std::string
 generalized_paxos :: debug_dump(e::compat::function<std::string(cstruct)> pcst,
                                 e::compat::function<std::string(command)> pcmd)
@@ -186,6 +186,11 @@ class generalized_paxos
         // used to decide retransmits/etc
         void all_accepted_commands(std::vector<command>* commands);
 
+        // used by the model checker to fork executions and to recognize
+        // states it has already explored
+        void copy_from(const generalized_paxos& other);
+        void encode_state(std::string* out) const;
+
         std::string debug_dump(e::compat::function<std::string(cstruct)> pcst, e::compat::function<std::string(command)> pcmd);
 
     private:
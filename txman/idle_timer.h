@@ -0,0 +1,65 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_txman_idle_timer_h_
+#define consus_txman_idle_timer_h_
+
+// C
+#include <stdint.h>
+
+// consus
+#include "namespace.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// How long a transaction has gone without activity, against the timeout that
+// applies to it:  the default it began with, tightened by any table it
+// touches that has a shorter one.  A zero timeout never expires, and neither
+// does a timer that has not yet seen any activity.  All times are in
+// nanoseconds.
+class idle_timer
+{
+    public:
+        idle_timer();
+        ~idle_timer() throw ();
+
+    public:
+        uint64_t timeout() const { return m_timeout; }
+        void set_timeout(uint64_t timeout) { m_timeout = timeout; }
+        // a nonzero timeout shorter than the current one replaces it
+        void tighten(uint64_t timeout);
+        void touch(uint64_t now) { m_last_activity = now; }
+        bool expired(uint64_t now) const;
+
+    private:
+        uint64_t m_last_activity;
+        uint64_t m_timeout;
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_txman_idle_timer_h_
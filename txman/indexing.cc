@@ -0,0 +1,112 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// C
+#include <stdlib.h>
+
+// e
+#include <e/serialization.h>
+
+// treadstone
+#include <treadstone.h>
+
+// consus
+#include "common/crc32c.h"
+#include "txman/indexing.h"
+
+std::string
+consus :: index_prefix(const e::slice& value)
+{
+    const uint32_t h = crc32c(0, value.data(), value.size());
+    std::string tmp;
+    e::packer(&tmp) << uint16_t(h >> 16) << value;
+    return tmp;
+}
+
+std::string
+consus :: index_key(const e::slice& value, const e::slice& key)
+{
+    std::string tmp = index_prefix(value);
+    tmp.append(key.cdata(), key.size());
+    return tmp;
+}
+
+bool
+consus :: index_extract(const secondary_index& si,
+                        const e::slice& document,
+                        std::string* value)
+{
+    if (document.empty())
+    {
+        return false;
+    }
+
+    treadstone_transformer* trans = treadstone_transformer_create(document.data(), document.size());
+
+    if (!trans)
+    {
+        return false;
+    }
+
+    unsigned char* v = NULL;
+    size_t v_sz = 0;
+    int rc = treadstone_transformer_extract_value(trans, si.field.c_str(), &v, &v_sz);
+    treadstone_transformer_destroy(trans);
+
+    if (rc < 0)
+    {
+        return false;
+    }
+
+    value->assign(reinterpret_cast<const char*>(v), v_sz);
+    free(v);
+    return true;
+}
+
+void
+consus :: index_changes(const secondary_index& si,
+                        const e::slice& key,
+                        const e::slice& old_doc,
+                        const e::slice& new_doc,
+                        std::vector<std::string>* tombstones,
+                        std::vector<std::string>* rows)
+{
+    std::string prev;
+    std::string next;
+    const bool had = index_extract(si, old_doc, &prev);
+    const bool has = index_extract(si, new_doc, &next);
+
+    if (had && (!has || prev != next))
+    {
+        tombstones->push_back(index_key(e::slice(prev), key));
+    }
+
+    if (has)
+    {
+        rows->push_back(index_key(e::slice(next), key));
+    }
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_txman_indexing_h_
+#define consus_txman_indexing_h_
+
+// C++
+#include <string>
+#include <vector>
+
+// e
+#include <e/slice.h>
+
+// consus
+#include "namespace.h"
+#include "common/secondary_index.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// Every index row for one field value shares a key prefix:  two bytes hashed
+// from the value followed by the length-prefixed value itself.  Key-value
+// stores place keys by their leading bytes, so all rows for a value land in
+// one partition and a lookup is a prefix scan of a single replica set.
+std::string index_prefix(const e::slice& value);
+// The row recording that the document at "key" holds "value"; the row's
+// value is the key, so lookups never have to parse the row's key.
+std::string index_key(const e::slice& value, const e::slice& key);
+// Pull the binary encoding of si.field out of a document.  Returns false when
+// the document is empty, is not an object, or lacks the field.
+bool index_extract(const secondary_index& si,
+                   const e::slice& document,
+                   std::string* value);
+// The index rows to tombstone and to write when a transaction takes the
+// document at "key" from old_doc to new_doc.  The row for the new value is
+// written even when the value is unchanged.
+void index_changes(const secondary_index& si,
+                   const e::slice& key,
+                   const e::slice& old_doc,
+                   const e::slice& new_doc,
+                   std::vector<std::string>* tombstones,
+                   std::vector<std::string>* rows);
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_txman_indexing_h_
@@ -143,3 +143,10 @@ kvs_lock_op :: callback_transaction(const transaction_group& tg, uint64_t seqno,
     m_tx_seqno = seqno;
     m_tx_func = func;
 }
+
+consus::transaction_group
+kvs_lock_op :: callback_group()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return m_tx_group;
+}
@@ -67,6 +67,8 @@ class kvs_lock_op
         void callback_client(comm_id client, uint64_t nonce);
         void callback_transaction(const transaction_group& tg, uint64_t seqno,
                                   void (transaction::*func)(consus_returncode, uint64_t, daemon*));
+        // the transaction this operation calls back, if any
+        transaction_group callback_group();
 
     private:
         const uint64_t m_state_key;
@@ -32,6 +32,7 @@
 #include <busybee.h>
 
 // consus
+#include "common/message.h"
 #include "common/network_msgtype.h"
 #include "txman/configuration.h"
 #include "txman/daemon.h"
@@ -92,33 +93,49 @@ void
 kvs_read :: response(consus_returncode rc,
                      uint64_t timestamp,
                      const e::slice& value,
+                     std::auto_ptr<e::buffer> backing,
                      daemon* d)
 {
     transaction_group tx_group;
     uint64_t tx_seqno;
-    void (transaction::*tx_func)(consus_returncode, uint64_t, const e::slice&, uint64_t, daemon*);
+    void (transaction::*tx_func)(consus_returncode, uint64_t, const e::slice&,
+                                 e::compat::shared_ptr<e::buffer>, uint64_t, daemon*);
 
     {
         po6::threads::mutex::hold hold(&m_mtx);
         m_finished = true;
+        tx_group = m_tx_group;
+        tx_seqno = m_tx_seqno;
+        tx_func = m_tx_func;
 
         if (m_client != comm_id())
         {
-            const size_t sz = BUSYBEE_HEADER_SIZE
-                            + pack_size(CLIENT_RESPONSE)
-                            + sizeof(uint64_t)
-                            + pack_size(rc)
-                            + sizeof(uint64_t)
-                            + pack_size(value);
-            std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-            msg->pack_at(BUSYBEE_HEADER_SIZE)
-                << CLIENT_RESPONSE << m_client_nonce << rc << timestamp << value;
+            std::auto_ptr<e::buffer> msg;
+
+            // a client response has the shape of the KVS_REP_RD_RESP it
+            // answers, so unless a transaction still needs the value, the
+            // response goes out in the buffer it arrived in
+            if (tx_group == transaction_group() &&
+                (message()
+                    << CLIENT_RESPONSE
+                    << m_client_nonce
+                    << rc
+                    << timestamp).reuse(backing.get(), value))
+            {
+                msg = backing;
+            }
+            else
+            {
+                msg = (message()
+                    << CLIENT_RESPONSE
+                    << m_client_nonce
+                    << rc
+                    << timestamp
+                    << value).create();
+            }
+
             d->send(m_client, msg);
         }
-
-        tx_group = m_tx_group;
-        tx_seqno = m_tx_seqno;
-        tx_func = m_tx_func;
     }
 
     if (tx_group != transaction_group())
@@ -128,7 +145,8 @@ kvs_read :: response(consus_returncode rc,
 
         if (xact)
         {
-            (*xact.*tx_func)(rc, timestamp, value, tx_seqno, d);
+            e::compat::shared_ptr<e::buffer> shared(backing.release());
+            (*xact.*tx_func)(rc, timestamp, value, shared, tx_seqno, d);
         }
     }
 }
@@ -146,6 +164,7 @@ kvs_read :: callback_transaction(const transaction_group& tg, uint64_t seqno,
                                  void (transaction::*func)(consus_returncode,
                                                            uint64_t,
                                                            const e::slice&,
+                                                           e::compat::shared_ptr<e::buffer>,
                                                            uint64_t, daemon*))
 {
     po6::threads::mutex::hold hold(&m_mtx);
@@ -153,3 +172,10 @@ kvs_read :: callback_transaction(const transaction_group& tg, uint64_t seqno,
     m_tx_seqno = seqno;
     m_tx_func = func;
 }
+
+consus::transaction_group
+kvs_read :: callback_group()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return m_tx_group;
+}
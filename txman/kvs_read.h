@@ -36,6 +36,7 @@
 
 // e
 #include <e/buffer.h>
+#include <e/compat.h>
 #include <e/slice.h>
 
 // consus
@@ -59,16 +60,21 @@ class kvs_read
     public:
         void read(const e::slice& table, const e::slice& key,
                   uint64_t timestamp, daemon* d);
+        // value points into backing, which the response is passed on in
         void response(consus_returncode rc,
                       uint64_t timestamp,
                       const e::slice& value,
+                      std::auto_ptr<e::buffer> backing,
                       daemon* d);
         void callback_client(comm_id client, uint64_t nonce);
         void callback_transaction(const transaction_group& tg, uint64_t seqno,
                                   void (transaction::*func)(consus_returncode,
                                                             uint64_t,
                                                             const e::slice&,
+                                                            e::compat::shared_ptr<e::buffer>,
                                                             uint64_t, daemon*));
+        // the transaction this operation calls back, if any
+        transaction_group callback_group();
 
     private:
         const uint64_t m_state_key;
@@ -81,7 +87,8 @@ class kvs_read
         // transaction callback
         transaction_group m_tx_group;
         uint64_t m_tx_seqno;
-        void (transaction::*m_tx_func)(consus_returncode, uint64_t, const e::slice&, uint64_t, daemon*);
+        void (transaction::*m_tx_func)(consus_returncode, uint64_t, const e::slice&,
+                                       e::compat::shared_ptr<e::buffer>, uint64_t, daemon*);
 
     private:
         kvs_read(const kvs_read&);
@@ -0,0 +1,124 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// BusyBee
+#include <busybee.h>
+
+// consus
+#include "common/network_msgtype.h"
+#include "txman/configuration.h"
+#include "txman/daemon.h"
+#include "txman/kvs_scan.h"
+
+using consus::kvs_scan;
+
+kvs_scan :: kvs_scan(const uint64_t& sk)
+    : m_state_key(sk)
+    , m_mtx()
+    , m_init(false)
+    , m_finished(false)
+    , m_client()
+    , m_client_nonce()
+{
+}
+
+kvs_scan :: ~kvs_scan() throw ()
+{
+}
+
+const uint64_t&
+kvs_scan :: state_key() const
+{
+    return m_state_key;
+}
+
+bool
+kvs_scan :: finished()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return !m_init || m_finished;
+}
+
+void
+kvs_scan :: scan(const e::slice& table, const e::slice& prefix, daemon* d)
+{
+    const size_t sz = BUSYBEE_HEADER_SIZE
+                    + pack_size(KVS_REP_SCAN)
+                    + sizeof(uint64_t)
+                    + pack_size(table)
+                    + pack_size(prefix);
+    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+    msg->pack_at(BUSYBEE_HEADER_SIZE)
+        << KVS_REP_SCAN << m_state_key << table << prefix;
+    configuration* c = d->get_config();
+    comm_id kvs = c->choose_kvs(d->m_us.dc);
+    d->send(kvs, msg);
+    po6::threads::mutex::hold hold(&m_mtx);
+    m_init = true;
+}
+
+void
+kvs_scan :: response(consus_returncode rc,
+                     const std::vector<e::slice>& values,
+                     daemon* d)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    m_finished = true;
+
+    if (m_client != comm_id())
+    {
+        size_t sz = BUSYBEE_HEADER_SIZE
+                  + pack_size(CLIENT_RESPONSE)
+                  + sizeof(uint64_t)
+                  + pack_size(rc)
+                  + sizeof(uint64_t);
+
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            sz += pack_size(values[i]);
+        }
+
+        std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
+        e::packer pa = msg->pack_at(BUSYBEE_HEADER_SIZE)
+            << CLIENT_RESPONSE << m_client_nonce << rc << uint64_t(values.size());
+
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            pa = pa << values[i];
+        }
+
+        d->send(m_client, msg);
+    }
+}
+
+void
+kvs_scan :: callback_client(comm_id client, uint64_t nonce)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    m_client = client;
+    m_client_nonce = nonce;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_txman_kvs_scan_h_
+#define consus_txman_kvs_scan_h_
+
+// STL
+#include <memory>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/buffer.h>
+#include <e/slice.h>
+
+// consus
+#include <consus.h>
+#include "namespace.h"
+#include "common/ids.h"
+
+BEGIN_CONSUS_NAMESPACE
+class daemon;
+
+class kvs_scan
+{
+    public:
+        kvs_scan(const uint64_t& sk);
+        ~kvs_scan() throw ();
+
+    public:
+        const uint64_t& state_key() const;
+        bool finished();
+
+    public:
+        void scan(const e::slice& table, const e::slice& prefix, daemon* d);
+        // values of the rows in the scanned range
+        void response(consus_returncode rc,
+                      const std::vector<e::slice>& values,
+                      daemon* d);
+        void callback_client(comm_id client, uint64_t nonce);
+
+    private:
+        const uint64_t m_state_key;
+        po6::threads::mutex m_mtx;
+        bool m_init;
+        bool m_finished;
+        // client callback
+        comm_id m_client;
+        uint64_t m_client_nonce;
+
+    private:
+        kvs_scan(const kvs_scan&);
+        kvs_scan& operator = (const kvs_scan&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_txman_kvs_scan_h_
@@ -152,3 +152,10 @@ kvs_write :: callback_transaction(const transaction_group& tg, uint64_t seqno,
     m_tx_seqno = seqno;
     m_tx_func = func;
 }
+
+consus::transaction_group
+kvs_write :: callback_group()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    return m_tx_group;
+}
@@ -0,0 +1,395 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// C
+#include <stddef.h>
+#include <string.h>
+
+// POSIX
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef CONSUS_LOCAL_CHANNEL
+#include <sys/epoll.h>
+#endif
+
+// Google Log
+#include <glog/logging.h>
+
+// e
+#include <e/atomic.h>
+
+// consus
+#include "common/generate_token.h"
+#include "common/local_channel.h"
+#include "txman/daemon.h"
+#include "txman/local_server.h"
+
+using consus::local_server;
+
+extern bool s_debug_mode;
+
+struct local_server::client
+{
+    client(comm_id i, int s, local_channel* c);
+    ~client() throw ();
+
+    const comm_id id;
+    const int sock;
+    // held to send on chan; receiving is left to the polling thread
+    po6::threads::mutex mtx;
+    const std::auto_ptr<local_channel> chan;
+
+    private:
+        client(const client&);
+        client& operator = (const client&);
+};
+
+local_server :: client :: client(comm_id i, int s, local_channel* c)
+    : id(i)
+    , sock(s)
+    , mtx()
+    , chan(c)
+{
+}
+
+local_server :: client :: ~client() throw ()
+{
+    close(sock);
+}
+
+local_server :: local_server(daemon* d)
+    : m_d(d)
+    , m_listen(-1)
+    , m_epoll(-1)
+    , m_mtx()
+    , m_clients()
+    , m_clients_sz(0)
+    , m_fds()
+{
+}
+
+local_server :: ~local_server() throw ()
+{
+    if (m_listen >= 0)
+    {
+        close(m_listen);
+    }
+
+    if (m_epoll >= 0)
+    {
+        close(m_epoll);
+    }
+}
+
+bool
+local_server :: listen(const po6::net::location& bind_to)
+{
+#ifdef CONSUS_LOCAL_CHANNEL
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_listen = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (m_epoll < 0 || m_listen < 0)
+    {
+        return false;
+    }
+
+    const std::string name = local_channel::socket_name(bind_to);
+    struct sockaddr_un addr;
+
+    if (name.size() > sizeof(addr.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memmove(addr.sun_path, name.data(), name.size());
+    socklen_t addr_sz = offsetof(struct sockaddr_un, sun_path) + name.size();
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = m_listen;
+    return bind(m_listen, reinterpret_cast<struct sockaddr*>(&addr), addr_sz) == 0 &&
+           ::listen(m_listen, SOMAXCONN) == 0 &&
+           epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_listen, &ev) == 0;
+#else
+    (void) bind_to;
+    errno = ENOSYS;
+    return false;
+#endif
+}
+
+void
+local_server :: poll(int timeout)
+{
+#ifdef CONSUS_LOCAL_CHANNEL
+    struct epoll_event events[64];
+    int n = epoll_wait(m_epoll, events, sizeof(events) / sizeof(events[0]), timeout);
+
+    for (int i = 0; i < n; ++i)
+    {
+        const int fd = events[i].data.fd;
+
+        if (fd == m_listen)
+        {
+            accept();
+            continue;
+        }
+
+        fd_map_t::iterator it = m_fds.find(fd);
+
+        // dropped earlier in this round
+        if (it == m_fds.end())
+        {
+            continue;
+        }
+
+        e::compat::shared_ptr<client> c = it->second;
+
+        if (fd == c->sock)
+        {
+            // clients never write to the socket; readable means gone
+            char byte;
+            ssize_t ret = ::read(fd, &byte, 1);
+
+            if (ret == 0 || (ret < 0 && errno != EAGAIN && errno != EINTR))
+            {
+                drop(c);
+            }
+        }
+        else
+        {
+            c->chan->silence();
+
+            if (!drain(c.get()))
+            {
+                drop(c);
+            }
+        }
+    }
+#else
+    (void) timeout;
+#endif
+}
+
+bool
+local_server :: serves(comm_id id)
+{
+    if (e::atomic::load_64_acquire(&m_clients_sz) == 0)
+    {
+        return false;
+    }
+
+    po6::threads::mutex::hold hold(&m_mtx);
+    return m_clients.find(id) != m_clients.end();
+}
+
+size_t
+local_server :: clients()
+{
+    return e::atomic::load_64_acquire(&m_clients_sz);
+}
+
+busybee_returncode
+local_server :: send(uint64_t id, std::auto_ptr<e::buffer> msg)
+{
+    e::compat::shared_ptr<client> c;
+
+    {
+        po6::threads::mutex::hold hold(&m_mtx);
+        client_map_t::iterator it = m_clients.find(comm_id(id));
+
+        if (it == m_clients.end())
+        {
+            return BUSYBEE_DISRUPTED;
+        }
+
+        c = it->second;
+    }
+
+    po6::threads::mutex::hold hold(&c->mtx);
+
+    if (!c->chan->send(msg))
+    {
+        // the polling thread sees the hangup and drops the client
+        ::shutdown(c->sock, SHUT_RDWR);
+        return BUSYBEE_DISRUPTED;
+    }
+
+    return BUSYBEE_SUCCESS;
+}
+
+void
+local_server :: accept()
+{
+#ifdef CONSUS_LOCAL_CHANNEL
+    while (true)
+    {
+        int sock = accept4(m_listen, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (sock < 0)
+        {
+            if (errno == ECONNABORTED || errno == EINTR)
+            {
+                continue;
+            }
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                PLOG(WARNING) << "could not accept local client";
+            }
+
+            return;
+        }
+
+        // the socket's name is open to anyone on the host
+        struct ucred cred;
+        socklen_t cred_sz = sizeof(cred);
+
+        if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &cred_sz) < 0 ||
+            cred.uid != geteuid() || cred.gid != getegid())
+        {
+            LOG(WARNING) << "refusing local client running as another user";
+            close(sock);
+            continue;
+        }
+
+        std::auto_ptr<local_channel> chan(local_channel::create());
+        int fds[local_channel::DESCRIPTORS];
+        uint64_t token = 0;
+
+        if (chan.get())
+        {
+            chan->descriptors(fds);
+        }
+
+        if (!chan.get() ||
+            !generate_token(&token) ||
+            !local_channel::send_descriptors(sock, fds))
+        {
+            PLOG(WARNING) << "could not set up a channel for a local client";
+            close(sock);
+            continue;
+        }
+
+        e::compat::shared_ptr<client> c(new client(comm_id(token), sock, chan.release()));
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = c->sock;
+
+        if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, c->sock, &ev) < 0)
+        {
+            PLOG(WARNING) << "could not watch local client";
+            continue;
+        }
+
+        ev.data.fd = c->chan->bell();
+
+        if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, c->chan->bell(), &ev) < 0)
+        {
+            PLOG(WARNING) << "could not watch local client";
+            epoll_ctl(m_epoll, EPOLL_CTL_DEL, c->sock, &ev);
+            continue;
+        }
+
+        m_fds[c->sock] = c;
+        m_fds[c->chan->bell()] = c;
+
+        {
+            po6::threads::mutex::hold hold(&m_mtx);
+            m_clients[c->id] = c;
+            e::atomic::store_64_release(&m_clients_sz, m_clients.size());
+        }
+
+        LOG_IF(INFO, s_debug_mode) << "local client " << c->id << " connected";
+
+        // arms the bell for the client's first message
+        if (!drain(c.get()))
+        {
+            drop(c);
+        }
+    }
+#endif
+}
+
+bool
+local_server :: drain(client* c)
+{
+    while (true)
+    {
+        std::auto_ptr<e::buffer> msg;
+
+        while (c->chan->recv(&msg))
+        {
+            m_d->m_busybee->deliver(c->id.get(), msg);
+        }
+
+        po6::threads::mutex::hold hold(&c->mtx);
+
+        if (c->chan->broken())
+        {
+            LOG(WARNING) << "local client " << c->id << " corrupted its channel";
+            return false;
+        }
+
+        if (c->chan->prepare_to_wait())
+        {
+            return true;
+        }
+    }
+}
+
+void
+local_server :: drop(e::compat::shared_ptr<client> c)
+{
+#ifdef CONSUS_LOCAL_CHANNEL
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, c->sock, &ev);
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, c->chan->bell(), &ev);
+#endif
+    m_fds.erase(c->sock);
+    m_fds.erase(c->chan->bell());
+
+    {
+        po6::threads::mutex::hold hold(&m_mtx);
+        m_clients.erase(c->id);
+        e::atomic::store_64_release(&m_clients_sz, m_clients.size());
+    }
+
+    m_d->m_chunks.forget(c->id);
+    m_d->m_chunk_sender.forget(c->id);
+    LOG_IF(INFO, s_debug_mode) << "local client " << c->id << " disconnected";
+}
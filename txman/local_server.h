@@ -0,0 +1,103 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_txman_local_server_h_
+#define consus_txman_local_server_h_
+
+// STL
+#include <map>
+#include <memory>
+
+// po6
+#include <po6/net/location.h>
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/buffer.h>
+#include <e/compat.h>
+
+// BusyBee
+#include <busybee.h>
+
+// consus
+#include "namespace.h"
+#include "common/ids.h"
+
+BEGIN_CONSUS_NAMESPACE
+class daemon;
+
+// Serves clients on this host over shared-memory channels (see
+// common/local_channel.h).  Each client gets an id of its own; what it sends
+// enters BusyBee's receive queue as if it came over TCP from that id, and
+// what the daemon sends to that id goes over the channel instead.
+class local_server
+{
+    public:
+        local_server(daemon* d);
+        ~local_server() throw ();
+
+    public:
+        // accept clients of the transaction manager at bind_to
+        bool listen(const po6::net::location& bind_to);
+        // wait up to timeout milliseconds for clients to connect, send, or
+        // go away, and deal with them; from one thread only
+        void poll(int timeout);
+        // whether id names a client connected here
+        bool serves(comm_id id);
+        size_t clients();
+        // for send_chunked
+        busybee_returncode send(uint64_t id, std::auto_ptr<e::buffer> msg);
+
+    private:
+        struct client;
+        typedef std::map<comm_id, e::compat::shared_ptr<client> > client_map_t;
+        typedef std::map<int, e::compat::shared_ptr<client> > fd_map_t;
+
+    private:
+        void accept();
+        // false if the client must be dropped
+        bool drain(client* c);
+        void drop(e::compat::shared_ptr<client> c);
+
+    private:
+        daemon* m_d;
+        int m_listen;
+        int m_epoll;
+        po6::threads::mutex m_mtx;
+        client_map_t m_clients;
+        uint64_t m_clients_sz;
+        // sockets and bells; only touched by the thread calling poll()
+        fd_map_t m_fds;
+
+    private:
+        local_server(const local_server&);
+        local_server& operator = (const local_server&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_txman_local_server_h_
@@ -54,6 +54,7 @@
 #include "tools/connect_opts.h"
 
 extern bool s_debug_mode;
+extern long s_idle_timeout;
 
 int
 main(int argc, const char* argv[])
@@ -108,6 +109,9 @@ main(int argc, const char* argv[])
     ap.arg().name('t', "threads")
             .description("the number of threads which will handle network traffic")
             .metavar("N").as_long(&threads);
+    ap.arg().long_name("idle-timeout")
+            .description("abort transactions whose client is idle for S seconds before committing (default: 60, 0 disables)")
+            .metavar("S").as_long(&s_idle_timeout);
     ap.arg().long_name("log-immediate")
             .description("immediately flush all log output")
             .set_true(&log_immediate).hidden();
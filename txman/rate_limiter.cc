@@ -0,0 +1,306 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// STL
+#include <algorithm>
+#include <sstream>
+
+// po6
+#include <po6/time.h>
+
+// e
+#include <e/strescape.h>
+
+// consus
+#include "txman/rate_limiter.h"
+
+using consus::rate_limiter;
+
+struct rate_limiter :: bucket
+{
+    bucket() : rate(0), tokens(0), last(0) {}
+    ~bucket() throw () {}
+
+    void set_rate(uint64_t r, uint64_t now)
+    {
+        if (rate == 0)
+        {
+            tokens = r;
+            last = now;
+        }
+
+        rate = r;
+        tokens = std::min(tokens, double(rate));
+    }
+
+    void refill(uint64_t now)
+    {
+        if (now > last)
+        {
+            tokens += double(rate) * double(now - last) / PO6_SECONDS;
+            tokens = std::min(tokens, double(rate));
+            last = now;
+        }
+    }
+
+    // nanoseconds until this bucket is out of debt far enough for n tokens
+    uint64_t wait(uint64_t n) const
+    {
+        if (rate == 0)
+        {
+            return 0;
+        }
+
+        const double need = std::min(double(n), double(rate));
+
+        if (tokens >= need)
+        {
+            return 0;
+        }
+
+        return uint64_t((need - tokens) * PO6_SECONDS / rate) + 1;
+    }
+
+    void charge(uint64_t n)
+    {
+        if (rate > 0)
+        {
+            tokens -= n;
+        }
+    }
+
+    uint64_t rate;
+    double tokens;
+    uint64_t last;
+};
+
+struct rate_limiter :: limit
+{
+    limit() : ops(), bytes(), last_used(0), admitted(0), throttled(0) {}
+    ~limit() throw () {}
+
+    void configure(const quota& q, uint64_t now)
+    {
+        ops.set_rate(q.ops_per_second, now);
+        bytes.set_rate(q.bytes_per_second, now);
+    }
+
+    uint64_t wait(uint64_t sz, uint64_t now)
+    {
+        ops.refill(now);
+        bytes.refill(now);
+        return std::max(ops.wait(1), bytes.wait(sz));
+    }
+
+    void charge(uint64_t sz, uint64_t now)
+    {
+        ops.charge(1);
+        bytes.charge(sz);
+        last_used = now;
+        ++admitted;
+    }
+
+    bucket ops;
+    bucket bytes;
+    uint64_t last_used;
+    uint64_t admitted;
+    uint64_t throttled;
+};
+
+rate_limiter :: rate_limiter()
+    : m_mtx()
+    , m_client_quota(quota::CLIENT, "", 0, 0, 0)
+    , m_tables()
+    , m_clients()
+    , m_admitted(0)
+    , m_throttled(0)
+{
+}
+
+rate_limiter :: ~rate_limiter() throw ()
+{
+}
+
+void
+rate_limiter :: reconfigure(const std::vector<quota>& quotas, uint64_t now)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    table_map_t tables;
+    m_client_quota = quota(quota::CLIENT, "", 0, 0, 0);
+
+    for (size_t i = 0; i < quotas.size(); ++i)
+    {
+        if (quotas[i].scope == quota::CLIENT)
+        {
+            m_client_quota = quotas[i];
+        }
+        else if (quotas[i].scope == quota::TABLE && quotas[i].rate_limited())
+        {
+            limit& l(tables[quotas[i].name]);
+            table_map_t::iterator it = m_tables.find(quotas[i].name);
+
+            if (it != m_tables.end())
+            {
+                l = it->second;
+            }
+
+            l.configure(quotas[i], now);
+        }
+    }
+
+    m_tables.swap(tables);
+
+    if (!m_client_quota.rate_limited())
+    {
+        m_clients.clear();
+    }
+
+    for (client_map_t::iterator it = m_clients.begin(); it != m_clients.end(); ++it)
+    {
+        it->second.configure(m_client_quota, now);
+    }
+}
+
+bool
+rate_limiter :: admit(comm_id client, const e::slice& table,
+                      uint64_t bytes, uint64_t now, uint64_t* retry_after)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    limit* cl = NULL;
+    limit* tl = NULL;
+
+    if (m_client_quota.rate_limited())
+    {
+        client_map_t::iterator it = m_clients.find(client);
+
+        if (it == m_clients.end())
+        {
+            it = m_clients.insert(std::make_pair(client, limit())).first;
+            it->second.configure(m_client_quota, now);
+        }
+
+        cl = &it->second;
+    }
+
+    if (!table.empty() && !m_tables.empty())
+    {
+        table_map_t::iterator it = m_tables.find(table.str());
+
+        if (it != m_tables.end())
+        {
+            tl = &it->second;
+        }
+    }
+
+    uint64_t wait = 0;
+
+    if (cl)
+    {
+        const uint64_t w = cl->wait(bytes, now);
+        cl->throttled += w > 0 ? 1 : 0;
+        wait = std::max(wait, w);
+    }
+
+    if (tl)
+    {
+        const uint64_t w = tl->wait(bytes, now);
+        tl->throttled += w > 0 ? 1 : 0;
+        wait = std::max(wait, w);
+    }
+
+    if (wait > 0)
+    {
+        ++m_throttled;
+        *retry_after = wait;
+        return false;
+    }
+
+    if (cl)
+    {
+        cl->charge(bytes, now);
+    }
+
+    if (tl)
+    {
+        tl->charge(bytes, now);
+    }
+
+    ++m_admitted;
+    *retry_after = 0;
+    return true;
+}
+
+void
+rate_limiter :: prune(uint64_t now)
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+
+    for (client_map_t::iterator it = m_clients.begin(); it != m_clients.end(); )
+    {
+        if (it->second.last_used + 60 * PO6_SECONDS < now)
+        {
+            m_clients.erase(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+std::string
+rate_limiter :: debug_dump()
+{
+    po6::threads::mutex::hold hold(&m_mtx);
+    std::ostringstream ostr;
+    ostr << "admitted=" << m_admitted << " throttled=" << m_throttled << "\n";
+
+    for (table_map_t::iterator it = m_tables.begin(); it != m_tables.end(); ++it)
+    {
+        ostr << "table=\"" << e::strescape(it->first) << "\""
+             << " ops/s=" << it->second.ops.rate
+             << " bytes/s=" << it->second.bytes.rate
+             << " admitted=" << it->second.admitted
+             << " throttled=" << it->second.throttled << "\n";
+    }
+
+    if (m_client_quota.rate_limited())
+    {
+        ostr << "per-client ops/s=" << m_client_quota.ops_per_second
+             << " bytes/s=" << m_client_quota.bytes_per_second
+             << " tracking " << m_clients.size() << " clients\n";
+    }
+
+    for (client_map_t::iterator it = m_clients.begin(); it != m_clients.end(); ++it)
+    {
+        ostr << "client=" << it->first.get()
+             << " admitted=" << it->second.admitted
+             << " throttled=" << it->second.throttled << "\n";
+    }
+
+    return ostr.str();
+}
@@ -0,0 +1,94 @@
+// Copyright (c) 2017, Robert Escriva, Cornell University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright notice,
+//       this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Consus nor the names of its contributors may be
+//       used to endorse or promote products derived from this software without
+//       specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef consus_txman_rate_limiter_h_
+#define consus_txman_rate_limiter_h_
+
+// STL
+#include <map>
+#include <string>
+#include <vector>
+
+// po6
+#include <po6/threads/mutex.h>
+
+// e
+#include <e/slice.h>
+
+// consus
+#include "namespace.h"
+#include "common/ids.h"
+#include "common/quota.h"
+
+BEGIN_CONSUS_NAMESPACE
+
+// The rate limiter enforces the quotas in the configuration with a pair of
+// token buckets (operations and bytes) per table and per client connection.
+// Buckets hold up to one second's worth of tokens.  An operation is admitted
+// whenever its buckets are not in debt, so one large write may overdraw a
+// bucket and delay the operations that follow it.
+class rate_limiter
+{
+    public:
+        rate_limiter();
+        ~rate_limiter() throw ();
+
+    public:
+        // adopt the quotas of a new configuration; buckets whose target is
+        // still limited keep their tokens
+        void reconfigure(const std::vector<quota>& quotas, uint64_t now);
+        // charge one operation of the given size to the client and, if it
+        // names one, the table; on refusal nothing is charged and
+        // *retry_after holds the nanoseconds until it would be admitted
+        bool admit(comm_id client, const e::slice& table,
+                   uint64_t bytes, uint64_t now, uint64_t* retry_after);
+        // forget clients whose buckets have been idle long enough to refill
+        void prune(uint64_t now);
+        std::string debug_dump();
+
+    private:
+        struct bucket;
+        struct limit;
+        typedef std::map<std::string, limit> table_map_t;
+        typedef std::map<comm_id, limit> client_map_t;
+
+    private:
+        po6::threads::mutex m_mtx;
+        quota m_client_quota;
+        table_map_t m_tables;
+        client_map_t m_clients;
+        uint64_t m_admitted;
+        uint64_t m_throttled;
+
+    private:
+        rate_limiter(const rate_limiter&);
+        rate_limiter& operator = (const rate_limiter&);
+};
+
+END_CONSUS_NAMESPACE
+
+#endif // consus_txman_rate_limiter_h_
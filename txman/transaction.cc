@@ -34,7 +34,11 @@
 // Google Log
 #include <glog/logging.h>
 
+// po6
+#include <po6/time.h>
+
 // e
+#include <e/atomic.h>
 #include <e/serialization.h>
 #include <e/strescape.h>
 
@@ -44,7 +48,9 @@
 // consus
 #include "common/consus.h"
 #include "common/ids.h"
+#include "common/message.h"
 #include "txman/daemon.h"
+#include "txman/indexing.h"
 #include "txman/log_entry_t.h"
 #include "txman/transaction.h"
 
@@ -88,6 +94,7 @@
 using consus::transaction;
 
 extern bool s_debug_mode;
+extern long s_idle_timeout;
 
 struct transaction :: comparison
 {
@@ -111,7 +118,7 @@ struct transaction :: operation
 
     // utils
     void set_client(comm_id client, uint64_t nonce);
-    bool merge(const operation& op, const comparison& cmp);
+    bool merge(const operation& op, const comparison& cmp, arena* a);
 
     // log entry
     log_entry_t type;
@@ -120,7 +127,6 @@ struct transaction :: operation
     uint64_t timestamp;
     e::slice value;
     consus_returncode rc;
-    e::compat::shared_ptr<e::buffer> backing;
 
     // locking
     bool require_lock;
@@ -131,7 +137,8 @@ struct transaction :: operation
     // reading
     bool require_read;
     bool read_done;
-    std::string read_backing;
+    // the KVS response that value points into
+    e::compat::shared_ptr<e::buffer> read_backing;
     uint64_t read_nonce;
 
     // writing
@@ -149,6 +156,16 @@ struct transaction :: operation
     bool verify_write_done;
     uint64_t verify_write_nonce;
 
+    // secondary indexes; the prior document is read under the write lock so
+    // that the rows pointing at it can be retired alongside the write
+    bool index_resolved;
+    std::vector<secondary_index> indexes;
+    bool index_read_done;
+    uint64_t index_read_nonce;
+    e::slice index_old;
+    bool index_writes_issued;
+    unsigned index_writes_pending;
+
     // durability
     bool log_write_issued;
     bool log_write_durable;
@@ -156,9 +173,10 @@ struct transaction :: operation
     uint64_t paxos_timestamps[CONSUS_MAX_REPLICATION_FACTOR];
     uint64_t paxos_2b_timestamps[CONSUS_MAX_REPLICATION_FACTOR];
 
-    // client response
+    // client response; a nonzero retry_after turns an abort into "throttled"
     comm_id client;
     uint64_t nonce;
+    uint64_t retry_after;
 };
 
 transaction :: operation :: operation()
@@ -168,7 +186,6 @@ transaction :: operation :: operation()
     , timestamp(0)
     , value()
     , rc(CONSUS_GARBAGE)
-    , backing()
     , require_lock(false)
     , lock_acquired(false)
     , lock_released(false)
@@ -186,10 +203,18 @@ transaction :: operation :: operation()
     , require_verify_write(false)
     , verify_write_done(false)
     , verify_write_nonce()
+    , index_resolved(false)
+    , indexes()
+    , index_read_done(false)
+    , index_read_nonce(0)
+    , index_old()
+    , index_writes_issued(false)
+    , index_writes_pending(0)
     , log_write_issued(false)
     , log_write_durable(false)
     , client()
     , nonce()
+    , retry_after(0)
 {
     for (unsigned i = 0; i < CONSUS_MAX_REPLICATION_FACTOR; ++i)
     {
@@ -203,6 +228,32 @@ transaction :: operation :: ~operation() throw ()
 {
 }
 
+struct transaction :: commit_record_chunk
+{
+    commit_record_chunk();
+    ~commit_record_chunk() throw ();
+
+    // log entries, each packed as a slice
+    std::string entries;
+    // per remote data center, indexed like m_dcs
+    uint64_t sent[CONSUS_MAX_REPLICATION_FACTOR];
+    bool acked[CONSUS_MAX_REPLICATION_FACTOR];
+};
+
+transaction :: commit_record_chunk :: commit_record_chunk()
+    : entries()
+{
+    for (unsigned i = 0; i < CONSUS_MAX_REPLICATION_FACTOR; ++i)
+    {
+        sent[i] = 0;
+        acked[i] = false;
+    }
+}
+
+transaction :: commit_record_chunk :: ~commit_record_chunk() throw ()
+{
+}
+
 void
 transaction :: operation :: set_client(comm_id c, uint64_t n)
 {
@@ -214,15 +265,15 @@ transaction :: operation :: set_client(comm_id c, uint64_t n)
 }
 
 bool
-transaction :: operation :: merge(const operation& op, const comparison& cmp)
+transaction :: operation :: merge(const operation& op, const comparison& cmp, arena* a)
 {
     if (type == LOG_ENTRY_NOP)
     {
+        // op points into whatever message carried it; keep our own copy
         type = op.type;
-        table = op.table;
-        key = op.key;
-        value = op.value;
-        backing = op.backing;
+        table = a->copy(op.table);
+        key = a->copy(op.key);
+        value = a->copy(op.value);
     }
     else
     {
@@ -240,20 +291,30 @@ transaction :: operation :: merge(const operation& op, const comparison& cmp)
 
 transaction :: transaction(const transaction_group& tg)
     : m_tg(tg)
-    , m_mtx()
     , m_init_timestamp()
     , m_group()
     , m_dcs()
     , m_dcs_sz()
     , m_state(INITIALIZED)
+    , m_published_state(INITIALIZED)
     , m_decision(INITIALIZED)
     , m_timestamp(0)
     , m_prefer_to_commit(true)
     , m_ops()
     , m_deferred_2b()
+    , m_cr_chunks()
+    , m_cr_peers()
+    , m_cr_count(0)
+    , m_cr_applied(0)
+    , m_cr_pending()
+    , m_idle()
+    , m_idle_wounded(false)
+    , m_deferred()
+    , m_changes_published(false)
+    , m_changes_end(0)
+    , m_arena()
+    , m_scratch()
 {
-    po6::threads::mutex::hold hold(&m_mtx);
-
     for (unsigned i = 0; i < CONSUS_MAX_REPLICATION_FACTOR; ++i)
     {
         m_dcs_timestamps[i] = 0;
@@ -273,8 +334,10 @@ transaction :: state_key() const
 bool
 transaction :: finished()
 {
-    po6::threads::mutex::hold hold(&m_mtx);
-    return m_state == INITIALIZED || m_state == COLLECTED;
+    // called by whichever thread drops the last reference, which need not be
+    // the owner; it only ever sees the published state
+    const uint32_t s = e::atomic::load_32_acquire(&m_published_state);
+    return s == INITIALIZED || s == COLLECTED;
 }
 
 void
@@ -283,7 +346,6 @@ transaction :: begin(comm_id id, uint64_t nonce, uint64_t timestamp,
                      const std::vector<paxos_group_id>& dcs,
                      daemon* d)
 {
-    po6::threads::mutex::hold hold(&m_mtx);
     CLIENT_RETURN_IF_EXECUTED(0, id, nonce, "begin");
     internal_begin("client", timestamp, group, dcs, d);
     m_ops[0].set_client(id, nonce);
@@ -304,12 +366,10 @@ transaction :: paxos_2a_begin(uint64_t seqno,
     if (seqno != 0 || up.error() || up.remain() || !group)
     {
         UNPACK_ERROR("paxos 2a::begin");
-        po6::threads::mutex::hold hold(&m_mtx);
         avoid_commit_if_possible(d);
         return;
     }
 
-    po6::threads::mutex::hold hold(&m_mtx);
     internal_begin("paxos 2a", timestamp, *group, dcs, d);
     work_state_machine(d);
 }
@@ -355,7 +415,7 @@ transaction :: internal_begin(const char* source, uint64_t timestamp,
     cmp.type = true;
 
     if (!resize_to_hold(0) ||
-        !m_ops[0].merge(op, cmp) ||
+        !m_ops[0].merge(op, cmp, &m_arena) ||
         (m_init_timestamp != 0 && m_init_timestamp != timestamp))
     {
         INVARIANT_VIOLATION("begin");
@@ -363,6 +423,8 @@ transaction :: internal_begin(const char* source, uint64_t timestamp,
         return;
     }
 
+    touch(NULL, d);
+
     if (m_init_timestamp == 0)
     {
         LOG_IF(INFO, s_debug_mode) << logid() << ".transaction_group: " << m_tg;
@@ -376,6 +438,13 @@ transaction :: internal_begin(const char* source, uint64_t timestamp,
         m_init_timestamp = timestamp;
         m_timestamp = std::max(m_timestamp, timestamp); // XXX replay
         m_group = group;
+        d->metrics_begin(m_tg.txid);
+        m_idle.set_timeout(d->get_config()->idle_timeout());
+
+        if (m_idle.timeout() == 0 && s_idle_timeout > 0)
+        {
+            m_idle.set_timeout(s_idle_timeout * PO6_SECONDS);
+        }
 
         for (unsigned i = 0; i < dcs.size() && i < CONSUS_MAX_REPLICATION_FACTOR; ++i)
         {
@@ -396,23 +465,45 @@ void
 transaction :: read(comm_id id, uint64_t nonce, uint64_t seqno,
                     const e::slice& table,
                     const e::slice& key,
-                    std::auto_ptr<e::buffer> _backing,
                     daemon* d)
 {
-    e::compat::shared_ptr<e::buffer> backing(_backing.release());
-    po6::threads::mutex::hold hold(&m_mtx);
     CLIENT_RETURN_IF_EXECUTED(seqno, id, nonce, "read");
-    internal_read("client", seqno, table, key, backing, d);
+
+    if (!admit(id, nonce, seqno, table, key.size(), d))
+    {
+        return;
+    }
+
+    internal_read("client", seqno, table, key, d);
     m_ops[seqno].require_lock = true;
     m_ops[seqno].require_read = true;
     m_ops[seqno].set_client(id, nonce);
     work_state_machine(d);
 }
 
+void
+transaction :: cached_read(uint64_t seqno,
+                           const e::slice& table,
+                           const e::slice& key,
+                           uint64_t timestamp,
+                           daemon* d)
+{
+    internal_read("client cache", seqno, table, key, d);
+
+    if (seqno >= m_ops.size() || m_ops[seqno].type != LOG_ENTRY_TX_READ)
+    {
+        return;
+    }
+
+    m_ops[seqno].require_lock = true;
+    m_ops[seqno].timestamp = timestamp;
+    m_ops[seqno].require_verify_read = true;
+}
+
 void
 transaction :: paxos_2a_read(uint64_t seqno,
                              e::unpacker up,
-                             std::auto_ptr<e::buffer> _backing,
+                             std::auto_ptr<e::buffer>,
                              daemon* d)
 {
     e::slice table;
@@ -423,14 +514,11 @@ transaction :: paxos_2a_read(uint64_t seqno,
     if (up.error() || up.remain())
     {
         UNPACK_ERROR("paxos 2a::read");
-        po6::threads::mutex::hold hold(&m_mtx);
         avoid_commit_if_possible(d);
         return;
     }
 
-    e::compat::shared_ptr<e::buffer> backing(_backing.release());
-    po6::threads::mutex::hold hold(&m_mtx);
-    internal_read("paxos 2a", seqno, table, key, backing, d);
+    internal_read("paxos 2a", seqno, table, key, d);
     m_ops[seqno].require_lock = true;
     m_ops[seqno].lock_acquired = true;
     m_ops[seqno].timestamp = timestamp;
@@ -440,7 +528,7 @@ transaction :: paxos_2a_read(uint64_t seqno,
 void
 transaction :: commit_record_read(uint64_t seqno,
                                   e::unpacker up,
-                                  e::compat::shared_ptr<e::buffer> backing,
+                                  e::compat::shared_ptr<e::buffer>,
                                   daemon* d)
 {
     e::slice table;
@@ -456,7 +544,7 @@ transaction :: commit_record_read(uint64_t seqno,
         return;
     }
 
-    internal_read("commit record", seqno, table, key, backing, d);
+    internal_read("commit record", seqno, table, key, d);
     m_ops[seqno].require_lock = true;
     m_ops[seqno].timestamp = timestamp;
     m_ops[seqno].require_verify_read = true;
@@ -466,7 +554,6 @@ void
 transaction :: internal_read(const char* source, uint64_t seqno,
                              const e::slice& table,
                              const e::slice& key,
-                             e::compat::shared_ptr<e::buffer> backing,
                              daemon* d)
 {
     ensure_initialized();
@@ -487,15 +574,16 @@ transaction :: internal_read(const char* source, uint64_t seqno,
     cmp.table = true;
     op.key = key;
     cmp.key = true;
-    op.backing = backing;
 
     if (!resize_to_hold(seqno) ||
-        !m_ops[seqno].merge(op, cmp))
+        !m_ops[seqno].merge(op, cmp, &m_arena))
     {
         LOG_IF(INFO, s_debug_mode) << logid() << " read failed; invariants violated";
         avoid_commit_if_possible(d);
         return;
     }
+
+    touch(&table, d);
 }
 
 void
@@ -503,13 +591,16 @@ transaction :: write(comm_id id, uint64_t nonce, uint64_t seqno,
                      const e::slice& table,
                      const e::slice& key,
                      const e::slice& value,
-                     std::auto_ptr<e::buffer> _backing,
                      daemon* d)
 {
-    e::compat::shared_ptr<e::buffer> backing(_backing.release());
-    po6::threads::mutex::hold hold(&m_mtx);
     CLIENT_RETURN_IF_EXECUTED(seqno, id, nonce, "write");
-    internal_write("client", seqno, table, key, value, backing, d);
+
+    if (!admit(id, nonce, seqno, table, key.size() + value.size(), d))
+    {
+        return;
+    }
+
+    internal_write("client", seqno, table, key, value, d);
     m_ops[seqno].require_lock = true;
     m_ops[seqno].require_write = true;
     m_ops[seqno].set_client(id, nonce);
@@ -519,7 +610,7 @@ transaction :: write(comm_id id, uint64_t nonce, uint64_t seqno,
 void
 transaction :: paxos_2a_write(uint64_t seqno,
                               e::unpacker up,
-                              std::auto_ptr<e::buffer> _backing,
+                              std::auto_ptr<e::buffer>,
                               daemon* d)
 {
     e::slice table;
@@ -530,14 +621,11 @@ transaction :: paxos_2a_write(uint64_t seqno,
     if (up.error() || up.remain())
     {
         UNPACK_ERROR("paxos 2a::write");
-        po6::threads::mutex::hold hold(&m_mtx);
         avoid_commit_if_possible(d);
         return;
     }
 
-    e::compat::shared_ptr<e::buffer> backing(_backing.release());
-    po6::threads::mutex::hold hold(&m_mtx);
-    internal_write("paxos 2a", seqno, table, key, value, backing, d);
+    internal_write("paxos 2a", seqno, table, key, value, d);
     m_ops[seqno].require_lock = true;
     m_ops[seqno].lock_acquired = true;
     m_ops[seqno].require_write = true;
@@ -547,7 +635,7 @@ transaction :: paxos_2a_write(uint64_t seqno,
 void
 transaction :: commit_record_write(uint64_t seqno,
                                    e::unpacker up,
-                                   e::compat::shared_ptr<e::buffer> backing,
+                                   e::compat::shared_ptr<e::buffer>,
                                    daemon* d)
 {
     e::slice table;
@@ -563,7 +651,7 @@ transaction :: commit_record_write(uint64_t seqno,
         return;
     }
 
-    internal_write("commit record", seqno, table, key, value, backing, d);
+    internal_write("commit record", seqno, table, key, value, d);
     m_ops[seqno].require_lock = true;
     m_ops[seqno].require_verify_write = true;
     m_ops[seqno].require_write = true;
@@ -574,7 +662,6 @@ transaction :: internal_write(const char* source, uint64_t seqno,
                               const e::slice& table,
                               const e::slice& key,
                               const e::slice& value,
-                              e::compat::shared_ptr<e::buffer> backing,
                               daemon* d)
 {
     ensure_initialized();
@@ -598,21 +685,21 @@ transaction :: internal_write(const char* source, uint64_t seqno,
     cmp.key = true;
     op.value = value;
     cmp.value = true;
-    op.backing = backing;
 
     if (!resize_to_hold(seqno) ||
-        !m_ops[seqno].merge(op, cmp))
+        !m_ops[seqno].merge(op, cmp, &m_arena))
     {
         LOG_IF(INFO, s_debug_mode) << logid() << " write failed; invariants violated";
         avoid_commit_if_possible(d);
         return;
     }
+
+    touch(&table, d);
 }
 
 void
 transaction :: prepare(comm_id id, uint64_t nonce, uint64_t seqno, daemon* d)
 {
-    po6::threads::mutex::hold hold(&m_mtx);
     CLIENT_RETURN_IF_EXECUTED(seqno, id, nonce, "prepare");
     internal_end_of_transaction("client", "prepare", LOG_ENTRY_TX_PREPARE, seqno, d);
     m_ops[seqno].set_client(id, nonce);
@@ -628,12 +715,10 @@ transaction :: paxos_2a_prepare(uint64_t seqno,
     if (up.error() || up.remain())
     {
         UNPACK_ERROR("paxos 2a::prepare");
-        po6::threads::mutex::hold hold(&m_mtx);
         avoid_commit_if_possible(d);
         return;
     }
 
-    po6::threads::mutex::hold hold(&m_mtx);
     internal_end_of_transaction("paxos 2a", "prepare", LOG_ENTRY_TX_PREPARE, seqno, d);
     work_state_machine(d);
 }
@@ -658,7 +743,6 @@ transaction :: commit_record_prepare(uint64_t seqno,
 void
 transaction :: abort(comm_id id, uint64_t nonce, uint64_t seqno, daemon* d)
 {
-    po6::threads::mutex::hold hold(&m_mtx);
     CLIENT_RETURN_IF_EXECUTED(seqno, id, nonce, "abort");
     internal_end_of_transaction("client", "abort", LOG_ENTRY_TX_ABORT, seqno, d);
     m_ops[seqno].set_client(id, nonce);
@@ -674,16 +758,47 @@ transaction :: paxos_2a_abort(uint64_t seqno,
     if (up.error() || up.remain())
     {
         UNPACK_ERROR("paxos 2a::abort");
-        po6::threads::mutex::hold hold(&m_mtx);
         avoid_commit_if_possible(d);
         return;
     }
 
-    po6::threads::mutex::hold hold(&m_mtx);
     internal_end_of_transaction("paxos 2a", "abort", LOG_ENTRY_TX_ABORT, seqno, d);
     work_state_machine(d);
 }
 
+bool
+transaction :: admit(comm_id id, uint64_t nonce, uint64_t seqno,
+                     const e::slice& table, uint64_t bytes, daemon* d)
+{
+    // a retransmission of an operation already in the log was charged when
+    // it first arrived
+    if (seqno < m_ops.size() && m_ops[seqno].type != LOG_ENTRY_NOP)
+    {
+        return true;
+    }
+
+    uint64_t retry_after = 0;
+
+    if (d->m_limiter.admit(id, table, bytes, po6::monotonic_time(), &retry_after))
+    {
+        return true;
+    }
+
+    LOG_IF(INFO, s_debug_mode) << logid() << ".ops[" << seqno << "]: throttled for " << retry_after << "ns";
+    // the client hears "throttled" through the usual abort response, once the
+    // abort is durable
+    internal_end_of_transaction("client", "throttle", LOG_ENTRY_TX_ABORT, seqno, d);
+
+    if (seqno < m_ops.size())
+    {
+        m_ops[seqno].set_client(id, nonce);
+        m_ops[seqno].retry_after = retry_after;
+    }
+
+    work_state_machine(d);
+    return false;
+}
+
 void
 transaction :: internal_end_of_transaction(const char* source, const char* func, log_entry_t let, uint64_t seqno, daemon* d)
 {
@@ -701,12 +816,14 @@ transaction :: internal_end_of_transaction(const char* source, const char* func,
     cmp.type = true;
 
     if (!resize_to_hold(seqno) ||
-        !m_ops[seqno].merge(op, cmp))
+        !m_ops[seqno].merge(op, cmp, &m_arena))
     {
         INVARIANT_VIOLATION(func);
         avoid_commit_if_possible(d);
         return;
     }
+
+    touch(NULL, d);
 }
 
 void
@@ -748,9 +865,8 @@ transaction :: paxos_2a(uint64_t seqno,
 void
 transaction :: paxos_2b(comm_id id, uint64_t seqno, daemon* d)
 {
-    po6::threads::mutex::hold hold(&m_mtx);
     internal_paxos_2b(id, seqno, d);
-    work_state_machine(d);
+    defer_state_machine(d);
 }
 
 void
@@ -806,18 +922,96 @@ transaction :: internal_paxos_2b(comm_id id, uint64_t seqno, daemon* d)
 }
 
 void
-transaction :: commit_record(e::slice commit_record, std::auto_ptr<e::buffer> _backing, daemon* d)
+transaction :: commit_record(comm_id id, paxos_group_id from,
+                             uint64_t index, uint64_t count,
+                             const e::slice& entries,
+                             std::auto_ptr<e::buffer> _backing,
+                             daemon* d)
 {
-    po6::threads::mutex::hold hold(&m_mtx);
+    if (index >= count || (m_cr_count != 0 && m_cr_count != count))
+    {
+        LOG(ERROR) << logid() << " dropping commit record chunk " << index << "/" << count
+                   << " that does not fit the " << m_cr_count << " chunks seen so far";
+        return;
+    }
+
+    m_cr_count = count;
 
-    if (!m_ops.empty())
+    if (index >= m_cr_applied && m_cr_pending.find(index) == m_cr_pending.end())
     {
-        work_state_machine(d);
+        e::compat::shared_ptr<e::buffer> backing(_backing.release());
+        m_cr_pending.insert(std::make_pair(index, pending_chunk_t(entries, backing)));
+    }
+
+    bool progress = false;
+
+    while (!m_cr_pending.empty() && m_cr_pending.begin()->first == m_cr_applied)
+    {
+        pending_chunk_t pc = m_cr_pending.begin()->second;
+        m_cr_pending.erase(m_cr_pending.begin());
+        apply_commit_record(pc.first, pc.second, d);
+        ++m_cr_applied;
+        progress = true;
+    }
+
+    if (progress)
+    {
+        const uint64_t now = po6::monotonic_time();
+
+        for (size_t i = 0; i < m_dcs_sz; ++i)
+        {
+            m_dcs_timestamps[i] = now;
+        }
+    }
+
+    if (m_cr_applied == m_cr_count &&
+        (m_ops.empty() || m_ops.back().type != LOG_ENTRY_TX_PREPARE))
+    {
+        ::abort(); // XXX
+    }
+
+    send_commit_record_ack(id, from, d);
+    work_state_machine(d);
+}
+
+void
+transaction :: commit_record_ack(comm_id id, paxos_group_id from,
+                                 uint64_t applied,
+                                 const std::vector<uint64_t>& received,
+                                 daemon* d)
+{
+    size_t idx = std::find(m_dcs, m_dcs + m_dcs_sz, from) - m_dcs;
+
+    // acks from a member we've since stopped sending to say nothing about
+    // what the current one holds
+    if (idx >= m_dcs_sz || m_cr_peers[idx] != id)
+    {
+        LOG_IF(INFO, s_debug_mode) << logid() << " dropping stale commit record ack from " << id;
         return;
     }
 
-    e::unpacker up(commit_record);
-    e::compat::shared_ptr<e::buffer> backing(_backing.release());
+    for (uint64_t i = 0; i < applied && i < m_cr_chunks.size(); ++i)
+    {
+        m_cr_chunks[i].acked[idx] = true;
+    }
+
+    for (size_t i = 0; i < received.size(); ++i)
+    {
+        if (received[i] < m_cr_chunks.size())
+        {
+            m_cr_chunks[received[i]].acked[idx] = true;
+        }
+    }
+
+    work_state_machine(d);
+}
+
+void
+transaction :: apply_commit_record(const e::slice& entries,
+                                   e::compat::shared_ptr<e::buffer> backing,
+                                   daemon* d)
+{
+    e::unpacker up(entries);
 
     while (!up.error() && up.remain())
     {
@@ -872,49 +1066,35 @@ transaction :: commit_record(e::slice commit_record, std::auto_ptr<e::buffer> _b
         }
     }
 
-    const uint64_t now = po6::monotonic_time();
-
-    for (size_t i = 0; i < m_dcs_sz; ++i)
-    {
-        m_dcs_timestamps[i] = now;
-    }
-
     if (up.error())
     {
         ::abort(); // XXX
     }
-
-    if (m_ops.empty() || m_ops.back().type != LOG_ENTRY_TX_PREPARE)
-    {
-        ::abort(); // XXX
-    }
-
-    work_state_machine(d);
 }
 
 void
-transaction :: callback_durable(uint64_t seqno, daemon* d)
+transaction :: callback_durable(const std::vector<uint64_t>& seqnos, daemon* d)
 {
+    for (size_t i = 0; i < seqnos.size(); ++i)
     {
-        po6::threads::mutex::hold hold(&m_mtx);
+        const uint64_t seqno = seqnos[i];
         LOG_IF(INFO, s_debug_mode) << logid() << ".ops[" << seqno << "]: durable on this host";
 
         if (seqno >= m_ops.size())
         {
-            return;
+            continue;
         }
 
         m_ops[seqno].log_write_durable = true;
+        internal_paxos_2b(d->m_us.id, seqno, d);
     }
 
-    paxos_2b(d->m_us.id, seqno, d);
+    defer_state_machine(d);
 }
 
 void
 transaction :: callback_locked(consus_returncode rc, uint64_t seqno, daemon* d)
 {
-    po6::threads::mutex::hold hold(&m_mtx);
-
     if (seqno >= m_ops.size())
     {
         LOG_IF(INFO, s_debug_mode) << logid() << ".ops[" << seqno << "]: lock callback dropped";
@@ -930,14 +1110,12 @@ transaction :: callback_locked(consus_returncode rc, uint64_t seqno, daemon* d)
         m_ops[seqno].lock_acquired = true;
     }
 
-    work_state_machine(d);
+    defer_state_machine(d);
 }
 
 void
 transaction :: callback_unlocked(consus_returncode rc, uint64_t seqno, daemon* d)
 {
-    po6::threads::mutex::hold hold(&m_mtx);
-
     if (seqno >= m_ops.size())
     {
         LOG_IF(INFO, s_debug_mode) << logid() << ".ops[" << seqno << "]: lock callback dropped";
@@ -953,15 +1131,14 @@ transaction :: callback_unlocked(consus_returncode rc, uint64_t seqno, daemon* d
         m_ops[seqno].lock_released = true;
     }
 
-    work_state_machine(d);
+    defer_state_machine(d);
 }
 
 void
 transaction :: callback_read(consus_returncode rc, uint64_t timestamp, const e::slice& value,
+                             e::compat::shared_ptr<e::buffer> backing,
                              uint64_t seqno, daemon*d)
 {
-    po6::threads::mutex::hold hold(&m_mtx);
-
     if (seqno >= m_ops.size())
     {
         LOG_IF(INFO, s_debug_mode) << logid() << ".ops[" << seqno << "]: read callback dropped";
@@ -975,20 +1152,18 @@ transaction :: callback_read(consus_returncode rc, uint64_t timestamp, const e::
     {
         m_ops[seqno].read_nonce = 0;
         m_ops[seqno].read_done = true;
-        m_ops[seqno].read_backing.assign(value.cdata(), value.size());
         m_ops[seqno].timestamp = timestamp;
-        m_ops[seqno].value = e::slice(m_ops[seqno].read_backing);
+        m_ops[seqno].value = value;
+        m_ops[seqno].read_backing = backing;
         m_ops[seqno].rc = rc;
     }
 
-    work_state_machine(d);
+    defer_state_machine(d);
 }
 
 void
 transaction :: callback_write(consus_returncode rc, uint64_t seqno, daemon* d)
 {
-    po6::threads::mutex::hold hold(&m_mtx);
-
     if (seqno >= m_ops.size())
     {
         LOG_IF(INFO, s_debug_mode) << logid() << ".ops[" << seqno << "]: write callback dropped";
@@ -1004,14 +1179,14 @@ transaction :: callback_write(consus_returncode rc, uint64_t seqno, daemon* d)
         m_ops[seqno].write_done = true;
     }
 
-    work_state_machine(d);
+    defer_state_machine(d);
 }
 
 void
 transaction :: callback_verify_read(consus_returncode rc, uint64_t timestamp, const e::slice&,
+                                    e::compat::shared_ptr<e::buffer>,
                                     uint64_t seqno, daemon*d)
 {
-    po6::threads::mutex::hold hold(&m_mtx);
     LOG_IF(INFO, s_debug_mode) << logid() << ".ops[" << seqno << "]: verify_read completed";
 
     if (seqno >= m_ops.size())
@@ -1032,14 +1207,14 @@ transaction :: callback_verify_read(consus_returncode rc, uint64_t timestamp, co
         }
     }
 
-    work_state_machine(d);
+    defer_state_machine(d);
 }
 
 void
 transaction :: callback_verify_write(consus_returncode rc, uint64_t timestamp, const e::slice&,
+                                     e::compat::shared_ptr<e::buffer>,
                                      uint64_t seqno, daemon*d)
 {
-    po6::threads::mutex::hold hold(&m_mtx);
     LOG_IF(INFO, s_debug_mode) << logid() << ".ops[" << seqno << "]: verify_read completed";
 
     if (seqno >= m_ops.size())
@@ -1060,22 +1235,78 @@ transaction :: callback_verify_write(consus_returncode rc, uint64_t timestamp, c
         }
     }
 
-    work_state_machine(d);
+    defer_state_machine(d);
+}
+
+void
+transaction :: callback_index_read(consus_returncode rc, uint64_t, const e::slice& value,
+                                   e::compat::shared_ptr<e::buffer>,
+                                   uint64_t seqno, daemon* d)
+{
+    if (seqno >= m_ops.size())
+    {
+        LOG_IF(INFO, s_debug_mode) << logid() << ".ops[" << seqno << "]: index read callback dropped";
+        return;
+    }
+
+    LOG_IF(INFO, s_debug_mode) << logid() << ".ops[" << seqno << "]: index read completed";
+    assert(rc == CONSUS_SUCCESS || rc == CONSUS_NOT_FOUND);// XXX unsafe
+
+    if (!m_ops[seqno].index_read_done)
+    {
+        m_ops[seqno].index_read_nonce = 0;
+        m_ops[seqno].index_read_done = true;
+
+        if (rc == CONSUS_SUCCESS)
+        {
+            m_ops[seqno].index_old = m_arena.copy(value);
+        }
+    }
+
+    defer_state_machine(d);
+}
+
+void
+transaction :: callback_index_write(consus_returncode rc, uint64_t seqno, daemon* d)
+{
+    if (seqno >= m_ops.size())
+    {
+        LOG_IF(INFO, s_debug_mode) << logid() << ".ops[" << seqno << "]: index write callback dropped";
+        return;
+    }
+
+    LOG_IF(INFO, s_debug_mode) << logid() << ".ops[" << seqno << "]: index write completed";
+    assert(rc == CONSUS_SUCCESS || rc == CONSUS_LESS_DURABLE);// XXX unsafe
+
+    if (m_ops[seqno].index_writes_pending > 0)
+    {
+        --m_ops[seqno].index_writes_pending;
+    }
+
+    defer_state_machine(d);
 }
 
 void
 transaction :: externally_work_state_machine(daemon* d)
 {
-    po6::threads::mutex::hold hold(&m_mtx);
     work_state_machine(d);
 }
 
+void
+transaction :: run_deferred_state_machine(daemon* d)
+{
+    // skipped if something else worked the state machine in the meantime
+    if (m_deferred.pending())
+    {
+        work_state_machine(d);
+    }
+}
+
 std::string
 transaction :: debug_dump()
 {
     std::ostringstream ostr;
-    po6::threads::mutex::hold hold(&m_mtx);
-    ostr << m_state;
+    ostr << static_cast<state_t>(e::atomic::load_32_acquire(&m_published_state));
     return ostr.str();
 }
 
@@ -1085,18 +1316,36 @@ transaction :: logid()
     return transaction_group::log(m_tg);
 }
 
+void
+transaction :: set_state(state_t s)
+{
+    m_state = s;
+    e::atomic::store_32_release(&m_published_state, s);
+}
+
 void
 transaction :: ensure_initialized()
 {
     if (m_state == INITIALIZED)
     {
-        m_state = EXECUTING;
+        set_state(EXECUTING);
+    }
+}
+
+void
+transaction :: defer_state_machine(daemon* d)
+{
+    if (m_deferred.defer())
+    {
+        d->defer_state_machine(m_tg);
     }
 }
 
 void
 transaction :: work_state_machine(daemon* d)
 {
+    m_deferred.start_pass();
+
     if (m_init_timestamp == 0)
     {
         return;
@@ -1128,6 +1377,9 @@ void
 transaction :: work_state_machine_executing(daemon* d)
 {
     size_t done = 0;
+    // an operation still in flight means the client is waiting on us, not
+    // the other way around
+    bool busy = false;
 
     for (size_t i = 0; i < m_ops.size(); ++i)
     {
@@ -1139,24 +1391,28 @@ transaction :: work_state_machine_executing(daemon* d)
         if (m_ops[i].require_lock && !m_ops[i].lock_acquired)
         {
             acquire_lock(i, d);
+            busy = true;
             continue;
         }
 
         if (m_ops[i].require_read && !m_ops[i].read_done)
         {
             start_read(i, d);
+            busy = true;
             continue;
         }
 
         if (m_ops[i].require_verify_read && !m_ops[i].verify_read_done)
         {
             start_verify_read(i, d);
+            busy = true;
             continue;
         }
 
         if (m_ops[i].require_verify_write && !m_ops[i].verify_write_done)
         {
             start_verify_write(i, d);
+            busy = true;
             continue;
         }
 
@@ -1167,12 +1423,13 @@ transaction :: work_state_machine_executing(daemon* d)
 
         if (!is_durable(i))
         {
+            busy = true;
             send_paxos_2a(i, d);
 
             if (!m_ops[i].log_write_issued)
             {
-                std::string le = generate_log_entry(i);
-                d->callback_when_durable(le, m_tg, i);
+                generate_log_entry(i, &m_scratch);
+                d->callback_when_durable(m_scratch, m_tg, i);
                 m_ops[i].log_write_issued = true;
             }
 
@@ -1192,7 +1449,7 @@ transaction :: work_state_machine_executing(daemon* d)
          m_ops.back().type == LOG_ENTRY_TX_ABORT))
     {
         LOG_IF(INFO, s_debug_mode) << logid() << " finished execuing all operations; transitioning to DATA CENTER VOTE state";
-        m_state = LOCAL_COMMIT_VOTE;
+        set_state(LOCAL_COMMIT_VOTE);
         return work_state_machine(d);
     }
 
@@ -1204,9 +1461,46 @@ transaction :: work_state_machine_executing(daemon* d)
     if (lv->outcome(&outcome))
     {
         LOG_IF(INFO, s_debug_mode) << logid() << " short-circuiting operations to abort (possible deadlock prevention)";
-        m_state = LOCAL_COMMIT_VOTE;
+        set_state(LOCAL_COMMIT_VOTE);
         return work_state_machine(d);
     }
+
+    if (busy)
+    {
+        touch(NULL, d);
+    }
+    else if (idle_too_long() && !m_idle_wounded)
+    {
+        LOG(INFO) << logid() << " aborting because the client has been idle for more than "
+                  << m_idle.timeout() / PO6_MILLIS << "ms";
+        m_idle_wounded = true;
+        d->metrics_idle_abort();
+        lv->wound(d);
+    }
+}
+
+void
+transaction :: touch(const e::slice* table, daemon* d)
+{
+    m_idle.touch(po6::monotonic_time());
+
+    if (table)
+    {
+        m_idle.tighten(d->get_config()->idle_timeout(*table));
+    }
+}
+
+bool
+transaction :: idle_too_long()
+{
+    if (m_ops.empty() ||
+        m_ops.back().type == LOG_ENTRY_TX_PREPARE ||
+        m_ops.back().type == LOG_ENTRY_TX_ABORT)
+    {
+        return false;
+    }
+
+    return m_idle.expired(po6::monotonic_time());
 }
 
 void
@@ -1246,13 +1540,13 @@ transaction :: work_state_machine_local_commit_vote(daemon* d)
         if (single_dc)
         {
             LOG_IF(INFO, s_debug_mode) << logid() << " data center vote chose COMMIT; transitioning to COMMITTED state";
-            m_state = COMMITTED;
+            set_state(COMMITTED);
             record_commit(d);
         }
         else
         {
             LOG_IF(INFO, s_debug_mode) << logid() << " data center vote chose COMMIT; transitioning to GLOBAL VOTE state";
-            m_state = GLOBAL_COMMIT_VOTE;
+            set_state(GLOBAL_COMMIT_VOTE);
         }
     }
     else if (outcome == CONSUS_VOTE_ABORT)
@@ -1261,13 +1555,13 @@ transaction :: work_state_machine_local_commit_vote(daemon* d)
         if (single_dc || m_tg.group == m_tg.txid.group)
         {
             LOG_IF(INFO, s_debug_mode) << logid() << " data center vote chose ABORT; transitioning to ABORTED state";
-            m_state = ABORTED;
+            set_state(ABORTED);
             record_abort(d);
         }
         else
         {
             LOG_IF(INFO, s_debug_mode) << logid() << " data center vote chose ABORT; transitioning to GLOBAL VOTE state";
-            m_state = GLOBAL_COMMIT_VOTE;
+            set_state(GLOBAL_COMMIT_VOTE);
         }
     }
     else
@@ -1301,22 +1595,12 @@ transaction :: work_state_machine_global_commit_vote(daemon* d)
 
     if (undecided_sz > 0)
     {
-        std::string commit_record;
-        e::packer pa(&commit_record);
-
-        for (size_t i = 0; i < m_ops.size(); ++i)
+        if (m_cr_chunks.empty())
         {
-            if (m_ops[i].type == LOG_ENTRY_NOP)
-            {
-                continue;
-            }
-
-            std::string log_entry = generate_log_entry(i);
-            pa = pa << e::slice(log_entry);
+            generate_commit_record_chunks();
         }
 
         const configuration* c = d->get_config();
-        const uint64_t now = po6::monotonic_time();
 
         for (unsigned i = 0; i < undecided_sz; ++i)
         {
@@ -1334,25 +1618,7 @@ transaction :: work_state_machine_global_commit_vote(daemon* d)
                 ::abort();
             }
 
-            for (unsigned j = 0; j < g->members_sz; ++j)
-            {
-                // XXX coordinator failure sensitive
-                if (c->get_state(g->members[j]) == txman_state::ONLINE &&
-                    m_dcs_timestamps[idx] + d->resend_interval() < now)
-                {
-                    transaction_group tg(g->id, m_tg.txid);
-                    const size_t sz = BUSYBEE_HEADER_SIZE
-                                    + pack_size(COMMIT_RECORD)
-                                    + pack_size(tg)
-                                    + pack_size(e::slice(commit_record));
-                    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-                    msg->pack_at(BUSYBEE_HEADER_SIZE)
-                        << COMMIT_RECORD << tg << e::slice(commit_record);
-                    d->send(g->members[j], msg);
-                    m_dcs_timestamps[idx] = now;
-                    break;
-                }
-            }
+            send_commit_record(idx, *g, d);
         }
     }
 
@@ -1366,13 +1632,13 @@ transaction :: work_state_machine_global_commit_vote(daemon* d)
     if (outcome == CONSUS_VOTE_COMMIT)
     {
         LOG_IF(INFO, s_debug_mode) << logid() << " global vote chose COMMIT; transitioning to COMMITTED state";
-        m_state = COMMITTED;
+        set_state(COMMITTED);
         record_commit(d);
     }
     else if (outcome == CONSUS_VOTE_ABORT)
     {
         LOG_IF(INFO, s_debug_mode) << logid() << " global vote chose ABORT; transitioning to ABORTED state";
-        m_state = ABORTED;
+        set_state(ABORTED);
         record_abort(d);
     }
     else
@@ -1388,7 +1654,7 @@ void
 transaction :: work_state_machine_committed(daemon* d)
 {
     size_t non_nop = 0;
-    size_t done = 0;
+    size_t written = 0;
     m_decision = COMMITTED;
 
     for (size_t i = 0; i < m_ops.size(); ++i)
@@ -1406,12 +1672,52 @@ transaction :: work_state_machine_committed(daemon* d)
             continue;
         }
 
+        // index rows are covered by the document's lock; hold it until
+        // they're in place
+        if (m_ops[i].index_writes_pending > 0)
+        {
+            continue;
+        }
+
+        ++written;
+    }
+
+    if (written < non_nop)
+    {
+        return;
+    }
+
+    // append to the feed while the locks are still held, so the feed orders
+    // the writes to a key as the locks did, and acknowledge the commit only
+    // once the feed has the writes on disk
+    if (!m_changes_published)
+    {
+        m_changes_end = publish_changes(d);
+        m_changes_published = true;
+    }
+
+    const bool feed_durable = m_changes_end == 0 ||
+                              d->m_changes.durable_or_wait(m_changes_end, m_tg);
+    size_t done = 0;
+
+    for (size_t i = 0; i < m_ops.size(); ++i)
+    {
+        if (m_ops[i].type == LOG_ENTRY_NOP)
+        {
+            continue;
+        }
+
         if (m_ops[i].require_lock && !m_ops[i].lock_released)
         {
             release_lock(i, d);
             continue;
         }
 
+        if (!feed_durable)
+        {
+            continue;
+        }
+
         if (m_ops[i].client != comm_id())
         {
             send_committed_response(&m_ops[i], d);
@@ -1424,7 +1730,16 @@ transaction :: work_state_machine_committed(daemon* d)
     {
         send_tx_commit(d);
         LOG_IF(INFO, s_debug_mode) << logid() << " transitioning to TERMINATED state";
-        m_state = TERMINATED;
+        set_state(TERMINATED);
+
+        if (m_init_timestamp != 0)
+        {
+            LOG_IF(INFO, s_debug_mode) << logid() << " arena: " << m_arena.allocations() << " allocations, "
+                                       << m_arena.bytes() << "B used, " << m_arena.reserved() << "B in "
+                                       << m_arena.blocks() << " blocks";
+            d->metrics_terminated(m_tg.txid, true, m_arena);
+        }
+
         return work_state_machine(d);
     }
 }
@@ -1463,7 +1778,16 @@ transaction :: work_state_machine_aborted(daemon* d)
     {
         send_tx_abort(d);
         LOG_IF(INFO, s_debug_mode) << logid() << " transitioning to TERMINATED state";
-        m_state = TERMINATED;
+        set_state(TERMINATED);
+
+        if (m_init_timestamp != 0)
+        {
+            LOG_IF(INFO, s_debug_mode) << logid() << " arena: " << m_arena.allocations() << " allocations, "
+                                       << m_arena.bytes() << "B used, " << m_arena.reserved() << "B in "
+                                       << m_arena.blocks() << " blocks";
+            d->metrics_terminated(m_tg.txid, false, m_arena);
+        }
+
         return work_state_machine(d);
     }
 }
@@ -1578,6 +1902,31 @@ transaction :: start_write(uint64_t seqno, daemon* d)
     assert(seqno < m_ops.size());
     operation& op(m_ops[seqno]);
 
+    // every write lands at m_timestamp, so when a transaction writes a
+    // document more than once, only the last write may touch its index
+    // rows; otherwise one write's row and the next one's tombstone for it
+    // would share a timestamp and replicas could keep either
+    if (!op.index_resolved)
+    {
+        if (!overwritten_later(seqno))
+        {
+            d->get_config()->indexes_for(op.table, &op.indexes);
+        }
+
+        op.index_resolved = true;
+    }
+
+    if (!op.indexes.empty() && !op.index_read_done)
+    {
+        start_index_read(seqno, d);
+        return;
+    }
+
+    if (!op.indexes.empty() && !op.index_writes_issued)
+    {
+        start_index_writes(seqno, d);
+    }
+
     if (op.write_nonce == 0)
     {
         daemon::write_map_t::state_reference sr;
@@ -1620,12 +1969,87 @@ transaction :: start_verify_write(uint64_t seqno, daemon* d)
     }
 }
 
-std::string
-transaction :: generate_log_entry(uint64_t seqno)
+void
+transaction :: start_index_read(uint64_t seqno, daemon* d)
+{
+    assert(seqno < m_ops.size());
+    operation& op(m_ops[seqno]);
+
+    if (op.index_read_nonce == 0)
+    {
+        // read beneath our own timestamp so every member of the group sees
+        // the same prior document, even after one of them applies the write;
+        // this is the document as it stood before the transaction, which is
+        // what the last of its writes to the key must diff against
+        daemon::read_map_t::state_reference sr;
+        kvs_read* kv = d->create_read(&sr);
+        kv->callback_transaction(m_tg, seqno, &transaction::callback_index_read);
+        kv->read(op.table, op.key, m_timestamp - 1, d);
+        op.index_read_nonce = kv->state_key();
+    }
+}
+
+void
+transaction :: start_index_writes(uint64_t seqno, daemon* d)
+{
+    assert(seqno < m_ops.size());
+    operation& op(m_ops[seqno]);
+    assert(op.index_read_done && !op.index_writes_issued);
+    op.index_writes_issued = true;
+
+    for (size_t i = 0; i < op.indexes.size(); ++i)
+    {
+        const std::string table(op.indexes[i].index_table());
+        std::vector<std::string> tombstones;
+        std::vector<std::string> rows;
+        index_changes(op.indexes[i], op.key, op.index_old, op.value, &tombstones, &rows);
+
+        for (size_t j = 0; j < tombstones.size(); ++j)
+        {
+            daemon::write_map_t::state_reference sr;
+            kvs_write* kv = d->create_write(&sr);
+            kv->callback_transaction(m_tg, seqno, &transaction::callback_index_write);
+            kv->write(CONSUS_WRITE_TOMBSTONE, e::slice(table), e::slice(tombstones[j]), m_timestamp, e::slice(), d);
+            ++op.index_writes_pending;
+        }
+
+        for (size_t j = 0; j < rows.size(); ++j)
+        {
+            daemon::write_map_t::state_reference sr;
+            kvs_write* kv = d->create_write(&sr);
+            kv->callback_transaction(m_tg, seqno, &transaction::callback_index_write);
+            kv->write(0, e::slice(table), e::slice(rows[j]), m_timestamp, op.key, d);
+            ++op.index_writes_pending;
+        }
+    }
+}
+
+bool
+transaction :: overwritten_later(uint64_t seqno)
 {
     assert(seqno < m_ops.size());
-    std::string entry;
-    e::packer pa(&entry);
+    const operation& op(m_ops[seqno]);
+
+    for (size_t i = seqno + 1; i < m_ops.size(); ++i)
+    {
+        if (m_ops[i].type == LOG_ENTRY_TX_WRITE &&
+            m_ops[i].table == op.table &&
+            m_ops[i].key == op.key)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+transaction :: generate_log_entry(uint64_t seqno, std::string* entry)
+{
+    assert(seqno < m_ops.size());
+    // keeps its capacity, so a reused string stops allocating
+    entry->clear();
+    e::packer pa(entry);
     std::vector<paxos_group_id> dcs(m_dcs, m_dcs + m_dcs_sz);
     operation* op = &m_ops[seqno];
 
@@ -1658,43 +2082,175 @@ transaction :: generate_log_entry(uint64_t seqno)
         default:
             ::abort();
     }
+}
 
-    return entry;
+void
+transaction :: generate_commit_record_chunks()
+{
+    m_cr_chunks.push_back(commit_record_chunk());
+
+    for (size_t i = 0; i < m_ops.size(); ++i)
+    {
+        if (m_ops[i].type == LOG_ENTRY_NOP)
+        {
+            continue;
+        }
+
+        generate_log_entry(i, &m_scratch);
+
+        if (!m_cr_chunks.back().entries.empty() &&
+            m_cr_chunks.back().entries.size() + m_scratch.size() > CONSUS_COMMIT_RECORD_CHUNK)
+        {
+            m_cr_chunks.push_back(commit_record_chunk());
+        }
+
+        e::packer pa(&m_cr_chunks.back().entries);
+        pa = pa << e::slice(m_scratch);
+    }
+}
+
+void
+transaction :: send_commit_record(size_t idx, const paxos_group& g, daemon* d)
+{
+    const configuration* c = d->get_config();
+    const uint64_t now = po6::monotonic_time();
+    comm_id peer;
+
+    for (unsigned i = 0; i < g.members_sz; ++i)
+    {
+        // XXX coordinator failure sensitive
+        if (c->get_state(g.members[i]) == txman_state::ONLINE)
+        {
+            peer = g.members[i];
+            break;
+        }
+    }
+
+    if (peer == comm_id())
+    {
+        return;
+    }
+
+    // a different member has none of what the last one acknowledged
+    if (peer != m_cr_peers[idx])
+    {
+        for (size_t i = 0; i < m_cr_chunks.size(); ++i)
+        {
+            m_cr_chunks[i].sent[idx] = 0;
+            m_cr_chunks[i].acked[idx] = false;
+        }
+
+        m_cr_peers[idx] = peer;
+    }
+
+    size_t first = 0;
+
+    while (first < m_cr_chunks.size() && m_cr_chunks[first].acked[idx])
+    {
+        ++first;
+    }
+
+    transaction_group tg(g.id, m_tg.txid);
+    const uint64_t count = m_cr_chunks.size();
+
+    for (size_t i = first; i < m_cr_chunks.size() && i < first + CONSUS_COMMIT_RECORD_WINDOW; ++i)
+    {
+        commit_record_chunk* crc = &m_cr_chunks[i];
+
+        if (crc->acked[idx] ||
+            std::max(crc->sent[idx], m_dcs_timestamps[idx]) + d->resend_interval() >= now)
+        {
+            continue;
+        }
+
+        const uint64_t index = i;
+        const e::slice entries(crc->entries);
+        std::auto_ptr<e::buffer> msg = (message()
+            << COMMIT_RECORD
+            << tg
+            << m_tg.group
+            << index
+            << count
+            << entries).create();
+        d->send(peer, msg);
+        crc->sent[idx] = now;
+    }
+}
+
+void
+transaction :: send_commit_record_ack(comm_id id, paxos_group_id to, daemon* d)
+{
+    std::vector<uint64_t> received;
+
+    for (std::map<uint64_t, pending_chunk_t>::iterator it = m_cr_pending.begin();
+            it != m_cr_pending.end(); ++it)
+    {
+        received.push_back(it->first);
+    }
+
+    transaction_group tg(to, m_tg.txid);
+    std::auto_ptr<e::buffer> msg = (message()
+        << COMMIT_RECORD_ACK
+        << tg
+        << m_tg.group
+        << m_cr_applied
+        << received).create();
+    d->send(id, msg);
+}
+
+uint64_t
+transaction :: publish_changes(daemon* d)
+{
+    std::vector<change_feed::change> changes;
+
+    for (size_t i = 0; i < m_ops.size(); ++i)
+    {
+        if (m_ops[i].type != LOG_ENTRY_TX_WRITE)
+        {
+            continue;
+        }
+
+        changes.push_back(change_feed::change());
+        change_feed::change* c = &changes.back();
+        c->timestamp = m_timestamp;
+        c->txid = m_tg.txid;
+        c->table = m_ops[i].table.str();
+        c->key = m_ops[i].key.str();
+        c->value = m_ops[i].value.str();
+    }
+
+    return d->m_changes.publish(&changes);
 }
 
 void
 transaction :: record_commit(daemon* d)
 {
-    d->m_dispositions.put(m_tg, CONSUS_VOTE_COMMIT);
+    d->m_dispositions.commit(m_tg);
 }
 
 void
 transaction :: record_abort(daemon* d)
 {
-    d->m_dispositions.put(m_tg, CONSUS_VOTE_ABORT);
+    d->m_dispositions.abort(m_tg);
 }
 
 void
 transaction :: send_paxos_2a(uint64_t i, daemon* d)
 {
-    std::string le = generate_log_entry(i);
-    const size_t sz = BUSYBEE_HEADER_SIZE
-                    + pack_size(TXMAN_PAXOS_2A)
-                    + pack_size(e::slice(le));
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(BUSYBEE_HEADER_SIZE) << TXMAN_PAXOS_2A << e::slice(le);
+    generate_log_entry(i, &m_scratch);
+    std::auto_ptr<e::buffer> msg = (message()
+        << TXMAN_PAXOS_2A
+        << e::slice(m_scratch)).create();
     send_to_nondurable(i, msg, m_ops[i].paxos_timestamps, d);
 }
 
 void
 transaction :: send_paxos_2b(uint64_t i, daemon* d)
 {
-    const size_t sz = BUSYBEE_HEADER_SIZE
-                    + pack_size(TXMAN_PAXOS_2B)
-                    + pack_size(m_tg)
-                    + sizeof(uint64_t);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(BUSYBEE_HEADER_SIZE) << TXMAN_PAXOS_2B << m_tg << i;
+    std::auto_ptr<e::buffer> msg = (message()
+        << TXMAN_PAXOS_2B
+        << m_tg
+        << i).create();
     send_to_group(msg, m_ops[i].paxos_2b_timestamps, d);
 }
 
@@ -1745,13 +2301,10 @@ transaction :: send_committed_response(operation* op, daemon* d)
 void
 transaction :: send_committed_response(comm_id id, uint64_t nonce, daemon* d)
 {
-    const size_t sz = BUSYBEE_HEADER_SIZE
-                    + pack_size(CLIENT_RESPONSE)
-                    + sizeof(uint64_t)
-                    + pack_size(CONSUS_COMMITTED);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(BUSYBEE_HEADER_SIZE)
-        << CLIENT_RESPONSE << nonce << CONSUS_COMMITTED;
+    std::auto_ptr<e::buffer> msg = (message()
+        << CLIENT_RESPONSE
+        << nonce
+        << CONSUS_COMMITTED).create();
     d->send(id, msg);
 }
 
@@ -1763,20 +2316,25 @@ transaction :: send_aborted_response(operation* op, daemon* d)
         return;
     }
 
-    send_aborted_response(op->client, op->nonce, d);
+    if (op->retry_after > 0)
+    {
+        d->send_throttled(op->client, op->nonce, op->retry_after);
+    }
+    else
+    {
+        send_aborted_response(op->client, op->nonce, d);
+    }
+
     op->client = comm_id();
 }
 
 void
 transaction :: send_aborted_response(comm_id id, uint64_t nonce, daemon* d)
 {
-    const size_t sz = BUSYBEE_HEADER_SIZE
-                    + pack_size(CLIENT_RESPONSE)
-                    + sizeof(uint64_t)
-                    + pack_size(CONSUS_ABORTED);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(BUSYBEE_HEADER_SIZE)
-        << CLIENT_RESPONSE << nonce << CONSUS_ABORTED;
+    std::auto_ptr<e::buffer> msg = (message()
+        << CLIENT_RESPONSE
+        << nonce
+        << CONSUS_ABORTED).create();
     d->send(id, msg);
 }
 
@@ -1784,15 +2342,12 @@ void
 transaction :: send_tx_begin(operation* op, daemon* d)
 {
     std::vector<comm_id> ids(m_group.members, m_group.members + m_group.members_sz);
-    const size_t sz = BUSYBEE_HEADER_SIZE
-                    + pack_size(CLIENT_RESPONSE)
-                    + sizeof(uint64_t)
-                    + pack_size(CONSUS_SUCCESS)
-                    + pack_size(m_tg)
-                    + ::pack_size(ids);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(BUSYBEE_HEADER_SIZE)
-        << CLIENT_RESPONSE << op->nonce << CONSUS_SUCCESS << m_tg.txid << ids;
+    std::auto_ptr<e::buffer> msg = (message()
+        << CLIENT_RESPONSE
+        << op->nonce
+        << CONSUS_SUCCESS
+        << m_tg.txid
+        << ids).create();
     d->send(op->client, msg);
     op->client = comm_id();
 }
@@ -1800,19 +2355,12 @@ transaction :: send_tx_begin(operation* op, daemon* d)
 void
 transaction :: send_tx_read(operation* op, daemon* d)
 {
-    const size_t sz = BUSYBEE_HEADER_SIZE
-                    + pack_size(CLIENT_RESPONSE)
-                    + sizeof(uint64_t)
-                    + pack_size(op->rc)
-                    + sizeof(uint64_t)
-                    + pack_size(op->value);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(BUSYBEE_HEADER_SIZE)
+    std::auto_ptr<e::buffer> msg = (message()
         << CLIENT_RESPONSE
         << op->nonce
         << op->rc
         << op->timestamp
-        << op->value;
+        << op->value).create();
     d->send(op->client, msg);
     op->client = comm_id();
 }
@@ -1820,13 +2368,10 @@ transaction :: send_tx_read(operation* op, daemon* d)
 void
 transaction :: send_tx_write(operation* op, daemon* d)
 {
-    const size_t sz = BUSYBEE_HEADER_SIZE
-                    + pack_size(CLIENT_RESPONSE)
-                    + sizeof(uint64_t)
-                    + pack_size(CONSUS_SUCCESS);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(BUSYBEE_HEADER_SIZE)
-        << CLIENT_RESPONSE << op->nonce << CONSUS_SUCCESS;
+    std::auto_ptr<e::buffer> msg = (message()
+        << CLIENT_RESPONSE
+        << op->nonce
+        << CONSUS_SUCCESS).create();
     d->send(op->client, msg);
     op->client = comm_id();
 }
@@ -1839,13 +2384,10 @@ transaction :: send_tx_commit(daemon* d)
         return;
     }
 
-    const size_t sz = BUSYBEE_HEADER_SIZE
-                    + pack_size(CLIENT_RESPONSE)
-                    + sizeof(uint64_t)
-                    + pack_size(CONSUS_SUCCESS);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(BUSYBEE_HEADER_SIZE)
-        << CLIENT_RESPONSE << m_ops.back().nonce << CONSUS_SUCCESS;
+    std::auto_ptr<e::buffer> msg = (message()
+        << CLIENT_RESPONSE
+        << m_ops.back().nonce
+        << CONSUS_SUCCESS).create();
     d->send(m_ops.back().client, msg);
 }
 
@@ -1857,13 +2399,10 @@ transaction :: send_tx_abort(daemon* d)
         return;
     }
 
-    const size_t sz = BUSYBEE_HEADER_SIZE
-                    + pack_size(CLIENT_RESPONSE)
-                    + sizeof(uint64_t)
-                    + pack_size(CONSUS_ABORTED);
-    std::auto_ptr<e::buffer> msg(e::buffer::create(sz));
-    msg->pack_at(BUSYBEE_HEADER_SIZE)
-        << CLIENT_RESPONSE << m_ops.back().nonce << CONSUS_ABORTED;
+    std::auto_ptr<e::buffer> msg = (message()
+        << CLIENT_RESPONSE
+        << m_ops.back().nonce
+        << CONSUS_ABORTED).create();
     d->send(m_ops.back().client, msg);
 }
 
@@ -28,6 +28,9 @@
 #ifndef consus_txman_transaction_h_
 #define consus_txman_transaction_h_
 
+// STL
+#include <map>
+
 // consus
 #include <consus.h>
 #include "namespace.h"
@@ -35,12 +38,17 @@
 #include "common/ids.h"
 #include "common/transaction_id.h"
 #include "common/transaction_group.h"
+#include "txman/arena.h"
+#include "txman/deferred_queue.h"
+#include "txman/idle_timer.h"
 #include "txman/log_entry_t.h"
 #include "txman/paxos_synod.h"
 
 BEGIN_CONSUS_NAMESPACE
 class daemon;
 
+// Every call into a transaction happens on the daemon thread that owns its
+// transaction group, so a transaction takes no locks of its own.
 class transaction
 {
     public:
@@ -73,14 +81,20 @@ class transaction
         void read(comm_id id, uint64_t nonce, uint64_t seqno,
                   const e::slice& table,
                   const e::slice& key,
-                  std::auto_ptr<e::buffer> backing,
                   daemon* d);
         void write(comm_id id, uint64_t nonce, uint64_t seqno,
                    const e::slice& table,
                    const e::slice& key,
                    const e::slice& value,
-                   std::auto_ptr<e::buffer> backing,
                    daemon* d);
+        // a read the client answered from its cache; it's checked against
+        // the latest version once the lock is held, and the transaction will
+        // not commit if the key changed after timestamp
+        void cached_read(uint64_t seqno,
+                         const e::slice& table,
+                         const e::slice& key,
+                         uint64_t timestamp,
+                         daemon* d);
         void prepare(comm_id id, uint64_t nonce, uint64_t seqno, daemon* d);
         void abort(comm_id id, uint64_t nonce, uint64_t seqno, daemon* d);
 
@@ -88,31 +102,53 @@ class transaction
         void paxos_2a(uint64_t seqno, log_entry_t t, e::unpacker up,
                       std::auto_ptr<e::buffer> backing, daemon* d);
         void paxos_2b(comm_id id, uint64_t seqno, daemon* d);
-        void commit_record(e::slice commit_record,
+        // one chunk of the commit record shipped by data center "from"; the
+        // chunks are applied in order as they become contiguous
+        void commit_record(comm_id id, paxos_group_id from,
+                           uint64_t index, uint64_t count,
+                           const e::slice& entries,
                            std::auto_ptr<e::buffer> _backing,
                            daemon* d);
-        void callback_durable(uint64_t seqno, daemon* d);
+        void commit_record_ack(comm_id id, paxos_group_id from,
+                               uint64_t applied,
+                               const std::vector<uint64_t>& received,
+                               daemon* d);
+        // every operation in seqnos is now durable on this host
+        void callback_durable(const std::vector<uint64_t>& seqnos, daemon* d);
 
         // key value store callbacks
         void callback_locked(consus_returncode rc, uint64_t seqno, daemon* d);
         void callback_unlocked(consus_returncode rc, uint64_t seqno, daemon* d);
+        // value points into backing, which is shared rather than copied
         void callback_read(consus_returncode rc, uint64_t timestamp, const e::slice& value,
+                           e::compat::shared_ptr<e::buffer> backing,
                            uint64_t seqno, daemon*d);
         void callback_write(consus_returncode rc, uint64_t seqno, daemon* d);
         void callback_verify_read(consus_returncode rc, uint64_t timestamp, const e::slice& value,
+                                  e::compat::shared_ptr<e::buffer> backing,
                                   uint64_t seqno, daemon*d);
         void callback_verify_write(consus_returncode rc, uint64_t timestamp, const e::slice& value,
+                                   e::compat::shared_ptr<e::buffer> backing,
                                    uint64_t seqno, daemon*d);
+        void callback_index_read(consus_returncode rc, uint64_t timestamp, const e::slice& value,
+                                 e::compat::shared_ptr<e::buffer> backing,
+                                 uint64_t seqno, daemon*d);
+        void callback_index_write(consus_returncode rc, uint64_t seqno, daemon* d);
 
         void externally_work_state_machine(daemon* d);
+        // the daemon's half of defer_state_machine
+        void run_deferred_state_machine(daemon* d);
         std::string debug_dump();
         std::string logid();
 
     private:
         struct operation;
         struct comparison;
+        struct commit_record_chunk;
+        typedef std::pair<e::slice, e::compat::shared_ptr<e::buffer> > pending_chunk_t;
 
     private:
+        void set_state(state_t s);
         void ensure_initialized();
         void paxos_2a_begin(uint64_t seqno, e::unpacker up,
                             std::auto_ptr<e::buffer> backing, daemon* d);
@@ -132,6 +168,8 @@ class transaction
                                  e::compat::shared_ptr<e::buffer> backing, daemon* d);
         void commit_record_prepare(uint64_t seqno, e::unpacker up,
                                    e::compat::shared_ptr<e::buffer> backing, daemon* d);
+        void apply_commit_record(const e::slice& entries,
+                                 e::compat::shared_ptr<e::buffer> backing, daemon* d);
         void internal_begin(const char* source, uint64_t timestamp,
                             const paxos_group& group,
                             const std::vector<paxos_group_id>& dcs,
@@ -139,13 +177,11 @@ class transaction
         void internal_read(const char* source, uint64_t seqno,
                            const e::slice& table,
                            const e::slice& key,
-                           e::compat::shared_ptr<e::buffer> backing,
                            daemon* d);
         void internal_write(const char* source, uint64_t seqno,
                             const e::slice& table,
                             const e::slice& key,
                             const e::slice& value,
-                            e::compat::shared_ptr<e::buffer> backing,
                             daemon* d);
         void internal_end_of_transaction(const char* source,
                                          const char* op,
@@ -153,7 +189,15 @@ class transaction
                                          uint64_t seqno,
                                          daemon* d);
         void internal_paxos_2b(comm_id id, uint64_t seqno, daemon* d);
+        // charge a client's operation against its quotas; when over quota,
+        // abort in its place so the client restarts the transaction once the
+        // quota allows, and return false
+        bool admit(comm_id id, uint64_t nonce, uint64_t seqno,
+                   const e::slice& table, uint64_t bytes, daemon* d);
 
+        // callbacks come in bursts; rather than work the state machine for
+        // each, they leave it for the owning thread to run once afterwards
+        void defer_state_machine(daemon* d);
         void work_state_machine(daemon* d);
         void work_state_machine_executing(daemon* d);
         void work_state_machine_local_commit_vote(daemon* d);
@@ -163,6 +207,8 @@ class transaction
 
         // execution utils
         void avoid_commit_if_possible(daemon* d);
+        void touch(const e::slice* table, daemon* d);
+        bool idle_too_long();
         bool is_durable(uint64_t seqno);
         bool resize_to_hold(uint64_t seqno);
 
@@ -173,11 +219,18 @@ class transaction
         void start_write(uint64_t seqno, daemon* d);
         void start_verify_read(uint64_t seqno, daemon* d);
         void start_verify_write(uint64_t seqno, daemon* d);
+        void start_index_read(uint64_t seqno, daemon* d);
+        void start_index_writes(uint64_t seqno, daemon* d);
+        bool overwritten_later(uint64_t seqno);
 
         // inter-data center
-        std::string generate_log_entry(uint64_t seqno);
+        void generate_log_entry(uint64_t seqno, std::string* entry);
+        void generate_commit_record_chunks();
+        void send_commit_record(size_t idx, const paxos_group& g, daemon* d);
+        void send_commit_record_ack(comm_id id, paxos_group_id to, daemon* d);
 
         // commit
+        uint64_t publish_changes(daemon* d);
         void record_commit(daemon* d);
         void record_abort(daemon* d);
 
@@ -199,18 +252,43 @@ class transaction
 
     private:
         const transaction_group m_tg;
-        po6::threads::mutex m_mtx;
         uint64_t m_init_timestamp;
         paxos_group m_group;
         paxos_group_id m_dcs[CONSUS_MAX_REPLICATION_FACTOR];
         uint64_t m_dcs_timestamps[CONSUS_MAX_REPLICATION_FACTOR];
         size_t m_dcs_sz;
         state_t m_state;
+        // m_state as seen from threads other than the owner
+        uint32_t m_published_state;
         state_t m_decision;
         uint64_t m_timestamp;
         bool m_prefer_to_commit;
         std::vector<operation> m_ops;
         std::vector<std::pair<comm_id, uint64_t> > m_deferred_2b;
+        // outgoing commit record, acknowledged chunk-by-chunk by the member
+        // of each remote data center it was sent to
+        std::vector<commit_record_chunk> m_cr_chunks;
+        comm_id m_cr_peers[CONSUS_MAX_REPLICATION_FACTOR];
+        // incoming commit record
+        uint64_t m_cr_count;
+        uint64_t m_cr_applied;
+        std::map<uint64_t, pending_chunk_t> m_cr_pending;
+        // transactions that sit idle before they prepare are wounded so
+        // that a vanished client doesn't hold its locks forever
+        idle_timer m_idle;
+        bool m_idle_wounded;
+        // the owning thread will run the state machine
+        deferral m_deferred;
+        // the change feed position just past this transaction's writes; the
+        // commit is acknowledged once the feed is durable up to it
+        bool m_changes_published;
+        uint64_t m_changes_end;
+        // table, key, and value bytes of every operation, and the prior
+        // documents read for index maintenance; freed all at once with the
+        // transaction
+        arena m_arena;
+        // reused for each log entry this transaction serializes
+        std::string m_scratch;
 
     private:
         transaction(const transaction&);